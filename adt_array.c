@@ -1,10 +1,17 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "container_stats.h"
 
 typedef struct Array Array;
 typedef void (*Array_ElemDestroyFunc) (void* elem);
+typedef int (*Array_PredicateFunc) (void* elem, void* arg);   /* return non 0 to select elem. */
 
 struct Array {
     void** data;
@@ -12,6 +19,8 @@ struct Array {
     size_t length;
 
     Array_ElemDestroyFunc elemDestroy;
+
+    CONTAINER_STATS_FIELD(stats)
 };
 
 #define Array_At(arrPtr, index)   ((arrPtr)->data[(index)])
@@ -42,9 +51,11 @@ Array* Array_CreateNew(size_t capacity, Array_ElemDestroyFunc func) {
 
     if (arr->data == NULL) {
         free(arr);
-        arr = NULL;
+        return NULL;
     }
 
+    ContainerStats_Init(&arr->stats, "Array");
+    ContainerStats_OnAlloc(&arr->stats, arr->capacity * sizeof(void*));
     return arr;
 }
 
@@ -64,6 +75,7 @@ int Array_ExpandCapacity(Array* arr, size_t newCapacity) {
         return 0;
     }
 
+    ContainerStats_OnGrow(&arr->stats, arr->capacity * sizeof(void*), newCapacity * sizeof(void*));
     arr->data = temp;
     arr->capacity = newCapacity;
     return 1;
@@ -96,13 +108,60 @@ void Array_Remove(Array* arr, size_t index) {
         return;
     }
 
-    for (i = index; i < Array_Length(arr); ++i) {
+    for (i = index; i + 1 < Array_Length(arr); ++i) {
         Array_At(arr, i) = Array_At(arr, i + 1);
     }
 
     arr->length -= 1;
 }
 
+/* one stable pass: every kept element moves down at most once, over the removed ones before it. */
+static size_t Array_Filter(Array* arr, Array_PredicateFunc pred, void* arg, int removeSelected) {
+    size_t read, write = 0, removed;
+
+    for (read = 0; read < arr->length; ++read) {
+        if ((pred(arr->data[read], arg) != 0) == removeSelected) {
+            arr->elemDestroy(arr->data[read]);
+        }
+        else {
+            arr->data[write++] = arr->data[read];
+        }
+    }
+
+    removed = arr->length - write;
+    arr->length = write;
+    return removed;
+}
+
+/* remove every element pred selects in O(n), the order of the rest is kept. return how many were removed (and destroyed). */
+size_t Array_RemoveIf(Array* arr, Array_PredicateFunc pred, void* arg) {
+    return Array_Filter(arr, pred, arg, 1);
+}
+
+/* keep only the elements pred selects. */
+size_t Array_Retain(Array* arr, Array_PredicateFunc pred, void* arg) {
+    return Array_Filter(arr, pred, arg, 0);
+}
+
+#ifdef CONTAINER_STATS
+void Array_GetStats(Array* arr, ContainerStats* out) {
+    *out = arr->stats;
+}
+#endif
+
+int array_is_odd(void* elem, void* arg) {
+    return ((uintptr_t)elem & 1) != 0;
+}
+
+static double seconds_since(const struct timespec* begin) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - begin->tv_sec) + (double)(end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+#define ARRAY_BENCH_ELEMS   50000
+
 int main() {
     Array* arr = Array_CreateNew(0, NULL);
 
@@ -117,6 +176,45 @@ int main() {
         printf("%s\n", (char*)Array_At(arr, i));
     }
 
+    /* drop half of the elements: one Array_Remove per element shifts the tail every time, RemoveIf moves each element once. */
+    Array* other = Array_CreateNew(0, NULL);
+    struct timespec begin;
+    double removeSeconds, removeIfSeconds;
+
+    for (i = 0; i < ARRAY_BENCH_ELEMS; ++i) {
+        Array_PushBack(other, (void*)(uintptr_t)i);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (i = 0; i < Array_Length(other);) {
+        if (array_is_odd(Array_At(other, i), NULL)) {
+            Array_Remove(other, i);
+        }
+        else {
+            ++i;
+        }
+    }
+    removeSeconds = seconds_since(&begin);
+
+    other->length = 0;
+    for (i = 0; i < ARRAY_BENCH_ELEMS; ++i) {
+        Array_PushBack(other, (void*)(uintptr_t)i);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    Array_RemoveIf(other, array_is_odd, NULL);
+    removeIfSeconds = seconds_since(&begin);
+
+    printf("\nremove the odd ones of %d: Remove loop %.4f s, RemoveIf %.6f s, %zu left\n",
+           ARRAY_BENCH_ELEMS, removeSeconds, removeIfSeconds, Array_Length(other));
+    Array_Destroy(other);
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    Array_GetStats(arr, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
     Array_Destroy(arr);
     return 0;
 }
@@ -0,0 +1,486 @@
+/**
+ * dense bitset for integer ids: one bit per id instead of one int (or one hash node) per id.
+ *
+ * words are 64-byte aligned and padded to a whole block of 8 words (512 bits), so the word-wise
+ * loops have no scalar tail and vectorize cleanly. bits at or past Bitset_Size are always 0.
+ * popcount uses the AVX2 nibble lookup when built with -mavx2, otherwise the popcnt builtin.
+ *
+ * rank / select need Bitset_BuildRankIndex first, and the index must be rebuilt after the bitset
+ * changes. rank is O(1): one stored count per 512-bit block plus at most 8 word popcounts.
+ *
+ * build: cc -std=c11 -O2 -mavx2 -mbmi2 adt_bitset.c   (or just -O2 for the portable path)
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__AVX2__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#include "container_stats.h"
+
+#define BITSET_WORD_BITS     64
+#define BITSET_BLOCK_WORDS   8
+#define BITSET_BLOCK_BITS    (BITSET_WORD_BITS * BITSET_BLOCK_WORDS)
+#define BITSET_ALIGN         64
+#define BITSET_NPOS          ((size_t)-1)
+
+typedef struct Bitset Bitset;
+
+struct Bitset {
+    uint64_t* words;
+    size_t wordCount;     /* always a multiple of BITSET_BLOCK_WORDS. */
+    size_t size;          /* in bits. */
+
+    uint64_t* rankIndex;  /* set bits before each block, wordCount / BITSET_BLOCK_WORDS + 1 entries. */
+
+    CONTAINER_STATS_FIELD(stats)
+};
+
+#define Bitset_Size(bsPtr)         ((bsPtr)->size)
+#define Bitset_Words(bsPtr)        ((bsPtr)->words)
+#define Bitset_WordCount(bsPtr)    ((bsPtr)->wordCount)
+
+/* no bound check, index must be less than Bitset_Size. */
+#define Bitset_Test(bsPtr, index)    (((bsPtr)->words[(index) / BITSET_WORD_BITS] >> ((index) % BITSET_WORD_BITS)) & 1u)
+#define Bitset_Set(bsPtr, index)     ((bsPtr)->words[(index) / BITSET_WORD_BITS] |= (uint64_t)1 << ((index) % BITSET_WORD_BITS))
+#define Bitset_Clear(bsPtr, index)   ((bsPtr)->words[(index) / BITSET_WORD_BITS] &= ~((uint64_t)1 << ((index) % BITSET_WORD_BITS)))
+#define Bitset_Flip(bsPtr, index)    ((bsPtr)->words[(index) / BITSET_WORD_BITS] ^= (uint64_t)1 << ((index) % BITSET_WORD_BITS))
+
+/* visit every set bit in increasing order, cursor is a size_t. */
+#define Bitset_ForEach(bsPtr, cursor) \
+    for (cursor = Bitset_FindNext(bsPtr, 0); cursor != BITSET_NPOS; cursor = Bitset_FindNext(bsPtr, cursor + 1))
+
+static inline size_t Bitset_Popcount64(uint64_t w) {
+#if defined(__GNUC__)
+    return (size_t)__builtin_popcountll(w);
+#else
+    w = w - ((w >> 1) & 0x5555555555555555ull);
+    w = (w & 0x3333333333333333ull) + ((w >> 2) & 0x3333333333333333ull);
+    w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (size_t)((w * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+/* w must not be 0. */
+static inline size_t Bitset_CountTrailingZeros64(uint64_t w) {
+#if defined(__GNUC__)
+    return (size_t)__builtin_ctzll(w);
+#else
+    size_t n = 0;
+
+    while ((w & 1u) == 0) {
+        w >>= 1;
+        n += 1;
+    }
+
+    return n;
+#endif
+}
+
+/* position of the k-th (from 0) set bit of w, k must be less than the popcount of w. */
+static inline size_t Bitset_SelectInWord(uint64_t w, size_t k) {
+#if defined(__BMI2__)
+    return Bitset_CountTrailingZeros64(_pdep_u64((uint64_t)1 << k, w));
+#else
+    while (k > 0) {
+        w &= w - 1;
+        k -= 1;
+    }
+
+    return Bitset_CountTrailingZeros64(w);
+#endif
+}
+
+static size_t Bitset_PopcountWords(const uint64_t* words, size_t n) {
+    size_t i = 0;
+    size_t count = 0;
+
+#if defined(__AVX2__)
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    __m256i v, lo, hi, bytes;
+
+    for (; i + 4 <= n; i += 4) {
+        v = _mm256_loadu_si256((const __m256i*)(words + i));
+        lo = _mm256_and_si256(v, lowMask);
+        hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+        bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+    }
+
+    count = (size_t)_mm256_extract_epi64(acc, 0) + (size_t)_mm256_extract_epi64(acc, 1)
+          + (size_t)_mm256_extract_epi64(acc, 2) + (size_t)_mm256_extract_epi64(acc, 3);
+#endif
+
+    for (; i < n; ++i) {
+        count += Bitset_Popcount64(words[i]);
+    }
+
+    return count;
+}
+
+static size_t Bitset_WordCountOf(size_t bitCount) {
+    size_t blocks = (bitCount + BITSET_BLOCK_BITS - 1) / BITSET_BLOCK_BITS;
+    return (blocks != 0 ? blocks : 1) * BITSET_BLOCK_WORDS;
+}
+
+/* clear the bits at or past size in the last word, keeps the invariant after whole-word writes. */
+static void Bitset_ClearTail(Bitset* bs) {
+    size_t used = (bs->size + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+
+    if (bs->size % BITSET_WORD_BITS != 0) {
+        bs->words[used - 1] &= ((uint64_t)1 << (bs->size % BITSET_WORD_BITS)) - 1;
+    }
+
+    memset(bs->words + used, 0, (bs->wordCount - used) * sizeof(uint64_t));
+}
+
+Bitset* Bitset_CreateNew(size_t bitCount) {
+    Bitset* bs = (Bitset*)malloc(sizeof(Bitset));
+    if (bs == NULL) {
+        return NULL;
+    }
+
+    bs->size = bitCount;
+    bs->wordCount = Bitset_WordCountOf(bitCount);
+    bs->rankIndex = NULL;
+
+    if ((bs->words = (uint64_t*)aligned_alloc(BITSET_ALIGN, bs->wordCount * sizeof(uint64_t))) == NULL) {
+        free(bs);
+        return NULL;
+    }
+
+    memset(bs->words, 0, bs->wordCount * sizeof(uint64_t));
+    ContainerStats_Init(&bs->stats, "Bitset");
+    ContainerStats_OnAlloc(&bs->stats, bs->wordCount * sizeof(uint64_t));
+    return bs;
+}
+
+void Bitset_Destroy(Bitset* bs) {
+    free(bs->rankIndex);
+    free(bs->words);
+    free(bs);
+}
+
+/* new bits are 0, shrinking drops the bits past newBitCount. */
+int Bitset_Resize(Bitset* bs, size_t newBitCount) {
+    size_t newWordCount = Bitset_WordCountOf(newBitCount);
+    uint64_t* temp;
+
+    if (newWordCount > bs->wordCount) {
+        if ((temp = (uint64_t*)aligned_alloc(BITSET_ALIGN, newWordCount * sizeof(uint64_t))) == NULL) {
+            return 0;
+        }
+
+        memcpy(temp, bs->words, bs->wordCount * sizeof(uint64_t));
+        memset(temp + bs->wordCount, 0, (newWordCount - bs->wordCount) * sizeof(uint64_t));
+        ContainerStats_OnGrow(&bs->stats, bs->wordCount * sizeof(uint64_t), newWordCount * sizeof(uint64_t));
+
+        free(bs->words);
+        bs->words = temp;
+        bs->wordCount = newWordCount;
+    }
+
+    bs->size = newBitCount;
+    Bitset_ClearTail(bs);
+    return 1;
+}
+
+void Bitset_SetAll(Bitset* bs) {
+    memset(bs->words, 0xff, bs->wordCount * sizeof(uint64_t));
+    Bitset_ClearTail(bs);
+}
+
+void Bitset_ClearAll(Bitset* bs) {
+    memset(bs->words, 0, bs->wordCount * sizeof(uint64_t));
+}
+
+/**
+ * word-wise set operations, dst = dst op src. bits past the end of src count as 0, dst keeps its size.
+ * the loops are plain on purpose, -O2 / -O3 turns them into full-width vector code.
+ * dst and src may be the same bitset, so the word pointers are deliberately not restrict.
+ */
+#define BITSET_BINARY_OP(name, expr, clearRest)                                        \
+    void name(Bitset* dst, const Bitset* src) {                                        \
+        size_t i;                                                                      \
+        size_t n = dst->wordCount < src->wordCount ? dst->wordCount : src->wordCount; \
+        uint64_t* d = dst->words;                                                      \
+        const uint64_t* s = src->words;                                                \
+                                                                                       \
+        for (i = 0; i < n; ++i) {                                                      \
+            d[i] = (expr);                                                             \
+        }                                                                              \
+                                                                                       \
+        if (clearRest) {                                                               \
+            memset(d + n, 0, (dst->wordCount - n) * sizeof(uint64_t));                 \
+        }                                                                              \
+                                                                                       \
+        Bitset_ClearTail(dst);                                                         \
+    }
+
+BITSET_BINARY_OP(Bitset_And, d[i] & s[i], 1)
+BITSET_BINARY_OP(Bitset_Or, d[i] | s[i], 0)
+BITSET_BINARY_OP(Bitset_Xor, d[i] ^ s[i], 0)
+BITSET_BINARY_OP(Bitset_AndNot, d[i] & ~s[i], 0)
+
+#undef BITSET_BINARY_OP
+
+size_t Bitset_Count(const Bitset* bs) {
+    return Bitset_PopcountWords(bs->words, bs->wordCount);
+}
+
+/* |left & right| without writing the intersection anywhere. */
+size_t Bitset_IntersectCount(const Bitset* left, const Bitset* right) {
+    size_t i, j;
+    size_t count = 0;
+    size_t n = left->wordCount < right->wordCount ? left->wordCount : right->wordCount;
+    uint64_t block[BITSET_BLOCK_WORDS];
+
+    for (i = 0; i < n; i += BITSET_BLOCK_WORDS) {
+        for (j = 0; j < BITSET_BLOCK_WORDS; ++j) {
+            block[j] = left->words[i + j] & right->words[i + j];
+        }
+
+        count += Bitset_PopcountWords(block, BITSET_BLOCK_WORDS);
+    }
+
+    return count;
+}
+
+/* first set bit at or after from, BITSET_NPOS when there is none. */
+size_t Bitset_FindNext(const Bitset* bs, size_t from) {
+    size_t i = from / BITSET_WORD_BITS;
+    uint64_t w;
+
+    if (from >= bs->size) {
+        return BITSET_NPOS;
+    }
+
+    w = bs->words[i] & (~(uint64_t)0 << (from % BITSET_WORD_BITS));
+
+    while (w == 0) {
+        if (++i >= bs->wordCount) {
+            return BITSET_NPOS;
+        }
+
+        w = bs->words[i];
+    }
+
+    return i * BITSET_WORD_BITS + Bitset_CountTrailingZeros64(w);
+}
+
+int Bitset_BuildRankIndex(Bitset* bs) {
+    size_t blocks = bs->wordCount / BITSET_BLOCK_WORDS;
+    size_t b;
+    uint64_t* index = (uint64_t*)realloc(bs->rankIndex, (blocks + 1) * sizeof(uint64_t));
+
+    if (index == NULL) {
+        return 0;
+    }
+
+    index[0] = 0;
+    for (b = 0; b < blocks; ++b) {
+        index[b + 1] = index[b] + Bitset_PopcountWords(bs->words + b * BITSET_BLOCK_WORDS, BITSET_BLOCK_WORDS);
+    }
+
+    bs->rankIndex = index;
+    return 1;
+}
+
+/* set bits in [0, index), index past the end counts the whole bitset. */
+size_t Bitset_Rank(const Bitset* bs, size_t index) {
+    size_t word, i;
+    size_t rank;
+
+    if (index > bs->size) {
+        index = bs->size;
+    }
+
+    word = index / BITSET_WORD_BITS;
+    i = word / BITSET_BLOCK_WORDS * BITSET_BLOCK_WORDS;
+    rank = (size_t)bs->rankIndex[i / BITSET_BLOCK_WORDS];
+
+    for (; i < word; ++i) {
+        rank += Bitset_Popcount64(bs->words[i]);
+    }
+
+    if (index % BITSET_WORD_BITS != 0) {
+        rank += Bitset_Popcount64(bs->words[word] & (((uint64_t)1 << (index % BITSET_WORD_BITS)) - 1));
+    }
+
+    return rank;
+}
+
+/* position of the k-th (from 0) set bit, BITSET_NPOS when there are not that many. */
+size_t Bitset_Select(const Bitset* bs, size_t k) {
+    size_t lo = 0;
+    size_t hi = bs->wordCount / BITSET_BLOCK_WORDS;
+    size_t mid, i, pop;
+
+    if (k >= bs->rankIndex[hi]) {
+        return BITSET_NPOS;
+    }
+
+    /* last block whose leading count is <= k. */
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo) / 2;
+
+        if (bs->rankIndex[mid] <= k) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    k -= (size_t)bs->rankIndex[lo];
+
+    for (i = lo * BITSET_BLOCK_WORDS; ; ++i) {
+        pop = Bitset_Popcount64(bs->words[i]);
+
+        if (k < pop) {
+            return i * BITSET_WORD_BITS + Bitset_SelectInWord(bs->words[i], k);
+        }
+
+        k -= pop;
+    }
+}
+
+#ifdef CONTAINER_STATS
+void Bitset_GetStats(Bitset* bs, ContainerStats* out) {
+    *out = bs->stats;
+}
+#endif
+
+#define BENCH_BITS     (1u << 28)   /* 32 MiB per bitset. */
+#define BENCH_ROUNDS   20
+
+static double seconds_since(const struct timespec* begin) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - begin->tv_sec) + (double)(end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+void bench(void) {
+    Bitset* a = Bitset_CreateNew(BENCH_BITS);
+    Bitset* b = Bitset_CreateNew(BENCH_BITS);
+    struct timespec begin;
+    uint64_t x = 0x9e3779b97f4a7c15ull;
+    double bytes = (double)Bitset_WordCount(a) * sizeof(uint64_t);
+    double seconds;
+    size_t i, count = 0;
+
+    for (i = 0; i < Bitset_WordCount(a); ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        a->words[i] = x;
+        b->words[i] = x * 0xff51afd7ed558ccdull;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (i = 0; i < BENCH_ROUNDS; ++i) {
+        Bitset_Flip(a, i);   /* keeps the compiler from hoisting the count out of the loop. */
+        count += Bitset_Count(a);
+    }
+    seconds = seconds_since(&begin);
+    printf("count:     %.2f GB/s (%zu)\n", BENCH_ROUNDS * bytes / seconds / 1e9, count / BENCH_ROUNDS);
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (i = 0; i < BENCH_ROUNDS; ++i) {
+        Bitset_Xor(a, b);
+    }
+    seconds = seconds_since(&begin);
+    printf("xor:       %.2f GB/s (read 2, write 1)\n", BENCH_ROUNDS * 3 * bytes / seconds / 1e9);
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    count = 0;
+    for (i = 0; i < BENCH_ROUNDS; ++i) {
+        Bitset_Flip(a, i);
+        count += Bitset_IntersectCount(a, b);
+    }
+    seconds = seconds_since(&begin);
+    printf("intersect: %.2f GB/s (%zu)\n", BENCH_ROUNDS * 2 * bytes / seconds / 1e9, count / BENCH_ROUNDS);
+
+    Bitset_BuildRankIndex(a);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    count = 0;
+    for (i = 0; i < 10000000; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        count += Bitset_Rank(a, (size_t)(x % BENCH_BITS));
+    }
+    seconds = seconds_since(&begin);
+    printf("rank:      %.1f ns / op (%zu)\n", seconds * 1e9 / 10000000, count % 1000);
+
+    Bitset_Destroy(a);
+    Bitset_Destroy(b);
+}
+
+int main() {
+    Bitset* bs = Bitset_CreateNew(1000);
+    Bitset* other = Bitset_CreateNew(100);
+    size_t i, k;
+
+    for (i = 0; i < 1000; i += 3) {
+        Bitset_Set(bs, i);
+    }
+
+    for (i = 0; i < 100; i += 2) {
+        Bitset_Set(other, i);
+    }
+
+    Bitset_Clear(bs, 0);
+    printf("test 3: %d, test 4: %d, count: %zu\n", (int)Bitset_Test(bs, 3), (int)Bitset_Test(bs, 4), Bitset_Count(bs));
+    printf("multiples of 6 below 100: %zu\n", Bitset_IntersectCount(bs, other));
+
+    /* rank / select agree with a plain scan. */
+    Bitset_BuildRankIndex(bs);
+    k = 0;
+    for (i = 0; i < Bitset_Size(bs); ++i) {
+        if (Bitset_Rank(bs, i) != k || (Bitset_Test(bs, i) && Bitset_Select(bs, k) != i)) {
+            printf("rank / select mismatch at %zu\n", i);
+            return 1;
+        }
+
+        k += Bitset_Test(bs, i);
+    }
+    printf("rank(1000): %zu, select(%zu): %zu, select(%zu): %s\n", Bitset_Rank(bs, 1000), k - 1, Bitset_Select(bs, k - 1),
+           k, Bitset_Select(bs, k) == BITSET_NPOS ? "none" : "?");
+
+    Bitset_And(bs, other);
+    printf("and:");
+    Bitset_ForEach(bs, i) {
+        printf(" %zu", i);
+    }
+    printf("\n");
+
+    /* a bitset combined with itself. */
+    k = Bitset_Count(bs);
+    Bitset_And(bs, bs);
+    Bitset_Or(bs, bs);
+    i = Bitset_Count(bs);
+    Bitset_Xor(bs, bs);
+    printf("self and / or keeps %zu of %zu, self xor leaves %zu\n", i, k, Bitset_Count(bs));
+
+    Bitset_Resize(bs, 40);
+    Bitset_SetAll(bs);
+    printf("after resize to 40 and set all: %zu\n", Bitset_Count(bs));
+
+    Bitset_Destroy(bs);
+    Bitset_Destroy(other);
+
+    bench();
+    return 0;
+}
@@ -0,0 +1,410 @@
+/**
+ * insertion-ordered compact hash map.
+ *
+ * two arrays instead of chained nodes: a dense entries array holding (hash, key, value) in insertion
+ * order, and a small open-addressing index of int32 slot numbers pointing into it. iteration is a
+ * linear scan of the entries, the order is the insertion order, and there is no per-entry allocation.
+ *
+ * removal leaves a hole in the entries (skipped by ForEach) and a dummy in the index, holes are
+ * squeezed out when the entries array fills up. re-inserting a removed key puts it at the end.
+ *
+ * unlike HashMap the hash function returns the full 32 bits, the map picks its own slot.
+ *
+ * build: cc -std=c11 -O2 adt_compact_hashmap.c
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "container_stats.h"
+
+#define COMPACT_HASHMAP_MIN_CAPACITY   8
+#define COMPACT_HASHMAP_INDEX_EMPTY    (-1)
+#define COMPACT_HASHMAP_INDEX_DUMMY    (-2)   /* the entry was removed, keep probing. */
+
+typedef struct CompactHashMapEntry CompactHashMapEntry;
+typedef struct CompactHashMap CompactHashMap;
+typedef uint32_t HashType;
+
+typedef int (*CompactHashMap_CompareFunc) (void* left, void* right);   /* return 0 means equal. */
+typedef HashType (*CompactHashMap_KeyHashFunc) (void* key);            /* full 32 bits, no modulo. */
+
+typedef void (*CompactHashMap_KeyDestroyFunc) (void* key);
+typedef void (*CompactHashMap_ValueDestroyFunc) (void* value);
+
+struct CompactHashMapEntry {
+    HashType hash;
+    int isDeleted;
+    void* key;
+    void* value;
+};
+
+struct CompactHashMap {
+    int32_t* index;                  /* indexMask + 1 slots, each an entry number or EMPTY / DUMMY. */
+    size_t indexMask;
+    CompactHashMapEntry* entries;    /* insertion order. */
+    size_t entriesUsed;              /* live entries and holes. */
+    size_t entriesCapacity;
+    size_t length;                   /* live entries. */
+
+    CompactHashMap_CompareFunc compare;
+    CompactHashMap_KeyHashFunc hash;
+    CompactHashMap_KeyDestroyFunc keyDestroy;
+    CompactHashMap_ValueDestroyFunc valueDestroy;
+
+    CONTAINER_STATS_FIELD(stats)
+};
+
+#define CompactHashMap_Length(mapPtr)       ((mapPtr)->length)
+#define CompactHashMap_IsEmpty(mapPtr)      (CompactHashMap_Length(mapPtr) == 0)
+#define CompactHashMap_EntryKey(entryPtr)     ((entryPtr)->key)
+#define CompactHashMap_EntryValue(entryPtr)   ((entryPtr)->value)
+
+/* visit live entries in insertion order, entryPtr is a CompactHashMapEntry*. */
+#define CompactHashMap_ForEach(mapPtr, entryPtr) \
+    for ((entryPtr) = (mapPtr)->entries; (entryPtr) != (mapPtr)->entries + (mapPtr)->entriesUsed; ++(entryPtr)) \
+        if (!(entryPtr)->isDeleted)
+
+#define CompactHashMap_ForEachReverse(mapPtr, entryPtr) \
+    for ((entryPtr) = (mapPtr)->entries + (mapPtr)->entriesUsed; (entryPtr)-- != (mapPtr)->entries; ) \
+        if (!(entryPtr)->isDeleted)
+
+void CompactHashMap_DefaultKeyDestroyFunc(void* key) {}
+void CompactHashMap_DefaultValueDestroyFunc(void* value) {}
+
+/* index size for a given entries capacity: a power of 2 keeping the load at most 2/3. */
+static size_t CompactHashMap_IndexSizeFor(size_t entriesCapacity) {
+    size_t size = COMPACT_HASHMAP_MIN_CAPACITY;
+
+    while (size < entriesCapacity + entriesCapacity / 2) {
+        size *= 2;
+    }
+
+    return size;
+}
+
+/* rebuild the index over the live entries, squeezing the holes out of the entries array. */
+static void CompactHashMap_Rebuild(CompactHashMap* map) {
+    size_t i, slot, used = 0;
+
+    for (i = 0; i < map->entriesUsed; ++i) {
+        if (!map->entries[i].isDeleted) {
+            map->entries[used++] = map->entries[i];
+        }
+    }
+
+    map->entriesUsed = used;
+    memset(map->index, 0xff, (map->indexMask + 1) * sizeof(int32_t));   /* all EMPTY. */
+
+    for (i = 0; i < used; ++i) {
+        for (slot = map->entries[i].hash & map->indexMask; map->index[slot] != COMPACT_HASHMAP_INDEX_EMPTY; slot = (slot + 1) & map->indexMask) {}
+        map->index[slot] = (int32_t)i;
+    }
+}
+
+static int CompactHashMap_Resize(CompactHashMap* map, size_t entriesCapacity) {
+    size_t indexSize = CompactHashMap_IndexSizeFor(entriesCapacity);
+    CompactHashMapEntry* entries;
+    int32_t* index;
+
+    if (entriesCapacity > INT32_MAX) {
+        return 0;
+    }
+
+    if ((entries = (CompactHashMapEntry*)realloc(map->entries, entriesCapacity * sizeof(CompactHashMapEntry))) == NULL) {
+        return 0;
+    }
+
+    map->entries = entries;
+
+    if (indexSize != map->indexMask + 1) {
+        if ((index = (int32_t*)malloc(indexSize * sizeof(int32_t))) == NULL) {
+            return 0;
+        }
+
+        free(map->index);
+        map->index = index;
+        map->indexMask = indexSize - 1;
+    }
+
+    ContainerStats_OnGrow(&map->stats,
+                          map->entriesCapacity * sizeof(CompactHashMapEntry),
+                          entriesCapacity * sizeof(CompactHashMapEntry) + indexSize * sizeof(int32_t));
+    map->entriesCapacity = entriesCapacity;
+    CompactHashMap_Rebuild(map);
+    return 1;
+}
+
+CompactHashMap* CompactHashMap_CreateNew(CompactHashMap_CompareFunc compare,
+                                         CompactHashMap_KeyHashFunc hash,
+                                         CompactHashMap_KeyDestroyFunc keyDestroy,
+                                         CompactHashMap_ValueDestroyFunc valueDestroy) {
+    CompactHashMap* map;
+
+    if (compare == NULL || hash == NULL) {
+        return NULL;
+    }
+
+    if ((map = (CompactHashMap*)malloc(sizeof(CompactHashMap))) == NULL) {
+        return NULL;
+    }
+
+    map->index = NULL;
+    map->indexMask = 0;
+    map->entries = NULL;
+    map->entriesUsed = 0;
+    map->entriesCapacity = 0;
+    map->length = 0;
+    map->compare = compare;
+    map->hash = hash;
+    map->keyDestroy = (keyDestroy == NULL ? CompactHashMap_DefaultKeyDestroyFunc : keyDestroy);
+    map->valueDestroy = (valueDestroy == NULL ? CompactHashMap_DefaultValueDestroyFunc : valueDestroy);
+    ContainerStats_Init(&map->stats, "CompactHashMap");
+
+    if (!CompactHashMap_Resize(map, COMPACT_HASHMAP_MIN_CAPACITY)) {
+        free(map->entries);
+        free(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+void CompactHashMap_Destroy(CompactHashMap* map) {
+    CompactHashMapEntry* entry;
+
+    CompactHashMap_ForEach(map, entry) {
+        map->keyDestroy(entry->key);
+        map->valueDestroy(entry->value);
+    }
+
+    free(map->index);
+    free(map->entries);
+    free(map);
+}
+
+/* the index slot holding the entry with key, or -1. */
+static long CompactHashMap_FindSlot(CompactHashMap* map, HashType hash, void* key) {
+    size_t slot = hash & map->indexMask;
+    size_t probe = 0;
+    int32_t i;
+
+    while ((i = map->index[slot]) != COMPACT_HASHMAP_INDEX_EMPTY) {
+        probe += 1;
+
+        if (i >= 0 && map->entries[i].hash == hash && map->compare(map->entries[i].key, key) == 0) {
+            ContainerStats_OnProbe(&map->stats, probe);
+            return (long)slot;
+        }
+
+        slot = (slot + 1) & map->indexMask;
+    }
+
+    ContainerStats_OnProbe(&map->stats, probe);
+    return -1;
+}
+
+CompactHashMapEntry* CompactHashMap_Find(CompactHashMap* map, void* key) {
+    ContainerStats_OpBegin(&map->stats, opBegin);
+    long slot = CompactHashMap_FindSlot(map, map->hash(key), key);
+    ContainerStats_OpEnd(&map->stats, opBegin);
+    return (slot >= 0) ? &map->entries[map->index[slot]] : NULL;
+}
+
+/* a new key goes to the end of the iteration order, an existing key keeps its place. */
+int CompactHashMap_Insert(CompactHashMap* map, void* key, void* value) {
+    ContainerStats_OpBegin(&map->stats, opBegin);
+    HashType hash = map->hash(key);
+    long found = CompactHashMap_FindSlot(map, hash, key);
+    CompactHashMapEntry* entry;
+    size_t slot;
+
+    if (found >= 0) {
+        entry = &map->entries[map->index[found]];
+        map->keyDestroy(entry->key);
+        map->valueDestroy(entry->value);
+        entry->key = key;
+        entry->value = value;
+        ContainerStats_OpEnd(&map->stats, opBegin);
+        return 1;
+    }
+
+    if (map->entriesUsed == map->entriesCapacity) {
+        /* mostly holes: squeezing them out is enough, otherwise double. */
+        if (!CompactHashMap_Resize(map, (map->length < map->entriesCapacity / 2) ? map->entriesCapacity : 2 * map->entriesCapacity)) {
+            return 0;
+        }
+    }
+
+    /* the first EMPTY or DUMMY slot on the probe path. */
+    for (slot = hash & map->indexMask; map->index[slot] >= 0; slot = (slot + 1) & map->indexMask) {}
+
+    entry = &map->entries[map->entriesUsed];
+    entry->hash = hash;
+    entry->isDeleted = 0;
+    entry->key = key;
+    entry->value = value;
+
+    map->index[slot] = (int32_t)map->entriesUsed;
+    map->entriesUsed += 1;
+    map->length += 1;
+
+    ContainerStats_OpEnd(&map->stats, opBegin);
+    return 1;
+}
+
+void CompactHashMap_Remove(CompactHashMap* map, void* key) {
+    long slot = CompactHashMap_FindSlot(map, map->hash(key), key);
+    CompactHashMapEntry* entry;
+
+    if (slot < 0) {
+        return;
+    }
+
+    entry = &map->entries[map->index[slot]];
+    map->index[slot] = COMPACT_HASHMAP_INDEX_DUMMY;
+    map->keyDestroy(entry->key);
+    map->valueDestroy(entry->value);
+    entry->isDeleted = 1;
+    entry->key = entry->value = NULL;
+    map->length -= 1;
+}
+
+#ifdef CONTAINER_STATS
+/* copy the counters, and fill the probe run length histogram from the current index. */
+void CompactHashMap_GetStats(CompactHashMap* map, ContainerStats* out) {
+    size_t slot, run = 0;
+
+    *out = map->stats;
+    memset(out->chainHistogram, 0, sizeof(out->chainHistogram));
+
+    for (slot = 0; slot <= map->indexMask; ++slot) {
+        if (map->index[slot] != COMPACT_HASHMAP_INDEX_EMPTY) {
+            run += 1;
+        }
+        else if (run != 0) {
+            ContainerStats_OnChain(out, run);
+            run = 0;
+        }
+    }
+
+    if (run != 0) {
+        ContainerStats_OnChain(out, run);
+    }
+}
+#endif
+
+/* usage. */
+HashType compact_hash_c_style_str(void* key) {   /* hash_c_style_str without the modulo. */
+    const char* str = (const char*)key;
+    HashType hashval = 0;
+
+    for (; *str != '\0' ; ++str)
+        hashval = *str + hashval * 31;
+
+    return hashval;
+}
+
+int compare_c_style_str(void* left, void* right) {
+    return strcmp((const char*)(left), (const char*)(right));
+}
+
+HashType hash_uintptr(void* key) {
+    uint64_t x = (uint64_t)(uintptr_t)key;
+
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return (HashType)x;
+}
+
+int compare_uintptr(void* left, void* right) {
+    return left != right;
+}
+
+#define BENCH_ENTRIES   1000000
+
+void bench(void) {
+    CompactHashMap* map = CompactHashMap_CreateNew(compare_uintptr, hash_uintptr, NULL, NULL);
+    CompactHashMapEntry* entry;
+    struct timespec begin, end;
+    uintptr_t sum = 0;
+    size_t i, found = 0;
+    double iterateSeconds, findSeconds, bytes;
+
+    for (i = 1; i <= BENCH_ENTRIES; ++i) {
+        CompactHashMap_Insert(map, (void*)i, (void*)(i * 3));
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    CompactHashMap_ForEach(map, entry) {
+        sum += (uintptr_t)CompactHashMap_EntryValue(entry);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    iterateSeconds = (double)(end.tv_sec - begin.tv_sec) + (double)(end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (i = 1; i <= BENCH_ENTRIES; ++i) {
+        found += CompactHashMap_Find(map, (void*)(i * 7 % BENCH_ENTRIES + 1)) != NULL;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    findSeconds = (double)(end.tv_sec - begin.tv_sec) + (double)(end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    bytes = (double)(map->entriesCapacity * sizeof(CompactHashMapEntry) + (map->indexMask + 1) * sizeof(int32_t));
+    printf("%d entries: iterate %.2f ms (%zu), find %.1f ns (%zu found)\n", BENCH_ENTRIES, iterateSeconds * 1e3,
+           (size_t)(sum % 1000), findSeconds * 1e9 / BENCH_ENTRIES, found);
+    printf("  %.1f bytes / entry, a chained node is %zu bytes plus its malloc header and bucket slot\n",
+           bytes / BENCH_ENTRIES, 3 * sizeof(void*));
+
+    CompactHashMap_Destroy(map);
+}
+
+int main() {
+    CompactHashMap* map = CompactHashMap_CreateNew(compare_c_style_str, compact_hash_c_style_str, NULL, NULL);
+    CompactHashMapEntry* entry;
+
+    CompactHashMap_Insert(map, "abc", "def");
+    CompactHashMap_Insert(map, "ock", "dlcma");
+    CompactHashMap_Insert(map, "d3q", "lcke");
+    CompactHashMap_Insert(map, "fzc", "dddz");
+
+    /* find. */
+    entry = CompactHashMap_Find(map, "abc");
+    if (entry != NULL) {
+        printf("find %s -> %s\n", "abc", (const char*)CompactHashMap_EntryValue(entry));
+    }
+    else {
+        printf("not found\n");
+    }
+
+    CompactHashMap_Remove(map, "ock");
+    CompactHashMap_Insert(map, "ock", "again");   /* goes to the end. */
+    CompactHashMap_Insert(map, "abc", "xyz");     /* keeps its place. */
+
+    /* traverse, always in insertion order. */
+    printf("\ntraverse: \n");
+    CompactHashMap_ForEach(map, entry) {
+        printf("  {'%s': '%s'}\n", (const char*)CompactHashMap_EntryKey(entry), (const char*)CompactHashMap_EntryValue(entry));
+    }
+
+    printf("\nreverse: \n");
+    CompactHashMap_ForEachReverse(map, entry) {
+        printf("  {'%s': '%s'}\n", (const char*)CompactHashMap_EntryKey(entry), (const char*)CompactHashMap_EntryValue(entry));
+    }
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    CompactHashMap_GetStats(map, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
+    CompactHashMap_Destroy(map);
+
+    bench();
+    return 0;
+}
@@ -0,0 +1,1046 @@
+/**
+ * lock-free ordered map: a skip list after Fraser ("Practical lock-freedom", 2004) and Herlihy-Shavit,
+ * written with C11 atomics. any number of threads insert, remove, look up and scan ranges at once,
+ * nobody ever waits for a lock.
+ *
+ * a node is logically removed once the lowest bit of its next pointers is set (top level first, level
+ * 0 last, whoever sets the level 0 mark owns the removal); searches unlink marked nodes as they pass.
+ * lookups and scans never write, they step over marked nodes.
+ *
+ * memory: every thread works through a ConcurrentSkipListThread handle (ConcurrentSkipList_Attach).
+ * removed nodes are reclaimed with epochs: a node retired in epoch e is reused once the global epoch
+ * reached e + 3, by then no thread can still be looking at it. keys and values are destroyed at that
+ * point, on the thread reusing the node. nodes come from per-thread chunks and go back to a per-thread
+ * free list of their height, a node of height h always has the same size, so nothing is split or merged.
+ *
+ * keys must be distinct, Insert of a present key leaves the map unchanged. a scan sees every key that
+ * stays in the map during the scan, keys inserted or removed meanwhile may or may not be seen.
+ *
+ * build: cc -std=c11 -O2 adt_concurrent_skiplist.c -lpthread
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "container_stats.h"
+
+#define CONCURRENT_SKIP_LIST_MAX_HEIGHT      16   /* a level holds a quarter of the nodes of the one below. */
+#define CONCURRENT_SKIP_LIST_CHUNK_SIZE      (64 * 1024)
+#define CONCURRENT_SKIP_LIST_ADVANCE_PERIOD  64   /* retires between two attempts to advance the epoch. */
+
+#define CONCURRENT_SKIP_LIST_OUT_OF_MEMORY   0
+#define CONCURRENT_SKIP_LIST_SUCCESS         1
+#define CONCURRENT_SKIP_LIST_EXISTS          2   /* the key was present, the map is unchanged. */
+
+/* node states, decide who unlinks and retires a node removed while its insert is still linking it. */
+#define CONCURRENT_SKIP_LIST_INSERTING   0
+#define CONCURRENT_SKIP_LIST_LINKED      1
+#define CONCURRENT_SKIP_LIST_ABANDONED   2   /* removed during the insert, the inserter retires it. */
+
+typedef struct ConcurrentSkipListNode ConcurrentSkipListNode;
+typedef struct ConcurrentSkipListChunk ConcurrentSkipListChunk;
+typedef struct ConcurrentSkipListThread ConcurrentSkipListThread;
+typedef struct ConcurrentSkipList ConcurrentSkipList;
+
+typedef int (*ConcurrentSkipList_CompareFunc) (void* left, void* right);   /* < 0 means left goes first, 0 means equal. */
+typedef void (*ConcurrentSkipList_KeyDestroyFunc) (void* key);
+typedef void (*ConcurrentSkipList_ValueDestroyFunc) (void* value);
+typedef int (*ConcurrentSkipList_VisitFunc) (void* key, void* value, void* arg);   /* return 0 to stop the scan. */
+
+/* a next pointer with the lowest bit set means its node is removed at that level. */
+#define CONCURRENT_SKIP_LIST_MARKED(word)   (((word) & 1) != 0)
+#define CONCURRENT_SKIP_LIST_NODE(word)     ((ConcurrentSkipListNode*)((word) & ~(uintptr_t)1))
+
+struct ConcurrentSkipListNode {
+    void* key;
+    void* value;
+    ConcurrentSkipListNode* free;   /* next on a limbo or free list once retired. */
+    atomic_int state;
+    unsigned int height;
+    _Atomic(uintptr_t) next[];
+};
+
+struct ConcurrentSkipListChunk {
+    ConcurrentSkipListChunk* next;
+    _Alignas(ConcurrentSkipListNode) char data[];
+};
+
+struct ConcurrentSkipListThread {
+    atomic_uint_least64_t local;       /* epoch << 1 | 1 while inside an operation, 0 outside. */
+    atomic_int inUse;
+    ConcurrentSkipListThread* next;    /* registry, handles are only freed with the list. */
+
+    uint64_t epoch;                    /* the epoch of the current operation. */
+    ConcurrentSkipListNode* limbo[3];  /* retired nodes by epoch % 3. */
+    uint64_t limboEpoch[3];
+    size_t retired;
+
+    ConcurrentSkipListNode* freeNodes[CONCURRENT_SKIP_LIST_MAX_HEIGHT];   /* by height - 1. */
+    char* chunkCursor;
+    char* chunkEnd;
+    uint64_t seed;
+    CONTAINER_STATS_FIELD(stats)       /* the operations of this handle, only its thread updates it. */
+    char padding[64];                  /* keep the hot fields of two handles off one cache line. */
+};
+
+struct ConcurrentSkipList {
+    ConcurrentSkipListNode* head;      /* full height sentinel without key. */
+    atomic_size_t length;
+    atomic_uint_least64_t epoch;
+
+    _Atomic(ConcurrentSkipListThread*) threads;
+    _Atomic(ConcurrentSkipListChunk*) chunks;
+    atomic_size_t poolBytes;
+
+    ConcurrentSkipList_CompareFunc compare;
+    ConcurrentSkipList_KeyDestroyFunc keyDestroy;
+    ConcurrentSkipList_ValueDestroyFunc valueDestroy;
+};
+
+/* exact while no operation runs, approximate otherwise. */
+#define ConcurrentSkipList_Length(listPtr)      atomic_load_explicit(&(listPtr)->length, memory_order_relaxed)
+#define ConcurrentSkipList_IsEmpty(listPtr)     (ConcurrentSkipList_Length(listPtr) == 0)
+#define ConcurrentSkipList_PoolBytes(listPtr)   atomic_load_explicit(&(listPtr)->poolBytes, memory_order_relaxed)
+
+void ConcurrentSkipList_DefaultKeyDestroyFunc(void* key) {}
+void ConcurrentSkipList_DefaultValueDestroyFunc(void* value) {}
+
+static size_t ConcurrentSkipList_NodeSize(unsigned int height) {
+    return sizeof(ConcurrentSkipListNode) + height * sizeof(_Atomic(uintptr_t));
+}
+
+ConcurrentSkipList* ConcurrentSkipList_CreateNew(ConcurrentSkipList_CompareFunc compare,
+                                                 ConcurrentSkipList_KeyDestroyFunc keyDestroy,
+                                                 ConcurrentSkipList_ValueDestroyFunc valueDestroy) {
+    ConcurrentSkipList* list = (ConcurrentSkipList*)malloc(sizeof(ConcurrentSkipList));
+    unsigned int i;
+
+    if (list == NULL) {
+        return NULL;
+    }
+
+    if ((list->head = (ConcurrentSkipListNode*)malloc(ConcurrentSkipList_NodeSize(CONCURRENT_SKIP_LIST_MAX_HEIGHT))) == NULL) {
+        free(list);
+        return NULL;
+    }
+
+    list->head->key = list->head->value = NULL;
+    list->head->height = CONCURRENT_SKIP_LIST_MAX_HEIGHT;
+    atomic_init(&list->head->state, CONCURRENT_SKIP_LIST_LINKED);
+    for (i = 0; i < CONCURRENT_SKIP_LIST_MAX_HEIGHT; ++i) {
+        atomic_init(&list->head->next[i], (uintptr_t)0);
+    }
+
+    atomic_init(&list->length, 0);
+    atomic_init(&list->epoch, 0);
+    atomic_init(&list->threads, NULL);
+    atomic_init(&list->chunks, NULL);
+    atomic_init(&list->poolBytes, 0);
+    list->compare = compare;
+    list->keyDestroy = (keyDestroy == NULL ? ConcurrentSkipList_DefaultKeyDestroyFunc : keyDestroy);
+    list->valueDestroy = (valueDestroy == NULL ? ConcurrentSkipList_DefaultValueDestroyFunc : valueDestroy);
+    return list;
+}
+
+/* a handle for the calling thread, reusing one a finished thread detached. NULL when out of memory. */
+ConcurrentSkipListThread* ConcurrentSkipList_Attach(ConcurrentSkipList* list) {
+    ConcurrentSkipListThread* t;
+    int unused;
+    unsigned int i;
+
+    for (t = atomic_load_explicit(&list->threads, memory_order_acquire); t != NULL; t = t->next) {
+        unused = 0;
+        if (atomic_load_explicit(&t->inUse, memory_order_relaxed) == 0
+            && atomic_compare_exchange_strong_explicit(&t->inUse, &unused, 1, memory_order_acquire, memory_order_relaxed)) {
+            return t;
+        }
+    }
+
+    if ((t = (ConcurrentSkipListThread*)malloc(sizeof(ConcurrentSkipListThread))) == NULL) {
+        return NULL;
+    }
+
+    atomic_init(&t->local, 0);
+    atomic_init(&t->inUse, 1);
+    t->epoch = 0;
+    t->retired = 0;
+    t->chunkCursor = t->chunkEnd = NULL;
+    t->seed = 0x9e3779b97f4a7c15ull ^ (uint64_t)(uintptr_t)t;
+    ContainerStats_Init(&t->stats, "ConcurrentSkipList");
+
+    for (i = 0; i < 3; ++i) {
+        t->limbo[i] = NULL;
+        t->limboEpoch[i] = 0;
+    }
+
+    for (i = 0; i < CONCURRENT_SKIP_LIST_MAX_HEIGHT; ++i) {
+        t->freeNodes[i] = NULL;
+    }
+
+    t->next = atomic_load_explicit(&list->threads, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&list->threads, &t->next, t, memory_order_release, memory_order_relaxed)) {
+    }
+
+    return t;
+}
+
+/* the handle must not be used afterwards. its retired nodes wait for the next thread attaching. */
+void ConcurrentSkipList_Detach(ConcurrentSkipList* list, ConcurrentSkipListThread* t) {
+    atomic_store_explicit(&t->inUse, 0, memory_order_release);
+}
+
+/* the node is unreachable and no thread looks at it anymore. */
+static void ConcurrentSkipList_Reclaim(ConcurrentSkipList* list, ConcurrentSkipListThread* t, ConcurrentSkipListNode* node) {
+    list->keyDestroy(node->key);
+    list->valueDestroy(node->value);
+    node->free = t->freeNodes[node->height - 1];
+    t->freeNodes[node->height - 1] = node;
+}
+
+/* move on to the global epoch once every thread inside an operation has seen it. */
+static void ConcurrentSkipList_TryAdvance(ConcurrentSkipList* list) {
+    uint64_t epoch = atomic_load(&list->epoch);
+    uint_least64_t local;
+    ConcurrentSkipListThread* t;
+
+    for (t = atomic_load_explicit(&list->threads, memory_order_acquire); t != NULL; t = t->next) {
+        local = atomic_load(&t->local);
+
+        if ((local & 1) != 0 && (local >> 1) != epoch) {
+            return;
+        }
+    }
+
+    atomic_compare_exchange_strong(&list->epoch, &epoch, epoch + 1);
+}
+
+static void ConcurrentSkipList_Enter(ConcurrentSkipList* list, ConcurrentSkipListThread* t) {
+    ConcurrentSkipListNode* node;
+    uint64_t epoch;
+    unsigned int i;
+
+    /**
+     * the global epoch must not have moved between reading and publishing it: then it stays within one
+     * of the published value until Exit, and so do the epochs nodes retired here are tagged with.
+     */
+    do {
+        epoch = atomic_load(&list->epoch);
+        atomic_store(&t->local, (epoch << 1) | 1);
+    } while (atomic_load(&list->epoch) != epoch);
+
+    if (epoch != t->epoch) {
+        for (i = 0; i < 3; ++i) {
+            if (t->limbo[i] != NULL && t->limboEpoch[i] + 3 <= epoch) {
+                while ((node = t->limbo[i]) != NULL) {
+                    t->limbo[i] = node->free;
+                    ConcurrentSkipList_Reclaim(list, t, node);
+                }
+            }
+        }
+
+        t->epoch = epoch;
+    }
+}
+
+static void ConcurrentSkipList_Exit(ConcurrentSkipListThread* t) {
+    atomic_store_explicit(&t->local, 0, memory_order_release);
+}
+
+/* the node is unlinked at every level, threads that found it before may still read it. */
+static void ConcurrentSkipList_Retire(ConcurrentSkipList* list, ConcurrentSkipListThread* t, ConcurrentSkipListNode* node) {
+    unsigned int slot = (unsigned int)(t->epoch % 3);   /* Enter emptied it if it held an older epoch. */
+
+    node->free = t->limbo[slot];
+    t->limbo[slot] = node;
+    t->limboEpoch[slot] = t->epoch;
+
+    if (++t->retired % CONCURRENT_SKIP_LIST_ADVANCE_PERIOD == 0) {
+        ConcurrentSkipList_TryAdvance(list);
+    }
+}
+
+/* from the free list of its height, else from the thread's chunk. NULL when out of memory. */
+static ConcurrentSkipListNode* ConcurrentSkipList_AllocNode(ConcurrentSkipList* list, ConcurrentSkipListThread* t, unsigned int height) {
+    ConcurrentSkipListNode* node = t->freeNodes[height - 1];
+    ConcurrentSkipListChunk* chunk;
+    size_t size = ConcurrentSkipList_NodeSize(height);
+
+    if (node != NULL) {
+        t->freeNodes[height - 1] = node->free;
+        return node;
+    }
+
+    if ((size_t)(t->chunkEnd - t->chunkCursor) < size) {
+        if ((chunk = (ConcurrentSkipListChunk*)malloc(sizeof(ConcurrentSkipListChunk) + CONCURRENT_SKIP_LIST_CHUNK_SIZE)) == NULL) {
+            return NULL;
+        }
+
+        chunk->next = atomic_load_explicit(&list->chunks, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&list->chunks, &chunk->next, chunk, memory_order_release, memory_order_relaxed)) {
+        }
+
+        atomic_fetch_add_explicit(&list->poolBytes, sizeof(ConcurrentSkipListChunk) + CONCURRENT_SKIP_LIST_CHUNK_SIZE, memory_order_relaxed);
+        ContainerStats_OnAlloc(&t->stats, sizeof(ConcurrentSkipListChunk) + CONCURRENT_SKIP_LIST_CHUNK_SIZE);
+        t->chunkCursor = chunk->data;
+        t->chunkEnd = chunk->data + CONCURRENT_SKIP_LIST_CHUNK_SIZE;
+    }
+
+    node = (ConcurrentSkipListNode*)t->chunkCursor;
+    t->chunkCursor += size;
+    return node;
+}
+
+static unsigned int ConcurrentSkipList_RandomHeight(ConcurrentSkipListThread* t) {
+    uint64_t x = t->seed;
+    unsigned int height = 1;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    t->seed = x;
+
+    for (x >>= 16; height < CONCURRENT_SKIP_LIST_MAX_HEIGHT && (x & 3) == 0; x >>= 2) {
+        height += 1;
+    }
+
+    return height;
+}
+
+/**
+ * fill preds / succs with the neighbours of key at every level, unlinking the marked nodes on the way.
+ * succs[level] is the first node not less than key. return 1 when succs[0] holds key.
+ */
+static int ConcurrentSkipList_Search(ConcurrentSkipList* list, void* key, ConcurrentSkipListNode** preds, ConcurrentSkipListNode** succs) {
+    ConcurrentSkipListNode* pred;
+    ConcurrentSkipListNode* curr;
+    uintptr_t succ, expected;
+    int level;
+
+retry:
+    pred = list->head;
+
+    for (level = CONCURRENT_SKIP_LIST_MAX_HEIGHT - 1; level >= 0; --level) {
+        curr = CONCURRENT_SKIP_LIST_NODE(atomic_load_explicit(&pred->next[level], memory_order_acquire));
+
+        while (curr != NULL) {
+            succ = atomic_load_explicit(&curr->next[level], memory_order_acquire);
+
+            if (CONCURRENT_SKIP_LIST_MARKED(succ)) {
+                expected = (uintptr_t)curr;
+                if (!atomic_compare_exchange_strong_explicit(&pred->next[level], &expected, succ & ~(uintptr_t)1,
+                                                             memory_order_acq_rel, memory_order_acquire)) {
+                    goto retry;   /* pred got removed or something was linked after it. */
+                }
+
+                curr = CONCURRENT_SKIP_LIST_NODE(succ);
+                continue;
+            }
+
+            if (list->compare(curr->key, key) >= 0) {
+                break;
+            }
+
+            pred = curr;
+            curr = CONCURRENT_SKIP_LIST_NODE(succ);
+        }
+
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+
+    return succs[0] != NULL && list->compare(succs[0]->key, key) == 0;
+}
+
+/* the first node not less than key, read only: marked nodes are stepped over, not unlinked. probe counts the compares. */
+static ConcurrentSkipListNode* ConcurrentSkipList_LowerBound(ConcurrentSkipList* list, void* key, size_t* probe) {
+    ConcurrentSkipListNode* pred = list->head;
+    ConcurrentSkipListNode* curr = NULL;
+    uintptr_t succ;
+    int level;
+
+    for (level = CONCURRENT_SKIP_LIST_MAX_HEIGHT - 1; level >= 0; --level) {
+        curr = CONCURRENT_SKIP_LIST_NODE(atomic_load_explicit(&pred->next[level], memory_order_acquire));
+
+        while (curr != NULL) {
+            succ = atomic_load_explicit(&curr->next[level], memory_order_acquire);
+
+            if (!CONCURRENT_SKIP_LIST_MARKED(succ)) {
+                *probe += 1;
+
+                if (list->compare(curr->key, key) >= 0) {
+                    break;
+                }
+
+                pred = curr;
+            }
+
+            curr = CONCURRENT_SKIP_LIST_NODE(succ);
+        }
+    }
+
+    return curr;
+}
+
+/**
+ * CONCURRENT_SKIP_LIST_SUCCESS, CONCURRENT_SKIP_LIST_EXISTS (key and value still belong to the caller)
+ * or CONCURRENT_SKIP_LIST_OUT_OF_MEMORY.
+ */
+int ConcurrentSkipList_Insert(ConcurrentSkipList* list, ConcurrentSkipListThread* t, void* key, void* value) {
+    ConcurrentSkipListNode* preds[CONCURRENT_SKIP_LIST_MAX_HEIGHT];
+    ConcurrentSkipListNode* succs[CONCURRENT_SKIP_LIST_MAX_HEIGHT];
+    ConcurrentSkipListNode* node = NULL;
+    unsigned int height = ConcurrentSkipList_RandomHeight(t);
+    unsigned int i;
+    uintptr_t expected, old;
+    int state;
+
+    ConcurrentSkipList_Enter(list, t);
+    ContainerStats_OpBegin(&t->stats, opBegin);
+
+    for (;;) {
+        if (ConcurrentSkipList_Search(list, key, preds, succs)) {
+            if (node != NULL) {   /* never published, straight back to the pool. */
+                node->free = t->freeNodes[height - 1];
+                t->freeNodes[height - 1] = node;
+            }
+
+            ContainerStats_OpEnd(&t->stats, opBegin);
+            ConcurrentSkipList_Exit(t);
+            return CONCURRENT_SKIP_LIST_EXISTS;
+        }
+
+        if (node == NULL) {
+            if ((node = ConcurrentSkipList_AllocNode(list, t, height)) == NULL) {
+                ContainerStats_OpEnd(&t->stats, opBegin);
+                ConcurrentSkipList_Exit(t);
+                return CONCURRENT_SKIP_LIST_OUT_OF_MEMORY;
+            }
+
+            node->key = key;
+            node->value = value;
+            node->height = height;
+            atomic_init(&node->state, CONCURRENT_SKIP_LIST_INSERTING);
+        }
+
+        for (i = 0; i < height; ++i) {
+            atomic_store_explicit(&node->next[i], (uintptr_t)succs[i], memory_order_relaxed);
+        }
+
+        /* linking level 0 puts the key in the map. */
+        expected = (uintptr_t)succs[0];
+        if (atomic_compare_exchange_strong_explicit(&preds[0]->next[0], &expected, (uintptr_t)node, memory_order_release, memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    atomic_fetch_add_explicit(&list->length, 1, memory_order_relaxed);
+
+    /* the upper levels are only shortcuts, stop linking them as soon as the node is removed. */
+    for (i = 1; i < height; ++i) {
+        for (;;) {
+            old = atomic_load_explicit(&node->next[i], memory_order_acquire);
+
+            if (CONCURRENT_SKIP_LIST_MARKED(old)) {
+                goto linked;
+            }
+
+            /* only a remover changes it besides this thread, by setting the mark. */
+            if (old != (uintptr_t)succs[i]
+                && !atomic_compare_exchange_strong_explicit(&node->next[i], &old, (uintptr_t)succs[i], memory_order_release, memory_order_relaxed)) {
+                goto linked;
+            }
+
+            expected = (uintptr_t)succs[i];
+            if (atomic_compare_exchange_strong_explicit(&preds[i]->next[i], &expected, (uintptr_t)node, memory_order_release, memory_order_relaxed)) {
+                break;
+            }
+
+            if (!ConcurrentSkipList_Search(list, key, preds, succs) || succs[0] != node) {
+                goto linked;
+            }
+        }
+    }
+
+linked:
+    state = CONCURRENT_SKIP_LIST_INSERTING;
+    if (!atomic_compare_exchange_strong_explicit(&node->state, &state, CONCURRENT_SKIP_LIST_LINKED, memory_order_acq_rel, memory_order_acquire)) {
+        /* removed while this thread was linking it, the remover left unlinking and retiring to us. */
+        ConcurrentSkipList_Search(list, key, preds, succs);
+        ConcurrentSkipList_Retire(list, t, node);
+    }
+
+    ContainerStats_OpEnd(&t->stats, opBegin);
+    ConcurrentSkipList_Exit(t);
+    return CONCURRENT_SKIP_LIST_SUCCESS;
+}
+
+/* return 1 when key was found and removed by this call. */
+int ConcurrentSkipList_Remove(ConcurrentSkipList* list, ConcurrentSkipListThread* t, void* key) {
+    ConcurrentSkipListNode* preds[CONCURRENT_SKIP_LIST_MAX_HEIGHT];
+    ConcurrentSkipListNode* succs[CONCURRENT_SKIP_LIST_MAX_HEIGHT];
+    ConcurrentSkipListNode* node;
+    unsigned int i;
+    int state;
+
+    ConcurrentSkipList_Enter(list, t);
+    ContainerStats_OpBegin(&t->stats, opBegin);
+
+    if (!ConcurrentSkipList_Search(list, key, preds, succs)) {
+        ContainerStats_OpEnd(&t->stats, opBegin);
+        ConcurrentSkipList_Exit(t);
+        return 0;
+    }
+
+    node = succs[0];
+    for (i = node->height - 1; i > 0; --i) {
+        atomic_fetch_or_explicit(&node->next[i], (uintptr_t)1, memory_order_acq_rel);
+    }
+
+    if (CONCURRENT_SKIP_LIST_MARKED(atomic_fetch_or_explicit(&node->next[0], (uintptr_t)1, memory_order_acq_rel))) {
+        ContainerStats_OpEnd(&t->stats, opBegin);
+        ConcurrentSkipList_Exit(t);
+        return 0;   /* another thread removed it first. */
+    }
+
+    atomic_fetch_sub_explicit(&list->length, 1, memory_order_relaxed);
+
+    /* when the insert is still linking upper levels, the inserter unlinks and retires it once done. */
+    state = CONCURRENT_SKIP_LIST_INSERTING;
+    if (!atomic_compare_exchange_strong_explicit(&node->state, &state, CONCURRENT_SKIP_LIST_ABANDONED, memory_order_acq_rel, memory_order_acquire)) {
+        ConcurrentSkipList_Search(list, key, preds, succs);
+        ConcurrentSkipList_Retire(list, t, node);
+    }
+
+    ContainerStats_OpEnd(&t->stats, opBegin);
+    ConcurrentSkipList_Exit(t);
+    return 1;
+}
+
+/* return 1 and store the value when key is present. the value stays valid until key is removed. */
+int ConcurrentSkipList_Find(ConcurrentSkipList* list, ConcurrentSkipListThread* t, void* key, void** value) {
+    ConcurrentSkipListNode* node;
+    size_t probe = 0;
+    int found;
+
+    ConcurrentSkipList_Enter(list, t);
+    ContainerStats_OpBegin(&t->stats, opBegin);
+    node = ConcurrentSkipList_LowerBound(list, key, &probe);
+
+    if ((found = (node != NULL && list->compare(node->key, key) == 0))) {
+        *value = node->value;
+    }
+
+    ContainerStats_OnProbe(&t->stats, probe);
+    ContainerStats_OpEnd(&t->stats, opBegin);
+    ConcurrentSkipList_Exit(t);
+    return found;
+}
+
+static int ConcurrentSkipList_Walk(ConcurrentSkipList* list, ConcurrentSkipListNode* node, void* high, int bounded,
+                                   ConcurrentSkipList_VisitFunc visit, void* arg) {
+    uintptr_t succ;
+
+    for (; node != NULL; node = CONCURRENT_SKIP_LIST_NODE(succ)) {
+        succ = atomic_load_explicit(&node->next[0], memory_order_acquire);
+
+        if (CONCURRENT_SKIP_LIST_MARKED(succ)) {
+            continue;
+        }
+
+        if (bounded && list->compare(node->key, high) >= 0) {
+            break;
+        }
+
+        if (!visit(node->key, node->value, arg)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * visit the keys in [low, high) in order, without taking a lock and without writing to the list. the
+ * nodes visited stay allocated during the scan: a long scan holds back reclamation, not other threads.
+ * return 0 when visit stopped the scan.
+ */
+int ConcurrentSkipList_ScanRange(ConcurrentSkipList* list, ConcurrentSkipListThread* t, void* low, void* high,
+                                 ConcurrentSkipList_VisitFunc visit, void* arg) {
+    size_t probe = 0;
+    int ret;
+
+    ConcurrentSkipList_Enter(list, t);
+    ret = ConcurrentSkipList_Walk(list, ConcurrentSkipList_LowerBound(list, low, &probe), high, 1, visit, arg);
+    ContainerStats_OnProbe(&t->stats, probe);
+    ConcurrentSkipList_Exit(t);
+    return ret;
+}
+
+/* visit every key in order, like ScanRange. */
+int ConcurrentSkipList_ForEach(ConcurrentSkipList* list, ConcurrentSkipListThread* t, ConcurrentSkipList_VisitFunc visit, void* arg) {
+    int ret;
+
+    ConcurrentSkipList_Enter(list, t);
+    ret = ConcurrentSkipList_Walk(list, CONCURRENT_SKIP_LIST_NODE(atomic_load_explicit(&list->head->next[0], memory_order_acquire)), NULL, 0, visit, arg);
+    ConcurrentSkipList_Exit(t);
+    return ret;
+}
+
+#ifdef CONTAINER_STATS
+/**
+ * the counters of every handle added up, attached or detached. the handles' threads must not be inside
+ * an operation meanwhile: their counters are plain fields.
+ */
+void ConcurrentSkipList_GetStats(ConcurrentSkipList* list, ContainerStats* out) {
+    ConcurrentSkipListThread* t;
+
+    ContainerStats_Init(out, "ConcurrentSkipList");
+
+    for (t = atomic_load_explicit(&list->threads, memory_order_acquire); t != NULL; t = t->next) {
+        ContainerStats_Merge(out, &t->stats);
+    }
+}
+#endif
+
+/* no other thread may use the list anymore, attached or not. */
+void ConcurrentSkipList_Destroy(ConcurrentSkipList* list) {
+    ConcurrentSkipListNode* node = CONCURRENT_SKIP_LIST_NODE(atomic_load(&list->head->next[0]));
+    ConcurrentSkipListThread* t = atomic_load(&list->threads);
+    ConcurrentSkipListThread* nextThread;
+    ConcurrentSkipListChunk* chunk = atomic_load(&list->chunks);
+    ConcurrentSkipListChunk* nextChunk;
+    unsigned int i;
+
+    for (; node != NULL; node = CONCURRENT_SKIP_LIST_NODE(atomic_load(&node->next[0]))) {
+        list->keyDestroy(node->key);
+        list->valueDestroy(node->value);
+    }
+
+    for (; t != NULL; t = nextThread) {
+        for (i = 0; i < 3; ++i) {
+            for (node = t->limbo[i]; node != NULL; node = node->free) {
+                list->keyDestroy(node->key);
+                list->valueDestroy(node->value);
+            }
+        }
+
+        nextThread = t->next;
+        free(t);
+    }
+
+    for (; chunk != NULL; chunk = nextChunk) {
+        nextChunk = chunk->next;
+        free(chunk);
+    }
+
+    free(list->head);
+    free(list);
+}
+
+/* usage: demo, stress test and a scaling benchmark against a mutex around the same list. */
+#define STRESS_THREAD_COUNT   4
+#define STRESS_OPS            200000
+#define STRESS_KEYS           4096       /* per thread, keys of thread i are i, i + STRESS_THREAD_COUNT, ... */
+#define CONTENDED_KEYS        64         /* shared by every thread. */
+#define BENCH_MAX_THREADS     8
+#define BENCH_KEY_SPACE       (1 << 20)
+#define BENCH_OPS_PER_THREAD  200000
+#define BENCH_SCAN_LENGTH     32
+
+int compare_uintptr(void* left, void* right) {
+    return ((uintptr_t)left > (uintptr_t)right) - ((uintptr_t)left < (uintptr_t)right);
+}
+
+static uint64_t xorshift(uint64_t* x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+static int print_event(void* key, void* value, void* arg) {
+    printf("  t=%zu %s\n", (size_t)(uintptr_t)key, (const char*)value);
+    return 1;
+}
+
+typedef struct ScanCheck {
+    uintptr_t last;
+    size_t count;
+    int ordered;
+} ScanCheck;
+
+static int check_order(void* key, void* value, void* arg) {
+    ScanCheck* check = (ScanCheck*)arg;
+
+    if (check->count > 0 && (uintptr_t)key <= check->last) {
+        check->ordered = 0;
+    }
+
+    check->last = (uintptr_t)key;
+    check->count += 1;
+    return check->count < BENCH_SCAN_LENGTH;
+}
+
+typedef struct StressContext {
+    ConcurrentSkipList* list;
+    size_t id;
+    unsigned char present[STRESS_KEYS];
+    size_t errors;
+} StressContext;
+
+/* every thread owns its own keys and knows which are in, lookups and scans cross into the others. */
+void* stress_routine(void* arg) {
+    StressContext* ctx = (StressContext*)arg;
+    ConcurrentSkipListThread* t = ConcurrentSkipList_Attach(ctx->list);
+    uint64_t x = 0x2545f4914f6cdd1dull * (ctx->id + 1);
+    ScanCheck check;
+    uint64_t r;
+    uintptr_t key;
+    size_t i, k;
+    void* value;
+
+    for (i = 0; i < STRESS_OPS; ++i) {
+        r = xorshift(&x);
+        k = (size_t)((r >> 2) % STRESS_KEYS);
+        key = (uintptr_t)(k * STRESS_THREAD_COUNT + ctx->id + 1);
+
+        switch (r & 3) {
+        case 0:
+            if ((ConcurrentSkipList_Insert(ctx->list, t, (void*)key, (void*)key) == CONCURRENT_SKIP_LIST_SUCCESS) != !ctx->present[k]) {
+                ctx->errors += 1;
+            }
+            ctx->present[k] = 1;
+            break;
+        case 1:
+            if (ConcurrentSkipList_Remove(ctx->list, t, (void*)key) != ctx->present[k]) {
+                ctx->errors += 1;
+            }
+            ctx->present[k] = 0;
+            break;
+        case 2:
+            if (ConcurrentSkipList_Find(ctx->list, t, (void*)key, &value) != ctx->present[k] || (ctx->present[k] && value != (void*)key)) {
+                ctx->errors += 1;
+            }
+            break;
+        default:
+            check.count = 0;
+            check.ordered = 1;
+            ConcurrentSkipList_ScanRange(ctx->list, t, (void*)key, (void*)UINTPTR_MAX, check_order, &check);
+            ctx->errors += !check.ordered;
+            break;
+        }
+    }
+
+    ConcurrentSkipList_Detach(ctx->list, t);
+    return NULL;
+}
+
+static int count_key(void* key, void* value, void* arg) {
+    *(size_t*)arg += 1;
+    return 1;
+}
+
+int stress_test(void) {
+    ConcurrentSkipList* list = ConcurrentSkipList_CreateNew(compare_uintptr, NULL, NULL);
+    StressContext* ctx = (StressContext*)calloc(STRESS_THREAD_COUNT, sizeof(StressContext));
+    pthread_t threads[STRESS_THREAD_COUNT];
+    ConcurrentSkipListThread* t;
+    size_t i, k, expected = 0, errors = 0, seen = 0;
+    void* value;
+
+    for (i = 0; i < STRESS_THREAD_COUNT; ++i) {
+        ctx[i].list = list;
+        ctx[i].id = i;
+        pthread_create(&threads[i], NULL, stress_routine, &ctx[i]);
+    }
+
+    for (i = 0; i < STRESS_THREAD_COUNT; ++i) {
+        pthread_join(threads[i], NULL);
+        errors += ctx[i].errors;
+    }
+
+    /* afterwards the list must hold exactly the keys the threads left in. */
+    t = ConcurrentSkipList_Attach(list);
+    for (i = 0; i < STRESS_THREAD_COUNT; ++i) {
+        for (k = 0; k < STRESS_KEYS; ++k) {
+            expected += ctx[i].present[k];
+            errors += ConcurrentSkipList_Find(list, t, (void*)(uintptr_t)(k * STRESS_THREAD_COUNT + i + 1), &value) != ctx[i].present[k];
+        }
+    }
+
+    ConcurrentSkipList_ForEach(list, t, count_key, &seen);
+    errors += (seen != expected || ConcurrentSkipList_Length(list) != expected);
+
+    printf("stress: %d threads x %d ops, %zu keys left, %zu pool bytes, %s\n",
+           STRESS_THREAD_COUNT, STRESS_OPS, seen, ConcurrentSkipList_PoolBytes(list), errors == 0 ? "ok" : "FAILED");
+
+    ConcurrentSkipList_Detach(list, t);
+    ConcurrentSkipList_Destroy(list);
+    free(ctx);
+    return errors == 0;
+}
+
+typedef struct ContendedContext {
+    ConcurrentSkipList* list;
+    size_t id;
+    size_t inserted[CONTENDED_KEYS];   /* successful calls of this thread, per key. */
+    size_t removed[CONTENDED_KEYS];
+    size_t errors;
+} ContendedContext;
+
+static atomic_size_t contended_key_destroys;
+static atomic_size_t contended_value_destroys;
+
+static void count_key_destroy(void* key) {
+    atomic_fetch_add_explicit(&contended_key_destroys, 1, memory_order_relaxed);
+}
+
+static void count_value_destroy(void* value) {
+    atomic_fetch_add_explicit(&contended_value_destroys, 1, memory_order_relaxed);
+}
+
+/* every thread inserts and removes the same few keys, so most removes race an insert or another remove. */
+void* contended_routine(void* arg) {
+    ContendedContext* ctx = (ContendedContext*)arg;
+    ConcurrentSkipListThread* t = ConcurrentSkipList_Attach(ctx->list);
+    uint64_t x = 0x9e3779b97f4a7c15ull * (ctx->id + 1);
+    ScanCheck check;
+    uint64_t r;
+    uintptr_t key;
+    size_t i, k;
+    void* value;
+
+    for (i = 0; i < STRESS_OPS; ++i) {
+        r = xorshift(&x);
+        k = (size_t)((r >> 2) % CONTENDED_KEYS);
+        key = (uintptr_t)(k + 1);
+
+        switch (r & 3) {
+        case 0:
+            ctx->inserted[k] += (ConcurrentSkipList_Insert(ctx->list, t, (void*)key, (void*)key) == CONCURRENT_SKIP_LIST_SUCCESS);
+            break;
+        case 1:
+            ctx->removed[k] += ConcurrentSkipList_Remove(ctx->list, t, (void*)key);
+            break;
+        case 2:
+            if (ConcurrentSkipList_Find(ctx->list, t, (void*)key, &value) && value != (void*)key) {
+                ctx->errors += 1;
+            }
+            break;
+        default:
+            check.count = 0;
+            check.ordered = 1;
+            ConcurrentSkipList_ScanRange(ctx->list, t, (void*)key, (void*)UINTPTR_MAX, check_order, &check);
+            ctx->errors += !check.ordered;
+            break;
+        }
+    }
+
+    ConcurrentSkipList_Detach(ctx->list, t);
+    return NULL;
+}
+
+/**
+ * a key is in the list at the end exactly when its successful inserts outnumber its successful removes
+ * by one, and once the list is destroyed every inserted key and value was destroyed exactly once.
+ */
+int contended_test(void) {
+    ConcurrentSkipList* list = ConcurrentSkipList_CreateNew(compare_uintptr, count_key_destroy, count_value_destroy);
+    ContendedContext* ctx = (ContendedContext*)calloc(STRESS_THREAD_COUNT, sizeof(ContendedContext));
+    pthread_t threads[STRESS_THREAD_COUNT];
+    ConcurrentSkipListThread* t;
+    size_t i, k, inserted, removed, totalInserted = 0, expected = 0, errors = 0;
+    void* value;
+
+    atomic_store(&contended_key_destroys, 0);
+    atomic_store(&contended_value_destroys, 0);
+
+    for (i = 0; i < STRESS_THREAD_COUNT; ++i) {
+        ctx[i].list = list;
+        ctx[i].id = i;
+        pthread_create(&threads[i], NULL, contended_routine, &ctx[i]);
+    }
+
+    for (i = 0; i < STRESS_THREAD_COUNT; ++i) {
+        pthread_join(threads[i], NULL);
+        errors += ctx[i].errors;
+    }
+
+    t = ConcurrentSkipList_Attach(list);
+    for (k = 0; k < CONTENDED_KEYS; ++k) {
+        inserted = 0;
+        removed = 0;
+
+        for (i = 0; i < STRESS_THREAD_COUNT; ++i) {
+            inserted += ctx[i].inserted[k];
+            removed += ctx[i].removed[k];
+        }
+
+        if (inserted < removed || inserted - removed > 1) {
+            errors += 1;
+        }
+        else {
+            errors += ConcurrentSkipList_Find(list, t, (void*)(uintptr_t)(k + 1), &value) != (int)(inserted - removed);
+            expected += inserted - removed;
+        }
+
+        totalInserted += inserted;
+    }
+
+    errors += ConcurrentSkipList_Length(list) != expected;
+    ConcurrentSkipList_Detach(list, t);
+    ConcurrentSkipList_Destroy(list);
+
+    errors += atomic_load(&contended_key_destroys) != totalInserted || atomic_load(&contended_value_destroys) != totalInserted;
+
+    printf("contended: %d threads x %d ops on %d keys, %zu inserts, %zu destroyed, %zu keys left, %s\n",
+           STRESS_THREAD_COUNT, STRESS_OPS, CONTENDED_KEYS, totalInserted, atomic_load(&contended_key_destroys),
+           expected, errors == 0 ? "ok" : "FAILED");
+
+    free(ctx);
+    return errors == 0;
+}
+
+/* the baseline: the same list, every operation under one mutex. */
+typedef struct BenchContext {
+    ConcurrentSkipList* list;
+    pthread_mutex_t* lock;   /* NULL for the lock-free runs. */
+    ConcurrentSkipListThread* shared;
+    uint64_t seed;
+} BenchContext;
+
+static int count_until_full(void* key, void* value, void* arg) {
+    return ++*(size_t*)arg < BENCH_SCAN_LENGTH;
+}
+
+/* an event store mix: 70% lookups, 10% inserts, 10% removes, 10% scans of 32 events. */
+void* bench_routine(void* arg) {
+    BenchContext* ctx = (BenchContext*)arg;
+    ConcurrentSkipListThread* t = (ctx->lock == NULL ? ConcurrentSkipList_Attach(ctx->list) : ctx->shared);
+    uint64_t x = ctx->seed;
+    uintptr_t key;
+    size_t i, scanned;
+    unsigned int op;
+    void* value;
+
+    for (i = 0; i < BENCH_OPS_PER_THREAD; ++i) {
+        key = (uintptr_t)(xorshift(&x) % BENCH_KEY_SPACE) + 1;
+        op = (unsigned int)(xorshift(&x) % 10);
+
+        if (ctx->lock != NULL) {
+            pthread_mutex_lock(ctx->lock);
+        }
+
+        if (op < 7) {
+            ConcurrentSkipList_Find(ctx->list, t, (void*)key, &value);
+        }
+        else if (op == 7) {
+            ConcurrentSkipList_Insert(ctx->list, t, (void*)key, (void*)key);
+        }
+        else if (op == 8) {
+            ConcurrentSkipList_Remove(ctx->list, t, (void*)key);
+        }
+        else {
+            scanned = 0;
+            ConcurrentSkipList_ScanRange(ctx->list, t, (void*)key, (void*)UINTPTR_MAX, count_until_full, &scanned);
+        }
+
+        if (ctx->lock != NULL) {
+            pthread_mutex_unlock(ctx->lock);
+        }
+    }
+
+    if (ctx->lock == NULL) {
+        ConcurrentSkipList_Detach(ctx->list, t);
+    }
+
+    return NULL;
+}
+
+double bench(size_t threadCount, int locked) {
+    ConcurrentSkipList* list = ConcurrentSkipList_CreateNew(compare_uintptr, NULL, NULL);
+    ConcurrentSkipListThread* t = ConcurrentSkipList_Attach(list);
+    pthread_t threads[BENCH_MAX_THREADS];
+    BenchContext ctx[BENCH_MAX_THREADS];
+    pthread_mutex_t lock;
+    struct timespec begin, end;
+    uint64_t x = 88172645463325252ull;
+    double seconds;
+    size_t i;
+
+    for (i = 0; i < BENCH_KEY_SPACE / 2; ++i) {
+        ConcurrentSkipList_Insert(list, t, (void*)(uintptr_t)(xorshift(&x) % BENCH_KEY_SPACE + 1), NULL);
+    }
+
+    pthread_mutex_init(&lock, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < threadCount; ++i) {
+        ctx[i].list = list;
+        ctx[i].lock = (locked ? &lock : NULL);
+        ctx[i].shared = t;
+        ctx[i].seed = 0x9e3779b97f4a7c15ull * (i + 1);
+        pthread_create(&threads[i], NULL, bench_routine, &ctx[i]);
+    }
+
+    for (i = 0; i < threadCount; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (double)(end.tv_sec - begin.tv_sec) + (double)(end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    pthread_mutex_destroy(&lock);
+    ConcurrentSkipList_Detach(list, t);
+    ConcurrentSkipList_Destroy(list);
+    return threadCount * BENCH_OPS_PER_THREAD / seconds / 1e6;
+}
+
+int main() {
+    ConcurrentSkipList* list = ConcurrentSkipList_CreateNew(compare_uintptr, NULL, NULL);
+    ConcurrentSkipListThread* t = ConcurrentSkipList_Attach(list);
+    const char* events[] = { "boot", "login", "query", "logout", "backup", "shutdown" };
+    uintptr_t times[] = { 100, 250, 180, 420, 900, 1000 };
+    size_t i, threads;
+    void* value;
+
+    for (i = 0; i < sizeof(times) / sizeof(times[0]); ++i) {
+        ConcurrentSkipList_Insert(list, t, (void*)times[i], (void*)events[i]);
+    }
+
+    printf("insert t=250 again: %s\n", ConcurrentSkipList_Insert(list, t, (void*)(uintptr_t)250, "dup") == CONCURRENT_SKIP_LIST_EXISTS ? "exists" : "inserted");
+    printf("find t=420: %s\n", ConcurrentSkipList_Find(list, t, (void*)(uintptr_t)420, &value) ? (const char*)value : "not found");
+
+    printf("events in [150, 900):\n");
+    ConcurrentSkipList_ScanRange(list, t, (void*)(uintptr_t)150, (void*)(uintptr_t)900, print_event, NULL);
+
+    ConcurrentSkipList_Remove(list, t, (void*)(uintptr_t)180);
+    printf("after removing t=180:\n");
+    ConcurrentSkipList_ForEach(list, t, print_event, NULL);
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    ConcurrentSkipList_GetStats(list, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
+    ConcurrentSkipList_Detach(list, t);
+    ConcurrentSkipList_Destroy(list);
+
+    if (!stress_test() || !contended_test()) {
+        return 1;
+    }
+
+    printf("\n%d ops per thread, %d keys, M ops/s:\n", BENCH_OPS_PER_THREAD, BENCH_KEY_SPACE / 2);
+    for (threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2) {
+        printf("  %zu thread(s): lock-free %6.2f, mutex %6.2f\n", threads, bench(threads, 0), bench(threads, 1));
+    }
+
+    return 0;
+}
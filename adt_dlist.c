@@ -1,12 +1,22 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "container_stats.h"
+#include "node_slab.h"
+#include "reclaimer.h"
 
 typedef struct DListNode DListNode;
 typedef struct DList DList;
 
 typedef void (*DList_ElemDestroyFunc) (void* elem);
+typedef int (*DList_CompareFunc) (void* left, void* right);   /* return < 0 means left goes first. */
+typedef int (*DList_PredicateFunc) (void* elem, void* arg);     /* return non 0 to select elem. */
 
 struct DListNode {
     DListNode* prev;
@@ -20,6 +30,9 @@ struct DList {
     size_t length;
 
     DList_ElemDestroyFunc elemDestroy;
+    NodeSlabSet slabs;   /* slabs of DList_Compact holding some of the nodes. */
+
+    CONTAINER_STATS_FIELD(stats)
 };
 
 #define DList_NodePrev(nodePtr)   ((nodePtr)->prev)
@@ -45,17 +58,28 @@ DList* DList_CreateNew(DList_ElemDestroyFunc func) {
     list->head = list->tail = NULL;
     list->length = 0;
     list->elemDestroy = (func == NULL ? DList_DefaultElemDestroyFunc : func);
+    NodeSlabSet_Init(&list->slabs);
+    ContainerStats_Init(&list->stats, "DList");
 
     return list;
 }
 
+/* a node copied by DList_Compact lives in a slab, the slab is released with its last node. */
+static void DList_FreeNode(DList* list, DListNode* node) {
+    if (!NodeSlabSet_FreeNode(&list->slabs, node)) {
+        free(node);
+    }
+
+    ContainerStats_OnFree(&list->stats, sizeof(DListNode));
+}
+
 void DList_Clear(DList* list) {
     DListNode* node = list->head;
 
     while (list->head != NULL) {
         node = node->next;
         list->elemDestroy(list->head->data);
-        free(list->head);
+        DList_FreeNode(list, list->head);
         list->head = node;
     }
 
@@ -64,15 +88,70 @@ void DList_Clear(DList* list) {
 
 void DList_Destroy(DList* list) {
     DList_Clear(list);
+    NodeSlabSet_Release(&list->slabs);
     free(list);
 }
 
+/* Reclaimer_StepFunc of a detached list, the list itself goes after its last node. */
+static size_t DList_ReclaimStep(void* garbage, size_t budget) {
+    DList* list = (DList*)garbage;
+    DListNode* node;
+    size_t n;
+
+    for (n = 0; n < budget && list->head != NULL; ++n) {
+        node = list->head;
+        list->head = node->next;
+        list->elemDestroy(node->data);
+        DList_FreeNode(list, node);
+    }
+
+    if (n < budget) {
+        NodeSlabSet_Release(&list->slabs);
+        free(list);
+    }
+
+    return n;
+}
+
+/**
+ * like DList_Destroy, but the nodes are freed and elemDestroy is called on the reclaimer thread,
+ * the caller only pays O(1). falls back to DList_Destroy when out of memory.
+ */
+void DList_DestroyAsync(DList* list, Reclaimer* reclaimer) {
+    if (!Reclaimer_Submit(reclaimer, DList_ReclaimStep, list, list->length + 1)) {
+        DList_Destroy(list);
+    }
+}
+
+/* like DList_Clear, the nodes are moved to a detached list in O(1) and freed on the reclaimer thread. */
+void DList_ClearAsync(DList* list, Reclaimer* reclaimer) {
+    DList* garbage;
+
+    if (list->head == NULL) {
+        return;
+    }
+
+    if ((garbage = (DList*)malloc(sizeof(DList))) == NULL) {
+        DList_Clear(list);
+        return;
+    }
+
+    *garbage = *list;
+    list->head = list->tail = NULL;
+    list->length = 0;
+    NodeSlabSet_Init(&list->slabs);
+
+    DList_DestroyAsync(garbage, reclaimer);
+}
+
 int DList_PushBack(DList* list, void* elem) {
     DListNode* node = (DListNode*)malloc(sizeof(DListNode));
     if (node == NULL) {
         return 0;
     }
 
+    ContainerStats_OnAlloc(&list->stats, sizeof(DListNode));
+
     node->data = elem;
 
     if (list->head == NULL) {
@@ -96,6 +175,8 @@ int DList_PushFront(DList* list, void* elem) {
         return 0;
     }
 
+    ContainerStats_OnAlloc(&list->stats, sizeof(DListNode));
+
     node->data = elem;
 
     if (list->head == NULL) {
@@ -105,6 +186,7 @@ int DList_PushFront(DList* list, void* elem) {
     else {
         node->prev = NULL;
         node->next = list->head;
+        list->head->prev = node;
         list->head = node;
     }
 
@@ -138,7 +220,7 @@ DListNode* DList_DeleteNode(DList* list, DListNode* node, int isBackOrder) {
     }
 
     list->elemDestroy(node->data);
-    free(node);
+    DList_FreeNode(list, node);
     list->length -= 1;
     return retNode;
 }
@@ -156,6 +238,34 @@ void DList_DeleteAll(DList* list, void* elem, size_t elmeSize) {
     }
 }
 
+/* one traversal, every removal is an O(1) unlink. */
+static size_t DList_Filter(DList* list, DList_PredicateFunc pred, void* arg, int removeSelected) {
+    DListNode* node = list->head;
+    size_t removed = 0;
+
+    while (node != NULL) {
+        if ((pred(node->data, arg) != 0) == removeSelected) {
+            node = DList_DeleteNode(list, node, 1);
+            removed += 1;
+        }
+        else {
+            node = node->next;
+        }
+    }
+
+    return removed;
+}
+
+/* remove (and destroy) every element pred selects, return how many were removed. */
+size_t DList_RemoveIf(DList* list, DList_PredicateFunc pred, void* arg) {
+    return DList_Filter(list, pred, arg, 1);
+}
+
+/* keep only the elements pred selects. */
+size_t DList_Retain(DList* list, DList_PredicateFunc pred, void* arg) {
+    return DList_Filter(list, pred, arg, 0);
+}
+
 void DList_PopBack(DList* list) {
     (void)DList_DeleteNode(list, list->tail, 1);
 }
@@ -164,6 +274,260 @@ void DList_PopFront(DList* list) {
     (void)DList_DeleteNode(list, list->head, 1);
 }
 
+/* merge two NULL terminated runs linked by next only, ties keep left first. */
+static DListNode* DList_MergeRuns(DListNode* left, DListNode* right, DList_CompareFunc compare) {
+    DListNode head;
+    DListNode* tail = &head;
+
+    while (left != NULL && right != NULL) {
+        if (compare(right->data, left->data) < 0) {
+            tail->next = right;
+            right = right->next;
+        }
+        else {
+            tail->next = left;
+            left = left->next;
+        }
+
+        tail = tail->next;
+    }
+
+    tail->next = (left != NULL) ? left : right;
+    return head.next;
+}
+
+/* restore prev links and tail after the next links were rewritten. */
+static void DList_Relink(DList* list, DListNode* head) {
+    DListNode* prev = NULL;
+    DListNode* node;
+
+    list->head = head;
+    for (node = head; node != NULL; node = node->next) {
+        node->prev = prev;
+        prev = node;
+    }
+
+    list->tail = prev;
+}
+
+/**
+ * stable bottom-up merge sort, O(n log n) and no allocation: nodes are relinked, never copied.
+ * run[i] holds a sorted run of 2^i nodes, each node is carried in like a binary counter.
+ */
+void DList_Sort(DList* list, DList_CompareFunc compare) {
+    DListNode* run[64] = { NULL };
+    DListNode* node = list->head;
+    DListNode* next;
+    DListNode* carry;
+    size_t i;
+
+    while (node != NULL) {
+        next = node->next;
+        node->next = NULL;
+        carry = node;
+
+        for (i = 0; run[i] != NULL; ++i) {
+            carry = DList_MergeRuns(run[i], carry, compare);
+            run[i] = NULL;
+        }
+
+        run[i] = carry;
+        node = next;
+    }
+
+    for (carry = NULL, i = 0; i < 64; ++i) {
+        if (run[i] != NULL) {
+            carry = (carry == NULL) ? run[i] : DList_MergeRuns(run[i], carry, compare);
+        }
+    }
+
+    DList_Relink(list, carry);
+}
+
+/**
+ * both lists sorted, move every node of other into list in order. other ends up empty, O(n).
+ * return 0 when out of memory, nothing is moved then.
+ */
+int DList_Merge(DList* list, DList* other, DList_CompareFunc compare) {
+    if (list == other || other->head == NULL) {
+        return 1;
+    }
+
+    if (!NodeSlabSet_Merge(&list->slabs, &other->slabs)) {
+        return 0;
+    }
+
+    DList_Relink(list, DList_MergeRuns(list->head, other->head, compare));
+    list->length += other->length;
+    other->head = other->tail = NULL;
+    other->length = 0;
+    return 1;
+}
+
+/**
+ * move the nodes [first, last] of other in front of pos in list (pos NULL means at the end), O(1).
+ * count is the number of nodes in the range, the caller knows it, a constant time splice can't
+ * count them. other may be list itself, then pos must not be inside the range.
+ * return 0 when out of memory (list could not take over the slabs of other), nothing is moved then.
+ */
+int DList_Splice(DList* list, DListNode* pos, DList* other, DListNode* first, DListNode* last, size_t count) {
+    if (list != other && !NodeSlabSet_Merge(&list->slabs, &other->slabs)) {
+        return 0;
+    }
+
+    if (first->prev != NULL) {
+        first->prev->next = last->next;
+    }
+    else {
+        other->head = last->next;
+    }
+
+    if (last->next != NULL) {
+        last->next->prev = first->prev;
+    }
+    else {
+        other->tail = first->prev;
+    }
+
+    other->length -= count;
+
+    if (pos == NULL) {
+        first->prev = list->tail;
+        last->next = NULL;
+
+        if (list->tail != NULL) {
+            list->tail->next = first;
+        }
+        else {
+            list->head = first;
+        }
+
+        list->tail = last;
+    }
+    else {
+        first->prev = pos->prev;
+        last->next = pos;
+
+        if (pos->prev != NULL) {
+            pos->prev->next = first;
+        }
+        else {
+            list->head = first;
+        }
+
+        pos->prev = last;
+    }
+
+    list->length += count;
+    return 1;
+}
+
+/* move all of other in front of pos in list, O(1). */
+int DList_SpliceAll(DList* list, DListNode* pos, DList* other) {
+    if (list != other && other->head != NULL) {
+        return DList_Splice(list, pos, other, other->head, other->tail, other->length);
+    }
+
+    return 1;
+}
+
+/**
+ * copy every node, in list order, into one contiguous slab and free the old ones, so a traversal
+ * walks memory sequentially again after a lot of insert/delete churn. the elements stay where they
+ * are, but every DListNode* the caller holds is invalidated. return 0 when out of memory, the list is
+ * unchanged then.
+ */
+int DList_Compact(DList* list) {
+    NodeSlabSet old = list->slabs;
+    NodeSlab* slab;
+    DListNode* nodes;
+    DListNode* node;
+    DListNode* next;
+    size_t i;
+
+    if (list->length == 0) {
+        return 1;
+    }
+
+    if ((slab = NodeSlab_CreateNew(sizeof(DListNode), list->length)) == NULL) {
+        return 0;
+    }
+
+    NodeSlabSet_Init(&list->slabs);
+    if (!NodeSlabSet_Add(&list->slabs, slab)) {
+        NodeSlab_Destroy(slab);
+        list->slabs = old;
+        return 0;
+    }
+
+    ContainerStats_OnAlloc(&list->stats, list->length * sizeof(DListNode));
+    nodes = (DListNode*)slab->begin;
+
+    for (i = 0, node = list->head; node != NULL; ++i, node = next) {
+        next = node->next;
+        nodes[i].prev = (i == 0) ? NULL : &nodes[i - 1];
+        nodes[i].next = (next == NULL) ? NULL : &nodes[i + 1];
+        nodes[i].data = node->data;
+
+        if (!NodeSlabSet_FreeNode(&old, node)) {
+            free(node);
+        }
+
+        ContainerStats_OnFree(&list->stats, sizeof(DListNode));
+    }
+
+    NodeSlabSet_Release(&old);
+    list->head = &nodes[0];
+    list->tail = &nodes[list->length - 1];
+    return 1;
+}
+
+#ifdef CONTAINER_STATS
+void DList_GetStats(DList* list, ContainerStats* out) {
+    *out = list->stats;
+}
+#endif
+
+int compare_int(void* left, void* right) {
+    return *(int*)left - *(int*)right;
+}
+
+int dlist_is_odd(void* elem, void* arg) {
+    return *(int*)elem % 2 != 0;
+}
+
+int compare_uintptr(void* left, void* right) {
+    return ((uintptr_t)left > (uintptr_t)right) - ((uintptr_t)left < (uintptr_t)right);
+}
+
+static double seconds_since(const struct timespec* begin) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - begin->tv_sec) + (double)(end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+#define DLIST_BENCH_NODES   (1 << 20)
+#define DLIST_BENCH_WALKS   20
+
+/* follow every link DLIST_BENCH_WALKS times, the elements are never dereferenced. */
+double bench_dlist_walk(DList* list, uintptr_t* sum) {
+    struct timespec begin;
+    DListNode* node;
+    int i;
+
+    *sum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < DLIST_BENCH_WALKS; ++i) {
+        DList_ForEach(list, node) {
+            *sum += (uintptr_t)DList_NodeData(node);
+        }
+    }
+
+    return seconds_since(&begin);
+}
+
 int main() {
     DList* list = DList_CreateNew(free);
 
@@ -192,6 +556,102 @@ int main() {
         printf("%d\n", *(int*)DList_NodeData(node));
     }
 
+    /* sort a second list in place and merge it in, no node is allocated or copied. */
+    DList* other = DList_CreateNew(free);
+    int values[] = { 9, 2, 30, 4 };
+    for (i = 0; i < 4; ++i) {
+        data = malloc(sizeof(int));
+        *data = values[i];
+        DList_PushFront(other, data);
+    }
+
+    /* PushFront links the old head back to the new one, walking from the tail gives the push order. */
+    i = 0;
+    DList_ForEachReverse(other, node) {
+        if (i >= 4 || *(int*)DList_NodeData(node) != values[i]) {
+            break;
+        }
+
+        i += 1;
+    }
+    printf("reverse walk after push front: %s\n", i == 4 && node == NULL && other->head->prev == NULL ? "ok" : "FAILED");
+
+    DList_Sort(other, compare_int);
+    DList_Merge(list, other, compare_int);
+    DList_Destroy(other);
+
+    printf("merged:");
+    DList_ForEach(list, node) {
+        printf(" %d", *(int*)DList_NodeData(node));
+    }
+    printf("\n");
+
+    printf("odd removed: %zu, left:", DList_RemoveIf(list, dlist_is_odd, NULL));
+    DList_ForEach(list, node) {
+        printf(" %d", *(int*)DList_NodeData(node));
+    }
+    printf("\n");
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    DList_GetStats(list, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
     DList_Destroy(list);
+
+    /* sorted by random keys the list order no longer follows the address order, Compact restores it. */
+    uint64_t x = 88172645463325252ull;
+    uintptr_t sum;
+
+    list = DList_CreateNew(NULL);
+    for (i = 0; i < DLIST_BENCH_NODES; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        DList_PushBack(list, (void*)(uintptr_t)(x >> 16));
+    }
+
+    double freshSeconds = bench_dlist_walk(list, &sum);
+    DList_Sort(list, compare_uintptr);
+    double scatteredSeconds = bench_dlist_walk(list, &sum);
+    DList_Compact(list);
+    double compactSeconds = bench_dlist_walk(list, &sum);
+
+    printf("\n%d nodes, %d walks\n", DLIST_BENCH_NODES, DLIST_BENCH_WALKS);
+    printf("  allocation order: %.4f s\n", freshSeconds);
+    printf("  after sort:       %.4f s\n", scatteredSeconds);
+    printf("  after compact:    %.4f s (checksum %zu)\n", compactSeconds, (size_t)sum);
+
+    DList_Destroy(list);
+
+    /* the caller of DestroyAsync only waits for the hand over, the reclaimer frees in the background. */
+    Reclaimer* reclaimer = Reclaimer_CreateNew(0);
+    struct timespec begin;
+    int async;
+
+    for (async = 0; async < 2; ++async) {
+        list = DList_CreateNew(free);
+        for (i = 0; i < DLIST_BENCH_NODES; ++i) {
+            data = malloc(sizeof(int));
+            *data = i;
+            DList_PushBack(list, data);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+
+        if (async) {
+            DList_DestroyAsync(list, reclaimer);
+            printf("  DestroyAsync:     %.6f s, %zu nodes outstanding\n", seconds_since(&begin), Reclaimer_Outstanding(reclaimer));
+            Reclaimer_Wait(reclaimer);
+            printf("  reclaimed after:  %.4f s\n", seconds_since(&begin));
+        }
+        else {
+            DList_Destroy(list);
+            printf("\n%d nodes\n  Destroy:          %.4f s\n", DLIST_BENCH_NODES, seconds_since(&begin));
+        }
+    }
+
+    Reclaimer_Destroy(reclaimer);
     return 0;
 }
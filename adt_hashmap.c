@@ -1,7 +1,16 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <time.h>
+
+#include "container_stats.h"
+#include "bloom_filter.h"
+#include "node_slab.h"
+#include "reclaimer.h"
+#include "parallel_build.h"
 
 #define HASHMAP_DEFAULT_BUCKET_SIZE 101
 
@@ -15,6 +24,18 @@ typedef HashType (*HashMap_KeyHashFunc) (void* key);
 typedef void (*HashMap_KeyDestroyFunc) (void* key);
 typedef void (*HashMap_ValueDestroyFunc) (void* value);
 
+/**
+ * key views: a key given as (data, length), e.g. a slice of a network buffer, no terminator needed.
+ * the view hash must give the same value as the key hash for an equal stored key, the view compare
+ * returns 0 when the stored key equals the view, and keyFromView makes an owned key (released by
+ * keyDestroy) out of a view. see HashMap_SetViewFuncs.
+ */
+typedef HashType (*HashMap_ViewHashFunc) (const void* data, size_t length);
+typedef int (*HashMap_ViewCompareFunc) (void* key, const void* data, size_t length);   /* return 0 means equal. */
+typedef void* (*HashMap_KeyFromViewFunc) (const void* data, size_t length);
+
+typedef uint64_t (*HashMap_BloomHashFunc) (void* key);   /* full 64-bit hash for the Bloom filter, not a bucket index. */
+
 struct HashMapNode {
     HashMapNode* next;
     void* key;
@@ -29,6 +50,18 @@ struct HashMap {
     HashMap_KeyHashFunc hash;
     HashMap_KeyDestroyFunc keyDestroy;
     HashMap_ValueDestroyFunc valueDestroy;
+
+    HashMap_ViewHashFunc viewHash;
+    HashMap_ViewCompareFunc viewCompare;
+    HashMap_KeyFromViewFunc keyFromView;
+
+    BloomFilter* bloom;   /* optional, see HashMap_AttachBloomFilter. */
+    HashMap_BloomHashFunc bloomHash;
+    size_t bloomRemoved;
+
+    NodeSlabSet slabs;   /* slabs of HashMap_Compact holding some of the nodes. */
+
+    CONTAINER_STATS_FIELD(stats)
 };
 
 void HashMap_DefaultKeyDestroyFunc(void* key) {}
@@ -52,15 +85,32 @@ HashMap* HashMap_CreateNew(HashMap_CompareFunc compare,
     hm->hash = hash;
     hm->keyDestroy = (keyDestroy == NULL ? HashMap_DefaultKeyDestroyFunc : keyDestroy);
     hm->valueDestroy = (valueDestroy == NULL ? HashMap_DefaultValueDestroyFunc : valueDestroy);
+    hm->viewHash = NULL;
+    hm->viewCompare = NULL;
+    hm->keyFromView = NULL;
+    hm->bloom = NULL;
+    hm->bloomHash = NULL;
+    hm->bloomRemoved = 0;
+    NodeSlabSet_Init(&hm->slabs);
 
     size_t i;
     for (i = 0; i < HASHMAP_DEFAULT_BUCKET_SIZE; ++i) {
         hm->bucket[i] = NULL;
     }
 
+    ContainerStats_Init(&hm->stats, "HashMap");
     return hm;
 }
 
+/* a node copied by HashMap_Compact lives in a slab, the slab is released with its last node. */
+static void HashMap_FreeNode(HashMap* hm, HashMapNode* node) {
+    if (!NodeSlabSet_FreeNode(&hm->slabs, node)) {
+        free(node);
+    }
+
+    ContainerStats_OnFree(&hm->stats, sizeof(HashMapNode));
+}
+
 void HashMap_Destroy(HashMap* hm) {
     size_t i;
     HashMapNode* node;
@@ -74,47 +124,271 @@ void HashMap_Destroy(HashMap* hm) {
 
                 hm->keyDestroy(hm->bucket[i]->key);
                 hm->valueDestroy(hm->bucket[i]->value);
-                free(hm->bucket[i]);
+                HashMap_FreeNode(hm, hm->bucket[i]);
 
                 hm->bucket[i] = node;
             }
         }
     }
 
+    if (hm->bloom != NULL) {
+        BloomFilter_Destroy(hm->bloom);
+    }
+
+    NodeSlabSet_Release(&hm->slabs);
     free(hm);
 }
 
-HashMapNode* HashMap_Find(HashMap* hm, void* key) {
-    HashType hashval = hm->hash(key);
+/* Reclaimer_StepFunc of a detached map, the map itself goes after its last node. */
+static size_t HashMap_ReclaimStep(void* garbage, size_t budget) {
+    HashMap* hm = (HashMap*)garbage;
+    HashMapNode* node;
+    size_t i, n = 0;
+
+    for (i = 0; i < HASHMAP_DEFAULT_BUCKET_SIZE && n < budget; ++i) {
+        while (hm->bucket[i] != NULL && n < budget) {
+            node = hm->bucket[i];
+            hm->bucket[i] = node->next;
+            hm->keyDestroy(node->key);
+            hm->valueDestroy(node->value);
+            HashMap_FreeNode(hm, node);
+            n += 1;
+        }
+    }
+
+    if (n < budget) {
+        if (hm->bloom != NULL) {
+            BloomFilter_Destroy(hm->bloom);
+        }
+
+        NodeSlabSet_Release(&hm->slabs);
+        free(hm);
+    }
+
+    return n;
+}
+
+/**
+ * like HashMap_Destroy, but the nodes are freed and keyDestroy/valueDestroy are called on the
+ * reclaimer thread, the caller only pays O(1). falls back to HashMap_Destroy when out of memory.
+ */
+void HashMap_DestroyAsync(HashMap* hm, Reclaimer* reclaimer) {
+    if (!Reclaimer_Submit(reclaimer, HashMap_ReclaimStep, hm, hm->length + 1)) {
+        HashMap_Destroy(hm);
+    }
+}
+
+typedef struct HashMapBuild {
+    HashMap* hm;
+    HashMapNode* nodes;
+    void* const* keys;
+    void* const* values;
+} HashMapBuild;
+
+static size_t HashMap_BuildHash(void* ctx, size_t item) {
+    HashMapBuild* build = (HashMapBuild*)ctx;
+    return build->hm->hash(build->keys[item]);
+}
+
+static void HashMap_BuildPlace(void* ctx, size_t item, size_t slot) {
+    HashMapBuild* build = (HashMapBuild*)ctx;
+
+    build->nodes[slot].key = build->keys[item];
+    build->nodes[slot].value = (build->values == NULL ? NULL : build->values[item]);
+}
+
+static void HashMap_BuildLink(void* ctx, size_t bucket, size_t begin, size_t end) {
+    HashMapBuild* build = (HashMapBuild*)ctx;
+    HashMapNode* nodes = build->nodes;
+    size_t slot;
+
+    for (slot = begin; slot + 1 < end; ++slot) {
+        nodes[slot].next = &nodes[slot + 1];
+    }
+
+    if (begin < end) {
+        nodes[end - 1].next = NULL;
+    }
+
+    build->hm->bucket[bucket] = (begin < end ? &nodes[begin] : NULL);
+}
+
+/**
+ * build a map out of count keys and their values (values NULL means every value is NULL) in one go:
+ * the keys are hashed on threadCount threads (0 means one per cpu), partitioned by bucket and the
+ * nodes are allocated as one block. no lookup is done, so the keys must be distinct, HashMap_Insert
+ * them one by one when they may repeat. hash is called from several threads at once. the map owns
+ * the keys and values afterwards. return NULL when out of memory.
+ */
+HashMap* HashMap_CreateFromArrays(HashMap_CompareFunc compare,
+                    HashMap_KeyHashFunc hash,
+                    HashMap_KeyDestroyFunc keyDestroy,
+                    HashMap_ValueDestroyFunc valueDestroy,
+                    void* const* keys,
+                    void* const* values,
+                    size_t count,
+                    size_t threadCount) {
+    HashMap* hm = HashMap_CreateNew(compare, hash, keyDestroy, valueDestroy);
+    HashMapBuild build;
+    NodeSlab* slab;
+
+    if (hm == NULL || count == 0) {
+        return hm;
+    }
+
+    if ((slab = NodeSlab_CreateNew(sizeof(HashMapNode), count)) == NULL) {
+        free(hm);
+        return NULL;
+    }
+
+    build.hm = hm;
+    build.nodes = (HashMapNode*)slab->begin;
+    build.keys = keys;
+    build.values = values;
+
+    if (!NodeSlabSet_Add(&hm->slabs, slab) ||
+        !ParallelBuild_Run(&build, count, HASHMAP_DEFAULT_BUCKET_SIZE, threadCount, HashMap_BuildHash, HashMap_BuildPlace, HashMap_BuildLink)) {
+        NodeSlabSet_Release(&hm->slabs);
+        NodeSlab_Destroy(slab);
+        free(hm);
+        return NULL;
+    }
+
+    hm->length = count;
+    ContainerStats_OnAlloc(&hm->stats, count * sizeof(HashMapNode));
+    return hm;
+}
+
+/* replace the filter by one holding the current keys, the old one stays when out of memory. */
+static int HashMap_RebuildBloomFilter(HashMap* hm, size_t expectedKeys) {
+    BloomFilter* bloom;
+    HashMapNode* node;
+    size_t i;
+
+    if ((bloom = BloomFilter_CreateNew(expectedKeys, 0)) == NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < HASHMAP_DEFAULT_BUCKET_SIZE; ++i) {
+        for (node = hm->bucket[i]; node != NULL; node = node->next) {
+            BloomFilter_Add(bloom, hm->bloomHash(node->key));
+        }
+    }
+
+    if (hm->bloom != NULL) {
+        BloomFilter_Destroy(hm->bloom);
+    }
+
+    hm->bloom = bloom;
+    hm->bloomRemoved = 0;
+    return 1;
+}
+
+/**
+ * put a Bloom filter in front of the buckets, a key it has never seen is rejected without walking a
+ * chain or calling compare. inserts keep it in sync, it is rebuilt when the map outgrows it and after
+ * as many removals as half its capacity. expectedKeys 0 means the current length.
+ */
+int HashMap_AttachBloomFilter(HashMap* hm, HashMap_BloomHashFunc bloomHash, size_t expectedKeys) {
+    if (bloomHash == NULL) {
+        return 0;
+    }
+
+    hm->bloomHash = bloomHash;
+    return HashMap_RebuildBloomFilter(hm, expectedKeys > hm->length ? expectedKeys : hm->length);
+}
+
+void HashMap_DetachBloomFilter(HashMap* hm) {
+    if (hm->bloom != NULL) {
+        BloomFilter_Destroy(hm->bloom);
+    }
+
+    hm->bloom = NULL;
+    hm->bloomHash = NULL;
+}
+
+static void HashMap_BloomFilterOnInsert(HashMap* hm, void* key) {
+    if (hm->bloom == NULL) {
+        return;
+    }
+
+    /* the rebuild includes the new key. out of memory, the old filter gets fuller, it must not miss it. */
+    if (hm->length <= BloomFilter_Capacity(hm->bloom) || !HashMap_RebuildBloomFilter(hm, 2 * hm->length)) {
+        BloomFilter_Add(hm->bloom, hm->bloomHash(key));
+    }
+}
+
+static void HashMap_BloomFilterOnRemove(HashMap* hm) {
+    size_t capacity;
+
+    if (hm->bloom == NULL) {
+        return;
+    }
+
+    /* a filter sized for 0 or 1 keys still has a whole block, count by what its bits hold or every remove rebuilds. */
+    capacity = BloomFilter_SizeBytes(hm->bloom) * 8 / BLOOM_FILTER_DEFAULT_BITS_PER_KEY;
+    if (capacity < BloomFilter_Capacity(hm->bloom)) {
+        capacity = BloomFilter_Capacity(hm->bloom);
+    }
+
+    hm->bloomRemoved += 1;
+
+    if (hm->bloomRemoved > capacity / 2) {
+        HashMap_RebuildBloomFilter(hm, BloomFilter_Capacity(hm->bloom));
+    }
+}
+
+HashMapNode* HashMap_FindInBucket(HashMap* hm, HashType hashval, void* key) {
     HashMapNode* node;
+    size_t probe = 0;
 
     for (node = hm->bucket[hashval]; node != NULL; node = node->next) {
+        probe += 1;
+
         if (hm->compare(node->key, key) == 0) {
-            return node;
+            break;
         }
     }
 
-    return NULL;
+    ContainerStats_OnProbe(&hm->stats, probe);
+    return node;
+}
+
+HashMapNode* HashMap_Find(HashMap* hm, void* key) {
+    ContainerStats_OpBegin(&hm->stats, opBegin);
+    HashMapNode* node = NULL;
+
+    if (hm->bloom == NULL || BloomFilter_MayContain(hm->bloom, hm->bloomHash(key))) {
+        node = HashMap_FindInBucket(hm, hm->hash(key), key);
+    }
+    else {
+        ContainerStats_OnProbe(&hm->stats, 0);
+    }
+
+    ContainerStats_OpEnd(&hm->stats, opBegin);
+    return node;
 }
 
 int HashMap_Insert(HashMap* hm, void* key, void* value) {
+    ContainerStats_OpBegin(&hm->stats, opBegin);
+    HashType hashValue = hm->hash(key);
     HashMapNode* findNode;
-    HashType hashValue;
 
-    if ((findNode = HashMap_Find(hm, key)) == NULL) {
+    if ((findNode = HashMap_FindInBucket(hm, hashValue, key)) == NULL) {
         findNode = (HashMapNode*)malloc(sizeof(HashMapNode));
         if (findNode == NULL) {
             return 0;
         }
 
+        ContainerStats_OnAlloc(&hm->stats, sizeof(HashMapNode));
         findNode->key = key;
         findNode->value = value;
 
-        hashValue = hm->hash(key);
         findNode->next = hm->bucket[hashValue];
         hm->bucket[hashValue] = findNode;
         
         hm->length += 1;
+        HashMap_BloomFilterOnInsert(hm, key);
     }
     else {
         hm->keyDestroy(findNode->key);
@@ -124,6 +398,86 @@ int HashMap_Insert(HashMap* hm, void* key, void* value) {
         findNode->value = value;
     }
 
+    ContainerStats_OpEnd(&hm->stats, opBegin);
+    return 1;
+}
+
+/* enable HashMap_FindView / HashMap_InsertView, return 0 when a callback is missing. */
+int HashMap_SetViewFuncs(HashMap* hm, 
+                    HashMap_ViewHashFunc viewHash, 
+                    HashMap_ViewCompareFunc viewCompare, 
+                    HashMap_KeyFromViewFunc keyFromView) {
+    if (viewHash == NULL || viewCompare == NULL || keyFromView == NULL) {
+        return 0;
+    }
+
+    hm->viewHash = viewHash;
+    hm->viewCompare = viewCompare;
+    hm->keyFromView = keyFromView;
+    return 1;
+}
+
+HashMapNode* HashMap_FindViewInBucket(HashMap* hm, HashType hashval, const void* data, size_t length) {
+    HashMapNode* node;
+    size_t probe = 0;
+
+    for (node = hm->bucket[hashval]; node != NULL; node = node->next) {
+        probe += 1;
+
+        if (hm->viewCompare(node->key, data, length) == 0) {
+            break;
+        }
+    }
+
+    ContainerStats_OnProbe(&hm->stats, probe);
+    return node;
+}
+
+/* lookup by a key view, nothing is allocated. the Bloom filter hashes stored keys, it is not consulted here. */
+HashMapNode* HashMap_FindView(HashMap* hm, const void* data, size_t length) {
+    ContainerStats_OpBegin(&hm->stats, opBegin);
+    HashMapNode* node = HashMap_FindViewInBucket(hm, hm->viewHash(data, length), data, length);
+    ContainerStats_OpEnd(&hm->stats, opBegin);
+    return node;
+}
+
+/**
+ * insert or update by a key view. the key is copied by keyFromView only when it is not in the map yet,
+ * an existing entry keeps its key and only gets the new value.
+ */
+int HashMap_InsertView(HashMap* hm, const void* data, size_t length, void* value) {
+    ContainerStats_OpBegin(&hm->stats, opBegin);
+    HashType hashValue = hm->viewHash(data, length);
+    HashMapNode* findNode;
+    void* key;
+
+    if ((findNode = HashMap_FindViewInBucket(hm, hashValue, data, length)) == NULL) {
+        if ((key = hm->keyFromView(data, length)) == NULL) {
+            return 0;
+        }
+
+        findNode = (HashMapNode*)malloc(sizeof(HashMapNode));
+        if (findNode == NULL) {
+            hm->keyDestroy(key);
+            return 0;
+        }
+
+        ContainerStats_OnAlloc(&hm->stats, sizeof(HashMapNode));
+        findNode->key = key;
+        findNode->value = value;
+
+        findNode->next = hm->bucket[hashValue];
+        hm->bucket[hashValue] = findNode;
+
+        hm->length += 1;
+        HashMap_BloomFilterOnInsert(hm, key);
+    }
+    else {
+        hm->valueDestroy(findNode->value);
+        findNode->value = value;
+    }
+
+    ContainerStats_OpEnd(&hm->stats, opBegin);
     return 1;
 }
 
@@ -159,9 +513,85 @@ void HashMap_Remove(HashMap* hm, void* key) {
     hm->length -= 1;
     hm->keyDestroy(node->key);
     hm->valueDestroy(node->value);
-    free(node);
+    HashMap_FreeNode(hm, node);
+    HashMap_BloomFilterOnRemove(hm);
 }
 
+/**
+ * copy every node into one contiguous slab, bucket by bucket in chain order, and free the old ones,
+ * so walking a chain or the whole map reads memory sequentially again after a lot of insert/remove
+ * churn. keys and values stay where they are, but every HashMapNode* the caller holds is invalidated.
+ * return 0 when out of memory, the map is unchanged then.
+ */
+int HashMap_Compact(HashMap* hm) {
+    NodeSlabSet old = hm->slabs;
+    NodeSlab* slab;
+    HashMapNode* nodes;
+    HashMapNode* node;
+    HashMapNode* next;
+    size_t i, n = 0;
+
+    if (hm->length == 0) {
+        return 1;
+    }
+
+    if ((slab = NodeSlab_CreateNew(sizeof(HashMapNode), hm->length)) == NULL) {
+        return 0;
+    }
+
+    NodeSlabSet_Init(&hm->slabs);
+    if (!NodeSlabSet_Add(&hm->slabs, slab)) {
+        NodeSlab_Destroy(slab);
+        hm->slabs = old;
+        return 0;
+    }
+
+    ContainerStats_OnAlloc(&hm->stats, hm->length * sizeof(HashMapNode));
+    nodes = (HashMapNode*)slab->begin;
+
+    for (i = 0; i < HASHMAP_DEFAULT_BUCKET_SIZE; ++i) {
+        if (hm->bucket[i] == NULL) {
+            continue;
+        }
+
+        for (node = hm->bucket[i], hm->bucket[i] = &nodes[n]; node != NULL; node = next, ++n) {
+            next = node->next;
+            nodes[n].next = (next == NULL) ? NULL : &nodes[n + 1];
+            nodes[n].key = node->key;
+            nodes[n].value = node->value;
+
+            if (!NodeSlabSet_FreeNode(&old, node)) {
+                free(node);
+            }
+
+            ContainerStats_OnFree(&hm->stats, sizeof(HashMapNode));
+        }
+    }
+
+    NodeSlabSet_Release(&old);
+    return 1;
+}
+
+#ifdef CONTAINER_STATS
+/* copy the counters, and fill the chain length histogram from the current buckets. */
+void HashMap_GetStats(HashMap* hm, ContainerStats* out) {
+    size_t i, len;
+    HashMapNode* node;
+
+    *out = hm->stats;
+    memset(out->chainHistogram, 0, sizeof(out->chainHistogram));
+
+    for (i = 0; i < HASHMAP_DEFAULT_BUCKET_SIZE; ++i) {
+        len = 0;
+        for (node = hm->bucket[i]; node != NULL; node = node->next) {
+            len += 1;
+        }
+
+        ContainerStats_OnChain(out, len);
+    }
+}
+#endif
+
 HashType hash_c_style_str(void* key) {
     const char* str = (const char*)key;
     HashType hashval = 0;
@@ -176,6 +606,106 @@ int compare_c_style_str(void* left, void* right) {
     return strcmp((const char*)(left), (const char*)(right));
 }
 
+/* the view counterparts of hash_c_style_str / compare_c_style_str, for maps of malloc'ed c strings. */
+HashType hash_c_style_str_view(const void* data, size_t length) {
+    const char* str = (const char*)data;
+    HashType hashval = 0;
+    size_t i;
+
+    for (i = 0; i < length; ++i)
+        hashval = str[i] + hashval * 31;
+
+    return hashval % HASHMAP_DEFAULT_BUCKET_SIZE;
+}
+
+/* a view may hold '\0' bytes, so compare lengths first, then bytes; strncmp would stop at the first '\0'. */
+int compare_c_style_str_view(void* key, const void* data, size_t length) {
+    const char* str = (const char*)key;
+
+    if (strnlen(str, length + 1) != length) {   /* never reads past the stored key's terminator. */
+        return 1;
+    }
+
+    return memcmp(str, data, length) != 0;
+}
+
+uint64_t bloom_hash_c_style_str(void* key) {
+    return BloomFilter_HashBytes(key, strlen((const char*)key));
+}
+
+void* c_style_str_from_view(const void* data, size_t length) {
+    char* str = (char*)malloc(length + 1);
+    if (str == NULL) {
+        return NULL;
+    }
+
+    memcpy(str, data, length);
+    str[length] = '\0';
+    return str;
+}
+
+/**
+ * interned-key mode: keys from a StringInternPool (adt_string_intern.c) are unique per content, so
+ * the pointer itself is hashed and compared, no string is walked on lookup.
+ */
+HashType hash_interned_key(void* key) {
+    uint64_t p = (uint64_t)(uintptr_t)key;
+
+    p ^= p >> 33;
+    p *= 0xff51afd7ed558ccdull;
+    p ^= p >> 33;
+    return (HashType)(p % HASHMAP_DEFAULT_BUCKET_SIZE);
+}
+
+int compare_interned_key(void* left, void* right) {
+    return left != right;
+}
+
+static double seconds_since(const struct timespec* begin) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - begin->tv_sec) + (double)(end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+#define BENCH_KEYS      20000
+#define BENCH_LOOKUPS   1000000
+#define BENCH_BUILD_KEYS   100000
+
+/* 4 lookups out of 5 miss, as in a cache in front of a slower store. */
+double bench_misses(int withBloomFilter, size_t* hits) {
+    HashMap* hm = HashMap_CreateNew(compare_c_style_str, hash_c_style_str, free, NULL);
+    char buf[32];
+    struct timespec begin;
+    uint64_t x = 88172645463325252ull;
+    size_t i;
+    double seconds;
+
+    for (i = 0; i < BENCH_KEYS; ++i) {
+        snprintf(buf, sizeof(buf), "key:%zu", i);
+        HashMap_Insert(hm, c_style_str_from_view(buf, strlen(buf)), NULL);
+    }
+
+    if (withBloomFilter) {
+        HashMap_AttachBloomFilter(hm, bloom_hash_c_style_str, 0);
+    }
+
+    *hits = 0;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < BENCH_LOOKUPS; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        snprintf(buf, sizeof(buf), "key:%zu", (size_t)(x % (5 * BENCH_KEYS)));
+        *hits += (HashMap_Find(hm, buf) != NULL);
+    }
+
+    seconds = seconds_since(&begin);
+    HashMap_Destroy(hm);
+    return seconds;
+}
+
 int main() {
     HashMap* hm = HashMap_CreateNew(compare_c_style_str, hash_c_style_str, NULL, NULL);
 
@@ -193,6 +723,11 @@ int main() {
         printf("not found\n");
     }
 
+    /* the nodes move into one slab, the node pointer found above is stale now. */
+    HashMap_Compact(hm);
+    node = HashMap_Find(hm, "fzc");
+    printf("compacted: %s -> %s\n", "fzc", node == NULL ? "not found" : (const char*)node->value);
+
     /* traverse. */
     printf("\ntraverse: \n");
 
@@ -208,5 +743,97 @@ int main() {
         }
     }
 
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    HashMap_GetStats(hm, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
+    HashMap_Destroy(hm);
+
+    /* keys sliced out of a request line, copied only the first time they are seen. */
+    const char* request = "GET /index.html\nGET /favicon.ico\nGET /index.html\n";
+    const char* begin;
+    const char* end;
+
+    hm = HashMap_CreateNew(compare_c_style_str, hash_c_style_str, free, NULL);
+    HashMap_SetViewFuncs(hm, hash_c_style_str_view, compare_c_style_str_view, c_style_str_from_view);
+
+    for (begin = request; (begin = strchr(begin, '/')) != NULL; begin = end) {
+        end = strchr(begin, '\n');
+        node = HashMap_FindView(hm, begin, (size_t)(end - begin));
+        HashMap_InsertView(hm, begin, (size_t)(end - begin), (void*)(uintptr_t)(node == NULL ? 1 : (uintptr_t)node->value + 1));
+    }
+
+    printf("\nhits by path: \n");
+    printf("  %s: %u\n", "/index.html", (unsigned)(uintptr_t)HashMap_Find(hm, "/index.html")->value);
+    printf("  %s: %u\n", "/favicon.ico", (unsigned)(uintptr_t)HashMap_FindView(hm, "/favicon.ico\n", 12)->value);
+
+    /* the keys are freed on the reclaimer thread. */
+    Reclaimer* reclaimer = Reclaimer_CreateNew(0);
+    HashMap_DestroyAsync(hm, reclaimer);
+    Reclaimer_Destroy(reclaimer);
+
+    /* Bloom filter in front of the chains. */
+    size_t plainHits, bloomHits;
+    double plainSeconds = bench_misses(0, &plainHits);
+    double bloomSeconds = bench_misses(1, &bloomHits);
+
+    printf("\n%d keys, %d lookups, 80%% misses\n", BENCH_KEYS, BENCH_LOOKUPS);
+    printf("  without Bloom filter: %.4f s, %zu hits\n", plainSeconds, plainHits);
+    printf("  with Bloom filter:    %.4f s, %zu hits\n", bloomSeconds, bloomHits);
+
+    /* a filter attached to an empty map is sized for 0 keys, churn on one key must not rebuild it every time. */
+    BloomFilter* bloom;
+    size_t rebuilds = 0;
+
+    hm = HashMap_CreateNew(compare_c_style_str, hash_c_style_str, NULL, NULL);
+    HashMap_AttachBloomFilter(hm, bloom_hash_c_style_str, 0);
+
+    for (i = 0; i < 1000; ++i) {
+        bloom = hm->bloom;
+        HashMap_Insert(hm, "churn", NULL);
+        HashMap_Remove(hm, "churn");
+        rebuilds += (hm->bloom != bloom);
+    }
+
+    printf("  1000 insert / remove pairs on an empty map: %zu rebuilds\n", rebuilds);
     HashMap_Destroy(hm);
+
+    /* bulk build against an Insert loop, the keys are distinct. */
+    void** keys = (void**)malloc(BENCH_BUILD_KEYS * sizeof(void*));
+    void** values = (void**)malloc(BENCH_BUILD_KEYS * sizeof(void*));
+    struct timespec buildBegin;
+    size_t threads;
+    char buf[32];
+
+    for (i = 0; i < BENCH_BUILD_KEYS; ++i) {
+        snprintf(buf, sizeof(buf), "key:%zu", i);
+        keys[i] = c_style_str_from_view(buf, strlen(buf));
+        values[i] = (void*)(uintptr_t)i;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &buildBegin);
+    hm = HashMap_CreateNew(compare_c_style_str, hash_c_style_str, NULL, NULL);
+    for (i = 0; i < BENCH_BUILD_KEYS; ++i) {
+        HashMap_Insert(hm, keys[i], values[i]);
+    }
+    printf("\n%d keys\n  Insert loop:               %.4f s\n", BENCH_BUILD_KEYS, seconds_since(&buildBegin));
+    HashMap_Destroy(hm);
+
+    for (threads = 1; threads <= 4; threads *= 4) {
+        clock_gettime(CLOCK_MONOTONIC, &buildBegin);
+        hm = HashMap_CreateFromArrays(compare_c_style_str, hash_c_style_str, NULL, NULL, keys, values, BENCH_BUILD_KEYS, threads);
+        printf("  CreateFromArrays, %zu thread%s: %.4f s, \"key:77\" -> %zu\n", threads, threads == 1 ? " " : "s",
+               seconds_since(&buildBegin), (size_t)(uintptr_t)HashMap_Find(hm, "key:77")->value);
+        HashMap_Destroy(hm);
+    }
+
+    for (i = 0; i < BENCH_BUILD_KEYS; ++i) {
+        free(keys[i]);
+    }
+
+    free(keys);
+    free(values);
+    return 0;
 }
@@ -0,0 +1,615 @@
+/**
+ * LRU cache: a hash map and a doubly linked list sharing one node per entry.
+ *
+ * every entry is a single allocation holding the bucket chain link (like HashMapNode) and the
+ * recency links (like DListNode). capacity is counted in entries, or in bytes when a charge
+ * function is given. the cache is split into shards by hash, each shard has its own lock, list
+ * and capacity share, so lookups on different shards never contend.
+ *
+ * build: cc -std=c11 -O2 adt_lru_cache.c -lpthread
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "container_stats.h"
+
+#define LRU_CACHE_MIN_BUCKET_SIZE   16
+
+typedef struct LRUCacheEntry LRUCacheEntry;
+typedef struct LRUCacheShard LRUCacheShard;
+typedef struct LRUCache LRUCache;
+typedef uint32_t HashType;
+
+typedef int (*LRUCache_CompareFunc) (void* left, void* right);   /* return 0 means equal. */
+typedef HashType (*LRUCache_KeyHashFunc) (void* key);            /* full 32 bits, no modulo. */
+typedef size_t (*LRUCache_ChargeFunc) (void* key, void* value);  /* bytes an entry costs. */
+
+typedef void (*LRUCache_KeyDestroyFunc) (void* key);
+typedef void (*LRUCache_ValueDestroyFunc) (void* value);
+typedef void (*LRUCache_EvictFunc) (void* key, void* value, void* context);   /* before the destroy funcs. */
+typedef void (*LRUCache_VisitFunc) (void* value, void* context);
+
+struct LRUCacheEntry {
+    LRUCacheEntry* hashNext;
+    LRUCacheEntry* prev;   /* towards the most recently used. */
+    LRUCacheEntry* next;   /* towards the least recently used. */
+    HashType hash;
+    size_t charge;
+    void* key;
+    void* value;
+};
+
+struct LRUCacheShard {
+    pthread_mutex_t lock;
+    LRUCacheEntry** bucket;
+    size_t bucketMask;
+    LRUCacheEntry* head;   /* most recently used. */
+    LRUCacheEntry* tail;   /* least recently used, evicted first. */
+    size_t length;
+    size_t usage;
+    size_t capacity;
+    CONTAINER_STATS_FIELD(stats)   /* updated under the shard lock. */
+    char padding[64];      /* keep neighbouring shard locks off the same cache line. */
+};
+
+struct LRUCache {
+    LRUCacheShard* shards;
+    size_t shardCount;
+    unsigned int shardBits;
+
+    LRUCache_CompareFunc compare;
+    LRUCache_KeyHashFunc hash;
+    LRUCache_ChargeFunc charge;
+    LRUCache_KeyDestroyFunc keyDestroy;
+    LRUCache_ValueDestroyFunc valueDestroy;
+    LRUCache_EvictFunc evict;
+    void* evictContext;
+};
+
+#define LRUCache_ShardCount(cachePtr)   ((cachePtr)->shardCount)
+
+void LRUCache_DefaultKeyDestroyFunc(void* key) {}
+void LRUCache_DefaultValueDestroyFunc(void* value) {}
+void LRUCache_DefaultEvictFunc(void* key, void* value, void* context) {}
+
+/**
+ * the shard comes from the top bits, which a weak hash leaves at 0 for short keys (a *31 polynomial
+ * over 4 chars or less), so they are mixed in first (murmur3 fmix32). the buckets keep the raw low bits.
+ */
+static LRUCacheShard* LRUCache_ShardOf(LRUCache* cache, HashType hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return &cache->shards[cache->shardBits == 0 ? 0 : hash >> (32 - cache->shardBits)];
+}
+
+/**
+ * capacity: total entries, or total bytes when charge != NULL, split evenly across shards.
+ * shardCount: rounded up to a power of 2, 1 gives a single list with exact global LRU order.
+ */
+LRUCache* LRUCache_CreateNew(size_t capacity,
+                             size_t shardCount,
+                             LRUCache_CompareFunc compare,
+                             LRUCache_KeyHashFunc hash,
+                             LRUCache_ChargeFunc charge,
+                             LRUCache_KeyDestroyFunc keyDestroy,
+                             LRUCache_ValueDestroyFunc valueDestroy) {
+    LRUCache* cache;
+    LRUCacheShard* shard;
+    size_t i;
+
+    if (compare == NULL || hash == NULL || capacity == 0) {
+        return NULL;
+    }
+
+    if ((cache = (LRUCache*)malloc(sizeof(LRUCache))) == NULL) {
+        return NULL;
+    }
+
+    cache->shardCount = 1;
+    cache->shardBits = 0;
+    while (cache->shardCount < shardCount && cache->shardBits < 16) {
+        cache->shardCount *= 2;
+        cache->shardBits += 1;
+    }
+
+    if ((cache->shards = (LRUCacheShard*)malloc(cache->shardCount * sizeof(LRUCacheShard))) == NULL) {
+        free(cache);
+        return NULL;
+    }
+
+    for (i = 0; i < cache->shardCount; ++i) {
+        shard = &cache->shards[i];
+        shard->bucketMask = LRU_CACHE_MIN_BUCKET_SIZE - 1;
+
+        if ((shard->bucket = (LRUCacheEntry**)calloc(LRU_CACHE_MIN_BUCKET_SIZE, sizeof(LRUCacheEntry*))) == NULL) {
+            while (i-- > 0) {
+                pthread_mutex_destroy(&cache->shards[i].lock);
+                free(cache->shards[i].bucket);
+            }
+
+            free(cache->shards);
+            free(cache);
+            return NULL;
+        }
+
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->head = shard->tail = NULL;
+        shard->length = 0;
+        shard->usage = 0;
+        shard->capacity = (capacity + cache->shardCount - 1) / cache->shardCount;
+        ContainerStats_Init(&shard->stats, "LRUCache");
+        ContainerStats_OnAlloc(&shard->stats, LRU_CACHE_MIN_BUCKET_SIZE * sizeof(LRUCacheEntry*));
+    }
+
+    cache->compare = compare;
+    cache->hash = hash;
+    cache->charge = charge;
+    cache->keyDestroy = (keyDestroy == NULL ? LRUCache_DefaultKeyDestroyFunc : keyDestroy);
+    cache->valueDestroy = (valueDestroy == NULL ? LRUCache_DefaultValueDestroyFunc : valueDestroy);
+    cache->evict = LRUCache_DefaultEvictFunc;
+    cache->evictContext = NULL;
+    return cache;
+}
+
+void LRUCache_SetEvictFunc(LRUCache* cache, LRUCache_EvictFunc evict, void* context) {
+    cache->evict = (evict == NULL ? LRUCache_DefaultEvictFunc : evict);
+    cache->evictContext = context;
+}
+
+void LRUCache_Destroy(LRUCache* cache) {
+    LRUCacheShard* shard;
+    LRUCacheEntry* entry;
+    size_t i;
+
+    for (i = 0; i < cache->shardCount; ++i) {
+        shard = &cache->shards[i];
+
+        while (shard->head != NULL) {
+            entry = shard->head;
+            shard->head = entry->next;
+
+            cache->keyDestroy(entry->key);
+            cache->valueDestroy(entry->value);
+            free(entry);
+        }
+
+        pthread_mutex_destroy(&shard->lock);
+        free(shard->bucket);
+    }
+
+    free(cache->shards);
+    free(cache);
+}
+
+/* the following helpers expect the shard lock to be held. */
+static void LRUCache_ListUnlink(LRUCacheShard* shard, LRUCacheEntry* entry) {
+    if (entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    }
+    else {
+        shard->head = entry->next;
+    }
+
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    }
+    else {
+        shard->tail = entry->prev;
+    }
+}
+
+static void LRUCache_ListPushFront(LRUCacheShard* shard, LRUCacheEntry* entry) {
+    entry->prev = NULL;
+    entry->next = shard->head;
+
+    if (shard->head != NULL) {
+        shard->head->prev = entry;
+    }
+    else {
+        shard->tail = entry;
+    }
+
+    shard->head = entry;
+}
+
+/* return the link pointing at the entry with key, or at the NULL ending its bucket chain. */
+static LRUCacheEntry** LRUCache_FindLink(LRUCache* cache, LRUCacheShard* shard, HashType hash, void* key) {
+    LRUCacheEntry** link = &shard->bucket[hash & shard->bucketMask];
+    size_t probe = 0;
+
+    while (*link != NULL && ((*link)->hash != hash || cache->compare((*link)->key, key) != 0)) {
+        link = &(*link)->hashNext;
+        probe += 1;
+    }
+
+    ContainerStats_OnProbe(&shard->stats, probe + (*link != NULL));
+    return link;
+}
+
+static void LRUCache_GrowBuckets(LRUCacheShard* shard) {
+    size_t newMask = 2 * shard->bucketMask + 1;
+    LRUCacheEntry** bucket = (LRUCacheEntry**)calloc(newMask + 1, sizeof(LRUCacheEntry*));
+    LRUCacheEntry* entry;
+
+    if (bucket == NULL) {
+        return;   /* keep the longer chains. */
+    }
+
+    for (entry = shard->head; entry != NULL; entry = entry->next) {
+        entry->hashNext = bucket[entry->hash & newMask];
+        bucket[entry->hash & newMask] = entry;
+    }
+
+    ContainerStats_OnGrow(&shard->stats, (shard->bucketMask + 1) * sizeof(LRUCacheEntry*), (newMask + 1) * sizeof(LRUCacheEntry*));
+    free(shard->bucket);
+    shard->bucket = bucket;
+    shard->bucketMask = newMask;
+}
+
+/* detach the entry from the chain and the list, the caller frees it outside the lock. */
+static void LRUCache_Detach(LRUCacheShard* shard, LRUCacheEntry** link) {
+    LRUCacheEntry* entry = *link;
+
+    *link = entry->hashNext;
+    LRUCache_ListUnlink(shard, entry);
+    shard->length -= 1;
+    shard->usage -= entry->charge;
+    ContainerStats_OnFree(&shard->stats, sizeof(LRUCacheEntry));
+}
+
+static void LRUCache_FreeEntries(LRUCache* cache, LRUCacheEntry* entry, int isEvicted) {
+    LRUCacheEntry* next;
+
+    for (; entry != NULL; entry = next) {
+        next = entry->hashNext;
+
+        if (isEvicted) {
+            cache->evict(entry->key, entry->value, cache->evictContext);
+        }
+
+        cache->keyDestroy(entry->key);
+        cache->valueDestroy(entry->value);
+        free(entry);
+    }
+}
+
+/* insert or replace, then evict from the cold end until the shard fits. return 0 when out of memory. */
+int LRUCache_Put(LRUCache* cache, void* key, void* value) {
+    HashType hash = cache->hash(key);
+    LRUCacheShard* shard = LRUCache_ShardOf(cache, hash);
+    LRUCacheEntry* replaced = NULL;
+    LRUCacheEntry* evicted = NULL;
+    LRUCacheEntry* victim;
+    LRUCacheEntry** link;
+
+    LRUCacheEntry* entry = (LRUCacheEntry*)malloc(sizeof(LRUCacheEntry));
+    if (entry == NULL) {
+        return 0;
+    }
+
+    entry->hash = hash;
+    entry->key = key;
+    entry->value = value;
+    entry->charge = (cache->charge == NULL ? 1 : cache->charge(key, value));
+
+    pthread_mutex_lock(&shard->lock);
+    ContainerStats_OpBegin(&shard->stats, opBegin);
+    ContainerStats_OnAlloc(&shard->stats, sizeof(LRUCacheEntry));
+
+    link = LRUCache_FindLink(cache, shard, hash, key);
+    if (*link != NULL) {
+        replaced = *link;
+        LRUCache_Detach(shard, link);
+        replaced->hashNext = NULL;
+    }
+
+    entry->hashNext = shard->bucket[hash & shard->bucketMask];
+    shard->bucket[hash & shard->bucketMask] = entry;
+    LRUCache_ListPushFront(shard, entry);
+    shard->length += 1;
+    shard->usage += entry->charge;
+
+    while (shard->usage > shard->capacity && shard->tail != NULL) {
+        victim = shard->tail;
+        LRUCache_Detach(shard, LRUCache_FindLink(cache, shard, victim->hash, victim->key));
+        victim->hashNext = evicted;
+        evicted = victim;
+    }
+
+    if (shard->length > shard->bucketMask + 1) {
+        LRUCache_GrowBuckets(shard);
+    }
+
+    ContainerStats_OpEnd(&shard->stats, opBegin);
+    pthread_mutex_unlock(&shard->lock);
+
+    /* user callbacks run outside the lock. */
+    LRUCache_FreeEntries(cache, replaced, 0);
+    LRUCache_FreeEntries(cache, evicted, 1);
+    return 1;
+}
+
+/**
+ * return 1 and mark the entry most recently used when key is cached.
+ * with several threads, *value may be evicted and destroyed by another thread right after this returns,
+ * use LRUCache_GetWith to work with the value while it is pinned.
+ */
+int LRUCache_Get(LRUCache* cache, void* key, void** value) {
+    HashType hash = cache->hash(key);
+    LRUCacheShard* shard = LRUCache_ShardOf(cache, hash);
+    LRUCacheEntry* entry;
+
+    pthread_mutex_lock(&shard->lock);
+    ContainerStats_OpBegin(&shard->stats, opBegin);
+
+    if ((entry = *LRUCache_FindLink(cache, shard, hash, key)) != NULL) {
+        if (entry != shard->head) {
+            LRUCache_ListUnlink(shard, entry);
+            LRUCache_ListPushFront(shard, entry);
+        }
+
+        *value = entry->value;
+    }
+
+    ContainerStats_OpEnd(&shard->stats, opBegin);
+    pthread_mutex_unlock(&shard->lock);
+    return entry != NULL;
+}
+
+/* like LRUCache_Get, visit runs under the shard lock and must not call back into the cache. */
+int LRUCache_GetWith(LRUCache* cache, void* key, LRUCache_VisitFunc visit, void* context) {
+    HashType hash = cache->hash(key);
+    LRUCacheShard* shard = LRUCache_ShardOf(cache, hash);
+    LRUCacheEntry* entry;
+
+    pthread_mutex_lock(&shard->lock);
+    ContainerStats_OpBegin(&shard->stats, opBegin);
+
+    if ((entry = *LRUCache_FindLink(cache, shard, hash, key)) != NULL) {
+        if (entry != shard->head) {
+            LRUCache_ListUnlink(shard, entry);
+            LRUCache_ListPushFront(shard, entry);
+        }
+
+        visit(entry->value, context);
+    }
+
+    ContainerStats_OpEnd(&shard->stats, opBegin);
+    pthread_mutex_unlock(&shard->lock);
+    return entry != NULL;
+}
+
+void LRUCache_Remove(LRUCache* cache, void* key) {
+    HashType hash = cache->hash(key);
+    LRUCacheShard* shard = LRUCache_ShardOf(cache, hash);
+    LRUCacheEntry* entry;
+    LRUCacheEntry** link;
+
+    pthread_mutex_lock(&shard->lock);
+    ContainerStats_OpBegin(&shard->stats, opBegin);
+
+    link = LRUCache_FindLink(cache, shard, hash, key);
+    if ((entry = *link) != NULL) {
+        LRUCache_Detach(shard, link);
+        entry->hashNext = NULL;
+    }
+
+    ContainerStats_OpEnd(&shard->stats, opBegin);
+    pthread_mutex_unlock(&shard->lock);
+    LRUCache_FreeEntries(cache, entry, 0);
+}
+
+size_t LRUCache_Length(LRUCache* cache) {
+    size_t i, length = 0;
+
+    for (i = 0; i < cache->shardCount; ++i) {
+        pthread_mutex_lock(&cache->shards[i].lock);
+        length += cache->shards[i].length;
+        pthread_mutex_unlock(&cache->shards[i].lock);
+    }
+
+    return length;
+}
+
+size_t LRUCache_Usage(LRUCache* cache) {
+    size_t i, usage = 0;
+
+    for (i = 0; i < cache->shardCount; ++i) {
+        pthread_mutex_lock(&cache->shards[i].lock);
+        usage += cache->shards[i].usage;
+        pthread_mutex_unlock(&cache->shards[i].lock);
+    }
+
+    return usage;
+}
+
+#ifdef CONTAINER_STATS
+/* the counters of every shard added up, and the chain length histogram of the current buckets. */
+void LRUCache_GetStats(LRUCache* cache, ContainerStats* out) {
+    LRUCacheShard* shard;
+    LRUCacheEntry* entry;
+    size_t i, b, len;
+
+    ContainerStats_Init(out, "LRUCache");
+
+    for (i = 0; i < cache->shardCount; ++i) {
+        shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        ContainerStats_Merge(out, &shard->stats);
+
+        for (b = 0; b <= shard->bucketMask; ++b) {
+            len = 0;
+            for (entry = shard->bucket[b]; entry != NULL; entry = entry->hashNext) {
+                len += 1;
+            }
+
+            ContainerStats_OnChain(out, len);
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+#endif
+
+/* usage. */
+HashType lru_hash_c_style_str(void* key) {   /* hash_c_style_str without the modulo. */
+    const char* str = (const char*)key;
+    HashType hashval = 0;
+
+    for (; *str != '\0' ; ++str)
+        hashval = *str + hashval * 31;
+
+    return hashval;
+}
+
+int compare_c_style_str(void* left, void* right) {
+    return strcmp((const char*)(left), (const char*)(right));
+}
+
+size_t charge_c_style_str(void* key, void* value) {
+    return strlen((const char*)key) + strlen((const char*)value);
+}
+
+HashType hash_uintptr(void* key) {
+    uint64_t x = (uint64_t)(uintptr_t)key;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return (HashType)x;
+}
+
+int compare_uintptr(void* left, void* right) {
+    return left != right;
+}
+
+void print_evicted(void* key, void* value, void* context) {
+    printf("  evicted {'%s': '%s'}\n", (const char*)key, (const char*)value);
+}
+
+#define BENCH_THREAD_COUNT   4
+#define BENCH_KEY_RANGE      200000
+#define BENCH_OPS_PER_THREAD 2000000
+
+typedef struct BenchContext {
+    LRUCache* cache;
+    unsigned int seed;
+    size_t hits;
+} BenchContext;
+
+void* bench_routine(void* arg) {
+    BenchContext* ctx = (BenchContext*)arg;
+    uint64_t x = ctx->seed;
+    uintptr_t key;
+    void* value;
+    size_t i;
+
+    for (i = 0; i < BENCH_OPS_PER_THREAD; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        key = (uintptr_t)(x % BENCH_KEY_RANGE) + 1;
+
+        if (LRUCache_Get(ctx->cache, (void*)key, &value)) {
+            ctx->hits += 1;
+        }
+        else {
+            LRUCache_Put(ctx->cache, (void*)key, (void*)key);
+        }
+    }
+
+    return NULL;
+}
+
+void bench(size_t shardCount) {
+    LRUCache* cache = LRUCache_CreateNew(BENCH_KEY_RANGE / 2, shardCount, compare_uintptr, hash_uintptr, NULL, NULL, NULL);
+    pthread_t threads[BENCH_THREAD_COUNT];
+    BenchContext ctx[BENCH_THREAD_COUNT];
+    struct timespec begin, end;
+    size_t i, hits = 0;
+    double seconds;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < BENCH_THREAD_COUNT; ++i) {
+        ctx[i].cache = cache;
+        ctx[i].seed = 0x9e3779b9u * (unsigned int)(i + 1);
+        ctx[i].hits = 0;
+        pthread_create(&threads[i], NULL, bench_routine, &ctx[i]);
+    }
+
+    for (i = 0; i < BENCH_THREAD_COUNT; ++i) {
+        pthread_join(threads[i], NULL);
+        hits += ctx[i].hits;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (double)(end.tv_sec - begin.tv_sec) + (double)(end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    printf("%2zu shard(s), %d threads: %.2f M ops/s, hit rate %.1f%%\n", LRUCache_ShardCount(cache), BENCH_THREAD_COUNT,
+           BENCH_THREAD_COUNT * BENCH_OPS_PER_THREAD / seconds / 1e6, 100.0 * hits / (BENCH_THREAD_COUNT * BENCH_OPS_PER_THREAD));
+
+    LRUCache_Destroy(cache);
+}
+
+int main() {
+    /* capacity by bytes: 16 bytes of keys + values. */
+    LRUCache* cache = LRUCache_CreateNew(16, 1, compare_c_style_str, lru_hash_c_style_str, charge_c_style_str, NULL, NULL);
+    void* value;
+
+    LRUCache_SetEvictFunc(cache, print_evicted, NULL);
+
+    LRUCache_Put(cache, "abc", "def");
+    LRUCache_Put(cache, "ock", "dlcma");
+    LRUCache_Get(cache, "abc", &value);      /* abc becomes the most recently used. */
+    LRUCache_Put(cache, "d3q", "lcke");      /* 22 bytes, ock goes first. */
+
+    printf("abc: %s\n", LRUCache_Get(cache, "abc", &value) ? (const char*)value : "miss");
+    printf("ock: %s\n", LRUCache_Get(cache, "ock", &value) ? (const char*)value : "miss");
+    printf("d3q: %s\n", LRUCache_Get(cache, "d3q", &value) ? (const char*)value : "miss");
+    printf("%zu entries, %zu bytes\n", LRUCache_Length(cache), LRUCache_Usage(cache));
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    LRUCache_GetStats(cache, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
+    LRUCache_Destroy(cache);
+
+    /* every 2 char key hashes below 2^12, they must still spread over all the shards. */
+    static char shortKeys[26 * 26][3];
+    size_t i, least = (size_t)-1, most = 0;
+
+    cache = LRUCache_CreateNew(26 * 26, 8, compare_c_style_str, lru_hash_c_style_str, NULL, NULL, NULL);
+    for (i = 0; i < 26 * 26; ++i) {
+        shortKeys[i][0] = (char)('a' + i / 26);
+        shortKeys[i][1] = (char)('a' + i % 26);
+        LRUCache_Put(cache, shortKeys[i], NULL);
+    }
+
+    for (i = 0; i < LRUCache_ShardCount(cache); ++i) {
+        least = cache->shards[i].length < least ? cache->shards[i].length : least;
+        most = cache->shards[i].length > most ? cache->shards[i].length : most;
+    }
+
+    printf("%d short keys over %zu shards: %zu to %zu per shard, %s\n",
+           26 * 26, LRUCache_ShardCount(cache), least, most, least > 0 ? "ok" : "FAILED");
+    LRUCache_Destroy(cache);
+
+    if (least == 0) {
+        return 1;
+    }
+
+    bench(1);
+    bench(16);
+    return 0;
+}
@@ -0,0 +1,837 @@
+/**
+ * persistent (immutable) hash map, a hash array mapped trie (HAMT).
+ *
+ * every update returns a new version that shares all untouched subtrees with the old one,
+ * so keeping an old version around (a snapshot) costs one reference count increment.
+ * nodes and entries are reference counted with atomics, a version can be read from any number
+ * of threads without locks, and is freed when the last version referencing it is released.
+ *
+ * PersistentHashMapCell publishes the latest version from a writer to lock-free readers.
+ *
+ * build: cc -std=c11 -O2 adt_persistent_hashmap.c -lpthread
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "container_stats.h"
+
+#define PERSISTENT_HASHMAP_BITS       5
+#define PERSISTENT_HASHMAP_FANOUT     (1u << PERSISTENT_HASHMAP_BITS)
+#define PERSISTENT_HASHMAP_MASK       (PERSISTENT_HASHMAP_FANOUT - 1)
+#define PERSISTENT_HASHMAP_HASH_BITS  32   /* below this depth keys with equal hashes share a collision node. */
+
+typedef struct PersistentHashMapEntry PersistentHashMapEntry;
+typedef struct PersistentHashMapNode PersistentHashMapNode;
+typedef struct PersistentHashMap PersistentHashMap;
+typedef uint32_t HashType;
+
+typedef int (*PersistentHashMap_CompareFunc) (void* left, void* right);   /* return 0 means equal. */
+typedef HashType (*PersistentHashMap_KeyHashFunc) (void* key);            /* full 32 bits, no modulo. */
+
+typedef void (*PersistentHashMap_KeyDestroyFunc) (void* key);
+typedef void (*PersistentHashMap_ValueDestroyFunc) (void* value);
+
+struct PersistentHashMapEntry {
+    atomic_size_t refCount;
+    HashType hash;
+    void* key;
+    void* value;
+};
+
+/**
+ * slots hold either a child node or an entry, entries are tagged with the lowest pointer bit.
+ * a collision node has no bitmap, its slots are all entries with the same hash.
+ */
+struct PersistentHashMapNode {
+    atomic_size_t refCount;
+    uint32_t bitmap;
+    uint16_t count;
+    uint16_t isCollision;
+    void* slot[];
+};
+
+struct PersistentHashMap {
+    atomic_size_t refCount;
+    PersistentHashMapNode* root;   /* NULL when empty. */
+    size_t length;
+
+    PersistentHashMap_CompareFunc compare;
+    PersistentHashMap_KeyHashFunc hash;
+    PersistentHashMap_KeyDestroyFunc keyDestroy;
+    PersistentHashMap_ValueDestroyFunc valueDestroy;
+
+    CONTAINER_STATS_FIELD(stats)   /* every update leading to this version, never written once published. */
+};
+
+#define PersistentHashMap_Length(hmPtr)    ((hmPtr)->length)
+#define PersistentHashMap_IsEmpty(hmPtr)   (PersistentHashMap_Length(hmPtr) == 0)
+
+#define PersistentHashMap_SlotIsEntry(slot)     (((uintptr_t)(slot) & 1u) != 0)
+#define PersistentHashMap_SlotEntry(slot)       ((PersistentHashMapEntry*)((uintptr_t)(slot) & ~(uintptr_t)1u))
+#define PersistentHashMap_EntrySlot(entryPtr)   ((void*)((uintptr_t)(entryPtr) | 1u))
+
+void PersistentHashMap_DefaultKeyDestroyFunc(void* key) {}
+void PersistentHashMap_DefaultValueDestroyFunc(void* value) {}
+
+static void PersistentHashMap_ReleaseEntry(PersistentHashMap* hm, PersistentHashMapEntry* entry) {
+    if (atomic_fetch_sub_explicit(&entry->refCount, 1, memory_order_acq_rel) == 1) {
+        hm->keyDestroy(entry->key);
+        hm->valueDestroy(entry->value);
+        free(entry);
+    }
+}
+
+static void PersistentHashMap_ReleaseNode(PersistentHashMap* hm, PersistentHashMapNode* node);
+
+static void PersistentHashMap_RetainSlot(void* slot) {
+    if (PersistentHashMap_SlotIsEntry(slot)) {
+        atomic_fetch_add_explicit(&PersistentHashMap_SlotEntry(slot)->refCount, 1, memory_order_relaxed);
+    }
+    else {
+        atomic_fetch_add_explicit(&((PersistentHashMapNode*)slot)->refCount, 1, memory_order_relaxed);
+    }
+}
+
+static void PersistentHashMap_ReleaseSlot(PersistentHashMap* hm, void* slot) {
+    if (PersistentHashMap_SlotIsEntry(slot)) {
+        PersistentHashMap_ReleaseEntry(hm, PersistentHashMap_SlotEntry(slot));
+    }
+    else {
+        PersistentHashMap_ReleaseNode(hm, (PersistentHashMapNode*)slot);
+    }
+}
+
+static void PersistentHashMap_ReleaseNode(PersistentHashMap* hm, PersistentHashMapNode* node) {
+    size_t i;
+
+    if (atomic_fetch_sub_explicit(&node->refCount, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    for (i = 0; i < node->count; ++i) {
+        PersistentHashMap_ReleaseSlot(hm, node->slot[i]);
+    }
+
+    free(node);
+}
+
+static PersistentHashMapNode* PersistentHashMap_AllocNode(size_t count, uint32_t bitmap, int isCollision) {
+    PersistentHashMapNode* node = (PersistentHashMapNode*)malloc(sizeof(PersistentHashMapNode) + count * sizeof(void*));
+    if (node == NULL) {
+        return NULL;
+    }
+
+    atomic_init(&node->refCount, 1);
+    node->bitmap = bitmap;
+    node->count = (uint16_t)count;
+    node->isCollision = (uint16_t)isCollision;
+    return node;
+}
+
+/**
+ * path copying: a copy of node where slot[pos] is replaced (replace != 0), inserted (count + 1),
+ * or removed (newSlot == NULL), every other child gains a reference. newSlot is moved into the copy.
+ */
+static PersistentHashMapNode* PersistentHashMap_CopyNode(PersistentHashMapNode* node, size_t pos, void* newSlot, uint32_t newBitmap, int replace) {
+    size_t count = node->count + (replace ? 0 : (newSlot != NULL ? 1 : -1));
+    size_t i, j = 0;
+
+    PersistentHashMapNode* copy = PersistentHashMap_AllocNode(count, newBitmap, node->isCollision);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < node->count; ++i) {
+        if (i == pos) {
+            if (newSlot != NULL) {
+                copy->slot[j++] = newSlot;
+            }
+
+            if (replace || newSlot == NULL) {
+                continue;
+            }
+        }
+
+        PersistentHashMap_RetainSlot(node->slot[i]);
+        copy->slot[j++] = node->slot[i];
+    }
+
+    if (pos == node->count && newSlot != NULL) {   /* append. */
+        copy->slot[j++] = newSlot;
+    }
+
+    return copy;
+}
+
+#define PersistentHashMap_Index(hash, shift)           (((hash) >> (shift)) & PERSISTENT_HASHMAP_MASK)
+#define PersistentHashMap_Position(bitmap, bit)        ((size_t)__builtin_popcount((bitmap) & ((bit) - 1)))
+
+/* undo a failed PersistentHashMap_MergeEntries, the entries are only borrowed. */
+static void PersistentHashMap_FreeMergeChain(PersistentHashMapNode* node) {
+    PersistentHashMapNode* next;
+
+    while (node != NULL) {
+        next = (!node->isCollision && node->count == 1 && !PersistentHashMap_SlotIsEntry(node->slot[0])) ? (PersistentHashMapNode*)node->slot[0] : NULL;
+        free(node);
+        node = next;
+    }
+}
+
+/* a subtree holding two entries which collide down to shift. */
+static PersistentHashMapNode* PersistentHashMap_MergeEntries(PersistentHashMapEntry* e1, PersistentHashMapEntry* e2, unsigned int shift) {
+    PersistentHashMapNode* node;
+    PersistentHashMapNode* child;
+    HashType i1, i2;
+
+    if (shift >= PERSISTENT_HASHMAP_HASH_BITS) {
+        if ((node = PersistentHashMap_AllocNode(2, 0, 1)) != NULL) {
+            node->slot[0] = PersistentHashMap_EntrySlot(e1);
+            node->slot[1] = PersistentHashMap_EntrySlot(e2);
+        }
+
+        return node;
+    }
+
+    i1 = PersistentHashMap_Index(e1->hash, shift);
+    i2 = PersistentHashMap_Index(e2->hash, shift);
+
+    if (i1 != i2) {
+        if ((node = PersistentHashMap_AllocNode(2, (1u << i1) | (1u << i2), 0)) != NULL) {
+            node->slot[i1 < i2 ? 0 : 1] = PersistentHashMap_EntrySlot(e1);
+            node->slot[i1 < i2 ? 1 : 0] = PersistentHashMap_EntrySlot(e2);
+        }
+
+        return node;
+    }
+
+    if ((child = PersistentHashMap_MergeEntries(e1, e2, shift + PERSISTENT_HASHMAP_BITS)) == NULL) {
+        return NULL;
+    }
+
+    if ((node = PersistentHashMap_AllocNode(1, 1u << i1, 0)) == NULL) {
+        PersistentHashMap_FreeMergeChain(child);
+        return NULL;
+    }
+
+    node->slot[0] = child;
+    return node;
+}
+
+/* return the new subtree, or NULL when out of memory. *added tells whether the key was new. */
+static PersistentHashMapNode* PersistentHashMap_NodeInsert(PersistentHashMap* hm, PersistentHashMapNode* node, unsigned int shift, PersistentHashMapEntry* entry, int* added) {
+    PersistentHashMapEntry* old;
+    PersistentHashMapNode* sub;
+    PersistentHashMapNode* copy;
+    uint32_t bit;
+    size_t i, pos;
+
+    if (node->isCollision) {
+        for (i = 0; i < node->count; ++i) {
+            if (hm->compare(PersistentHashMap_SlotEntry(node->slot[i])->key, entry->key) == 0) {
+                *added = 0;
+                return PersistentHashMap_CopyNode(node, i, PersistentHashMap_EntrySlot(entry), 0, 1);
+            }
+        }
+
+        *added = 1;
+        return PersistentHashMap_CopyNode(node, node->count, PersistentHashMap_EntrySlot(entry), 0, 0);
+    }
+
+    bit = 1u << PersistentHashMap_Index(entry->hash, shift);
+    pos = PersistentHashMap_Position(node->bitmap, bit);
+
+    if ((node->bitmap & bit) == 0) {
+        *added = 1;
+        return PersistentHashMap_CopyNode(node, pos, PersistentHashMap_EntrySlot(entry), node->bitmap | bit, 0);
+    }
+
+    if (PersistentHashMap_SlotIsEntry(node->slot[pos])) {
+        old = PersistentHashMap_SlotEntry(node->slot[pos]);
+
+        if (old->hash == entry->hash && hm->compare(old->key, entry->key) == 0) {
+            *added = 0;
+            return PersistentHashMap_CopyNode(node, pos, PersistentHashMap_EntrySlot(entry), node->bitmap, 1);
+        }
+
+        if ((sub = PersistentHashMap_MergeEntries(old, entry, shift + PERSISTENT_HASHMAP_BITS)) == NULL) {
+            return NULL;
+        }
+
+        atomic_fetch_add_explicit(&old->refCount, 1, memory_order_relaxed);   /* now shared with sub. */
+        *added = 1;
+    }
+    else {
+        if ((sub = PersistentHashMap_NodeInsert(hm, (PersistentHashMapNode*)node->slot[pos], shift + PERSISTENT_HASHMAP_BITS, entry, added)) == NULL) {
+            return NULL;
+        }
+    }
+
+    if ((copy = PersistentHashMap_CopyNode(node, pos, sub, node->bitmap, 1)) == NULL) {
+        atomic_fetch_add_explicit(&entry->refCount, 1, memory_order_relaxed);   /* the caller still frees entry. */
+        PersistentHashMap_ReleaseNode(hm, sub);
+        return NULL;
+    }
+
+    return copy;
+}
+
+#define PERSISTENT_HASHMAP_UNCHANGED   ((void*)(uintptr_t)2)   /* key not found, share the old subtree. */
+
+/**
+ * return PERSISTENT_HASHMAP_UNCHANGED, NULL (subtree became empty), a tagged entry (the subtree shrank
+ * to one entry which the parent inlines), or the new subtree.
+ */
+static void* PersistentHashMap_NodeRemove(PersistentHashMap* hm, PersistentHashMapNode* node, unsigned int shift, void* key, HashType hash, int isRoot) {
+    PersistentHashMapEntry* entry;
+    void* sub;
+    uint32_t bit;
+    size_t i, pos;
+
+    if (node->isCollision) {
+        for (i = 0; i < node->count; ++i) {
+            if (hm->compare(PersistentHashMap_SlotEntry(node->slot[i])->key, key) == 0) {
+                break;
+            }
+        }
+
+        if (i == node->count) {
+            return PERSISTENT_HASHMAP_UNCHANGED;
+        }
+
+        if (node->count == 2) {
+            PersistentHashMap_RetainSlot(node->slot[1 - i]);
+            return node->slot[1 - i];
+        }
+
+        return PersistentHashMap_CopyNode(node, i, NULL, 0, 0);
+    }
+
+    bit = 1u << PersistentHashMap_Index(hash, shift);
+    if ((node->bitmap & bit) == 0) {
+        return PERSISTENT_HASHMAP_UNCHANGED;
+    }
+
+    pos = PersistentHashMap_Position(node->bitmap, bit);
+
+    if (PersistentHashMap_SlotIsEntry(node->slot[pos])) {
+        entry = PersistentHashMap_SlotEntry(node->slot[pos]);
+
+        if (entry->hash != hash || hm->compare(entry->key, key) != 0) {
+            return PERSISTENT_HASHMAP_UNCHANGED;
+        }
+
+        if (node->count == 1) {
+            return NULL;
+        }
+
+        if (node->count == 2 && !isRoot && PersistentHashMap_SlotIsEntry(node->slot[1 - pos])) {
+            PersistentHashMap_RetainSlot(node->slot[1 - pos]);
+            return node->slot[1 - pos];
+        }
+
+        return PersistentHashMap_CopyNode(node, pos, NULL, node->bitmap & ~bit, 0);
+    }
+
+    sub = PersistentHashMap_NodeRemove(hm, (PersistentHashMapNode*)node->slot[pos], shift + PERSISTENT_HASHMAP_BITS, key, hash, 0);
+
+    if (sub == PERSISTENT_HASHMAP_UNCHANGED) {
+        return sub;
+    }
+
+    if (sub == NULL) {   /* only reachable when the child held a single entry, kept for safety. */
+        if (node->count == 1) {
+            return NULL;
+        }
+
+        return PersistentHashMap_CopyNode(node, pos, NULL, node->bitmap & ~bit, 0);
+    }
+
+    if (PersistentHashMap_SlotIsEntry(sub) && node->count == 1 && !isRoot) {
+        return sub;   /* keep collapsing upwards. */
+    }
+
+    return PersistentHashMap_CopyNode(node, pos, sub, node->bitmap, 1);
+}
+
+static PersistentHashMap* PersistentHashMap_NewVersion(PersistentHashMap* hm, PersistentHashMapNode* root, size_t length) {
+    PersistentHashMap* version = (PersistentHashMap*)malloc(sizeof(PersistentHashMap));
+    if (version == NULL) {
+        return NULL;
+    }
+
+    atomic_init(&version->refCount, 1);
+    version->root = root;
+    version->length = length;
+    version->compare = hm->compare;
+    version->hash = hm->hash;
+    version->keyDestroy = hm->keyDestroy;
+    version->valueDestroy = hm->valueDestroy;
+    return version;
+}
+
+#ifdef CONTAINER_STATS
+/* path copying made a new node at every level from the root down to where hash ends, count them on version. */
+static void PersistentHashMap_OnPathAlloc(PersistentHashMap* version, HashType hash) {
+    PersistentHashMapNode* node = version->root;
+    unsigned int shift = 0;
+    uint32_t bit;
+    void* slot;
+
+    while (node != NULL) {
+        ContainerStats_OnAlloc(&version->stats, sizeof(PersistentHashMapNode) + node->count * sizeof(void*));
+
+        if (node->isCollision) {
+            return;
+        }
+
+        bit = 1u << PersistentHashMap_Index(hash, shift);
+        if ((node->bitmap & bit) == 0) {
+            return;
+        }
+
+        slot = node->slot[PersistentHashMap_Position(node->bitmap, bit)];
+        if (PersistentHashMap_SlotIsEntry(slot)) {
+            return;
+        }
+
+        node = (PersistentHashMapNode*)slot;
+        shift += PERSISTENT_HASHMAP_BITS;
+    }
+}
+#else
+#define PersistentHashMap_OnPathAlloc(version, hash)   ((void)0)
+#endif
+
+PersistentHashMap* PersistentHashMap_CreateNew(PersistentHashMap_CompareFunc compare,
+                                               PersistentHashMap_KeyHashFunc hash,
+                                               PersistentHashMap_KeyDestroyFunc keyDestroy,
+                                               PersistentHashMap_ValueDestroyFunc valueDestroy) {
+    PersistentHashMap proto;
+
+    if (compare == NULL || hash == NULL) {
+        return NULL;
+    }
+
+    proto.compare = compare;
+    proto.hash = hash;
+    proto.keyDestroy = (keyDestroy == NULL ? PersistentHashMap_DefaultKeyDestroyFunc : keyDestroy);
+    proto.valueDestroy = (valueDestroy == NULL ? PersistentHashMap_DefaultValueDestroyFunc : valueDestroy);
+
+    PersistentHashMap* version = PersistentHashMap_NewVersion(&proto, NULL, 0);
+    if (version != NULL) {
+        ContainerStats_Init(&version->stats, "PersistentHashMap");
+        ContainerStats_OnAlloc(&version->stats, sizeof(PersistentHashMap));
+    }
+
+    return version;
+}
+
+/* O(1) snapshot, any thread already holding hm may call this. */
+PersistentHashMap* PersistentHashMap_Retain(PersistentHashMap* hm) {
+    atomic_fetch_add_explicit(&hm->refCount, 1, memory_order_relaxed);
+    return hm;
+}
+
+void PersistentHashMap_Release(PersistentHashMap* hm) {
+    if (atomic_fetch_sub_explicit(&hm->refCount, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    if (hm->root != NULL) {
+        PersistentHashMap_ReleaseNode(hm, hm->root);
+    }
+
+    free(hm);
+}
+
+PersistentHashMapEntry* PersistentHashMap_Find(PersistentHashMap* hm, void* key) {
+    HashType hash = hm->hash(key);
+    PersistentHashMapNode* node = hm->root;
+    PersistentHashMapEntry* entry;
+    unsigned int shift = 0;
+    uint32_t bit;
+    void* slot;
+    size_t i;
+
+    while (node != NULL) {
+        if (node->isCollision) {
+            for (i = 0; i < node->count; ++i) {
+                if (hm->compare(PersistentHashMap_SlotEntry(node->slot[i])->key, key) == 0) {
+                    return PersistentHashMap_SlotEntry(node->slot[i]);
+                }
+            }
+
+            return NULL;
+        }
+
+        bit = 1u << PersistentHashMap_Index(hash, shift);
+        if ((node->bitmap & bit) == 0) {
+            return NULL;
+        }
+
+        slot = node->slot[PersistentHashMap_Position(node->bitmap, bit)];
+
+        if (PersistentHashMap_SlotIsEntry(slot)) {
+            entry = PersistentHashMap_SlotEntry(slot);
+            return (entry->hash == hash && hm->compare(entry->key, key) == 0) ? entry : NULL;
+        }
+
+        node = (PersistentHashMapNode*)slot;
+        shift += PERSISTENT_HASHMAP_BITS;
+    }
+
+    return NULL;
+}
+
+/* return a new version holding key -> value, hm is unchanged. the new version owns key and value. */
+PersistentHashMap* PersistentHashMap_Insert(PersistentHashMap* hm, void* key, void* value) {
+    PersistentHashMapEntry* entry;
+    PersistentHashMapNode* root;
+    PersistentHashMap* version;
+    int added = 1;
+    ContainerStats_VersionOpBegin(&hm->stats, sample);   /* counted on the new version, hm may be read by other threads. */
+
+    if ((entry = (PersistentHashMapEntry*)malloc(sizeof(PersistentHashMapEntry))) == NULL) {
+        return NULL;
+    }
+
+    atomic_init(&entry->refCount, 1);
+    entry->hash = hm->hash(key);
+    entry->key = key;
+    entry->value = value;
+
+    if (hm->root == NULL) {
+        if ((root = PersistentHashMap_AllocNode(1, 1u << PersistentHashMap_Index(entry->hash, 0), 0)) != NULL) {
+            root->slot[0] = PersistentHashMap_EntrySlot(entry);
+        }
+    }
+    else {
+        root = PersistentHashMap_NodeInsert(hm, hm->root, 0, entry, &added);
+    }
+
+    if (root == NULL) {
+        free(entry);
+        return NULL;
+    }
+
+    if ((version = PersistentHashMap_NewVersion(hm, root, hm->length + (added ? 1 : 0))) == NULL) {
+        PersistentHashMap_ReleaseNode(hm, root);
+        return NULL;
+    }
+
+    ContainerStats_VersionOpEnd(&version->stats, &hm->stats, sample);
+    ContainerStats_OnAlloc(&version->stats, sizeof(PersistentHashMap) + sizeof(PersistentHashMapEntry));
+    PersistentHashMap_OnPathAlloc(version, entry->hash);
+    return version;
+}
+
+/* return a new version without key (a new reference to hm when key is absent), NULL when out of memory. */
+PersistentHashMap* PersistentHashMap_Remove(PersistentHashMap* hm, void* key) {
+    PersistentHashMap* version;
+    void* root;
+    ContainerStats_VersionOpBegin(&hm->stats, sample);   /* a key that is absent makes no version and is not counted. */
+
+    if (hm->root == NULL) {
+        return PersistentHashMap_Retain(hm);
+    }
+
+    root = PersistentHashMap_NodeRemove(hm, hm->root, 0, key, hm->hash(key), 1);
+
+    if (root == PERSISTENT_HASHMAP_UNCHANGED) {
+        return PersistentHashMap_Retain(hm);
+    }
+
+    if ((version = PersistentHashMap_NewVersion(hm, (PersistentHashMapNode*)root, hm->length - 1)) == NULL) {
+        if (root != NULL) {
+            PersistentHashMap_ReleaseNode(hm, (PersistentHashMapNode*)root);
+        }
+
+        return NULL;
+    }
+
+    ContainerStats_VersionOpEnd(&version->stats, &hm->stats, sample);
+    ContainerStats_OnAlloc(&version->stats, sizeof(PersistentHashMap));
+    PersistentHashMap_OnPathAlloc(version, hm->hash(key));
+    return version;
+}
+
+typedef void (*PersistentHashMap_VisitFunc) (void* key, void* value, void* context);
+
+static void PersistentHashMap_VisitNode(PersistentHashMapNode* node, PersistentHashMap_VisitFunc visit, void* context) {
+    PersistentHashMapEntry* entry;
+    size_t i;
+
+    for (i = 0; i < node->count; ++i) {
+        if (PersistentHashMap_SlotIsEntry(node->slot[i])) {
+            entry = PersistentHashMap_SlotEntry(node->slot[i]);
+            visit(entry->key, entry->value, context);
+        }
+        else {
+            PersistentHashMap_VisitNode((PersistentHashMapNode*)node->slot[i], visit, context);
+        }
+    }
+}
+
+void PersistentHashMap_ForEach(PersistentHashMap* hm, PersistentHashMap_VisitFunc visit, void* context) {
+    if (hm->root != NULL) {
+        PersistentHashMap_VisitNode(hm->root, visit, context);
+    }
+}
+
+#ifdef CONTAINER_STATS
+static void PersistentHashMap_ChainNode(PersistentHashMapNode* node, size_t depth, ContainerStats* out) {
+    size_t i;
+
+    for (i = 0; i < node->count; ++i) {
+        if (PersistentHashMap_SlotIsEntry(node->slot[i])) {
+            ContainerStats_OnChain(out, depth);
+        }
+        else {
+            PersistentHashMap_ChainNode((PersistentHashMapNode*)node->slot[i], depth + 1, out);
+        }
+    }
+}
+
+/**
+ * the counters of every update leading to hm, along the chain of versions it was made from.
+ * frees are not counted: a shared node is freed by whichever version drops it last.
+ * the chain histogram holds the number of nodes a Find walks to reach each entry.
+ */
+void PersistentHashMap_GetStats(PersistentHashMap* hm, ContainerStats* out) {
+    *out = hm->stats;
+    memset(out->chainHistogram, 0, sizeof(out->chainHistogram));
+
+    if (hm->root != NULL) {
+        PersistentHashMap_ChainNode(hm->root, 1, out);
+    }
+}
+#endif
+
+/**
+ * single writer, many readers. readers never block: they announce themselves in one of two counters,
+ * grab the current version and take a reference. the writer swaps in a new version, flips the counter
+ * in use, and waits only for readers that were already inside the old counter before dropping its
+ * reference to the old version.
+ */
+typedef struct PersistentHashMapCell {
+    _Atomic(PersistentHashMap*) current;
+    atomic_uint epoch;
+    atomic_size_t readers[2];
+} PersistentHashMapCell;
+
+void PersistentHashMapCell_Init(PersistentHashMapCell* cell, PersistentHashMap* hm) {
+    atomic_init(&cell->current, hm);
+    atomic_init(&cell->epoch, 0);
+    atomic_init(&cell->readers[0], 0);
+    atomic_init(&cell->readers[1], 0);
+}
+
+/* reader side, release the returned snapshot with PersistentHashMap_Release. */
+PersistentHashMap* PersistentHashMapCell_Snapshot(PersistentHashMapCell* cell) {
+    PersistentHashMap* hm;
+    unsigned int e;
+
+    while (1) {
+        e = atomic_load(&cell->epoch) & 1u;
+        atomic_fetch_add(&cell->readers[e], 1);
+
+        if ((atomic_load(&cell->epoch) & 1u) == e) {
+            break;
+        }
+
+        atomic_fetch_sub(&cell->readers[e], 1);
+    }
+
+    hm = PersistentHashMap_Retain(atomic_load(&cell->current));
+    atomic_fetch_sub_explicit(&cell->readers[e], 1, memory_order_release);
+    return hm;
+}
+
+/* writer side, the cell takes over the reference to hm. */
+void PersistentHashMapCell_Publish(PersistentHashMapCell* cell, PersistentHashMap* hm) {
+    PersistentHashMap* old = atomic_exchange(&cell->current, hm);
+    unsigned int e = atomic_fetch_add(&cell->epoch, 1) & 1u;
+
+    while (atomic_load_explicit(&cell->readers[e], memory_order_acquire) != 0) {
+        sched_yield();   /* a reader is between loading old and retaining it. */
+    }
+
+    PersistentHashMap_Release(old);
+}
+
+void PersistentHashMapCell_Destroy(PersistentHashMapCell* cell) {
+    PersistentHashMap_Release(atomic_load(&cell->current));
+}
+
+/* usage. */
+HashType persistent_hash_c_style_str(void* key) {   /* hash_c_style_str without the modulo. */
+    const char* str = (const char*)key;
+    HashType hashval = 0;
+
+    for (; *str != '\0' ; ++str)
+        hashval = *str + hashval * 31;
+
+    return hashval;
+}
+
+int compare_c_style_str(void* left, void* right) {
+    return strcmp((const char*)(left), (const char*)(right));
+}
+
+HashType hash_uintptr(void* key) {
+    uint64_t x = (uint64_t)(uintptr_t)key;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return (HashType)x;
+}
+
+int compare_uintptr(void* left, void* right) {
+    return left != right;
+}
+
+void print_pair(void* key, void* value, void* context) {
+    printf("  {'%s': '%s'}\n", (const char*)key, (const char*)value);
+}
+
+#define TEST_KEY_COUNT       200000
+#define READER_THREAD_COUNT  2
+
+typedef struct ReaderContext {
+    PersistentHashMapCell* cell;
+    atomic_int* done;
+    size_t snapshots;
+    size_t failures;
+} ReaderContext;
+
+/* every published version holds exactly the keys 1 .. length, each mapped to itself. */
+void* reader_routine(void* arg) {
+    ReaderContext* ctx = (ReaderContext*)arg;
+    PersistentHashMap* snapshot;
+    PersistentHashMapEntry* entry;
+    size_t n;
+
+    while (!atomic_load(ctx->done)) {
+        snapshot = PersistentHashMapCell_Snapshot(ctx->cell);
+        n = PersistentHashMap_Length(snapshot);
+
+        if (n != 0) {
+            entry = PersistentHashMap_Find(snapshot, (void*)(uintptr_t)n);
+            if (entry == NULL || entry->value != (void*)(uintptr_t)n ||
+                PersistentHashMap_Find(snapshot, (void*)(uintptr_t)(n + 1)) != NULL) {
+                ctx->failures += 1;
+            }
+        }
+
+        ctx->snapshots += 1;
+        PersistentHashMap_Release(snapshot);
+    }
+
+    return NULL;
+}
+
+int main() {
+    PersistentHashMap* v1 = PersistentHashMap_CreateNew(compare_c_style_str, persistent_hash_c_style_str, NULL, NULL);
+    PersistentHashMap* v2;
+    PersistentHashMap* v3;
+    PersistentHashMap* next;
+
+    v2 = PersistentHashMap_Insert(v1, "abc", "def");
+    PersistentHashMap_Release(v1);
+    v1 = v2;
+    v2 = PersistentHashMap_Insert(v1, "ock", "dlcma");
+    PersistentHashMap_Release(v1);
+
+    v3 = PersistentHashMap_Insert(v2, "d3q", "lcke");   /* v2 is a snapshot now, v3 shares its nodes. */
+    next = PersistentHashMap_Remove(v3, "abc");
+    PersistentHashMap_Release(v3);
+    v3 = next;
+
+    printf("v2 (%zu):\n", PersistentHashMap_Length(v2));
+    PersistentHashMap_ForEach(v2, print_pair, NULL);
+    printf("v3 (%zu):\n", PersistentHashMap_Length(v3));
+    PersistentHashMap_ForEach(v3, print_pair, NULL);
+
+    PersistentHashMap_Release(v2);
+    PersistentHashMap_Release(v3);
+
+    /* a writer keeps publishing versions while readers check each snapshot is consistent. */
+    PersistentHashMapCell cell;
+    pthread_t readers[READER_THREAD_COUNT];
+    ReaderContext ctx[READER_THREAD_COUNT];
+    atomic_int done;
+    size_t i, failures = 0, snapshots = 0;
+    struct timespec begin, end;
+
+    PersistentHashMapCell_Init(&cell, PersistentHashMap_CreateNew(compare_uintptr, hash_uintptr, NULL, NULL));
+    atomic_init(&done, 0);
+
+    for (i = 0; i < READER_THREAD_COUNT; ++i) {
+        ctx[i].cell = &cell;
+        ctx[i].done = &done;
+        ctx[i].snapshots = 0;
+        ctx[i].failures = 0;
+        pthread_create(&readers[i], NULL, reader_routine, &ctx[i]);
+    }
+
+    v1 = PersistentHashMapCell_Snapshot(&cell);
+    for (i = 1; i <= TEST_KEY_COUNT; ++i) {
+        next = PersistentHashMap_Insert(v1, (void*)(uintptr_t)i, (void*)(uintptr_t)i);
+        PersistentHashMap_Release(v1);
+        v1 = next;
+        PersistentHashMapCell_Publish(&cell, PersistentHashMap_Retain(v1));
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    v2 = PersistentHashMap_Retain(v1);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("snapshot of %zu entries: %ld ns\n", PersistentHashMap_Length(v2),
+           (long)((end.tv_sec - begin.tv_sec) * 1000000000L + (end.tv_nsec - begin.tv_nsec)));
+
+    /* shrink from the top, every published version still holds 1 .. length. */
+    for (i = TEST_KEY_COUNT; i > TEST_KEY_COUNT / 2; --i) {
+        next = PersistentHashMap_Remove(v1, (void*)(uintptr_t)i);
+        PersistentHashMap_Release(v1);
+        v1 = next;
+        PersistentHashMapCell_Publish(&cell, PersistentHashMap_Retain(v1));
+    }
+
+    atomic_store(&done, 1);
+    for (i = 0; i < READER_THREAD_COUNT; ++i) {
+        pthread_join(readers[i], NULL);
+        failures += ctx[i].failures;
+        snapshots += ctx[i].snapshots;
+    }
+
+    for (i = 1; i <= TEST_KEY_COUNT; ++i) {
+        if (PersistentHashMap_Find(v2, (void*)(uintptr_t)i) == NULL) {
+            failures += 1;
+        }
+
+        if ((PersistentHashMap_Find(v1, (void*)(uintptr_t)i) == NULL) != (i > TEST_KEY_COUNT / 2)) {
+            failures += 1;
+        }
+    }
+
+    printf("readers took %zu snapshots, old snapshot %zu entries, current %zu entries, %s\n",
+           snapshots, PersistentHashMap_Length(v2), PersistentHashMap_Length(v1), failures == 0 ? "ok" : "FAILED");
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    PersistentHashMap_GetStats(v1, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
+    PersistentHashMap_Release(v1);
+    PersistentHashMap_Release(v2);
+    PersistentHashMapCell_Destroy(&cell);
+    return failures == 0 ? 0 : 1;
+}
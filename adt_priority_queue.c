@@ -0,0 +1,537 @@
+/**
+ * priority queue on an implicit 4-ary heap.
+ *
+ * compared to a binary heap the tree is half as deep, and the 4 children of a node are adjacent:
+ * the storage is offset so every group of children sits in one 32-byte half of a cache line, a
+ * sift-down touches one line per level.
+ *
+ * handles are optional (withHandles at creation). a handle is a stable id for a pushed element,
+ * valid until that element is popped or removed, and lets the caller change its priority
+ * (DecreaseKey / Update) or remove it in O(log n). without handles no bookkeeping is done.
+ *
+ * build: cc -std=c11 -O2 adt_priority_queue.c
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "container_stats.h"
+
+#define PRIORITY_QUEUE_ARITY        4
+#define PRIORITY_QUEUE_SLOT_OFFSET  3   /* data[1] lands on a 32-byte boundary. */
+#define PRIORITY_QUEUE_NPOS         ((size_t)-1)
+
+typedef struct PriorityQueue PriorityQueue;
+
+typedef int (*PriorityQueue_CompareFunc) (void* left, void* right);   /* return < 0 means left comes out first. */
+typedef void (*PriorityQueue_ElemDestroyFunc) (void* elem);
+
+struct PriorityQueue {
+    void** data;          /* heap order, data[0] is the top. */
+    void** base;          /* the allocation data points into. */
+    size_t capacity;
+    size_t length;
+
+    size_t* handleOf;     /* heap index -> handle, NULL without handles. */
+    size_t* positionOf;   /* handle -> heap index, free handles chain through it. */
+    size_t handleCapacity;
+    size_t handleCount;
+    size_t freeHandle;
+
+    PriorityQueue_CompareFunc compare;
+    PriorityQueue_ElemDestroyFunc elemDestroy;
+
+    CONTAINER_STATS_FIELD(stats)
+};
+
+#define PriorityQueue_Capacity(pqPtr)     ((pqPtr)->capacity)
+#define PriorityQueue_Length(pqPtr)       ((pqPtr)->length)
+#define PriorityQueue_IsEmpty(pqPtr)      (PriorityQueue_Length(pqPtr) == 0)
+#define PriorityQueue_Top(pqPtr)          ((pqPtr)->data[0])
+#define PriorityQueue_HasHandles(pqPtr)   ((pqPtr)->handleOf != NULL)
+
+/* the element a live handle refers to. */
+#define PriorityQueue_HandleElem(pqPtr, handle)   ((pqPtr)->data[(pqPtr)->positionOf[(handle)]])
+
+void PriorityQueue_DefaultElemDestroyFunc(void* elem) {}
+
+static void** PriorityQueue_AllocSlots(size_t capacity) {
+    size_t bytes = (capacity + PRIORITY_QUEUE_SLOT_OFFSET) * sizeof(void*);
+    return (void**)aligned_alloc(64, (bytes + 63) / 64 * 64);
+}
+
+PriorityQueue* PriorityQueue_CreateNew(size_t capacity, PriorityQueue_CompareFunc compare, PriorityQueue_ElemDestroyFunc func, int withHandles) {
+    PriorityQueue* pq = (PriorityQueue*)malloc(sizeof(PriorityQueue));
+    if (pq == NULL) {
+        return NULL;
+    }
+
+    pq->capacity = (capacity != 0) ? capacity : 16;
+    pq->length = 0;
+    pq->handleOf = NULL;
+    pq->positionOf = NULL;
+    pq->handleCapacity = 0;
+    pq->handleCount = 0;
+    pq->freeHandle = PRIORITY_QUEUE_NPOS;
+    pq->compare = compare;
+    pq->elemDestroy = (func == NULL ? PriorityQueue_DefaultElemDestroyFunc : func);
+
+    if ((pq->base = PriorityQueue_AllocSlots(pq->capacity)) == NULL) {
+        free(pq);
+        return NULL;
+    }
+
+    pq->data = pq->base + PRIORITY_QUEUE_SLOT_OFFSET;
+
+    if (withHandles) {
+        pq->handleOf = (size_t*)malloc(pq->capacity * sizeof(size_t));
+        pq->positionOf = (size_t*)malloc(pq->capacity * sizeof(size_t));
+        pq->handleCapacity = pq->capacity;
+
+        if (pq->handleOf == NULL || pq->positionOf == NULL) {
+            free(pq->handleOf);
+            free(pq->positionOf);
+            free(pq->base);
+            free(pq);
+            return NULL;
+        }
+    }
+
+    ContainerStats_Init(&pq->stats, "PriorityQueue");
+    ContainerStats_OnAlloc(&pq->stats, pq->capacity * (sizeof(void*) + (withHandles ? 2 * sizeof(size_t) : 0)));
+    return pq;
+}
+
+void PriorityQueue_Destroy(PriorityQueue* pq) {
+    size_t i;
+    for (i = 0; i < PriorityQueue_Length(pq); ++i) {
+        pq->elemDestroy(pq->data[i]);
+    }
+
+    free(pq->handleOf);
+    free(pq->positionOf);
+    free(pq->base);
+    free(pq);
+}
+
+int PriorityQueue_ExpandCapacity(PriorityQueue* pq, size_t newCapacity) {
+    void** temp;
+    size_t* handleOf;
+
+    if (newCapacity <= pq->capacity) {
+        return 1;
+    }
+
+    if ((temp = PriorityQueue_AllocSlots(newCapacity)) == NULL) {
+        return 0;
+    }
+
+    if (pq->handleOf != NULL) {
+        if ((handleOf = (size_t*)realloc(pq->handleOf, newCapacity * sizeof(size_t))) == NULL) {
+            free(temp);
+            return 0;
+        }
+
+        pq->handleOf = handleOf;
+    }
+
+    memcpy(temp + PRIORITY_QUEUE_SLOT_OFFSET, pq->data, pq->length * sizeof(void*));
+    free(pq->base);
+    pq->base = temp;
+    pq->data = temp + PRIORITY_QUEUE_SLOT_OFFSET;
+
+    ContainerStats_OnGrow(&pq->stats, pq->capacity * sizeof(void*), newCapacity * sizeof(void*));
+    pq->capacity = newCapacity;
+    return 1;
+}
+
+/* take a free handle id, the caller sets its position. */
+static int PriorityQueue_NewHandle(PriorityQueue* pq, size_t* handle) {
+    size_t* temp;
+
+    if (pq->freeHandle != PRIORITY_QUEUE_NPOS) {
+        *handle = pq->freeHandle;
+        pq->freeHandle = pq->positionOf[*handle];
+        return 1;
+    }
+
+    if (pq->handleCount == pq->handleCapacity) {
+        if ((temp = (size_t*)realloc(pq->positionOf, 2 * pq->handleCapacity * sizeof(size_t))) == NULL) {
+            return 0;
+        }
+
+        pq->positionOf = temp;
+        pq->handleCapacity *= 2;
+    }
+
+    *handle = pq->handleCount++;
+    return 1;
+}
+
+static void PriorityQueue_FreeHandle(PriorityQueue* pq, size_t handle) {
+    pq->positionOf[handle] = pq->freeHandle;
+    pq->freeHandle = handle;
+}
+
+/* put an element (and its handle) into heap slot i. */
+#define PriorityQueue_Place(pq, i, elem, handle)        \
+    do {                                                \
+        (pq)->data[(i)] = (elem);                       \
+        if ((pq)->handleOf != NULL) {                   \
+            (pq)->handleOf[(i)] = (handle);             \
+            (pq)->positionOf[(handle)] = (i);           \
+        }                                               \
+    } while (0)
+
+/* return the final index. */
+static size_t PriorityQueue_SiftUp(PriorityQueue* pq, size_t i) {
+    void* elem = pq->data[i];
+    size_t handle = (pq->handleOf != NULL) ? pq->handleOf[i] : 0;
+    size_t parent;
+
+    while (i > 0) {
+        parent = (i - 1) / PRIORITY_QUEUE_ARITY;
+
+        if (pq->compare(elem, pq->data[parent]) >= 0) {
+            break;
+        }
+
+        PriorityQueue_Place(pq, i, pq->data[parent], (pq->handleOf != NULL) ? pq->handleOf[parent] : 0);
+        i = parent;
+    }
+
+    PriorityQueue_Place(pq, i, elem, handle);
+    return i;
+}
+
+static void PriorityQueue_SiftDown(PriorityQueue* pq, size_t i) {
+    void* elem = pq->data[i];
+    size_t handle = (pq->handleOf != NULL) ? pq->handleOf[i] : 0;
+    size_t child, end, best;
+
+    while ((child = PRIORITY_QUEUE_ARITY * i + 1) < pq->length) {
+        end = (child + PRIORITY_QUEUE_ARITY < pq->length) ? child + PRIORITY_QUEUE_ARITY : pq->length;
+
+        for (best = child++; child < end; ++child) {
+            if (pq->compare(pq->data[child], pq->data[best]) < 0) {
+                best = child;
+            }
+        }
+
+        if (pq->compare(pq->data[best], elem) >= 0) {
+            break;
+        }
+
+        PriorityQueue_Place(pq, i, pq->data[best], (pq->handleOf != NULL) ? pq->handleOf[best] : 0);
+        i = best;
+    }
+
+    PriorityQueue_Place(pq, i, elem, handle);
+}
+
+/* handle may be NULL, it is only filled when the queue was created with handles. */
+int PriorityQueue_PushWithHandle(PriorityQueue* pq, void* elem, size_t* handle) {
+    size_t h = 0;
+
+    if (pq->capacity == pq->length) {
+        if (!PriorityQueue_ExpandCapacity(pq, 2 * pq->capacity)) {
+            return 0;
+        }
+    }
+
+    if (pq->handleOf != NULL) {
+        if (!PriorityQueue_NewHandle(pq, &h)) {
+            return 0;
+        }
+
+        pq->handleOf[pq->length] = h;
+
+        if (handle != NULL) {
+            *handle = h;
+        }
+    }
+
+    pq->data[pq->length] = elem;
+    pq->length += 1;
+    PriorityQueue_SiftUp(pq, pq->length - 1);
+    return 1;
+}
+
+int PriorityQueue_Push(PriorityQueue* pq, void* elem) {
+    return PriorityQueue_PushWithHandle(pq, elem, NULL);
+}
+
+/* detach the element at heap index i and return it, the handle goes back to the free list. */
+static void* PriorityQueue_RemoveAt(PriorityQueue* pq, size_t i) {
+    void* elem = pq->data[i];
+    size_t last = pq->length - 1;
+
+    if (pq->handleOf != NULL) {
+        PriorityQueue_FreeHandle(pq, pq->handleOf[i]);
+    }
+
+    pq->length -= 1;
+
+    if (i != last) {
+        PriorityQueue_Place(pq, i, pq->data[last], (pq->handleOf != NULL) ? pq->handleOf[last] : 0);
+
+        if (PriorityQueue_SiftUp(pq, i) == i) {
+            PriorityQueue_SiftDown(pq, i);
+        }
+    }
+
+    return elem;
+}
+
+/* the top element is returned, not destroyed. NULL when empty. */
+void* PriorityQueue_Pop(PriorityQueue* pq) {
+    if (PriorityQueue_IsEmpty(pq)) {
+        return NULL;
+    }
+
+    return PriorityQueue_RemoveAt(pq, 0);
+}
+
+/* remove the element of a live handle and return it, not destroyed. */
+void* PriorityQueue_RemoveHandle(PriorityQueue* pq, size_t handle) {
+    return PriorityQueue_RemoveAt(pq, pq->positionOf[handle]);
+}
+
+/* the element of this handle now compares smaller (or equal) than before. */
+void PriorityQueue_DecreaseKey(PriorityQueue* pq, size_t handle) {
+    PriorityQueue_SiftUp(pq, pq->positionOf[handle]);
+}
+
+/* the element of this handle changed its priority in either direction. */
+void PriorityQueue_Update(PriorityQueue* pq, size_t handle) {
+    size_t i = pq->positionOf[handle];
+
+    if (PriorityQueue_SiftUp(pq, i) == i) {
+        PriorityQueue_SiftDown(pq, i);
+    }
+}
+
+/**
+ * push count elements at once. when they are at least as many as the queue already holds the heap
+ * is rebuilt bottom-up in O(n) instead of count sift-ups. handles may be NULL, otherwise it gets the
+ * handle of each element in the order of elems.
+ */
+int PriorityQueue_Heapify(PriorityQueue* pq, void** elems, size_t count, size_t* handles) {
+    size_t oldLength = pq->length;
+    size_t newCapacity = pq->capacity;
+    size_t i, h = 0;
+
+    while (newCapacity < oldLength + count) {
+        newCapacity *= 2;
+    }
+
+    if (!PriorityQueue_ExpandCapacity(pq, newCapacity)) {
+        return 0;
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (pq->handleOf != NULL) {
+            if (!PriorityQueue_NewHandle(pq, &h)) {
+                while (i-- > 0) {
+                    PriorityQueue_FreeHandle(pq, pq->handleOf[oldLength + i]);
+                }
+
+                return 0;
+            }
+
+            if (handles != NULL) {
+                handles[i] = h;
+            }
+        }
+
+        PriorityQueue_Place(pq, oldLength + i, elems[i], h);
+    }
+
+    pq->length = oldLength + count;
+
+    if (count < oldLength) {
+        for (i = oldLength; i < pq->length; ++i) {
+            PriorityQueue_SiftUp(pq, i);
+        }
+    }
+    else if (pq->length > 1) {
+        for (i = (pq->length - 2) / PRIORITY_QUEUE_ARITY + 1; i-- > 0; ) {
+            PriorityQueue_SiftDown(pq, i);
+        }
+    }
+
+    return 1;
+}
+
+#ifdef CONTAINER_STATS
+void PriorityQueue_GetStats(PriorityQueue* pq, ContainerStats* out) {
+    *out = pq->stats;
+}
+#endif
+
+typedef struct Task {
+    const char* name;
+    int priority;
+} Task;
+
+int compare_task(void* left, void* right) {
+    return ((Task*)left)->priority - ((Task*)right)->priority;
+}
+
+int compare_uintptr(void* left, void* right) {
+    return ((uintptr_t)left > (uintptr_t)right) - ((uintptr_t)left < (uintptr_t)right);
+}
+
+/* the approach the heap replaces: keep a doubly linked list sorted on every insertion. */
+typedef struct SortedListNode {
+    struct SortedListNode* prev;
+    struct SortedListNode* next;
+    void* data;
+} SortedListNode;
+
+static double seconds_since(const struct timespec* begin) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - begin->tv_sec) + (double)(end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+#define BENCH_SORTED_LIST_MAX   10000   /* O(n^2), past this it is extrapolated: 1e5 already takes about a minute. */
+
+double bench_sorted_list(size_t n) {
+    SortedListNode head = { NULL, NULL, NULL };
+    SortedListNode* node;
+    SortedListNode* cursor;
+    struct timespec begin;
+    uint64_t x = 88172645463325252ull;
+    uintptr_t last = 0;
+    size_t i;
+
+    head.prev = head.next = &head;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < n; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+
+        node = (SortedListNode*)malloc(sizeof(SortedListNode));
+        node->data = (void*)(uintptr_t)(x >> 1);
+
+        for (cursor = head.next; cursor != &head && compare_uintptr(cursor->data, node->data) <= 0; cursor = cursor->next) {}
+
+        node->next = cursor;
+        node->prev = cursor->prev;
+        cursor->prev->next = node;
+        cursor->prev = node;
+    }
+
+    while (head.next != &head) {
+        node = head.next;
+        head.next = node->next;
+        node->next->prev = &head;
+
+        if ((uintptr_t)node->data < last) {
+            printf("sorted list out of order\n");
+        }
+
+        last = (uintptr_t)node->data;
+        free(node);
+    }
+
+    return seconds_since(&begin);
+}
+
+double bench_heap(size_t n) {
+    PriorityQueue* pq = PriorityQueue_CreateNew(0, compare_uintptr, NULL, 0);
+    struct timespec begin;
+    uint64_t x = 88172645463325252ull;
+    uintptr_t last = 0;
+    uintptr_t top;
+    size_t i;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < n; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        PriorityQueue_Push(pq, (void*)(uintptr_t)(x >> 1));
+    }
+
+    while (!PriorityQueue_IsEmpty(pq)) {
+        top = (uintptr_t)PriorityQueue_Pop(pq);
+
+        if (top < last) {
+            printf("heap out of order\n");
+        }
+
+        last = top;
+    }
+
+    PriorityQueue_Destroy(pq);
+    return seconds_since(&begin);
+}
+
+void bench(void) {
+    size_t n;
+    double listSeconds = 0;
+    size_t listN = 0;
+
+    printf("%10s %14s %14s\n", "n", "4-ary heap", "sorted list");
+
+    for (n = 1000; n <= 10000000; n *= 10) {
+        printf("%10zu %12.4f s", n, bench_heap(n));
+
+        if (n <= BENCH_SORTED_LIST_MAX) {
+            listSeconds = bench_sorted_list(n);
+            listN = n;
+            printf(" %12.4f s\n", listSeconds);
+        }
+        else {
+            printf(" %12.1f s (extrapolated)\n", listSeconds * ((double)n / listN) * ((double)n / listN));
+        }
+    }
+}
+
+int main() {
+    Task tasks[] = {
+        { "flush", 5 }, { "compact", 9 }, { "read", 1 }, { "write", 3 }, { "gc", 7 }, { "stat", 4 }
+    };
+    void* elems[sizeof(tasks) / sizeof(Task)];
+    size_t handles[sizeof(tasks) / sizeof(Task)];
+    PriorityQueue* pq = PriorityQueue_CreateNew(0, compare_task, NULL, 1);
+    Task* task;
+    size_t i;
+
+    for (i = 0; i < sizeof(tasks) / sizeof(Task); ++i) {
+        elems[i] = &tasks[i];
+    }
+
+    PriorityQueue_Heapify(pq, elems, sizeof(tasks) / sizeof(Task), handles);
+
+    tasks[1].priority = 0;   /* compact becomes urgent. */
+    PriorityQueue_DecreaseKey(pq, handles[1]);
+
+    task = (Task*)PriorityQueue_RemoveHandle(pq, handles[4]);   /* gc is cancelled. */
+    printf("removed: %s\n", task->name);
+
+    tasks[2].priority = 8;   /* read can wait. */
+    PriorityQueue_Update(pq, handles[2]);
+
+    while (!PriorityQueue_IsEmpty(pq)) {
+        task = (Task*)PriorityQueue_Pop(pq);
+        printf("%s(%d) ", task->name, task->priority);
+    }
+    printf("\n");
+
+    PriorityQueue_Destroy(pq);
+
+    bench();
+    return 0;
+}
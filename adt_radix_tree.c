@@ -0,0 +1,1204 @@
+/**
+ * adaptive radix tree (Leis et al., "The Adaptive Radix Tree: ARTful Indexing for Main-Memory
+ * Databases", 2013) keyed by byte strings: ordered, so besides point lookups it answers prefix
+ * scans ("every key starting with user:123:") and range scans, which a hash map can't.
+ *
+ * an inner node branches on one key byte and grows through 4 sizes as children are added: Node4 and
+ * Node16 keep sorted byte/child arrays (Node16 is searched with one SSE2 compare), Node48 maps the
+ * byte to one of 48 slots, Node256 indexes the children directly. nodes shrink again on removal.
+ *
+ * path compression: a node stores the bytes every key below it shares, inline up to
+ * RADIX_TREE_INLINE_PREFIX bytes. lazy expansion: a key no other key shares a path with is a leaf
+ * right below the point where it branches off. a leaf only holds the rest of its key from there on,
+ * so the bytes keys have in common are stored once. a key ending where a node starts branching is
+ * the leaf of that node.
+ *
+ * build: cc -std=c11 -O2 adt_radix_tree.c
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "container_stats.h"
+
+#define RADIX_TREE_INLINE_PREFIX   8
+
+#define RADIX_TREE_NODE4     0
+#define RADIX_TREE_NODE16    1
+#define RADIX_TREE_NODE48    2
+#define RADIX_TREE_NODE256   3
+
+typedef struct RadixTreeLeaf RadixTreeLeaf;
+typedef struct RadixTreeNode RadixTreeNode;
+typedef struct RadixTree RadixTree;
+
+typedef void (*RadixTree_ValueDestroyFunc) (void* value);
+typedef int (*RadixTree_VisitFunc) (const void* key, size_t length, void* value, void* arg);   /* return 0 to stop the scan. */
+
+struct RadixTreeLeaf {
+    void* value;
+    size_t suffixLength;
+    unsigned char suffix[];   /* the key bytes below the point the leaf hangs from. */
+};
+
+/* a child pointer is either a RadixTreeNode* or a RadixTreeLeaf* with the lowest bit set. */
+#define RADIX_TREE_IS_LEAF(childPtr)    (((uintptr_t)(childPtr) & 1) != 0)
+#define RADIX_TREE_LEAF(childPtr)       ((RadixTreeLeaf*)((uintptr_t)(childPtr) & ~(uintptr_t)1))
+#define RADIX_TREE_TAG_LEAF(leafPtr)    ((void*)((uintptr_t)(leafPtr) | 1))
+
+struct RadixTreeNode {
+    uint8_t type;
+    uint16_t count;          /* children, the leaf not included. */
+    uint32_t prefixLength;
+    union {
+        unsigned char bytes[RADIX_TREE_INLINE_PREFIX];
+        unsigned char* heap;   /* prefixLength > RADIX_TREE_INLINE_PREFIX. */
+    } prefix;
+    RadixTreeLeaf* leaf;     /* the key ending right after the prefix, or NULL. */
+};
+
+#define RadixTreeNode_Prefix(nodePtr) \
+    ((nodePtr)->prefixLength <= RADIX_TREE_INLINE_PREFIX ? (nodePtr)->prefix.bytes : (nodePtr)->prefix.heap)
+
+typedef struct RadixTreeNode4 {
+    RadixTreeNode n;
+    unsigned char keys[4];
+    void* children[4];
+} RadixTreeNode4;
+
+typedef struct RadixTreeNode16 {
+    RadixTreeNode n;
+    unsigned char keys[16];
+    void* children[16];
+} RadixTreeNode16;
+
+typedef struct RadixTreeNode48 {
+    RadixTreeNode n;
+    unsigned char childIndex[256];   /* slot + 1, 0 means no child. */
+    void* children[48];
+} RadixTreeNode48;
+
+typedef struct RadixTreeNode256 {
+    RadixTreeNode n;
+    void* children[256];
+} RadixTreeNode256;
+
+struct RadixTree {
+    void* root;
+    size_t length;
+    size_t bytes;   /* nodes, long prefixes and leaves currently allocated. */
+
+    RadixTree_ValueDestroyFunc valueDestroy;
+
+    CONTAINER_STATS_FIELD(stats)
+};
+
+#define RadixTree_Length(treePtr)       ((treePtr)->length)
+#define RadixTree_IsEmpty(treePtr)      (RadixTree_Length(treePtr) == 0)
+#define RadixTree_SizeBytes(treePtr)    ((treePtr)->bytes)
+#define RadixTree_LeafValue(leafPtr)    ((leafPtr)->value)
+
+static const size_t RadixTree_NodeSizes[] = {
+    sizeof(RadixTreeNode4), sizeof(RadixTreeNode16), sizeof(RadixTreeNode48), sizeof(RadixTreeNode256)
+};
+
+void RadixTree_DefaultValueDestroyFunc(void* value) {}
+
+RadixTree* RadixTree_CreateNew(RadixTree_ValueDestroyFunc valueDestroy) {
+    RadixTree* tree = (RadixTree*)malloc(sizeof(RadixTree));
+    if (tree == NULL) {
+        return NULL;
+    }
+
+    tree->root = NULL;
+    tree->length = 0;
+    tree->bytes = 0;
+    tree->valueDestroy = (valueDestroy == NULL ? RadixTree_DefaultValueDestroyFunc : valueDestroy);
+    ContainerStats_Init(&tree->stats, "RadixTree");
+    return tree;
+}
+
+static RadixTreeNode* RadixTree_AllocNode(RadixTree* tree, uint8_t type) {
+    RadixTreeNode* n = (RadixTreeNode*)calloc(1, RadixTree_NodeSizes[type]);
+    if (n == NULL) {
+        return NULL;
+    }
+
+    n->type = type;
+    tree->bytes += RadixTree_NodeSizes[type];
+    ContainerStats_OnAlloc(&tree->stats, RadixTree_NodeSizes[type]);
+    return n;
+}
+
+/* the node only, its prefix may have been handed on. */
+static void RadixTree_FreeNode(RadixTree* tree, RadixTreeNode* n) {
+    tree->bytes -= RadixTree_NodeSizes[n->type];
+    ContainerStats_OnFree(&tree->stats, RadixTree_NodeSizes[n->type]);
+    free(n);
+}
+
+/* bytes may point into the current prefix. return 0 when out of memory, the prefix is unchanged then. */
+static int RadixTree_SetPrefix(RadixTree* tree, RadixTreeNode* n, const unsigned char* bytes, size_t length) {
+    unsigned char* old = (n->prefixLength > RADIX_TREE_INLINE_PREFIX ? n->prefix.heap : NULL);
+    unsigned char* heap;
+
+    if (length > RADIX_TREE_INLINE_PREFIX) {
+        if ((heap = (unsigned char*)malloc(length)) == NULL) {
+            return 0;
+        }
+
+        memcpy(heap, bytes, length);
+        n->prefix.heap = heap;
+        tree->bytes += length;
+        ContainerStats_OnAlloc(&tree->stats, length);
+    }
+    else {
+        memmove(n->prefix.bytes, bytes, length);
+    }
+
+    if (old != NULL) {
+        tree->bytes -= n->prefixLength;
+        ContainerStats_OnFree(&tree->stats, n->prefixLength);
+        free(old);
+    }
+
+    n->prefixLength = (uint32_t)length;
+    return 1;
+}
+
+static RadixTreeLeaf* RadixTree_AllocLeaf(RadixTree* tree, const unsigned char* suffix, size_t length, void* value) {
+    RadixTreeLeaf* leaf = (RadixTreeLeaf*)malloc(sizeof(RadixTreeLeaf) + length);
+    if (leaf == NULL) {
+        return NULL;
+    }
+
+    leaf->value = value;
+    leaf->suffixLength = length;
+    memcpy(leaf->suffix, suffix, length);
+    tree->bytes += sizeof(RadixTreeLeaf) + length;
+    ContainerStats_OnAlloc(&tree->stats, sizeof(RadixTreeLeaf) + length);
+    return leaf;
+}
+
+/* the leaf only, its value is not destroyed. */
+static void RadixTree_FreeLeaf(RadixTree* tree, RadixTreeLeaf* leaf) {
+    tree->bytes -= sizeof(RadixTreeLeaf) + leaf->suffixLength;
+    ContainerStats_OnFree(&tree->stats, sizeof(RadixTreeLeaf) + leaf->suffixLength);
+    free(leaf);
+}
+
+/* the leaf now hangs drop bytes deeper, never fails: when the smaller block can't be had the old one stays. */
+static RadixTreeLeaf* RadixTree_TrimLeaf(RadixTree* tree, RadixTreeLeaf* leaf, size_t drop) {
+    RadixTreeLeaf* smaller;
+    size_t length = leaf->suffixLength - drop;
+
+    memmove(leaf->suffix, leaf->suffix + drop, length);
+    leaf->suffixLength = length;
+
+    if ((smaller = (RadixTreeLeaf*)realloc(leaf, sizeof(RadixTreeLeaf) + length)) == NULL) {
+        return leaf;
+    }
+
+    tree->bytes -= drop;
+    ContainerStats_OnGrow(&tree->stats, sizeof(RadixTreeLeaf) + length + drop, sizeof(RadixTreeLeaf) + length);
+    return smaller;
+}
+
+static int RadixTree_LeafMatches(const RadixTreeLeaf* leaf, const unsigned char* key, size_t length, size_t depth) {
+    return leaf->suffixLength == length - depth && memcmp(leaf->suffix, key + depth, length - depth) == 0;
+}
+
+/* order of two byte strings, a proper prefix goes first. */
+static int RadixTree_CompareKeys(const unsigned char* left, size_t leftLength, const unsigned char* right, size_t rightLength) {
+    int cmp = memcmp(left, right, leftLength < rightLength ? leftLength : rightLength);
+
+    if (cmp != 0) {
+        return cmp;
+    }
+
+    return (leftLength > rightLength) - (leftLength < rightLength);
+}
+
+/**
+ * children in byte order: *cursor starts at 0, the child of the next byte is returned and its byte
+ * stored in *byte, NULL when there is none left.
+ */
+static void* RadixTree_NextChild(const RadixTreeNode* n, int* cursor, unsigned char* byte) {
+    switch (n->type) {
+    case RADIX_TREE_NODE4:
+        if (*cursor < n->count) {
+            *byte = ((const RadixTreeNode4*)n)->keys[*cursor];
+            return ((const RadixTreeNode4*)n)->children[(*cursor)++];
+        }
+        break;
+    case RADIX_TREE_NODE16:
+        if (*cursor < n->count) {
+            *byte = ((const RadixTreeNode16*)n)->keys[*cursor];
+            return ((const RadixTreeNode16*)n)->children[(*cursor)++];
+        }
+        break;
+    case RADIX_TREE_NODE48:
+        for (; *cursor < 256; ++*cursor) {
+            if (((const RadixTreeNode48*)n)->childIndex[*cursor] != 0) {
+                *byte = (unsigned char)*cursor;
+                return ((const RadixTreeNode48*)n)->children[((const RadixTreeNode48*)n)->childIndex[(*cursor)++] - 1];
+            }
+        }
+        break;
+    default:
+        for (; *cursor < 256; ++*cursor) {
+            if (((const RadixTreeNode256*)n)->children[*cursor] != NULL) {
+                *byte = (unsigned char)*cursor;
+                return ((const RadixTreeNode256*)n)->children[(*cursor)++];
+            }
+        }
+        break;
+    }
+
+    return NULL;
+}
+
+/* the slot holding the child of byte, NULL when there is none. */
+static void** RadixTree_FindChild(RadixTreeNode* n, unsigned char byte) {
+    int i;
+
+    switch (n->type) {
+    case RADIX_TREE_NODE4: {
+        RadixTreeNode4* n4 = (RadixTreeNode4*)n;
+        for (i = 0; i < n->count; ++i) {
+            if (n4->keys[i] == byte) {
+                return &n4->children[i];
+            }
+        }
+        return NULL;
+    }
+    case RADIX_TREE_NODE16: {
+        RadixTreeNode16* n16 = (RadixTreeNode16*)n;
+#if defined(__SSE2__)
+        __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)byte), _mm_loadu_si128((const __m128i*)n16->keys));
+        int mask = _mm_movemask_epi8(cmp) & ((1 << n->count) - 1);
+
+        return (mask != 0) ? &n16->children[__builtin_ctz((unsigned)mask)] : NULL;
+#else
+        for (i = 0; i < n->count; ++i) {
+            if (n16->keys[i] == byte) {
+                return &n16->children[i];
+            }
+        }
+        return NULL;
+#endif
+    }
+    case RADIX_TREE_NODE48: {
+        RadixTreeNode48* n48 = (RadixTreeNode48*)n;
+        return (n48->childIndex[byte] != 0) ? &n48->children[n48->childIndex[byte] - 1] : NULL;
+    }
+    default: {
+        RadixTreeNode256* n256 = (RadixTreeNode256*)n;
+        return (n256->children[byte] != NULL) ? &n256->children[byte] : NULL;
+    }
+    }
+}
+
+/* position of the first key greater than byte in a sorted Node4 / Node16 key array. */
+static int RadixTree_UpperBound(const unsigned char* keys, int count, unsigned char byte) {
+    int i;
+
+#if defined(__SSE2__)
+    if (count > 4) {
+        /* no unsigned byte compare in SSE2: flip the sign bit of both sides. */
+        __m128i flip = _mm_set1_epi8((char)0x80);
+        __m128i cmp = _mm_cmpgt_epi8(_mm_xor_si128(_mm_loadu_si128((const __m128i*)keys), flip), _mm_xor_si128(_mm_set1_epi8((char)byte), flip));
+        int mask = _mm_movemask_epi8(cmp) & ((1 << count) - 1);
+
+        return (mask != 0) ? __builtin_ctz((unsigned)mask) : count;
+    }
+#endif
+
+    for (i = 0; i < count && keys[i] <= byte; ++i) {
+    }
+
+    return i;
+}
+
+/* how many prefix bytes of n match key from depth on, stops where key ends. */
+static size_t RadixTree_PrefixMatch(RadixTreeNode* n, const unsigned char* key, size_t length, size_t depth) {
+    const unsigned char* prefix = RadixTreeNode_Prefix(n);
+    size_t i;
+
+    for (i = 0; i < n->prefixLength && depth + i < length && prefix[i] == key[depth + i]; ++i) {
+    }
+
+    return i;
+}
+
+/* NULL when key is not in the tree. */
+RadixTreeLeaf* RadixTree_Find(RadixTree* tree, const void* key, size_t length) {
+    const unsigned char* k = (const unsigned char*)key;
+    void* child = tree->root;
+    void** slot;
+    RadixTreeNode* n;
+    size_t depth = 0;
+    size_t probes = 0;
+
+    while (child != NULL && !RADIX_TREE_IS_LEAF(child)) {
+        n = (RadixTreeNode*)child;
+        probes += 1;
+
+        if (length - depth < n->prefixLength || memcmp(RadixTreeNode_Prefix(n), k + depth, n->prefixLength) != 0) {
+            return NULL;
+        }
+
+        depth += n->prefixLength;
+
+        if (depth == length) {
+            ContainerStats_OnProbe(&tree->stats, probes);
+            return n->leaf;
+        }
+
+        if ((slot = RadixTree_FindChild(n, k[depth])) == NULL) {
+            return NULL;
+        }
+
+        child = *slot;
+        depth += 1;
+    }
+
+    ContainerStats_OnProbe(&tree->stats, probes);
+    return (child != NULL && RadixTree_LeafMatches(RADIX_TREE_LEAF(child), k, length, depth)) ? RADIX_TREE_LEAF(child) : NULL;
+}
+
+/* move the header and the children into a node of another size, the old one is freed. */
+static RadixTreeNode* RadixTree_Resize(RadixTree* tree, RadixTreeNode* n, uint8_t type) {
+    RadixTreeNode* m = RadixTree_AllocNode(tree, type);
+    unsigned char byte;
+    void* child;
+    int cursor = 0, i = 0;
+
+    if (m == NULL) {
+        return NULL;
+    }
+
+    m->prefixLength = n->prefixLength;
+    m->prefix = n->prefix;
+    m->leaf = n->leaf;
+
+    while ((child = RadixTree_NextChild(n, &cursor, &byte)) != NULL) {
+        switch (type) {
+        case RADIX_TREE_NODE4:
+            ((RadixTreeNode4*)m)->keys[i] = byte;
+            ((RadixTreeNode4*)m)->children[i] = child;
+            break;
+        case RADIX_TREE_NODE16:
+            ((RadixTreeNode16*)m)->keys[i] = byte;
+            ((RadixTreeNode16*)m)->children[i] = child;
+            break;
+        case RADIX_TREE_NODE48:
+            ((RadixTreeNode48*)m)->childIndex[byte] = (unsigned char)(i + 1);
+            ((RadixTreeNode48*)m)->children[i] = child;
+            break;
+        default:
+            ((RadixTreeNode256*)m)->children[byte] = child;
+            break;
+        }
+
+        i += 1;
+    }
+
+    m->count = (uint16_t)i;
+    RadixTree_FreeNode(tree, n);
+    return m;
+}
+
+/* add the child of byte to the node at *ref, which is replaced when it has to grow. 0 when out of memory. */
+static int RadixTree_AddChild(RadixTree* tree, void** ref, unsigned char byte, void* child) {
+    RadixTreeNode* n = (RadixTreeNode*)*ref;
+    unsigned char* keys;
+    void** children;
+    int capacity, pos, i;
+
+    switch (n->type) {
+    case RADIX_TREE_NODE4:
+    case RADIX_TREE_NODE16:
+        if (n->type == RADIX_TREE_NODE4) {
+            keys = ((RadixTreeNode4*)n)->keys;
+            children = ((RadixTreeNode4*)n)->children;
+            capacity = 4;
+        }
+        else {
+            keys = ((RadixTreeNode16*)n)->keys;
+            children = ((RadixTreeNode16*)n)->children;
+            capacity = 16;
+        }
+
+        if (n->count < capacity) {
+            pos = RadixTree_UpperBound(keys, n->count, byte);
+            memmove(keys + pos + 1, keys + pos, (size_t)(n->count - pos));
+            memmove(children + pos + 1, children + pos, (size_t)(n->count - pos) * sizeof(void*));
+            keys[pos] = byte;
+            children[pos] = child;
+            n->count += 1;
+            return 1;
+        }
+        break;
+    case RADIX_TREE_NODE48:
+        if (n->count < 48) {
+            RadixTreeNode48* n48 = (RadixTreeNode48*)n;
+
+            for (i = 0; n48->children[i] != NULL; ++i) {
+            }
+
+            n48->children[i] = child;
+            n48->childIndex[byte] = (unsigned char)(i + 1);
+            n->count += 1;
+            return 1;
+        }
+        break;
+    default:
+        ((RadixTreeNode256*)n)->children[byte] = child;
+        n->count += 1;
+        return 1;
+    }
+
+    if ((n = RadixTree_Resize(tree, n, (uint8_t)(n->type + 1))) == NULL) {
+        return 0;
+    }
+
+    *ref = n;
+    return RadixTree_AddChild(tree, ref, byte, child);
+}
+
+/* a Node4 with the given prefix, for a split. */
+static RadixTreeNode* RadixTree_SplitNode(RadixTree* tree, const unsigned char* prefix, size_t prefixLength) {
+    RadixTreeNode* n = RadixTree_AllocNode(tree, RADIX_TREE_NODE4);
+
+    if (n != NULL && !RadixTree_SetPrefix(tree, n, prefix, prefixLength)) {
+        RadixTree_FreeNode(tree, n);
+        return NULL;
+    }
+
+    return n;
+}
+
+/**
+ * insert or replace (the old value is destroyed), the key bytes are copied. keys are byte strings,
+ * '\0' is an ordinary byte and one key may be a prefix of another. return 0 when out of memory.
+ */
+int RadixTree_Insert(RadixTree* tree, const void* key, size_t length, void* value) {
+    ContainerStats_OpBegin(&tree->stats, opBegin);
+    const unsigned char* k = (const unsigned char*)key;
+    void** ref = &tree->root;
+    RadixTreeLeaf* leaf;
+    RadixTreeLeaf* old;
+    RadixTreeNode* n;
+    RadixTreeNode* split;
+    void* splitRef;   /* split as a child pointer, a Node4 with 2 entries never grows. */
+    unsigned char edge;
+    size_t depth = 0, match;
+    void** slot;
+
+    for (;;) {
+        if (*ref == NULL) {
+            if ((leaf = RadixTree_AllocLeaf(tree, k, length, value)) == NULL) {
+                return 0;
+            }
+
+            *ref = RADIX_TREE_TAG_LEAF(leaf);
+            break;
+        }
+
+        if (RADIX_TREE_IS_LEAF(*ref)) {
+            old = RADIX_TREE_LEAF(*ref);
+
+            if (RadixTree_LeafMatches(old, k, length, depth)) {
+                tree->valueDestroy(old->value);
+                old->value = value;
+                ContainerStats_OpEnd(&tree->stats, opBegin);
+                return 1;
+            }
+
+            /* lazy expansion ends here: branch where the two keys differ. */
+            for (match = 0; match < old->suffixLength && depth + match < length && old->suffix[match] == k[depth + match]; ++match) {
+            }
+
+            if ((split = RadixTree_SplitNode(tree, k + depth, match)) == NULL) {
+                return 0;
+            }
+
+            if (depth + match == length) {
+                leaf = RadixTree_AllocLeaf(tree, (const unsigned char*)"", 0, value);
+            }
+            else {
+                leaf = RadixTree_AllocLeaf(tree, k + depth + match + 1, length - depth - match - 1, value);
+            }
+
+            if (leaf == NULL) {
+                RadixTree_SetPrefix(tree, split, (const unsigned char*)"", 0);
+                RadixTree_FreeNode(tree, split);
+                return 0;
+            }
+
+            splitRef = split;
+
+            if (old->suffixLength == match) {
+                split->leaf = RadixTree_TrimLeaf(tree, old, match);
+            }
+            else {
+                edge = old->suffix[match];
+                RadixTree_AddChild(tree, &splitRef, edge, RADIX_TREE_TAG_LEAF(RadixTree_TrimLeaf(tree, old, match + 1)));
+            }
+
+            if (depth + match == length) {
+                split->leaf = leaf;
+            }
+            else {
+                RadixTree_AddChild(tree, &splitRef, k[depth + match], RADIX_TREE_TAG_LEAF(leaf));
+            }
+
+            *ref = splitRef;
+            break;
+        }
+
+        n = (RadixTreeNode*)*ref;
+        match = RadixTree_PrefixMatch(n, k, length, depth);
+
+        if (match < n->prefixLength) {
+            /* the key leaves the compressed path: a new node takes the matching part. */
+            if ((split = RadixTree_SplitNode(tree, k + depth, match)) == NULL) {
+                return 0;
+            }
+
+            if (depth + match == length) {
+                leaf = RadixTree_AllocLeaf(tree, (const unsigned char*)"", 0, value);
+            }
+            else {
+                leaf = RadixTree_AllocLeaf(tree, k + depth + match + 1, length - depth - match - 1, value);
+            }
+
+            edge = RadixTreeNode_Prefix(n)[match];
+
+            if (leaf == NULL || !RadixTree_SetPrefix(tree, n, RadixTreeNode_Prefix(n) + match + 1, n->prefixLength - match - 1)) {
+                if (leaf != NULL) {
+                    RadixTree_FreeLeaf(tree, leaf);
+                }
+
+                RadixTree_SetPrefix(tree, split, (const unsigned char*)"", 0);
+                RadixTree_FreeNode(tree, split);
+                return 0;
+            }
+
+            splitRef = split;
+            RadixTree_AddChild(tree, &splitRef, edge, n);
+
+            if (depth + match == length) {
+                split->leaf = leaf;
+            }
+            else {
+                RadixTree_AddChild(tree, &splitRef, k[depth + match], RADIX_TREE_TAG_LEAF(leaf));
+            }
+
+            *ref = splitRef;
+            break;
+        }
+
+        depth += n->prefixLength;
+
+        if (depth == length) {
+            if (n->leaf != NULL) {
+                tree->valueDestroy(n->leaf->value);
+                n->leaf->value = value;
+                ContainerStats_OpEnd(&tree->stats, opBegin);
+                return 1;
+            }
+
+            if ((n->leaf = RadixTree_AllocLeaf(tree, (const unsigned char*)"", 0, value)) == NULL) {
+                return 0;
+            }
+
+            break;
+        }
+
+        if ((slot = RadixTree_FindChild(n, k[depth])) != NULL) {
+            ref = slot;
+            depth += 1;
+            continue;
+        }
+
+        if ((leaf = RadixTree_AllocLeaf(tree, k + depth + 1, length - depth - 1, value)) == NULL) {
+            return 0;
+        }
+
+        if (!RadixTree_AddChild(tree, ref, k[depth], RADIX_TREE_TAG_LEAF(leaf))) {
+            RadixTree_FreeLeaf(tree, leaf);
+            return 0;
+        }
+
+        break;
+    }
+
+    tree->length += 1;
+    ContainerStats_OpEnd(&tree->stats, opBegin);
+    return 1;
+}
+
+static void RadixTree_RemoveChild(RadixTreeNode* n, unsigned char byte) {
+    unsigned char* keys;
+    void** children;
+    int pos;
+
+    switch (n->type) {
+    case RADIX_TREE_NODE4:
+    case RADIX_TREE_NODE16:
+        if (n->type == RADIX_TREE_NODE4) {
+            keys = ((RadixTreeNode4*)n)->keys;
+            children = ((RadixTreeNode4*)n)->children;
+        }
+        else {
+            keys = ((RadixTreeNode16*)n)->keys;
+            children = ((RadixTreeNode16*)n)->children;
+        }
+
+        for (pos = 0; keys[pos] != byte; ++pos) {
+        }
+
+        memmove(keys + pos, keys + pos + 1, (size_t)(n->count - pos - 1));
+        memmove(children + pos, children + pos + 1, (size_t)(n->count - pos - 1) * sizeof(void*));
+        break;
+    case RADIX_TREE_NODE48:
+        ((RadixTreeNode48*)n)->children[((RadixTreeNode48*)n)->childIndex[byte] - 1] = NULL;
+        ((RadixTreeNode48*)n)->childIndex[byte] = 0;
+        break;
+    default:
+        ((RadixTreeNode256*)n)->children[byte] = NULL;
+        break;
+    }
+
+    n->count -= 1;
+}
+
+/**
+ * a Node4 with nothing but one leaf or one child is replaced by it, the child takes over the prefix
+ * (and the edge byte) in front of its own. return 0 when out of memory, the node stays then.
+ */
+static int RadixTree_Collapse(RadixTree* tree, void** ref) {
+    RadixTreeNode* n = (RadixTreeNode*)*ref;
+    void* child = (n->count == 0 ? RADIX_TREE_TAG_LEAF(n->leaf) : ((RadixTreeNode4*)n)->children[0]);
+    size_t head = n->prefixLength + n->count;   /* the edge byte counts when there is a child. */
+    unsigned char* bytes;
+    RadixTreeLeaf* leaf;
+    RadixTreeNode* c;
+
+    if (RADIX_TREE_IS_LEAF(child)) {
+        leaf = RADIX_TREE_LEAF(child);
+
+        if ((bytes = (unsigned char*)malloc(head + leaf->suffixLength + 1)) == NULL) {
+            return 0;
+        }
+
+        memcpy(bytes, RadixTreeNode_Prefix(n), n->prefixLength);
+        if (n->count == 1) {
+            bytes[head - 1] = ((RadixTreeNode4*)n)->keys[0];
+        }
+        memcpy(bytes + head, leaf->suffix, leaf->suffixLength);
+
+        if ((child = RadixTree_AllocLeaf(tree, bytes, head + leaf->suffixLength, leaf->value)) == NULL) {
+            free(bytes);
+            return 0;
+        }
+
+        free(bytes);
+        RadixTree_FreeLeaf(tree, leaf);
+        child = RADIX_TREE_TAG_LEAF(child);
+    }
+    else {
+        c = (RadixTreeNode*)child;
+
+        if ((bytes = (unsigned char*)malloc(head + c->prefixLength)) == NULL) {
+            return 0;
+        }
+
+        memcpy(bytes, RadixTreeNode_Prefix(n), n->prefixLength);
+        bytes[head - 1] = ((RadixTreeNode4*)n)->keys[0];
+        memcpy(bytes + head, RadixTreeNode_Prefix(c), c->prefixLength);
+
+        if (!RadixTree_SetPrefix(tree, c, bytes, head + c->prefixLength)) {
+            free(bytes);
+            return 0;
+        }
+
+        free(bytes);
+    }
+
+    RadixTree_SetPrefix(tree, n, (const unsigned char*)"", 0);
+    RadixTree_FreeNode(tree, n);
+    *ref = child;
+    return 1;
+}
+
+/* after a removal: shrink the node at *ref, or replace it by its only leaf or child. */
+static void RadixTree_Shrink(RadixTree* tree, void** ref) {
+    RadixTreeNode* n = (RadixTreeNode*)*ref;
+    RadixTreeNode* m;
+
+    switch (n->type) {
+    case RADIX_TREE_NODE4:
+        /* out of memory only means the path stays longer than needed. */
+        if ((n->count == 0 && n->leaf != NULL) || (n->count == 1 && n->leaf == NULL)) {
+            RadixTree_Collapse(tree, ref);
+        }
+        return;
+    case RADIX_TREE_NODE16:
+        if (n->count > 3) {
+            return;
+        }
+        break;
+    case RADIX_TREE_NODE48:
+        if (n->count > 12) {
+            return;
+        }
+        break;
+    default:
+        if (n->count > 37) {
+            return;
+        }
+        break;
+    }
+
+    /* out of memory only means the node stays bigger than needed. */
+    if ((m = RadixTree_Resize(tree, n, (uint8_t)(n->type - 1))) != NULL) {
+        *ref = m;
+    }
+}
+
+/* return 1 when key was found and removed. */
+int RadixTree_Remove(RadixTree* tree, const void* key, size_t length) {
+    const unsigned char* k = (const unsigned char*)key;
+    void** ref = &tree->root;
+    void** slot;
+    RadixTreeNode* n;
+    RadixTreeLeaf* leaf;
+    size_t depth = 0;
+
+    if (*ref == NULL) {
+        return 0;
+    }
+
+    if (RADIX_TREE_IS_LEAF(*ref)) {
+        leaf = RADIX_TREE_LEAF(*ref);
+        if (!RadixTree_LeafMatches(leaf, k, length, 0)) {
+            return 0;
+        }
+
+        tree->valueDestroy(leaf->value);
+        RadixTree_FreeLeaf(tree, leaf);
+        *ref = NULL;
+        tree->length -= 1;
+        return 1;
+    }
+
+    for (;;) {
+        n = (RadixTreeNode*)*ref;
+
+        if (RadixTree_PrefixMatch(n, k, length, depth) < n->prefixLength) {
+            return 0;
+        }
+
+        depth += n->prefixLength;
+
+        if (depth == length) {
+            if (n->leaf == NULL) {
+                return 0;
+            }
+
+            tree->valueDestroy(n->leaf->value);
+            RadixTree_FreeLeaf(tree, n->leaf);
+            n->leaf = NULL;
+            break;
+        }
+
+        if ((slot = RadixTree_FindChild(n, k[depth])) == NULL) {
+            return 0;
+        }
+
+        if (RADIX_TREE_IS_LEAF(*slot)) {
+            leaf = RADIX_TREE_LEAF(*slot);
+            if (!RadixTree_LeafMatches(leaf, k, length, depth + 1)) {
+                return 0;
+            }
+
+            RadixTree_RemoveChild(n, k[depth]);
+            tree->valueDestroy(leaf->value);
+            RadixTree_FreeLeaf(tree, leaf);
+            break;
+        }
+
+        ref = slot;
+        depth += 1;
+    }
+
+    RadixTree_Shrink(tree, ref);
+    tree->length -= 1;
+    return 1;
+}
+
+static void RadixTree_DestroyChild(RadixTree* tree, void* child) {
+    RadixTreeNode* n;
+    unsigned char byte;
+    void* grandChild;
+    int cursor = 0;
+
+    if (RADIX_TREE_IS_LEAF(child)) {
+        tree->valueDestroy(RADIX_TREE_LEAF(child)->value);
+        RadixTree_FreeLeaf(tree, RADIX_TREE_LEAF(child));
+        return;
+    }
+
+    n = (RadixTreeNode*)child;
+    while ((grandChild = RadixTree_NextChild(n, &cursor, &byte)) != NULL) {
+        RadixTree_DestroyChild(tree, grandChild);
+    }
+
+    if (n->leaf != NULL) {
+        RadixTree_DestroyChild(tree, RADIX_TREE_TAG_LEAF(n->leaf));
+    }
+
+    RadixTree_SetPrefix(tree, n, (const unsigned char*)"", 0);
+    RadixTree_FreeNode(tree, n);
+}
+
+void RadixTree_Destroy(RadixTree* tree) {
+    if (tree->root != NULL) {
+        RadixTree_DestroyChild(tree, tree->root);
+    }
+
+    free(tree);
+}
+
+typedef struct RadixTreeScan {
+    const unsigned char* low;    /* NULL means no lower bound. */
+    size_t lowLength;
+    const unsigned char* high;   /* NULL means no upper bound. */
+    size_t highLength;
+    RadixTree_VisitFunc visit;
+    void* arg;
+
+    unsigned char* key;          /* the path walked so far, leaves only hold the end of their key. */
+    size_t keyCapacity;
+} RadixTreeScan;
+
+static int RadixTree_ScanReserve(RadixTreeScan* scan, size_t length) {
+    unsigned char* key;
+    size_t capacity = (scan->keyCapacity == 0 ? 64 : scan->keyCapacity);
+
+    if (scan->key != NULL && length <= scan->keyCapacity) {
+        return 1;
+    }
+
+    while (capacity < length) {
+        capacity *= 2;
+    }
+
+    if ((key = (unsigned char*)realloc(scan->key, capacity)) == NULL) {
+        return 0;
+    }
+
+    scan->key = key;
+    scan->keyCapacity = capacity;
+    return 1;
+}
+
+/**
+ * in order walk of the keys below child that are in [low, high), scan->key holds the first depth
+ * bytes of their path. checkLow is 0 once the path is known to be above low. return 0 when the scan
+ * is over (or out of memory).
+ */
+static int RadixTree_Walk(RadixTreeScan* scan, void* child, size_t depth, int checkLow) {
+    RadixTreeNode* n;
+    RadixTreeLeaf* leaf;
+    const unsigned char* prefix;
+    unsigned char byte;
+    void* next;
+    int cursor = 0, childCheckLow;
+    size_t i;
+
+    if (RADIX_TREE_IS_LEAF(child)) {
+        leaf = RADIX_TREE_LEAF(child);
+
+        if (!RadixTree_ScanReserve(scan, depth + leaf->suffixLength)) {
+            return 0;
+        }
+
+        memcpy(scan->key + depth, leaf->suffix, leaf->suffixLength);
+        depth += leaf->suffixLength;
+
+        if (checkLow && RadixTree_CompareKeys(scan->key, depth, scan->low, scan->lowLength) < 0) {
+            return 1;
+        }
+
+        if (scan->high != NULL && RadixTree_CompareKeys(scan->key, depth, scan->high, scan->highLength) >= 0) {
+            return 0;
+        }
+
+        return scan->visit(scan->key, depth, leaf->value, scan->arg);
+    }
+
+    n = (RadixTreeNode*)child;
+    prefix = RadixTreeNode_Prefix(n);
+
+    if (checkLow) {
+        for (i = 0; i < n->prefixLength; ++i) {
+            if (depth + i == scan->lowLength) {
+                checkLow = 0;   /* low is a prefix of every key below. */
+                break;
+            }
+
+            if (prefix[i] != scan->low[depth + i]) {
+                if (prefix[i] < scan->low[depth + i]) {
+                    return 1;   /* every key below is smaller than low. */
+                }
+
+                checkLow = 0;
+                break;
+            }
+        }
+    }
+
+    if (!RadixTree_ScanReserve(scan, depth + n->prefixLength + 1)) {
+        return 0;
+    }
+
+    memcpy(scan->key + depth, prefix, n->prefixLength);
+    depth += n->prefixLength;
+
+    if (n->leaf != NULL && !RadixTree_Walk(scan, RADIX_TREE_TAG_LEAF(n->leaf), depth, checkLow)) {
+        return 0;
+    }
+
+    if (checkLow && depth >= scan->lowLength) {
+        checkLow = 0;
+    }
+
+    while ((next = RadixTree_NextChild(n, &cursor, &byte)) != NULL) {
+        childCheckLow = checkLow;
+
+        if (checkLow) {
+            if (byte < scan->low[depth]) {
+                continue;
+            }
+
+            childCheckLow = (byte == scan->low[depth]);
+        }
+
+        scan->key[depth] = byte;
+
+        if (!RadixTree_Walk(scan, next, depth + 1, childCheckLow)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void RadixTree_ScanInit(RadixTreeScan* scan, RadixTree_VisitFunc visit, void* arg) {
+    scan->low = scan->high = NULL;
+    scan->lowLength = scan->highLength = 0;
+    scan->visit = visit;
+    scan->arg = arg;
+    scan->key = NULL;
+    scan->keyCapacity = 0;
+}
+
+/**
+ * visit the keys in [low, high) in order, low NULL means from the first key, high NULL means to the
+ * last one. the key passed to visit is only valid during the call. return 0 when visit stopped the
+ * scan, or when out of memory.
+ */
+int RadixTree_ScanRange(RadixTree* tree, const void* low, size_t lowLength, const void* high, size_t highLength,
+                        RadixTree_VisitFunc visit, void* arg) {
+    RadixTreeScan scan;
+    int ret = 1;
+
+    RadixTree_ScanInit(&scan, visit, arg);
+    scan.low = (const unsigned char*)low;
+    scan.lowLength = lowLength;
+    scan.high = (const unsigned char*)high;
+    scan.highLength = highLength;
+
+    if (tree->root != NULL) {
+        ret = RadixTree_Walk(&scan, tree->root, 0, low != NULL);
+    }
+
+    free(scan.key);
+    return ret;
+}
+
+/* visit every key in order. */
+int RadixTree_ForEach(RadixTree* tree, RadixTree_VisitFunc visit, void* arg) {
+    return RadixTree_ScanRange(tree, NULL, 0, NULL, 0, visit, arg);
+}
+
+/* visit the keys starting with prefix in order: one descent, then a walk of that subtree. */
+int RadixTree_ScanPrefix(RadixTree* tree, const void* prefix, size_t length, RadixTree_VisitFunc visit, void* arg) {
+    const unsigned char* p = (const unsigned char*)prefix;
+    RadixTreeScan scan;
+    void* child = tree->root;
+    void** slot;
+    RadixTreeNode* n;
+    RadixTreeLeaf* leaf;
+    size_t depth = 0, match;
+    int ret = 1;
+
+    RadixTree_ScanInit(&scan, visit, arg);
+
+    while (child != NULL && !RADIX_TREE_IS_LEAF(child)) {
+        n = (RadixTreeNode*)child;
+        match = RadixTree_PrefixMatch(n, p, length, depth);
+
+        if (depth + match == length) {
+            break;   /* every key below starts with prefix. */
+        }
+
+        if (match < n->prefixLength) {
+            return 1;
+        }
+
+        depth += n->prefixLength;
+
+        if ((slot = RadixTree_FindChild(n, p[depth])) == NULL) {
+            return 1;
+        }
+
+        child = *slot;
+        depth += 1;
+    }
+
+    if (child == NULL) {
+        return 1;
+    }
+
+    if (RADIX_TREE_IS_LEAF(child)) {
+        leaf = RADIX_TREE_LEAF(child);
+        if (depth + leaf->suffixLength < length || memcmp(leaf->suffix, p + depth, length - depth) != 0) {
+            return 1;
+        }
+    }
+
+    if (!RadixTree_ScanReserve(&scan, depth)) {
+        return 0;
+    }
+
+    memcpy(scan.key, p, depth);
+    ret = RadixTree_Walk(&scan, child, depth, 0);
+    free(scan.key);
+    return ret;
+}
+
+#ifdef CONTAINER_STATS
+void RadixTree_GetStats(RadixTree* tree, ContainerStats* out) {
+    *out = tree->stats;
+}
+#endif
+
+static int print_entry(const void* key, size_t length, void* value, void* arg) {
+    printf("  %.*s -> %s\n", (int)length, (const char*)key, (const char*)value);
+    return 1;
+}
+
+static int count_entry(const void* key, size_t length, void* value, void* arg) {
+    *(size_t*)arg += 1;
+    return 1;
+}
+
+static double seconds_since(const struct timespec* begin) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - begin->tv_sec) + (double)(end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+#define BENCH_KEYS   1000000
+
+int main() {
+    RadixTree* tree = RadixTree_CreateNew(NULL);
+    const char* keys[] = {
+        "user:123:name", "user:123:email", "user:1234:name", "user:12:name", "user:123", "order:7", "user:124:name"
+    };
+    const char* values[] = { "ada", "ada@example.com", "bob", "eve", "(profile)", "books", "sam" };
+    size_t i, count;
+
+    for (i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        RadixTree_Insert(tree, keys[i], strlen(keys[i]), (void*)values[i]);
+    }
+
+    RadixTreeLeaf* leaf = RadixTree_Find(tree, "user:1234:name", 14);
+    printf("find user:1234:name -> %s\n", leaf == NULL ? "not found" : (const char*)RadixTree_LeafValue(leaf));
+    printf("find user:99 -> %s\n", RadixTree_Find(tree, "user:99", 7) == NULL ? "not found" : "found");
+
+    printf("\nin order:\n");
+    RadixTree_ForEach(tree, print_entry, NULL);
+
+    printf("\nprefix user:123:\n");
+    RadixTree_ScanPrefix(tree, "user:123:", 9, print_entry, NULL);
+
+    printf("\nrange [user:123, user:124)\n");
+    RadixTree_ScanRange(tree, "user:123", 8, "user:124", 8, print_entry, NULL);
+
+    RadixTree_Remove(tree, "user:123", 8);
+    RadixTree_Remove(tree, "order:7", 7);
+    printf("\nafter removing user:123 and order:7:\n");
+    RadixTree_ForEach(tree, print_entry, NULL);
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    RadixTree_GetStats(tree, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
+    RadixTree_Destroy(tree);
+
+    /* long keys sharing most of their bytes, as in a namespaced key-value store. */
+    char buf[64];
+    size_t keyBytes = 0;
+    struct timespec begin;
+    double insertSeconds, findSeconds;
+
+    tree = RadixTree_CreateNew(NULL);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < BENCH_KEYS; ++i) {
+        keyBytes += (size_t)snprintf(buf, sizeof(buf), "tenant:acme:region:eu-west:user:%08zu:session", i * 7);
+        RadixTree_Insert(tree, buf, strlen(buf), (void*)(uintptr_t)i);
+    }
+
+    insertSeconds = seconds_since(&begin);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (count = 0, i = 0; i < BENCH_KEYS; ++i) {
+        snprintf(buf, sizeof(buf), "tenant:acme:region:eu-west:user:%08zu:session", (i * 7919) % BENCH_KEYS * 7);
+        count += (RadixTree_Find(tree, buf, strlen(buf)) != NULL);
+    }
+
+    findSeconds = seconds_since(&begin);
+
+    printf("\n%d keys of %zu bytes\n", BENCH_KEYS, keyBytes / BENCH_KEYS);
+    printf("  insert %.1f ns/key, find %.1f ns/key, %zu found\n", insertSeconds * 1e9 / BENCH_KEYS, findSeconds * 1e9 / BENCH_KEYS, count);
+
+    /* a HashMap holds a node and a copy of the key (with its terminator) per entry. */
+    printf("  radix tree: %.1f bytes/key, HashMap with copied keys: %.1f bytes/key (allocator overhead not counted)\n",
+           (double)RadixTree_SizeBytes(tree) / BENCH_KEYS, (double)(BENCH_KEYS * 3 * sizeof(void*) + keyBytes + BENCH_KEYS) / BENCH_KEYS);
+
+    count = 0;
+    RadixTree_ScanPrefix(tree, "tenant:acme:region:eu-west:user:0000", 36, count_entry, &count);
+    printf("  prefix user:0000*: %zu keys\n", count);
+
+    RadixTree_Destroy(tree);
+    return 0;
+}
@@ -0,0 +1,545 @@
+/**
+ * string intern pool: every distinct string is stored once, and the same bytes always give back the
+ * same pointer and the same id.
+ *
+ * each string lives in an arena next to its hash, length and id, so an interned pointer is all a map
+ * needs: keys compare by pointer and hash by address (see hash_interned_key / compare_interned_key
+ * in adt_hashmap.c), the string is hashed only once, when it is interned. ids are dense from 0, they
+ * can index a plain array or a bitset.
+ *
+ * the table is split into shards by hash like the LRU cache, each shard has a rwlock: lookups of
+ * already interned strings only take the read lock, a miss retakes it for writing and checks again.
+ * interned strings are never freed before the pool.
+ *
+ * build: cc -std=c11 -O2 adt_string_intern.c -lpthread
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "container_stats.h"
+
+#define STRING_INTERN_MIN_BUCKET_SIZE   64
+#define STRING_INTERN_ARENA_CHUNK_SIZE  (64 * 1024)
+#define STRING_INTERN_ID_BASE_BITS      10   /* the first id segment holds 1024 strings, then it doubles. */
+#define STRING_INTERN_ID_SEGMENTS       (32 - STRING_INTERN_ID_BASE_BITS + 1)
+
+typedef uint32_t HashType;
+typedef struct InternedString InternedString;
+typedef struct StringInternArenaChunk StringInternArenaChunk;
+typedef struct StringInternShard StringInternShard;
+typedef struct StringInternPool StringInternPool;
+typedef _Atomic(InternedString*) InternedStringSlot;   /* ById reads it without the shard lock. */
+
+struct InternedString {
+    InternedString* next;   /* bucket chain. */
+    HashType hash;
+    uint32_t length;
+    uint32_t id;
+    char data[];            /* '\0' terminated, this is what the pool hands out. */
+};
+
+struct StringInternArenaChunk {
+    StringInternArenaChunk* next;
+    size_t used;
+    size_t size;
+    _Alignas(InternedString) char data[];
+};
+
+struct StringInternShard {
+    pthread_rwlock_t lock;
+    InternedString** bucket;
+    size_t bucketMask;
+    size_t length;
+    StringInternArenaChunk* chunk;   /* the one being filled, older ones follow. */
+    size_t arenaBytes;
+    CONTAINER_STATS_FIELD(stats)     /* write lock only: inserts, arena chunks, id segments, grows. */
+    char padding[64];                /* keep neighbouring shard locks off the same cache line. */
+};
+
+struct StringInternPool {
+    StringInternShard* shards;
+    size_t shardCount;
+    unsigned int shardBits;
+
+    atomic_uint_least32_t nextId;
+    pthread_mutex_t segmentLock;
+    _Atomic(InternedStringSlot*) segments[STRING_INTERN_ID_SEGMENTS];   /* id -> string. */
+};
+
+/* everything below takes a pointer returned by the pool. */
+#define InternedString_Of(strPtr)       ((const InternedString*)((const char*)(strPtr) - offsetof(InternedString, data)))
+#define InternedString_Length(strPtr)   (InternedString_Of(strPtr)->length)
+#define InternedString_Hash(strPtr)     (InternedString_Of(strPtr)->hash)
+#define InternedString_Id(strPtr)       (InternedString_Of(strPtr)->id)
+
+#define StringInternPool_ShardCount(poolPtr)   ((poolPtr)->shardCount)
+#define StringInternPool_Length(poolPtr)       ((size_t)atomic_load_explicit(&(poolPtr)->nextId, memory_order_relaxed))
+
+/* FNV-1a, then a final mix so both the high (shard) and low (bucket) bits are usable. */
+HashType string_intern_hash(const char* str, size_t len) {
+    HashType h = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        h ^= (unsigned char)str[i];
+        h *= 16777619u;
+    }
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static StringInternShard* StringInternPool_ShardOf(StringInternPool* pool, HashType hash) {
+    return &pool->shards[pool->shardBits == 0 ? 0 : hash >> (32 - pool->shardBits)];
+}
+
+/* shardCount is rounded up to a power of 2. */
+StringInternPool* StringInternPool_CreateNew(size_t shardCount) {
+    StringInternPool* pool;
+    StringInternShard* shard;
+    size_t i;
+
+    if ((pool = (StringInternPool*)malloc(sizeof(StringInternPool))) == NULL) {
+        return NULL;
+    }
+
+    pool->shardCount = 1;
+    pool->shardBits = 0;
+    while (pool->shardCount < shardCount && pool->shardBits < 16) {
+        pool->shardCount *= 2;
+        pool->shardBits += 1;
+    }
+
+    if ((pool->shards = (StringInternShard*)malloc(pool->shardCount * sizeof(StringInternShard))) == NULL) {
+        free(pool);
+        return NULL;
+    }
+
+    for (i = 0; i < pool->shardCount; ++i) {
+        shard = &pool->shards[i];
+        shard->bucketMask = STRING_INTERN_MIN_BUCKET_SIZE - 1;
+
+        if ((shard->bucket = (InternedString**)calloc(STRING_INTERN_MIN_BUCKET_SIZE, sizeof(InternedString*))) == NULL) {
+            while (i-- > 0) {
+                pthread_rwlock_destroy(&pool->shards[i].lock);
+                free(pool->shards[i].bucket);
+            }
+
+            free(pool->shards);
+            free(pool);
+            return NULL;
+        }
+
+        pthread_rwlock_init(&shard->lock, NULL);
+        shard->length = 0;
+        shard->chunk = NULL;
+        shard->arenaBytes = 0;
+        ContainerStats_Init(&shard->stats, "StringInternPool");
+        ContainerStats_OnAlloc(&shard->stats, STRING_INTERN_MIN_BUCKET_SIZE * sizeof(InternedString*));
+    }
+
+    atomic_init(&pool->nextId, 0);
+    pthread_mutex_init(&pool->segmentLock, NULL);
+    for (i = 0; i < STRING_INTERN_ID_SEGMENTS; ++i) {
+        atomic_init(&pool->segments[i], NULL);
+    }
+
+    return pool;
+}
+
+void StringInternPool_Destroy(StringInternPool* pool) {
+    StringInternArenaChunk* chunk;
+    StringInternArenaChunk* next;
+    size_t i;
+
+    for (i = 0; i < pool->shardCount; ++i) {
+        for (chunk = pool->shards[i].chunk; chunk != NULL; chunk = next) {
+            next = chunk->next;
+            free(chunk);
+        }
+
+        free(pool->shards[i].bucket);
+        pthread_rwlock_destroy(&pool->shards[i].lock);
+    }
+
+    for (i = 0; i < STRING_INTERN_ID_SEGMENTS; ++i) {
+        free((void*)atomic_load_explicit(&pool->segments[i], memory_order_relaxed));
+    }
+
+    pthread_mutex_destroy(&pool->segmentLock);
+    free(pool->shards);
+    free(pool);
+}
+
+/* segment and offset of an id: segment k holds ids [2^(k+B) - 2^B, 2^(k+B+1) - 2^B). */
+static void StringInternPool_IdSlot(uint32_t id, size_t* segment, size_t* offset) {
+    uint64_t biased = (uint64_t)id + ((uint64_t)1 << STRING_INTERN_ID_BASE_BITS);
+    size_t bit = 63;
+
+    while ((biased >> bit) == 0) {
+        bit -= 1;
+    }
+
+    *segment = bit - STRING_INTERN_ID_BASE_BITS;
+    *offset = (size_t)(biased - ((uint64_t)1 << bit));
+}
+
+/* called with the write lock of shard held, the segment is counted there. */
+static InternedStringSlot* StringInternPool_Segment(StringInternPool* pool, StringInternShard* shard, size_t segment) {
+    InternedStringSlot* slots = atomic_load_explicit(&pool->segments[segment], memory_order_acquire);
+
+    (void)shard;   /* only counted with CONTAINER_STATS. */
+
+    if (slots == NULL) {
+        pthread_mutex_lock(&pool->segmentLock);
+
+        if ((slots = atomic_load_explicit(&pool->segments[segment], memory_order_relaxed)) == NULL) {
+            slots = (InternedStringSlot*)calloc((size_t)1 << (segment + STRING_INTERN_ID_BASE_BITS), sizeof(InternedStringSlot));   /* all zero bytes: every slot NULL. */
+            atomic_store_explicit(&pool->segments[segment], slots, memory_order_release);
+
+            if (slots != NULL) {
+                ContainerStats_OnAlloc(&shard->stats, ((size_t)1 << (segment + STRING_INTERN_ID_BASE_BITS)) * sizeof(InternedStringSlot));
+            }
+        }
+
+        pthread_mutex_unlock(&pool->segmentLock);
+    }
+
+    return slots;
+}
+
+/* bump allocation from the shard's arena, called with the write lock held. */
+static InternedString* StringInternShard_Alloc(StringInternShard* shard, size_t len) {
+    size_t bytes = (offsetof(InternedString, data) + len + 1 + _Alignof(InternedString) - 1) / _Alignof(InternedString) * _Alignof(InternedString);
+    size_t chunkSize;
+    StringInternArenaChunk* chunk = shard->chunk;
+
+    if (chunk == NULL || chunk->size - chunk->used < bytes) {
+        chunkSize = bytes > STRING_INTERN_ARENA_CHUNK_SIZE ? bytes : STRING_INTERN_ARENA_CHUNK_SIZE;
+
+        if ((chunk = (StringInternArenaChunk*)malloc(sizeof(StringInternArenaChunk) + chunkSize)) == NULL) {
+            return NULL;
+        }
+
+        chunk->used = 0;
+        chunk->size = chunkSize;
+
+        /* an oversized string gets its own chunk behind the current one, which keeps filling. */
+        if (shard->chunk != NULL && bytes > STRING_INTERN_ARENA_CHUNK_SIZE) {
+            chunk->next = shard->chunk->next;
+            shard->chunk->next = chunk;
+        }
+        else {
+            chunk->next = shard->chunk;
+            shard->chunk = chunk;
+        }
+
+        shard->arenaBytes += sizeof(StringInternArenaChunk) + chunkSize;
+        ContainerStats_OnAlloc(&shard->stats, sizeof(StringInternArenaChunk) + chunkSize);
+    }
+
+    chunk->used += bytes;
+    return (InternedString*)(chunk->data + chunk->used - bytes);
+}
+
+static void StringInternShard_GrowBuckets(StringInternShard* shard) {
+    size_t newMask = 2 * shard->bucketMask + 1;
+    InternedString** bucket = (InternedString**)calloc(newMask + 1, sizeof(InternedString*));
+    InternedString* entry;
+    InternedString* next;
+    size_t i;
+
+    if (bucket == NULL) {
+        return;   /* keep the longer chains. */
+    }
+
+    for (i = 0; i <= shard->bucketMask; ++i) {
+        for (entry = shard->bucket[i]; entry != NULL; entry = next) {
+            next = entry->next;
+            entry->next = bucket[entry->hash & newMask];
+            bucket[entry->hash & newMask] = entry;
+        }
+    }
+
+    ContainerStats_OnGrow(&shard->stats, (shard->bucketMask + 1) * sizeof(InternedString*), (newMask + 1) * sizeof(InternedString*));
+    free(shard->bucket);
+    shard->bucket = bucket;
+    shard->bucketMask = newMask;
+}
+
+static InternedString* StringInternShard_Search(StringInternShard* shard, HashType hash, const char* str, size_t len) {
+    InternedString* entry;
+
+    for (entry = shard->bucket[hash & shard->bucketMask]; entry != NULL; entry = entry->next) {
+        if (entry->hash == hash && entry->length == len && memcmp(entry->data, str, len) == 0) {
+            break;
+        }
+    }
+
+    return entry;
+}
+
+/* the interned string if it is already in the pool, NULL otherwise. never inserts. */
+const char* StringInternPool_Find(StringInternPool* pool, const char* str, size_t len) {
+    HashType hash = string_intern_hash(str, len);
+    StringInternShard* shard = StringInternPool_ShardOf(pool, hash);
+    InternedString* entry;
+
+    pthread_rwlock_rdlock(&shard->lock);
+    entry = StringInternShard_Search(shard, hash, str, len);
+    pthread_rwlock_unlock(&shard->lock);
+
+    return entry != NULL ? entry->data : NULL;
+}
+
+/**
+ * lookup-or-insert, safe to call from any number of threads. str does not need a '\0', the returned
+ * copy always has one. NULL only when out of memory.
+ */
+const char* StringInternPool_Intern(StringInternPool* pool, const char* str, size_t len) {
+    HashType hash = string_intern_hash(str, len);
+    StringInternShard* shard = StringInternPool_ShardOf(pool, hash);
+    InternedString* entry;
+    InternedStringSlot* slots;
+    size_t segment, offset;
+    uint32_t id;
+
+    pthread_rwlock_rdlock(&shard->lock);
+    entry = StringInternShard_Search(shard, hash, str, len);
+    pthread_rwlock_unlock(&shard->lock);
+
+    if (entry != NULL) {
+        return entry->data;
+    }
+
+    pthread_rwlock_wrlock(&shard->lock);
+    ContainerStats_OpBegin(&shard->stats, opBegin);   /* hits under the read lock are not counted. */
+
+    /* another thread may have inserted it between the two locks. */
+    if ((entry = StringInternShard_Search(shard, hash, str, len)) == NULL && len <= UINT32_MAX) {
+        if ((entry = StringInternShard_Alloc(shard, len)) != NULL) {
+            /* the id is claimed only once its segment exists, out of memory leaves nextId as it was. */
+            id = atomic_load_explicit(&pool->nextId, memory_order_relaxed);
+            do {
+                StringInternPool_IdSlot(id, &segment, &offset);
+
+                if ((slots = StringInternPool_Segment(pool, shard, segment)) == NULL) {
+                    break;
+                }
+            } while (!atomic_compare_exchange_weak_explicit(&pool->nextId, &id, id + 1, memory_order_relaxed, memory_order_relaxed));
+
+            if (slots == NULL) {
+                entry = NULL;   /* the arena bytes are reused by nobody. */
+            }
+            else {
+                entry->hash = hash;
+                entry->length = (uint32_t)len;
+                entry->id = id;
+                memcpy(entry->data, str, len);
+                entry->data[len] = '\0';
+                atomic_store_explicit(&slots[offset], entry, memory_order_release);   /* publishes the bytes above to ById. */
+
+                entry->next = shard->bucket[hash & shard->bucketMask];
+                shard->bucket[hash & shard->bucketMask] = entry;
+                shard->length += 1;
+
+                if (shard->length > shard->bucketMask + 1) {
+                    StringInternShard_GrowBuckets(shard);
+                }
+            }
+        }
+    }
+
+    ContainerStats_OpEnd(&shard->stats, opBegin);
+    pthread_rwlock_unlock(&shard->lock);
+    return entry != NULL ? entry->data : NULL;
+}
+
+const char* StringInternPool_InternCStr(StringInternPool* pool, const char* str) {
+    return StringInternPool_Intern(pool, str, strlen(str));
+}
+
+/* the string of an id returned by the pool (InternedString_Id). */
+const char* StringInternPool_ById(StringInternPool* pool, uint32_t id) {
+    size_t segment, offset;
+    InternedStringSlot* slots;
+    InternedString* entry;
+
+    if (id >= atomic_load_explicit(&pool->nextId, memory_order_relaxed)) {
+        return NULL;
+    }
+
+    StringInternPool_IdSlot(id, &segment, &offset);
+    if ((slots = atomic_load_explicit(&pool->segments[segment], memory_order_acquire)) == NULL) {
+        return NULL;
+    }
+
+    entry = atomic_load_explicit(&slots[offset], memory_order_acquire);
+    return entry != NULL ? entry->data : NULL;
+}
+
+/* bytes held by the arenas, headers included. */
+size_t StringInternPool_ArenaBytes(StringInternPool* pool) {
+    size_t i, bytes = 0;
+
+    for (i = 0; i < pool->shardCount; ++i) {
+        pthread_rwlock_rdlock(&pool->shards[i].lock);
+        bytes += pool->shards[i].arenaBytes;
+        pthread_rwlock_unlock(&pool->shards[i].lock);
+    }
+
+    return bytes;
+}
+
+#ifdef CONTAINER_STATS
+/**
+ * the counters of every shard added up, and the chain length histogram of the current buckets.
+ * only inserts are sampled: a hit runs under the read lock, next to other readers.
+ */
+void StringInternPool_GetStats(StringInternPool* pool, ContainerStats* out) {
+    StringInternShard* shard;
+    InternedString* entry;
+    size_t i, b, len;
+
+    ContainerStats_Init(out, "StringInternPool");
+
+    for (i = 0; i < pool->shardCount; ++i) {
+        shard = &pool->shards[i];
+        pthread_rwlock_rdlock(&shard->lock);
+        ContainerStats_Merge(out, &shard->stats);
+
+        for (b = 0; b <= shard->bucketMask; ++b) {
+            len = 0;
+            for (entry = shard->bucket[b]; entry != NULL; entry = entry->next) {
+                len += 1;
+            }
+
+            ContainerStats_OnChain(out, len);
+        }
+
+        pthread_rwlock_unlock(&shard->lock);
+    }
+}
+#endif
+
+/* usage. */
+#define BENCH_THREAD_COUNT   4
+#define BENCH_VOCABULARY     200000
+#define BENCH_OPS_PER_THREAD 2000000
+
+typedef struct BenchContext {
+    StringInternPool* pool;
+    char (*words)[16];
+    unsigned int seed;
+    size_t mismatches;
+} BenchContext;
+
+void* bench_routine(void* arg) {
+    BenchContext* ctx = (BenchContext*)arg;
+    uint64_t x = ctx->seed;
+    const char* interned;
+    size_t i, w;
+
+    for (i = 0; i < BENCH_OPS_PER_THREAD; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        w = (size_t)(x % BENCH_VOCABULARY);
+
+        interned = StringInternPool_InternCStr(ctx->pool, ctx->words[w]);
+
+        /* every thread must agree on the pointer, and the id must lead back to it. */
+        if (strcmp(interned, ctx->words[w]) != 0 || StringInternPool_ById(ctx->pool, InternedString_Id(interned)) != interned) {
+            ctx->mismatches += 1;
+        }
+    }
+
+    return NULL;
+}
+
+void bench(size_t shardCount) {
+    StringInternPool* pool = StringInternPool_CreateNew(shardCount);
+    char (*words)[16] = (char (*)[16])malloc(BENCH_VOCABULARY * sizeof(*words));
+    pthread_t threads[BENCH_THREAD_COUNT];
+    BenchContext ctx[BENCH_THREAD_COUNT];
+    struct timespec begin, end;
+    size_t i, mismatches = 0;
+    double seconds;
+
+    for (i = 0; i < BENCH_VOCABULARY; ++i) {
+        snprintf(words[i], sizeof(words[i]), "tok_%zu", i * 7919);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < BENCH_THREAD_COUNT; ++i) {
+        ctx[i].pool = pool;
+        ctx[i].words = words;
+        ctx[i].seed = 0x9e3779b9u * (unsigned int)(i + 1);
+        ctx[i].mismatches = 0;
+        pthread_create(&threads[i], NULL, bench_routine, &ctx[i]);
+    }
+
+    for (i = 0; i < BENCH_THREAD_COUNT; ++i) {
+        pthread_join(threads[i], NULL);
+        mismatches += ctx[i].mismatches;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (double)(end.tv_sec - begin.tv_sec) + (double)(end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    printf("%2zu shard(s), %d threads: %.2f M interns/s, %zu distinct, %zu arena bytes, %zu mismatches\n",
+           StringInternPool_ShardCount(pool), BENCH_THREAD_COUNT, BENCH_THREAD_COUNT * BENCH_OPS_PER_THREAD / seconds / 1e6,
+           StringInternPool_Length(pool), StringInternPool_ArenaBytes(pool), mismatches);
+
+    free(words);
+    StringInternPool_Destroy(pool);
+}
+
+int main() {
+    const char* text[] = { "the", "quick", "fox", "jumps", "over", "the", "lazy", "dog", "the", "fox" };
+    StringInternPool* pool = StringInternPool_CreateNew(8);
+    size_t counts[16] = { 0 };   /* ids are dense, a plain array works as a map. */
+    const char* word;
+    char buffer[8];
+    size_t i;
+
+    for (i = 0; i < sizeof(text) / sizeof(text[0]); ++i) {
+        word = StringInternPool_InternCStr(pool, text[i]);
+        counts[InternedString_Id(word)] += 1;
+    }
+
+    for (i = 0; i < StringInternPool_Length(pool); ++i) {
+        word = StringInternPool_ById(pool, (uint32_t)i);
+        printf("%u '%s' (len %u): %zu\n", InternedString_Id(word), word, InternedString_Length(word), counts[i]);
+    }
+
+    /* the same bytes from another buffer give the same pointer, so == replaces strcmp. */
+    memcpy(buffer, "fox", 4);
+    printf("same pointer: %d\n", StringInternPool_InternCStr(pool, buffer) == StringInternPool_Find(pool, "fox", 3));
+    printf("not interned: %p\n", (void*)StringInternPool_Find(pool, "cat", 3));
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    StringInternPool_GetStats(pool, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
+    StringInternPool_Destroy(pool);
+
+    bench(1);
+    bench(16);
+    return 0;
+}
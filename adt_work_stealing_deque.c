@@ -0,0 +1,342 @@
+/**
+ * Chase-Lev work-stealing deque, written with C11 atomics (the memory orders follow
+ * "Correct and Efficient Work-Stealing for Weak Memory Models", Le et al. 2013).
+ *
+ * the owner thread pushes and pops at the bottom, any other thread may steal from the top.
+ * the ring buffer grows on demand, retired buffers are kept alive until the deque is
+ * destroyed, because a thief may still be reading from them.
+ *
+ * build: cc -std=c11 -O2 adt_work_stealing_deque.c -lpthread
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "container_stats.h"
+
+#define WORK_STEALING_DEQUE_EMPTY     0
+#define WORK_STEALING_DEQUE_SUCCESS   1
+#define WORK_STEALING_DEQUE_ABORT     2   /* lost a race against another thread, try again. */
+
+typedef struct WorkStealingDequeBuffer WorkStealingDequeBuffer;
+typedef struct WorkStealingDeque WorkStealingDeque;
+
+struct WorkStealingDequeBuffer {
+    WorkStealingDequeBuffer* retired;   /* the smaller buffer this one replaced. */
+    int64_t mask;                       /* capacity - 1, capacity is a power of 2. */
+    _Atomic(void*) data[];
+};
+
+struct WorkStealingDeque {
+    _Alignas(64) atomic_int_least64_t top;
+    _Alignas(64) atomic_int_least64_t bottom;
+    _Atomic(WorkStealingDequeBuffer*) buffer;
+
+    CONTAINER_STATS_FIELD(stats)   /* owner side only: buffer allocations and grows. */
+};
+
+#define WorkStealingDeque_Capacity(dqPtr) \
+    (atomic_load_explicit(&(dqPtr)->buffer, memory_order_relaxed)->mask + 1)
+
+WorkStealingDequeBuffer* WorkStealingDequeBuffer_CreateNew(int64_t capacity) {
+    WorkStealingDequeBuffer* buf = (WorkStealingDequeBuffer*)malloc(sizeof(WorkStealingDequeBuffer) + capacity * sizeof(_Atomic(void*)));
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    buf->retired = NULL;
+    buf->mask = capacity - 1;
+    return buf;
+}
+
+WorkStealingDeque* WorkStealingDeque_CreateNew(size_t capacity) {
+    int64_t realCapacity = 16;
+    while ((size_t)realCapacity < capacity) {
+        realCapacity *= 2;
+    }
+
+    WorkStealingDeque* dq = (WorkStealingDeque*)malloc(sizeof(WorkStealingDeque));
+    if (dq == NULL) {
+        return NULL;
+    }
+
+    WorkStealingDequeBuffer* buf = WorkStealingDequeBuffer_CreateNew(realCapacity);
+    if (buf == NULL) {
+        free(dq);
+        return NULL;
+    }
+
+    atomic_init(&dq->top, 0);
+    atomic_init(&dq->bottom, 0);
+    atomic_init(&dq->buffer, buf);
+    ContainerStats_Init(&dq->stats, "WorkStealingDeque");
+    ContainerStats_OnAlloc(&dq->stats, realCapacity * sizeof(_Atomic(void*)));
+    return dq;
+}
+
+/* only call this when no other thread touches the deque anymore. */
+void WorkStealingDeque_Destroy(WorkStealingDeque* dq) {
+    WorkStealingDequeBuffer* buf = atomic_load_explicit(&dq->buffer, memory_order_relaxed);
+    WorkStealingDequeBuffer* retired;
+
+    while (buf != NULL) {
+        retired = buf->retired;
+        free(buf);
+        buf = retired;
+    }
+
+    free(dq);
+}
+
+/* approximate when called concurrently, exact from the owner when no thief is running. */
+size_t WorkStealingDeque_Length(WorkStealingDeque* dq) {
+    int64_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+    return (b > t) ? (size_t)(b - t) : 0;
+}
+
+/* owner only. */
+static WorkStealingDequeBuffer* WorkStealingDeque_Grow(WorkStealingDeque* dq, WorkStealingDequeBuffer* old, int64_t top, int64_t bottom) {
+    WorkStealingDequeBuffer* buf = WorkStealingDequeBuffer_CreateNew(2 * (old->mask + 1));
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    int64_t i;
+    for (i = top; i < bottom; ++i) {
+        atomic_store_explicit(&buf->data[i & buf->mask],
+                              atomic_load_explicit(&old->data[i & old->mask], memory_order_relaxed),
+                              memory_order_relaxed);
+    }
+
+    buf->retired = old;
+    atomic_store_explicit(&dq->buffer, buf, memory_order_release);
+    ContainerStats_OnGrow(&dq->stats, 0, 2 * (old->mask + 1) * sizeof(_Atomic(void*)));   /* the old buffer stays alive. */
+    return buf;
+}
+
+/* owner only, return 0 when out of memory. */
+int WorkStealingDeque_PushBottom(WorkStealingDeque* dq, void* elem) {
+    int64_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    WorkStealingDequeBuffer* buf = atomic_load_explicit(&dq->buffer, memory_order_relaxed);
+
+    if (b - t > buf->mask) {
+        if ((buf = WorkStealingDeque_Grow(dq, buf, t, b)) == NULL) {
+            return 0;
+        }
+    }
+
+    atomic_store_explicit(&buf->data[b & buf->mask], elem, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+    return 1;
+}
+
+/* owner only, return WORK_STEALING_DEQUE_EMPTY or WORK_STEALING_DEQUE_SUCCESS. */
+int WorkStealingDeque_PopBottom(WorkStealingDeque* dq, void** elem) {
+    int64_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+    WorkStealingDequeBuffer* buf = atomic_load_explicit(&dq->buffer, memory_order_relaxed);
+    atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+    int ret = WORK_STEALING_DEQUE_SUCCESS;
+
+    if (t <= b) {
+        *elem = atomic_load_explicit(&buf->data[b & buf->mask], memory_order_relaxed);
+
+        if (t == b) {   /* last element, race against the thieves. */
+            if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+                ret = WORK_STEALING_DEQUE_EMPTY;
+            }
+
+            atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+        }
+    }
+    else {
+        ret = WORK_STEALING_DEQUE_EMPTY;
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+    }
+
+    return ret;
+}
+
+/* any thread, return WORK_STEALING_DEQUE_EMPTY, WORK_STEALING_DEQUE_SUCCESS or WORK_STEALING_DEQUE_ABORT. */
+int WorkStealingDeque_Steal(WorkStealingDeque* dq, void** elem) {
+    int64_t t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+
+    if (t >= b) {
+        return WORK_STEALING_DEQUE_EMPTY;
+    }
+
+    WorkStealingDequeBuffer* buf = atomic_load_explicit(&dq->buffer, memory_order_acquire);
+    void* data = atomic_load_explicit(&buf->data[t & buf->mask], memory_order_relaxed);
+
+    if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return WORK_STEALING_DEQUE_ABORT;
+    }
+
+    *elem = data;
+    return WORK_STEALING_DEQUE_SUCCESS;
+}
+
+#ifdef CONTAINER_STATS
+/* owner only. */
+void WorkStealingDeque_GetStats(WorkStealingDeque* dq, ContainerStats* out) {
+    *out = dq->stats;
+}
+#endif
+
+/* usage: stress test and steal-throughput benchmark. */
+#define THIEF_COUNT        3
+#define STRESS_TASK_COUNT  1000000
+#define BENCH_TASK_COUNT   4000000
+
+typedef struct ThiefContext {
+    WorkStealingDeque* dq;
+    atomic_int* done;
+    unsigned char* seen;   /* stress test only. */
+    size_t stolen;
+} ThiefContext;
+
+void* thief_routine(void* arg) {
+    ThiefContext* ctx = (ThiefContext*)arg;
+    void* elem;
+    int ret;
+
+    while (1) {
+        ret = WorkStealingDeque_Steal(ctx->dq, &elem);
+
+        if (ret == WORK_STEALING_DEQUE_SUCCESS) {
+            if (ctx->seen != NULL) {
+                ctx->seen[(size_t)(uintptr_t)elem - 1] += 1;
+            }
+
+            ctx->stolen += 1;
+        }
+        else if (ret == WORK_STEALING_DEQUE_EMPTY && atomic_load(ctx->done)) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+double elapsed_seconds(const struct timespec* begin, const struct timespec* end) {
+    return (double)(end->tv_sec - begin->tv_sec) + (double)(end->tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+int stress_test(void) {
+    WorkStealingDeque* dq = WorkStealingDeque_CreateNew(0);   /* start small to exercise growing. */
+    unsigned char* seen = (unsigned char*)calloc(STRESS_TASK_COUNT, sizeof(unsigned char));
+    atomic_int done;
+    pthread_t thieves[THIEF_COUNT];
+    ThiefContext ctx[THIEF_COUNT];
+    size_t i, popped = 0, total = 0, failures = 0;
+    void* elem;
+
+    atomic_init(&done, 0);
+    for (i = 0; i < THIEF_COUNT; ++i) {
+        ctx[i].dq = dq;
+        ctx[i].done = &done;
+        ctx[i].seen = seen;
+        ctx[i].stolen = 0;
+        pthread_create(&thieves[i], NULL, thief_routine, &ctx[i]);
+    }
+
+    /* push in bursts, pop part of every burst, like a scheduler spawning and running tasks. */
+    for (i = 1; i <= STRESS_TASK_COUNT; ++i) {
+        WorkStealingDeque_PushBottom(dq, (void*)(uintptr_t)i);
+
+        if (i % 4096 == 0) {
+            while (WorkStealingDeque_Length(dq) > 1024 && WorkStealingDeque_PopBottom(dq, &elem) == WORK_STEALING_DEQUE_SUCCESS) {
+                seen[(size_t)(uintptr_t)elem - 1] += 1;
+                popped += 1;
+            }
+        }
+    }
+
+    while (WorkStealingDeque_PopBottom(dq, &elem) == WORK_STEALING_DEQUE_SUCCESS) {
+        seen[(size_t)(uintptr_t)elem - 1] += 1;
+        popped += 1;
+    }
+
+    atomic_store(&done, 1);
+    for (i = 0; i < THIEF_COUNT; ++i) {
+        pthread_join(thieves[i], NULL);
+        total += ctx[i].stolen;
+    }
+
+    total += popped;
+    for (i = 0; i < STRESS_TASK_COUNT; ++i) {
+        if (seen[i] != 1) {
+            failures += 1;
+        }
+    }
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    WorkStealingDeque_GetStats(dq, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
+    printf("stress: %zu tasks, %zu popped, %zu stolen, final capacity %lld, %s\n",
+           (size_t)STRESS_TASK_COUNT, popped, total - popped, (long long)WorkStealingDeque_Capacity(dq),
+           (failures == 0 && total == STRESS_TASK_COUNT) ? "ok" : "FAILED");
+
+    free(seen);
+    WorkStealingDeque_Destroy(dq);
+    return failures == 0 && total == STRESS_TASK_COUNT;
+}
+
+void steal_benchmark(void) {
+    WorkStealingDeque* dq = WorkStealingDeque_CreateNew(BENCH_TASK_COUNT);
+    atomic_int done;
+    pthread_t thieves[THIEF_COUNT];
+    ThiefContext ctx[THIEF_COUNT];
+    struct timespec begin, end;
+    size_t i, stolen = 0;
+
+    for (i = 1; i <= BENCH_TASK_COUNT; ++i) {
+        WorkStealingDeque_PushBottom(dq, (void*)(uintptr_t)i);
+    }
+
+    atomic_init(&done, 1);   /* thieves stop as soon as the deque is drained. */
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < THIEF_COUNT; ++i) {
+        ctx[i].dq = dq;
+        ctx[i].done = &done;
+        ctx[i].seen = NULL;
+        ctx[i].stolen = 0;
+        pthread_create(&thieves[i], NULL, thief_routine, &ctx[i]);
+    }
+
+    for (i = 0; i < THIEF_COUNT; ++i) {
+        pthread_join(thieves[i], NULL);
+        stolen += ctx[i].stolen;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("bench: %d thieves stole %zu tasks in %.3f s, %.2f M steals/s\n",
+           THIEF_COUNT, stolen, elapsed_seconds(&begin, &end), stolen / elapsed_seconds(&begin, &end) / 1e6);
+
+    WorkStealingDeque_Destroy(dq);
+}
+
+int main() {
+    if (!stress_test()) {
+        return 1;
+    }
+
+    steal_benchmark();
+    return 0;
+}
@@ -0,0 +1,703 @@
+/**
+ * benchmark runner over the containers of this repo, with hardware counters per operation
+ * (perf_counters.h): the same workloads on the void* and the elemSize variants side by side, so a
+ * gap in ns per op comes with the cycles, cache, branch and TLB misses that explain it.
+ *
+ * every container source is compiled into this file, its own demo main() and helpers are renamed
+ * on the way in by prefixing them with BENCH_PREFIX.
+ *
+ * usage: bench_perf [-n ops] [-r repeats] [-c cpu] [-f filter] [-s save.txt] [-b baseline.txt] [-t percent]
+ *   -n   elements per workload (default 100000)
+ *   -r   runs per workload, the fastest one is kept (default 3)
+ *   -c   pin to this cpu
+ *   -f   only run workloads whose name contains filter
+ *   -s   write the results as a baseline
+ *   -b   compare against a baseline, exit status 1 on a regression
+ *   -t   regression threshold in percent (default 10)
+ *
+ * build: cc -std=c11 -O2 bench_perf.c
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "perf_counters.h"
+
+#define BENCH_CAT_(a, b)   a##b
+#define BENCH_CAT(a, b)    BENCH_CAT_(a, b)
+
+#define main                  BENCH_CAT(BENCH_PREFIX, _main)
+#define bench                 BENCH_CAT(BENCH_PREFIX, _bench)
+#define seconds_since         BENCH_CAT(BENCH_PREFIX, _seconds_since)
+#define compare_uintptr       BENCH_CAT(BENCH_PREFIX, _compare_uintptr)
+#define compare_c_style_str   BENCH_CAT(BENCH_PREFIX, _compare_c_style_str)
+#define hash_uintptr          BENCH_CAT(BENCH_PREFIX, _hash_uintptr)
+#define elapsed_seconds       BENCH_CAT(BENCH_PREFIX, _elapsed_seconds)
+#define stress_test           BENCH_CAT(BENCH_PREFIX, _stress_test)
+#define stress_routine        BENCH_CAT(BENCH_PREFIX, _stress_routine)
+#define bench_routine         BENCH_CAT(BENCH_PREFIX, _bench_routine)
+#define reader_routine        BENCH_CAT(BENCH_PREFIX, _reader_routine)
+#define StressContext         BENCH_CAT(BENCH_PREFIX, _StressContext)
+#define BenchContext          BENCH_CAT(BENCH_PREFIX, _BenchContext)
+#define ReaderContext         BENCH_CAT(BENCH_PREFIX, _ReaderContext)
+
+#define BENCH_PREFIX array
+#include "adt_array.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX generic_array
+#include "void_ptr_array.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX dlist
+#include "adt_dlist.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX generic_dlist
+#include "void_ptr_doubly_linked_list.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX hashmap
+#include "adt_hashmap.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX generic_hash_table
+#include "void_ptr_hash_table.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX compact_hashmap
+#include "adt_compact_hashmap.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX cuckoo
+#include "void_ptr_cuckoo_hash_table.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX slot_map
+#include "void_ptr_slot_map.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX priority_queue
+#include "adt_priority_queue.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX bitset
+#include "adt_bitset.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX work_stealing_deque
+#include "adt_work_stealing_deque.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX lru_cache
+#include "adt_lru_cache.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX persistent_hashmap
+#include "adt_persistent_hashmap.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX string_intern
+#include "adt_string_intern.c"
+#undef BENCH_PREFIX
+
+/* these two demos size their runs with names already taken above. */
+#undef BENCH_KEYS
+#undef BENCH_OPS_PER_THREAD
+
+#define BENCH_PREFIX radix_tree
+#include "adt_radix_tree.c"
+#undef BENCH_PREFIX
+
+#define BENCH_PREFIX skiplist
+#include "adt_concurrent_skiplist.c"
+#undef BENCH_PREFIX
+
+#undef main
+#undef bench
+#undef seconds_since
+#undef compare_uintptr
+#undef compare_c_style_str
+#undef hash_uintptr
+#undef elapsed_seconds
+#undef stress_test
+#undef stress_routine
+#undef bench_routine
+#undef reader_routine
+#undef StressContext
+#undef BenchContext
+#undef ReaderContext
+
+#define BENCH_MAX_RESULTS   64
+
+/* runner state, the workloads call Bench_Begin / Bench_End around what they measure. */
+typedef struct BenchRunner {
+    PerfCounters counters;
+    size_t n;
+    int repeats;
+    int repeat;                  /* the current run, 0 .. repeats - 1. */
+    const char* filter;
+    PerfBaseline* baseline;
+    double threshold;
+    int regressions;
+
+    const char* names[BENCH_MAX_RESULTS];
+    PerfSample samples[BENCH_MAX_RESULTS];
+    size_t length;
+} BenchRunner;
+
+static void Bench_Begin(BenchRunner* runner) {
+    PerfCounters_Start(&runner->counters);
+}
+
+/* keep the fastest run of each name. */
+static void Bench_End(BenchRunner* runner, const char* name, size_t ops) {
+    PerfSample sample;
+    size_t i;
+
+    PerfCounters_Stop(&runner->counters, ops, &sample);
+
+    for (i = 0; i < runner->length; ++i) {
+        if (strcmp(runner->names[i], name) == 0) {
+            if (sample.nsPerOp < runner->samples[i].nsPerOp) {
+                runner->samples[i] = sample;
+            }
+
+            return;
+        }
+    }
+
+    if (runner->length < BENCH_MAX_RESULTS) {
+        runner->names[runner->length] = name;
+        runner->samples[runner->length] = sample;
+        runner->length += 1;
+    }
+}
+
+/* the same pseudo random keys for every map, never 0. */
+static uint64_t bench_key(size_t i) {
+    uint64_t h = (uint64_t)(i + 1) * 0x9e3779b97f4a7c15ull;
+    return (h ^ (h >> 29)) | 1;
+}
+
+static HashType bench_hash_uintptr(void* key) {
+    return hash_interned_key(key);   /* pointer mix, modulo the HashMap bucket count. */
+}
+
+static int bench_compare_uintptr(void* left, void* right) {
+    return left != right;
+}
+
+static HashType bench_full_hash_uintptr(void* key) {
+    return (HashType)BloomFilter_Mix64((uint64_t)(uintptr_t)key);
+}
+
+#define BENCH_GENERIC_BUCKETS   65536
+
+static unsigned int bench_generic_hash_uint64(void* key) {
+    uint64_t k;
+    memcpy(&k, key, sizeof(k));
+    return (unsigned int)(BloomFilter_Mix64(k) % BENCH_GENERIC_BUCKETS);
+}
+
+static int bench_generic_compare_uint64(void* left, void* right) {
+    return memcmp(left, right, sizeof(uint64_t)) == 0;
+}
+
+static int bench_compare_priority(void* left, void* right) {
+    return ((uintptr_t)left > (uintptr_t)right) - ((uintptr_t)left < (uintptr_t)right);
+}
+
+static volatile uint64_t bench_sink;
+
+void bench_sequences(BenchRunner* runner) {
+    size_t n = runner->n, i;
+    uint64_t sum = 0, value;
+
+    Array* arr = Array_CreateNew(0, NULL);
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        Array_PushBack(arr, (void*)(uintptr_t)i);
+    }
+    Bench_End(runner, "Array/push_back", n);
+
+    Bench_Begin(runner);
+    Array_ForEach(arr, i) {
+        sum += (uintptr_t)Array_At(arr, i);
+    }
+    Bench_End(runner, "Array/iterate", n);
+    Array_Destroy(arr);
+
+    GenericArray* garr = GenericArray_CreateNew(0, sizeof(uint64_t), NULL);
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        value = i;
+        memcpy(GenericArray_PushBack(garr), &value, sizeof(value));
+    }
+    Bench_End(runner, "GenericArray/push_back", n);
+
+    Bench_Begin(runner);
+    GenericArray_ForEach(garr, i) {
+        sum += *(uint64_t*)GenericArray_At(garr, i);
+    }
+    Bench_End(runner, "GenericArray/iterate", n);
+    GenericArray_Destroy(garr);
+
+    DList* list = DList_CreateNew(NULL);
+    DListNode* node;
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        DList_PushBack(list, (void*)(uintptr_t)i);
+    }
+    Bench_End(runner, "DList/push_back", n);
+
+    Bench_Begin(runner);
+    DList_ForEach(list, node) {
+        sum += (uintptr_t)DList_NodeData(node);
+    }
+    Bench_End(runner, "DList/iterate", n);
+    DList_Destroy(list);
+
+    GenericDoublyList* glist = GenericDoublyList_CreateNew(sizeof(uint64_t), NULL);
+    GenericDoublyListNode* gnode;
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        value = i;
+        memcpy(GenericDoublyList_PushBack(glist), &value, sizeof(value));
+    }
+    Bench_End(runner, "GenericDoublyList/push_back", n);
+
+    Bench_Begin(runner);
+    GenericDoublyList_ForEach(glist, gnode) {
+        sum += *(uint64_t*)GenericDoublyList_NodeData(gnode);
+    }
+    Bench_End(runner, "GenericDoublyList/iterate", n);
+    GenericDoublyList_Destroy(glist);
+
+    GenericSlotMap* slots = GenericSlotMap_CreateNew(0, sizeof(uint64_t), NULL);
+    GenericSlotMapHandle handle;
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        value = i;
+        memcpy(GenericSlotMap_Insert(slots, &handle), &value, sizeof(value));
+    }
+    Bench_End(runner, "GenericSlotMap/insert", n);
+
+    Bench_Begin(runner);
+    GenericSlotMap_ForEach(slots, i) {
+        sum += *(uint64_t*)GenericSlotMap_At(slots, i);
+    }
+    Bench_End(runner, "GenericSlotMap/iterate", n);
+    GenericSlotMap_Destroy(slots);
+
+    bench_sink = sum;
+}
+
+void bench_maps(BenchRunner* runner) {
+    size_t n = runner->n, i, found = 0;
+    uint64_t key, value;
+
+    /* HashMap has a fixed 101 buckets, its lookups walk chains of n / 101 nodes. */
+    HashMap* hm = HashMap_CreateNew(bench_compare_uintptr, bench_hash_uintptr, NULL, NULL);
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        HashMap_Insert(hm, (void*)(uintptr_t)bench_key(i), NULL);
+    }
+    Bench_End(runner, "HashMap/insert", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        found += (HashMap_Find(hm, (void*)(uintptr_t)bench_key(i)) != NULL);
+    }
+    Bench_End(runner, "HashMap/find_hit", n);
+    HashMap_Destroy(hm);
+
+    GenericHashTable* ht = GenericHashTable_CreateNew(BENCH_GENERIC_BUCKETS, sizeof(uint64_t), sizeof(uint64_t),
+                                                      bench_generic_hash_uint64, bench_generic_compare_uint64, NULL, NULL);
+    GenericHashNode* hnode;
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        key = bench_key(i);
+        hnode = GenericHashTable_CreateNode(ht);
+        memcpy(GenericHashNode_Key(ht, hnode), &key, sizeof(key));
+        memcpy(GenericHashNode_Value(ht, hnode), &i, sizeof(i));
+        GenericHashTable_Set(ht, hnode);
+    }
+    Bench_End(runner, "GenericHashTable/insert", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        key = bench_key(i);
+        found += (GenericHashTable_Search(ht, &key) != NULL);
+    }
+    Bench_End(runner, "GenericHashTable/find_hit", n);
+    GenericHashTable_Destroy(ht);
+    free(ht->bucket);
+    free(ht);
+
+    CompactHashMap* cm = CompactHashMap_CreateNew(bench_compare_uintptr, bench_full_hash_uintptr, NULL, NULL);
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        CompactHashMap_Insert(cm, (void*)(uintptr_t)bench_key(i), NULL);
+    }
+    Bench_End(runner, "CompactHashMap/insert", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        found += (CompactHashMap_Find(cm, (void*)(uintptr_t)bench_key(i)) != NULL);
+    }
+    Bench_End(runner, "CompactHashMap/find_hit", n);
+    CompactHashMap_Destroy(cm);
+
+    GenericCuckooTable* ct = GenericCuckooTable_CreateNew(0, sizeof(uint64_t), sizeof(uint64_t), NULL, NULL, NULL);
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        key = bench_key(i);
+        value = i;
+        GenericCuckooTable_Insert(ct, &key, &value);
+    }
+    Bench_End(runner, "GenericCuckooTable/insert", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        key = bench_key(i);
+        found += (GenericCuckooTable_Find(ct, &key) != NULL);
+    }
+    Bench_End(runner, "GenericCuckooTable/find_hit", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        key = bench_key(i) + 1;   /* keys are odd, so this one is never there. */
+        found += (GenericCuckooTable_Find(ct, &key) != NULL);
+    }
+    Bench_End(runner, "GenericCuckooTable/find_miss", n);
+    GenericCuckooTable_Destroy(ct);
+
+    /* one thread, so one shard, and room for every key: the lookups measure hits, not evictions. */
+    LRUCache* lru = LRUCache_CreateNew(n, 1, bench_compare_uintptr, bench_full_hash_uintptr, NULL, NULL, NULL);
+    void* cached;
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        LRUCache_Put(lru, (void*)(uintptr_t)bench_key(i), NULL);
+    }
+    Bench_End(runner, "LRUCache/put", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        found += LRUCache_Get(lru, (void*)(uintptr_t)bench_key(i), &cached);
+    }
+    Bench_End(runner, "LRUCache/get_hit", n);
+    LRUCache_Destroy(lru);
+
+    /* every insert makes a new version and drops the previous one, as a single writer would. */
+    PersistentHashMap* pm = PersistentHashMap_CreateNew(bench_compare_uintptr, bench_full_hash_uintptr, NULL, NULL);
+    PersistentHashMap* next;
+    Bench_Begin(runner);
+    for (i = 0; i < n && pm != NULL; ++i) {
+        next = PersistentHashMap_Insert(pm, (void*)(uintptr_t)bench_key(i), NULL);
+        PersistentHashMap_Release(pm);
+        pm = next;
+    }
+    Bench_End(runner, "PersistentHashMap/insert", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n && pm != NULL; ++i) {
+        found += (PersistentHashMap_Find(pm, (void*)(uintptr_t)bench_key(i)) != NULL);
+    }
+    Bench_End(runner, "PersistentHashMap/find_hit", n);
+
+    if (pm != NULL) {
+        PersistentHashMap_Release(pm);
+    }
+
+    ConcurrentSkipList* sl = ConcurrentSkipList_CreateNew(bench_compare_priority, NULL, NULL);
+    ConcurrentSkipListThread* slt = ConcurrentSkipList_Attach(sl);
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        ConcurrentSkipList_Insert(sl, slt, (void*)(uintptr_t)bench_key(i), NULL);
+    }
+    Bench_End(runner, "ConcurrentSkipList/insert", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        found += ConcurrentSkipList_Find(sl, slt, (void*)(uintptr_t)bench_key(i), &cached);
+    }
+    Bench_End(runner, "ConcurrentSkipList/find_hit", n);
+    ConcurrentSkipList_Detach(sl, slt);
+    ConcurrentSkipList_Destroy(sl);
+
+    bench_sink = found;
+}
+
+#define BENCH_STRING_SIZE   24
+
+/* n distinct strings, formatted before the clock starts. */
+static char* bench_strings(size_t n) {
+    char* strings = (char*)malloc(n * BENCH_STRING_SIZE);
+    size_t i;
+
+    for (i = 0; strings != NULL && i < n; ++i) {
+        snprintf(strings + i * BENCH_STRING_SIZE, BENCH_STRING_SIZE, "key-%016llx", (unsigned long long)bench_key(i));
+    }
+
+    return strings;
+}
+
+void bench_strings_workload(BenchRunner* runner) {
+    size_t n = runner->n, i, found = 0;
+    char* strings = bench_strings(n);
+    const char* str;
+    uint64_t sum = 0;
+
+    if (strings == NULL) {
+        return;
+    }
+
+    StringInternPool* pool = StringInternPool_CreateNew(1);
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        str = strings + i * BENCH_STRING_SIZE;
+        sum += (uintptr_t)StringInternPool_Intern(pool, str, strlen(str));
+    }
+    Bench_End(runner, "StringInternPool/intern_new", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        str = strings + i * BENCH_STRING_SIZE;
+        sum += (uintptr_t)StringInternPool_Intern(pool, str, strlen(str));
+    }
+    Bench_End(runner, "StringInternPool/intern_hit", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        sum += (uintptr_t)StringInternPool_ById(pool, (uint32_t)(bench_key(i) % n));
+    }
+    Bench_End(runner, "StringInternPool/by_id", n);
+    StringInternPool_Destroy(pool);
+
+    RadixTree* tree = RadixTree_CreateNew(NULL);
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        str = strings + i * BENCH_STRING_SIZE;
+        RadixTree_Insert(tree, str, strlen(str), NULL);
+    }
+    Bench_End(runner, "RadixTree/insert", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        str = strings + i * BENCH_STRING_SIZE;
+        found += (RadixTree_Find(tree, str, strlen(str)) != NULL);
+    }
+    Bench_End(runner, "RadixTree/find_hit", n);
+    RadixTree_Destroy(tree);
+
+    free(strings);
+    bench_sink = sum + found;
+}
+
+void bench_bitset(BenchRunner* runner) {
+    size_t n = runner->n, i, sum = 0;
+    Bitset* bs = Bitset_CreateNew(n);
+
+    if (bs == NULL) {
+        return;
+    }
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        Bitset_Set(bs, (size_t)(bench_key(i) % n));
+    }
+    Bench_End(runner, "Bitset/set", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        sum += Bitset_Test(bs, (size_t)(bench_key(i) % n));
+    }
+    Bench_End(runner, "Bitset/test", n);
+
+    /* one op per 64-bit word. */
+    Bench_Begin(runner);
+    sum += Bitset_Count(bs);
+    Bench_End(runner, "Bitset/count", Bitset_WordCount(bs));
+
+    Bitset_BuildRankIndex(bs);
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        sum += Bitset_Rank(bs, (size_t)(bench_key(i) % n));
+    }
+    Bench_End(runner, "Bitset/rank", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        sum += Bitset_Select(bs, i);   /* about two thirds of the bits are set, the rest is a miss. */
+    }
+    Bench_End(runner, "Bitset/select", n);
+    Bitset_Destroy(bs);
+
+    bench_sink = sum;
+}
+
+/* owner side only, plus steals with nobody racing: the cost of the fences and the CAS, not of contention. */
+void bench_work_stealing_deque(BenchRunner* runner) {
+    size_t n = runner->n, i;
+    uint64_t sum = 0;
+    void* elem;
+
+    WorkStealingDeque* dq = WorkStealingDeque_CreateNew(0);
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        WorkStealingDeque_PushBottom(dq, (void*)(uintptr_t)i);
+    }
+    Bench_End(runner, "WorkStealingDeque/push_bottom", n);
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        if (WorkStealingDeque_PopBottom(dq, &elem) == WORK_STEALING_DEQUE_SUCCESS) {
+            sum += (uintptr_t)elem;
+        }
+    }
+    Bench_End(runner, "WorkStealingDeque/pop_bottom", n);
+
+    for (i = 0; i < n; ++i) {
+        WorkStealingDeque_PushBottom(dq, (void*)(uintptr_t)i);
+    }
+
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        if (WorkStealingDeque_Steal(dq, &elem) == WORK_STEALING_DEQUE_SUCCESS) {
+            sum += (uintptr_t)elem;
+        }
+    }
+    Bench_End(runner, "WorkStealingDeque/steal", n);
+    WorkStealingDeque_Destroy(dq);
+
+    bench_sink = sum;
+}
+
+void bench_priority_queue(BenchRunner* runner) {
+    size_t n = runner->n, i;
+    uint64_t sum = 0;
+
+    PriorityQueue* pq = PriorityQueue_CreateNew(0, bench_compare_priority, NULL, 0);
+    Bench_Begin(runner);
+    for (i = 0; i < n; ++i) {
+        PriorityQueue_Push(pq, (void*)(uintptr_t)bench_key(i));
+    }
+    Bench_End(runner, "PriorityQueue/push", n);
+
+    Bench_Begin(runner);
+    while (!PriorityQueue_IsEmpty(pq)) {
+        sum += (uintptr_t)PriorityQueue_Pop(pq);
+    }
+    Bench_End(runner, "PriorityQueue/pop", n);
+    PriorityQueue_Destroy(pq);
+
+    bench_sink = sum;
+}
+
+typedef struct BenchWorkload {
+    const char* name;
+    void (*run)(BenchRunner*);
+} BenchWorkload;
+
+static const BenchWorkload bench_workloads[] = {
+    { "sequences", bench_sequences },
+    { "maps", bench_maps },
+    { "priority_queue", bench_priority_queue },
+    { "strings", bench_strings_workload },
+    { "bitset", bench_bitset },
+    { "work_stealing_deque", bench_work_stealing_deque }
+};
+
+int main(int argc, char* argv[]) {
+    BenchRunner runner;
+    const char* savePath = NULL;
+    const char* baselinePath = NULL;
+    int cpu = -1;
+    int i, opened;
+    size_t w, r;
+
+    memset(&runner, 0, sizeof(runner));
+    runner.n = 100000;
+    runner.repeats = 3;
+    runner.threshold = 10.0;
+
+    for (i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-n") == 0) {
+            runner.n = (size_t)strtoull(argv[i + 1], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-r") == 0) {
+            runner.repeats = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-c") == 0) {
+            cpu = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-f") == 0) {
+            runner.filter = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-s") == 0) {
+            savePath = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-b") == 0) {
+            baselinePath = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-t") == 0) {
+            runner.threshold = atof(argv[i + 1]);
+        }
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    if (cpu >= 0 && !PerfCounters_PinToCpu(cpu)) {
+        fprintf(stderr, "cannot pin to cpu %d, running unpinned\n", cpu);
+    }
+
+    if (baselinePath != NULL && (runner.baseline = PerfBaseline_Load(baselinePath)) == NULL) {
+        fprintf(stderr, "cannot read baseline %s\n", baselinePath);
+        return 2;
+    }
+
+    if ((opened = PerfCounters_Open(&runner.counters)) == 0) {
+        fprintf(stderr, "no perf counters available (perf_event_paranoid, VM?), wall time only\n");
+    }
+
+    for (w = 0; w < sizeof(bench_workloads) / sizeof(BenchWorkload); ++w) {
+        if (runner.filter != NULL && strstr(bench_workloads[w].name, runner.filter) == NULL) {
+            continue;
+        }
+
+        for (runner.repeat = 0; runner.repeat < runner.repeats; ++runner.repeat) {
+            bench_workloads[w].run(&runner);
+        }
+    }
+
+    printf("%zu elements, best of %d, %d of %d counters\n\n", runner.n, runner.repeats, opened, PERF_COUNTER_COUNT);
+    PerfSample_PrintHeader(stdout);
+
+    for (r = 0; r < runner.length; ++r) {
+        PerfSample_Print(stdout, runner.names[r], &runner.samples[r]);
+    }
+
+    if (runner.baseline != NULL) {
+        printf("\ncompared to %s (threshold %.1f%%):\n", baselinePath, runner.threshold);
+
+        for (r = 0; r < runner.length; ++r) {
+            runner.regressions += PerfBaseline_Compare(stdout, runner.baseline, runner.names[r], &runner.samples[r], runner.threshold);
+        }
+
+        printf("%d regressions\n", runner.regressions);
+        PerfBaseline_Destroy(runner.baseline);
+    }
+
+    if (savePath != NULL && !PerfBaseline_Save(savePath, runner.names, runner.samples, runner.length)) {
+        fprintf(stderr, "cannot write %s\n", savePath);
+    }
+
+    PerfCounters_Close(&runner.counters);
+    return runner.regressions > 0;
+}
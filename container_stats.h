@@ -0,0 +1,241 @@
+/**
+ * compile-time opt-in instrumentation shared by every container in this repo.
+ *
+ * build with -DCONTAINER_STATS to turn it on, every container then carries a ContainerStats member
+ * counting allocations / bytes, grow or rehash events, lookup probe lengths, and a sampled op latency.
+ * without the flag every macro below expands to nothing, so the containers are byte-for-byte the
+ * same as before.
+ *
+ * counters are plain (non-atomic) fields, they are only updated by the thread that owns the container.
+ * the concurrent containers keep one per shard (updated under the shard lock) or per thread handle,
+ * <Type>_GetStats merges them with ContainerStats_Merge.
+ */
+#ifndef CONTAINER_STATS_H
+#define CONTAINER_STATS_H
+
+#ifdef CONTAINER_STATS
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define CONTAINER_STATS_PROBE_BUCKETS      16   /* 0 .. 14 exact, the last one counts 15 and more. */
+#define CONTAINER_STATS_LATENCY_BUCKETS    32   /* bucket i counts latencies in [2^i, 2^(i+1)) ns. */
+
+#ifndef CONTAINER_STATS_SAMPLE_RATE
+#define CONTAINER_STATS_SAMPLE_RATE        64   /* time 1 op out of this many, must be a power of 2. */
+#endif
+
+typedef struct ContainerStats {
+    const char* name;
+
+    size_t allocCount;
+    size_t freeCount;
+    size_t allocBytes;
+    size_t freeBytes;
+    size_t growCount;   /* capacity expansion or rehash. */
+
+    size_t probeCount;
+    size_t probeTotal;
+    size_t probeMax;
+    size_t probeHistogram[CONTAINER_STATS_PROBE_BUCKETS];   /* nodes / slots visited per lookup. */
+    size_t chainHistogram[CONTAINER_STATS_PROBE_BUCKETS];   /* current chain lengths, filled by the snapshot. */
+
+    size_t opCount;
+    size_t sampledOpCount;
+    uint64_t latencyTotalNs;
+    uint64_t latencyMaxNs;
+    size_t latencyHistogram[CONTAINER_STATS_LATENCY_BUCKETS];
+} ContainerStats;
+
+#define CONTAINER_STATS_FIELD(fieldName)   ContainerStats fieldName;
+
+static inline void ContainerStats_Init(ContainerStats* stats, const char* name) {
+    memset(stats, 0, sizeof(ContainerStats));
+    stats->name = name;
+}
+
+static inline void ContainerStats_OnAlloc(ContainerStats* stats, size_t bytes) {
+    stats->allocCount += 1;
+    stats->allocBytes += bytes;
+}
+
+static inline void ContainerStats_OnFree(ContainerStats* stats, size_t bytes) {
+    stats->freeCount += 1;
+    stats->freeBytes += bytes;
+}
+
+static inline void ContainerStats_OnGrow(ContainerStats* stats, size_t oldBytes, size_t newBytes) {
+    stats->growCount += 1;
+
+    if (oldBytes != 0) {   /* 0 when the old storage is kept alive. */
+        ContainerStats_OnFree(stats, oldBytes);
+    }
+
+    ContainerStats_OnAlloc(stats, newBytes);
+}
+
+static inline void ContainerStats_OnProbe(ContainerStats* stats, size_t probeLength) {
+    stats->probeCount += 1;
+    stats->probeTotal += probeLength;
+
+    if (probeLength > stats->probeMax) {
+        stats->probeMax = probeLength;
+    }
+
+    stats->probeHistogram[probeLength < CONTAINER_STATS_PROBE_BUCKETS ? probeLength : CONTAINER_STATS_PROBE_BUCKETS - 1] += 1;
+}
+
+static inline void ContainerStats_OnChain(ContainerStats* stats, size_t chainLength) {
+    stats->chainHistogram[chainLength < CONTAINER_STATS_PROBE_BUCKETS ? chainLength : CONTAINER_STATS_PROBE_BUCKETS - 1] += 1;
+}
+
+static inline uint64_t ContainerStats_NowNs(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* return 0 when this op is not sampled. */
+static inline uint64_t ContainerStats_SampleBegin(ContainerStats* stats) {
+    stats->opCount += 1;
+    return (stats->opCount & (CONTAINER_STATS_SAMPLE_RATE - 1)) == 0 ? ContainerStats_NowNs() : 0;
+}
+
+static inline void ContainerStats_SampleEnd(ContainerStats* stats, uint64_t begin) {
+    uint64_t ns;
+    size_t bucket = 0;
+
+    if (begin == 0) {
+        return;
+    }
+
+    ns = ContainerStats_NowNs() - begin;
+    stats->sampledOpCount += 1;
+    stats->latencyTotalNs += ns;
+
+    if (ns > stats->latencyMaxNs) {
+        stats->latencyMaxNs = ns;
+    }
+
+    while (ns > 1 && bucket < CONTAINER_STATS_LATENCY_BUCKETS - 1) {
+        ns >>= 1;
+        bucket += 1;
+    }
+
+    stats->latencyHistogram[bucket] += 1;
+}
+
+/* add src into dst, for containers keeping one ContainerStats per shard or per thread. */
+static inline void ContainerStats_Merge(ContainerStats* dst, const ContainerStats* src) {
+    size_t i;
+
+    dst->allocCount += src->allocCount;
+    dst->freeCount += src->freeCount;
+    dst->allocBytes += src->allocBytes;
+    dst->freeBytes += src->freeBytes;
+    dst->growCount += src->growCount;
+
+    dst->probeCount += src->probeCount;
+    dst->probeTotal += src->probeTotal;
+    dst->probeMax = (src->probeMax > dst->probeMax ? src->probeMax : dst->probeMax);
+
+    for (i = 0; i < CONTAINER_STATS_PROBE_BUCKETS; ++i) {
+        dst->probeHistogram[i] += src->probeHistogram[i];
+        dst->chainHistogram[i] += src->chainHistogram[i];
+    }
+
+    dst->opCount += src->opCount;
+    dst->sampledOpCount += src->sampledOpCount;
+    dst->latencyTotalNs += src->latencyTotalNs;
+    dst->latencyMaxNs = (src->latencyMaxNs > dst->latencyMaxNs ? src->latencyMaxNs : dst->latencyMaxNs);
+
+    for (i = 0; i < CONTAINER_STATS_LATENCY_BUCKETS; ++i) {
+        dst->latencyHistogram[i] += src->latencyHistogram[i];
+    }
+}
+
+#define ContainerStats_OpBegin(statsPtr, var)   uint64_t var = ContainerStats_SampleBegin(statsPtr)
+#define ContainerStats_OpEnd(statsPtr, var)     ContainerStats_SampleEnd(statsPtr, var)
+
+/**
+ * persistent containers: an update reads the old version, shared with other threads, and builds a new
+ * one carrying the counters on. the op is counted on the new version, nothing is written to the old.
+ */
+static inline uint64_t ContainerStats_VersionSampleBegin(const ContainerStats* from) {
+    return ((from->opCount + 1) & (CONTAINER_STATS_SAMPLE_RATE - 1)) == 0 ? ContainerStats_NowNs() : 0;
+}
+
+static inline void ContainerStats_VersionSampleEnd(ContainerStats* to, const ContainerStats* from, uint64_t begin) {
+    *to = *from;
+    to->opCount += 1;
+    ContainerStats_SampleEnd(to, begin);
+}
+
+#define ContainerStats_VersionOpBegin(fromPtr, var)       uint64_t var = ContainerStats_VersionSampleBegin(fromPtr)
+#define ContainerStats_VersionOpEnd(toPtr, fromPtr, var)  ContainerStats_VersionSampleEnd(toPtr, fromPtr, var)
+
+static inline void ContainerStats_Dump(const ContainerStats* stats, FILE* f) {
+    size_t i;
+
+    fprintf(f, "[%s]\n", stats->name);
+    fprintf(f, "  allocs: %zu (%zu bytes), frees: %zu (%zu bytes), live: %zu bytes, grows: %zu\n",
+            stats->allocCount, stats->allocBytes, stats->freeCount, stats->freeBytes,
+            stats->allocBytes - stats->freeBytes, stats->growCount);
+
+    if (stats->probeCount != 0) {
+        fprintf(f, "  probes: %zu lookups, avg %.2f, max %zu\n",
+                stats->probeCount, (double)stats->probeTotal / stats->probeCount, stats->probeMax);
+        fprintf(f, "  probe length histogram:");
+        for (i = 0; i < CONTAINER_STATS_PROBE_BUCKETS; ++i) {
+            fprintf(f, " %s%zu:%zu", (i == CONTAINER_STATS_PROBE_BUCKETS - 1 ? ">=" : ""), i, stats->probeHistogram[i]);
+        }
+        fprintf(f, "\n");
+    }
+
+    for (i = 0; i < CONTAINER_STATS_PROBE_BUCKETS; ++i) {
+        if (stats->chainHistogram[i] != 0) {
+            break;
+        }
+    }
+
+    if (i != CONTAINER_STATS_PROBE_BUCKETS) {
+        fprintf(f, "  chain length histogram:");
+        for (i = 0; i < CONTAINER_STATS_PROBE_BUCKETS; ++i) {
+            fprintf(f, " %s%zu:%zu", (i == CONTAINER_STATS_PROBE_BUCKETS - 1 ? ">=" : ""), i, stats->chainHistogram[i]);
+        }
+        fprintf(f, "\n");
+    }
+
+    if (stats->sampledOpCount != 0) {
+        fprintf(f, "  ops: %zu, sampled: %zu, avg %.1f ns, max %llu ns\n",
+                stats->opCount, stats->sampledOpCount, (double)stats->latencyTotalNs / stats->sampledOpCount,
+                (unsigned long long)stats->latencyMaxNs);
+        fprintf(f, "  latency histogram (ns):");
+        for (i = 0; i < CONTAINER_STATS_LATENCY_BUCKETS; ++i) {
+            if (stats->latencyHistogram[i] != 0) {
+                fprintf(f, " <%llu:%zu", 2ull << i, stats->latencyHistogram[i]);
+            }
+        }
+        fprintf(f, "\n");
+    }
+}
+
+#else
+
+#define CONTAINER_STATS_FIELD(fieldName)
+#define ContainerStats_Init(statsPtr, name)                     ((void)0)
+#define ContainerStats_OnAlloc(statsPtr, bytes)                 ((void)0)
+#define ContainerStats_OnFree(statsPtr, bytes)                  ((void)0)
+#define ContainerStats_OnGrow(statsPtr, oldBytes, newBytes)     ((void)0)
+#define ContainerStats_OnProbe(statsPtr, probeLength)           ((void)0)
+#define ContainerStats_OnChain(statsPtr, chainLength)           ((void)0)
+#define ContainerStats_OpBegin(statsPtr, var)
+#define ContainerStats_OpEnd(statsPtr, var)                     ((void)0)
+#define ContainerStats_VersionOpBegin(fromPtr, var)
+#define ContainerStats_VersionOpEnd(toPtr, fromPtr, var)        ((void)0)
+
+#endif /* CONTAINER_STATS */
+
+#endif /* CONTAINER_STATS_H */
@@ -27,6 +27,10 @@
 #include <string.h>
 #include <stddef.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 typedef struct String {
     char* data;
     size_t capacity;
@@ -63,7 +67,7 @@ String* String_Create_CStyle(const char* cstr) {
     }
 
     size_t len = strlen(cstr);
-    size_t capacity = (size_t)(1.5 * len);
+    size_t capacity = len + 1 + len / 2;
     String* str = String_CreateNew(capacity);
     if (str == NULL) {
         return NULL;
@@ -106,44 +110,264 @@ int String_Append_CStyle(String* str, const char* cstr, size_t cstrLen) {
     return 1;
 }
 
+/* capacity counts the '\0', so a string of length n needs n + 1. */
+int String_Reserve(String* str, size_t capacity) {
+    if (capacity <= str->capacity) {
+        return 1;
+    }
+
+    return String_ExpandCapacity(str, capacity);
+}
+
+int String_ShrinkToFit(String* str) {
+    if (str->capacity == str->length + 1) {
+        return 1;
+    }
+
+    return String_ExpandCapacity(str, str->length + 1);
+}
+
+#define STRING_NPOS ((size_t)-1)
+
+/**
+ * length based substring search, embedded '\0' are ordinary bytes. with SSE2 16 candidate positions
+ * are filtered at once by comparing the first and the last byte of the pattern, only the survivors
+ * get a memcmp. without SSE2 memchr finds the first byte.
+ */
+const char* String_SearchBytes(const char* text, size_t textLen, const char* pattern, size_t patternLen) {
+    const char* end;
+    const char* cursor = text;
+
+    if (patternLen == 0) {
+        return text;
+    }
+
+    if (patternLen > textLen) {
+        return NULL;
+    }
+
+    if (patternLen == 1) {
+        return (const char*)memchr(text, pattern[0], textLen);
+    }
+
+    end = text + (textLen - patternLen + 1);   /* one past the last possible start. */
+
+#if defined(__SSE2__)
+    {
+        const __m128i first = _mm_set1_epi8(pattern[0]);
+        const __m128i last = _mm_set1_epi8(pattern[patternLen - 1]);
+        __m128i blockFirst, blockLast;
+        unsigned int mask, bit;
+
+        for (; cursor + 16 <= end; cursor += 16) {
+            blockFirst = _mm_loadu_si128((const __m128i*)cursor);
+            blockLast = _mm_loadu_si128((const __m128i*)(cursor + patternLen - 1));
+            mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast)));
+
+            while (mask != 0) {
+                for (bit = 0; ((mask >> bit) & 1u) == 0; ++bit) {}
+
+                if (memcmp(cursor + bit + 1, pattern + 1, patternLen - 2) == 0) {
+                    return cursor + bit;
+                }
+
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif
+
+    while (cursor < end) {
+        if ((cursor = (const char*)memchr(cursor, pattern[0], (size_t)(end - cursor))) == NULL) {
+            return NULL;
+        }
+
+        if (memcmp(cursor + 1, pattern + 1, patternLen - 1) == 0) {
+            return cursor;
+        }
+
+        cursor += 1;
+    }
+
+    return NULL;
+}
+
+/* index of the first pattern at or after from, STRING_NPOS when there is none. */
+size_t String_Find(const String* str, size_t from, const char* pattern, size_t patternLen) {
+    const char* pos;
+
+    if (from > str->length) {
+        return STRING_NPOS;
+    }
+
+    pos = String_SearchBytes(str->data + from, str->length - from, pattern, patternLen);
+    return (pos != NULL) ? (size_t)(pos - str->data) : STRING_NPOS;
+}
+
+/**
+ * replace every non-overlapping pattern, left to right. the matches are counted first so the result
+ * is written in one pass: in place when target is not longer than pattern, otherwise into a single
+ * allocation of the exact size.
+ */
 int String_Replace(String* str, const char* pattern, size_t patternLen, const char* target, size_t targetLen) {
-    const char* patternPos = NULL;
-    const char* cursor = str->data;
-    String* temp = String_CreateNew((size_t)(1.5 * String_Length(str)));
-    if (temp == NULL) {
+    const char* cursor;
+    const char* end = str->data + str->length;
+    const char* found;
+    char* out;
+    char* write;
+    size_t count = 0;
+    size_t newLength;
+
+    if (patternLen == 0 || str->length == 0) {
+        return 1;
+    }
+
+    for (cursor = str->data; (found = String_SearchBytes(cursor, (size_t)(end - cursor), pattern, patternLen)) != NULL; cursor = found + patternLen) {
+        count += 1;
+    }
+
+    if (count == 0) {
+        return 1;
+    }
+
+    newLength = str->length - count * patternLen + count * targetLen;
+
+    if (targetLen <= patternLen) {
+        out = str->data;   /* the write position never passes the read position. */
+    }
+    else if ((out = (char*)malloc((newLength + 1) * sizeof(char))) == NULL) {
         return 0;
     }
 
-    while (1) {
-        patternPos = strstr(cursor, pattern);
+    write = out;
+    for (cursor = str->data; (found = String_SearchBytes(cursor, (size_t)(end - cursor), pattern, patternLen)) != NULL; cursor = found + patternLen) {
+        memmove(write, cursor, (size_t)(found - cursor));
+        write += found - cursor;
+        memcpy(write, target, targetLen);
+        write += targetLen;
+    }
 
-        if (patternPos != NULL) {
-            if (!String_Append_CStyle(temp, cursor, (size_t)(patternPos - cursor))) {
-                String_Destroy(temp);
-                return 0;
-            }
-            
-            if (!String_Append_CStyle(temp, target, targetLen)) {
-                String_Destroy(temp);
-                return 0;
-            }
+    memmove(write, cursor, (size_t)(end - cursor));
+    out[newLength] = '\0';
+
+    if (out != str->data) {
+        free(str->data);
+        str->data = out;
+        str->capacity = newLength + 1;
+    }
+
+    str->length = newLength;
+    return 1;
+}
+
+/* a piece of some other string, not '\0' terminated. */
+typedef struct StringView {
+    const char* data;
+    size_t length;
+} StringView;
+
+typedef struct StringViewArray {
+    StringView* data;
+    size_t capacity;
+    size_t length;
+} StringViewArray;
+
+#define StringViewArray_At(arrPtr, index)   ((arrPtr)->data[(index)])
+#define StringViewArray_Length(arrPtr)      ((arrPtr)->length)
+
+StringViewArray* StringViewArray_CreateNew(size_t capacity) {
+    StringViewArray* arr = (StringViewArray*)malloc(sizeof(StringViewArray));
+    if (arr == NULL) {
+        return NULL;
+    }
+
+    arr->length = 0;
+    arr->capacity = (capacity != 0) ? capacity : 8;
+
+    if ((arr->data = (StringView*)malloc(arr->capacity * sizeof(StringView))) == NULL) {
+        free(arr);
+        return NULL;
+    }
+
+    return arr;
+}
 
-            cursor = patternPos + patternLen;
+void StringViewArray_Destroy(StringViewArray* arr) {
+    free(arr->data);
+    free(arr);
+}
+
+int StringViewArray_PushBack(StringViewArray* arr, const char* data, size_t length) {
+    StringView* temp;
+
+    if (arr->capacity == arr->length) {
+        if ((temp = (StringView*)realloc(arr->data, 2 * arr->capacity * sizeof(StringView))) == NULL) {
+            return 0;
         }
-        else {
-            size_t strLeftLen = String_Length(str) - (size_t)(cursor - String_Data(str));
-            if (!String_Append_CStyle(temp, cursor, strLeftLen)) {
-                String_Destroy(temp);
-                return 0;
-            }
 
-            free(str->data);
-            str->data = temp->data;
-            str->length = temp->length;
-            str->capacity = temp->capacity;
-            return 1;
+        arr->data = temp;
+        arr->capacity *= 2;
+    }
+
+    arr->data[arr->length].data = data;
+    arr->data[arr->length].length = length;
+    arr->length += 1;
+    return 1;
+}
+
+/**
+ * append the pieces of str between separators to out, nothing is copied: the views point into str
+ * and stay valid until str is modified. n separators always give n + 1 pieces, some maybe empty.
+ */
+int String_Split(const String* str, const char* sep, size_t sepLen, StringViewArray* out) {
+    const char* cursor = str->data;
+    const char* end = str->data + str->length;
+    const char* found;
+
+    if (sepLen == 0) {
+        return StringViewArray_PushBack(out, str->data, str->length);
+    }
+
+    while ((found = String_SearchBytes(cursor, (size_t)(end - cursor), sep, sepLen)) != NULL) {
+        if (!StringViewArray_PushBack(out, cursor, (size_t)(found - cursor))) {
+            return 0;
+        }
+
+        cursor = found + sepLen;
+    }
+
+    return StringViewArray_PushBack(out, cursor, (size_t)(end - cursor));
+}
+
+/* a new string of the pieces with sep in between, sized up front and allocated once. */
+String* String_Join(const StringViewArray* parts, const char* sep, size_t sepLen) {
+    String* str;
+    size_t i, length = 0;
+
+    for (i = 0; i < parts->length; ++i) {
+        length += parts->data[i].length;
+    }
+
+    if (parts->length > 1) {
+        length += (parts->length - 1) * sepLen;
+    }
+
+    if ((str = String_CreateNew(length + 1)) == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < parts->length; ++i) {
+        if (i != 0) {
+            memcpy(str->data + str->length, sep, sepLen);
+            str->length += sepLen;
         }
+
+        memcpy(str->data + str->length, parts->data[i].data, parts->data[i].length);
+        str->length += parts->data[i].length;
     }
+
+    str->data[str->length] = '\0';
+    return str;
 }
 
 typedef struct ReplaceTable {
@@ -177,30 +401,366 @@ void replace_file_content_then_write_to_file(const char* templateFilePath, const
         String_Replace(fileContent, rt[i].pattern, strlen(rt[i].pattern), rt[i].target, strlen(rt[i].target));
     }
 
-    fprintf(targetFile, "%s", String_Data(fileContent));
+    fwrite(String_Data(fileContent), sizeof(char), String_Length(fileContent), targetFile);
 
     fclose(templateFile);
     fclose(targetFile);
     String_Destroy(fileContent);
 }
 
-void create_array(const char* targetFilePath, const char* elementType, const char* arrayTypeName) {
+/**
+ * a predicate compiled into its own removal function, so the condition is inlined instead of called
+ * through a pointer like in RemoveIf. condition is a C expression over elem, a const pointer to the
+ * element, true means remove: { "Negative", "*elem < 0" } gives <TypeName>_RemoveNegative.
+ */
+typedef struct Filter {
+    const char* name;
+    const char* condition;
+} Filter;
+
+/* repeat snippet once per filter, "@FilterName" and "@FilterCondition" are replaced by that filter. */
+String* expand_for_each_filter(const char* snippet, const Filter* filters, size_t filterCount) {
+    size_t i;
+    String* block = String_CreateNew(256);
+    String* code;
+
+    if (block == NULL) {
+        return NULL;
+    }
+
+    String_Append_CStyle(block, "", 0);
+
+    for (i = 0; i < filterCount; ++i) {
+        if ((code = String_Create_CStyle(snippet)) == NULL) {
+            String_Destroy(block);
+            return NULL;
+        }
+
+        String_Replace(code, "@FilterName", strlen("@FilterName"), filters[i].name, strlen(filters[i].name));
+        String_Replace(code, "@FilterCondition", strlen("@FilterCondition"), filters[i].condition, strlen(filters[i].condition));
+        String_Append_CStyle(block, String_Data(code), String_Length(code));
+        String_Destroy(code);
+    }
+
+    return block;
+}
+
+static const char* const ARRAY_FILTER_SNIPPET =
+    "static int @ArrayTypeName_Is@FilterName(const @ElementType* elem) {\n"
+    "    return (@FilterCondition);\n"
+    "}\n"
+    "\n"
+    "/* @ArrayTypeName_RemoveIf with the predicate compiled in. */\n"
+    "size_t @ArrayTypeName_Remove@FilterName(@ArrayTypeName* arr) {\n"
+    "    size_t read, write = 0, removed;\n"
+    "\n"
+    "    if (!@ArrayTypeName_Own(arr)) {\n"
+    "        return 0;\n"
+    "    }\n"
+    "\n"
+    "    for (read = 0; read < arr->length; ++read) {\n"
+    "        if (!@ArrayTypeName_Is@FilterName(&arr->data[read])) {\n"
+    "            arr->data[write++] = arr->data[read];\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    removed = arr->length - write;\n"
+    "    arr->length = write;\n"
+    "    return removed;\n"
+    "}\n"
+    "\n";
+
+static const char* const FIXED_ARRAY_FILTER_SNIPPET =
+    "static int @FixedArrayTypeName_Is@FilterName(const @ElementType* elem) {\n"
+    "    return (@FilterCondition);\n"
+    "}\n"
+    "\n"
+    "/* @FixedArrayTypeName_RemoveIf with the predicate compiled in. */\n"
+    "size_t @FixedArrayTypeName_Remove@FilterName(@FixedArrayTypeName* arr) {\n"
+    "    size_t read, write = 0, removed;\n"
+    "\n"
+    "    for (read = 0; read < arr->length; ++read) {\n"
+    "        if (!@FixedArrayTypeName_Is@FilterName(&arr->data[read])) {\n"
+    "            arr->data[write++] = arr->data[read];\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    removed = arr->length - write;\n"
+    "    arr->length = write;\n"
+    "    return removed;\n"
+    "}\n"
+    "\n";
+
+static const char* const LIST_FILTER_SNIPPET =
+    "static int @ListTypeName_Is@FilterName(const @ElementType* elem) {\n"
+    "    return (@FilterCondition);\n"
+    "}\n"
+    "\n"
+    "/* @ListTypeName_RemoveIf with the predicate compiled in. */\n"
+    "size_t @ListTypeName_Remove@FilterName(@ListTypeName* list) {\n"
+    "    @ListNodeTypeName* node = list->head;\n"
+    "    size_t removed = 0;\n"
+    "\n"
+    "    while (node != NULL) {\n"
+    "        if (@ListTypeName_Is@FilterName(&node->data)) {\n"
+    "            node = @ListTypeName_DeleteNode(list, node, 1);\n"
+    "            removed += 1;\n"
+    "        }\n"
+    "        else {\n"
+    "            node = node->next;\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    return removed;\n"
+    "}\n"
+    "\n";
+
+static const char* const POOL_LIST_FILTER_SNIPPET =
+    "static int @PoolListTypeName_Is@FilterName(const @ElementType* elem) {\n"
+    "    return (@FilterCondition);\n"
+    "}\n"
+    "\n"
+    "/* @PoolListTypeName_RemoveIf with the predicate compiled in. */\n"
+    "uint32_t @PoolListTypeName_Remove@FilterName(@PoolListTypeName* list) {\n"
+    "    uint32_t node = @PoolListTypeName_Head(list), next, removed = 0;\n"
+    "\n"
+    "    while (node != @PoolListTypeName_END) {\n"
+    "        next = list->nodes[node].next;\n"
+    "\n"
+    "        if (@PoolListTypeName_Is@FilterName(&list->nodes[node].data)) {\n"
+    "            @PoolListTypeName_Remove(list, node);\n"
+    "            removed += 1;\n"
+    "        }\n"
+    "\n"
+    "        node = next;\n"
+    "    }\n"
+    "\n"
+    "    return removed;\n"
+    "}\n"
+    "\n";
+
+void create_array_with_filters(const char* targetFilePath, const char* elementType, const char* arrayTypeName, const Filter* filters, size_t filterCount) {
+    String* block = expand_for_each_filter(ARRAY_FILTER_SNIPPET, filters, filterCount);
+    if (block == NULL) {
+        return;
+    }
+
+    /* the filters still refer to the type names, so they go first. */
     const ReplaceTable rt[] = {
+        "@Filters", String_Data(block),
         "@ElementType", elementType,
         "@ArrayTypeName", arrayTypeName
     };
 
     replace_file_content_then_write_to_file("template_array.txt", targetFilePath, rt, sizeof(rt) / sizeof(ReplaceTable));
+    String_Destroy(block);
 }
 
-void create_doubly_linked_list(const char* targetFilePath, const char* elementType, const char* listNodeTypeName, const char* listTypeName) {
+void create_array(const char* targetFilePath, const char* elementType, const char* arrayTypeName) {
+    create_array_with_filters(targetFilePath, elementType, arrayTypeName, NULL, 0);
+}
+
+void create_doubly_linked_list_with_filters(const char* targetFilePath, const char* elementType, const char* listNodeTypeName, const char* listTypeName, const Filter* filters, size_t filterCount) {
+    String* block = expand_for_each_filter(LIST_FILTER_SNIPPET, filters, filterCount);
+    if (block == NULL) {
+        return;
+    }
+
     const ReplaceTable rt[] = {
+        "@Filters", String_Data(block),
         "@ElementType", elementType,
         "@ListNodeTypeName", listNodeTypeName,
         "@ListTypeName", listTypeName
     };
 
     replace_file_content_then_write_to_file("template_doubly_linked_list.txt", targetFilePath, rt, sizeof(rt) / sizeof(ReplaceTable));
+    String_Destroy(block);
+}
+
+void create_doubly_linked_list(const char* targetFilePath, const char* elementType, const char* listNodeTypeName, const char* listTypeName) {
+    create_doubly_linked_list_with_filters(targetFilePath, elementType, listNodeTypeName, listTypeName, NULL, 0);
+}
+
+void create_work_stealing_deque(const char* targetFilePath, const char* elementType, const char* dequeTypeName) {
+    const ReplaceTable rt[] = {
+        "@ElementType", elementType,
+        "@DequeTypeName", dequeTypeName
+    };
+
+    replace_file_content_then_write_to_file("template_work_stealing_deque.txt", targetFilePath, rt, sizeof(rt) / sizeof(ReplaceTable));
+}
+
+void create_bitset(const char* targetFilePath, const char* bitCount, const char* bitsetTypeName) {
+    const ReplaceTable rt[] = {
+        "@BitCount", bitCount,
+        "@BitsetTypeName", bitsetTypeName
+    };
+
+    replace_file_content_then_write_to_file("template_bitset.txt", targetFilePath, rt, sizeof(rt) / sizeof(ReplaceTable));
+}
+
+void create_priority_queue(const char* targetFilePath, const char* elementType, const char* priorityQueueTypeName) {
+    const ReplaceTable rt[] = {
+        "@ElementType", elementType,
+        "@PriorityQueueTypeName", priorityQueueTypeName
+    };
+
+    replace_file_content_then_write_to_file("template_priority_queue.txt", targetFilePath, rt, sizeof(rt) / sizeof(ReplaceTable));
+}
+
+void create_slot_map(const char* targetFilePath, const char* elementType, const char* slotMapTypeName) {
+    const ReplaceTable rt[] = {
+        "@ElementType", elementType,
+        "@SlotMapTypeName", slotMapTypeName
+    };
+
+    replace_file_content_then_write_to_file("template_slot_map.txt", targetFilePath, rt, sizeof(rt) / sizeof(ReplaceTable));
+}
+
+void create_fixed_array_with_filters(const char* targetFilePath, const char* elementType, const char* capacity, const char* fixedArrayTypeName, const Filter* filters, size_t filterCount) {
+    String* block = expand_for_each_filter(FIXED_ARRAY_FILTER_SNIPPET, filters, filterCount);
+    if (block == NULL) {
+        return;
+    }
+
+    const ReplaceTable rt[] = {
+        "@Filters", String_Data(block),
+        "@ElementType", elementType,
+        "@Capacity", capacity,
+        "@FixedArrayTypeName", fixedArrayTypeName
+    };
+
+    replace_file_content_then_write_to_file("template_fixed_array.txt", targetFilePath, rt, sizeof(rt) / sizeof(ReplaceTable));
+    String_Destroy(block);
+}
+
+void create_fixed_array(const char* targetFilePath, const char* elementType, const char* capacity, const char* fixedArrayTypeName) {
+    create_fixed_array_with_filters(targetFilePath, elementType, capacity, fixedArrayTypeName, NULL, 0);
+}
+
+void create_fixed_ring_queue(const char* targetFilePath, const char* elementType, const char* capacity, const char* ringQueueTypeName) {
+    const ReplaceTable rt[] = {
+        "@ElementType", elementType,
+        "@Capacity", capacity,
+        "@RingQueueTypeName", ringQueueTypeName
+    };
+
+    replace_file_content_then_write_to_file("template_fixed_ring_queue.txt", targetFilePath, rt, sizeof(rt) / sizeof(ReplaceTable));
+}
+
+void create_fixed_pool_list_with_filters(const char* targetFilePath, const char* elementType, const char* capacity, const char* poolListTypeName, const Filter* filters, size_t filterCount) {
+    String* block = expand_for_each_filter(POOL_LIST_FILTER_SNIPPET, filters, filterCount);
+    if (block == NULL) {
+        return;
+    }
+
+    const ReplaceTable rt[] = {
+        "@Filters", String_Data(block),
+        "@ElementType", elementType,
+        "@Capacity", capacity,
+        "@PoolListTypeName", poolListTypeName
+    };
+
+    replace_file_content_then_write_to_file("template_fixed_pool_list.txt", targetFilePath, rt, sizeof(rt) / sizeof(ReplaceTable));
+    String_Destroy(block);
+}
+
+void create_fixed_pool_list(const char* targetFilePath, const char* elementType, const char* capacity, const char* poolListTypeName) {
+    create_fixed_pool_list_with_filters(targetFilePath, elementType, capacity, poolListTypeName, NULL, 0);
+}
+
+typedef struct StructField {
+    const char* type;
+    const char* name;
+} StructField;
+
+/* repeat snippet once per field, "@FieldType" and "@FieldName" are replaced by that field. */
+String* expand_for_each_field(const char* snippet, const StructField* fields, size_t fieldCount) {
+    size_t i;
+    String* block = String_CreateNew(256);
+    String* line;
+
+    if (block == NULL) {
+        return NULL;
+    }
+
+    String_Append_CStyle(block, "", 0);
+
+    for (i = 0; i < fieldCount; ++i) {
+        if ((line = String_Create_CStyle(snippet)) == NULL) {
+            String_Destroy(block);
+            return NULL;
+        }
+
+        String_Replace(line, "@FieldType", strlen("@FieldType"), fields[i].type, strlen(fields[i].type));
+        String_Replace(line, "@FieldName", strlen("@FieldName"), fields[i].name, strlen(fields[i].name));
+        String_Append_CStyle(block, String_Data(line), String_Length(line));
+        String_Destroy(line);
+    }
+
+    return block;
+}
+
+/**
+ * struct-of-arrays container, one column per field with shared length / capacity.
+ * recordTypeName is the plain struct used to push / get a whole row.
+ */
+void create_struct_of_arrays(const char* targetFilePath, const char* soaTypeName, const char* recordTypeName, const StructField* fields, size_t fieldCount) {
+    #define SOA_BLOCK_COUNT 16
+
+    const ReplaceTable snippets[SOA_BLOCK_COUNT] = {
+        "@RecordFields",     "    @FieldType @FieldName;\n",
+        "@ColumnFields",     "    @FieldType* @FieldName;\n",
+        "@ColumnRowSize",    " + sizeof(@FieldType)",
+        "@ColumnAccessors",  "#define @SoATypeName_@FieldName(soaPtr, i)    ((soaPtr)->@FieldName[(i)])\n"
+                             "#define @SoATypeName_Column_@FieldName(soaPtr)    ((soaPtr)->@FieldName)\n",
+        "@ColumnNextNulls",  "    next.@FieldName = NULL;\n",
+        "@ColumnAllocs",     "    if (ok && (next.@FieldName = (@FieldType*)@SoATypeName_AllocColumn(newCapacity * sizeof(@FieldType))) == NULL) {\n"
+                             "        ok = 0;\n"
+                             "    }\n\n",
+        "@ColumnFreeNext",   "        free(next.@FieldName);\n",
+        "@ColumnCopies",     "        memcpy(next.@FieldName, soa->@FieldName, soa->length * sizeof(@FieldType));\n",
+        "@ColumnMoves",      "    free(soa->@FieldName);\n"
+                             "    soa->@FieldName = next.@FieldName;\n",
+        "@ColumnNulls",      "    soa->@FieldName = NULL;\n",
+        "@ColumnFrees",      "    free(soa->@FieldName);\n",
+        "@ColumnStores",     "    soa->@FieldName[i] = record->@FieldName;\n",
+        "@ColumnLoads",      "    record->@FieldName = soa->@FieldName[i];\n",
+        "@ColumnShifts",     "    memmove(soa->@FieldName + index, soa->@FieldName + index + 1, n * sizeof(@FieldType));\n",
+        "@ColumnSwaps",      "    soa->@FieldName[index] = soa->@FieldName[last];\n",
+        "@ColumnKeeps",      "                soa->@FieldName[write] = soa->@FieldName[read];\n"
+    };
+
+    ReplaceTable rt[SOA_BLOCK_COUNT + 2];
+    String* blocks[SOA_BLOCK_COUNT];
+    size_t i;
+
+    for (i = 0; i < SOA_BLOCK_COUNT; ++i) {
+        if ((blocks[i] = expand_for_each_field(snippets[i].target, fields, fieldCount)) == NULL) {
+            while (i > 0) {
+                String_Destroy(blocks[--i]);
+            }
+
+            return;
+        }
+
+        rt[i].pattern = snippets[i].pattern;
+        rt[i].target = String_Data(blocks[i]);
+    }
+
+    /* the per field blocks still refer to the type names, so those go last. */
+    rt[SOA_BLOCK_COUNT].pattern = "@RecordTypeName";
+    rt[SOA_BLOCK_COUNT].target = recordTypeName;
+    rt[SOA_BLOCK_COUNT + 1].pattern = "@SoATypeName";
+    rt[SOA_BLOCK_COUNT + 1].target = soaTypeName;
+
+    replace_file_content_then_write_to_file("template_struct_of_arrays.txt", targetFilePath, rt, SOA_BLOCK_COUNT + 2);
+
+    for (i = 0; i < SOA_BLOCK_COUNT; ++i) {
+        String_Destroy(blocks[i]);
+    }
+
+    #undef SOA_BLOCK_COUNT
 }
 
 void example(void) {
@@ -209,6 +769,36 @@ void example(void) {
     create_doubly_linked_list("dlist_int.c", "int", "ListNodeInt", "ListInt");
     create_doubly_linked_list("stack_int.c", "int", "StackNodeInt", "StackInt");  /* stack based on doubly linked list. */
     create_doubly_linked_list("queue_int.c", "int", "QueueNodeInt", "QueueInt");  /* queue based on doubly linked list. */
+    create_work_stealing_deque("task_deque.c", "void*", "TaskDeque");  /* owner pushes / pops at the bottom, thieves steal from the top. */
+    create_bitset("bitset_1024.c", "1024", "Bitset1024");  /* fixed size, lives on the stack or inline in a struct. */
+    create_priority_queue("timer_queue.c", "double", "TimerQueue");  /* min-heap, define TimerQueue_LessThan to reorder. */
+    create_slot_map("entity_map.c", "double", "EntityMap");  /* handles survive removal of other entities. */
+    create_fixed_array("fixed_stack_int.c", "int", "64", "FixedStackInt");  /* no heap: for threads that must not call malloc. */
+    create_fixed_ring_queue("event_queue.c", "int", "256", "EventQueue");
+    create_fixed_pool_list("fixed_list_int.c", "int", "128", "FixedListInt");
+
+    {
+        const Filter filters[] = {
+            "Negative", "*elem < 0",
+            "Zero", "*elem == 0"
+        };
+
+        /* ArrayInt_RemoveNegative and ArrayInt_RemoveZero, next to the generic RemoveIf / Retain. */
+        create_array_with_filters("array_int.c", "int", "ArrayInt", filters, sizeof(filters) / sizeof(Filter));
+        create_fixed_pool_list_with_filters("fixed_list_int.c", "int", "128", "FixedListInt", filters, sizeof(filters) / sizeof(Filter));
+    }
+
+    {
+        const StructField particleFields[] = {
+            "float", "x",
+            "float", "y",
+            "float", "z",
+            "int", "id"
+        };
+
+        /* scanning x touches only the x column. */
+        create_struct_of_arrays("particles.c", "Particles", "Particle", particleFields, sizeof(particleFields) / sizeof(StructField));
+    }
 }
 
 int main() {
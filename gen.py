@@ -11,8 +11,98 @@ def do_file_replace(filePath, replaceMap):
         file.write(file_content)
 
 
-def create_array(targetFilePath, elementType, arrayTypeName):
+# a predicate compiled into its own removal function: filters is a list of (name, condition) pairs,
+# condition is a C expression over elem, a const pointer to the element, true means remove.
+# ('Negative', '*elem < 0') gives <TypeName>_RemoveNegative.
+ARRAY_FILTER_SNIPPET = (
+    'static int @ArrayTypeName_Is@FilterName(const @ElementType* elem) {\n'
+    '    return (@FilterCondition);\n'
+    '}\n'
+    '\n'
+    '/* @ArrayTypeName_RemoveIf with the predicate compiled in. */\n'
+    'size_t @ArrayTypeName_Remove@FilterName(@ArrayTypeName* arr) {\n'
+    '    size_t read, write = 0, removed;\n'
+    '\n'
+    '    if (!@ArrayTypeName_Own(arr)) {\n'
+    '        return 0;\n'
+    '    }\n'
+    '\n'
+    '    for (read = 0; read < arr->length; ++read) {\n'
+    '        if (!@ArrayTypeName_Is@FilterName(&arr->data[read])) {\n'
+    '            arr->data[write++] = arr->data[read];\n'
+    '        }\n'
+    '    }\n'
+    '\n'
+    '    removed = arr->length - write;\n'
+    '    arr->length = write;\n'
+    '    return removed;\n'
+    '}\n'
+    '\n'
+)
+
+# a fixed array is never mapped, it has no _Own.
+FIXED_ARRAY_FILTER_SNIPPET = ARRAY_FILTER_SNIPPET.replace(
+    '    if (!@ArrayTypeName_Own(arr)) {\n        return 0;\n    }\n\n', '').replace('@ArrayTypeName', '@FixedArrayTypeName')
+
+LIST_FILTER_SNIPPET = (
+    'static int @ListTypeName_Is@FilterName(const @ElementType* elem) {\n'
+    '    return (@FilterCondition);\n'
+    '}\n'
+    '\n'
+    '/* @ListTypeName_RemoveIf with the predicate compiled in. */\n'
+    'size_t @ListTypeName_Remove@FilterName(@ListTypeName* list) {\n'
+    '    @ListNodeTypeName* node = list->head;\n'
+    '    size_t removed = 0;\n'
+    '\n'
+    '    while (node != NULL) {\n'
+    '        if (@ListTypeName_Is@FilterName(&node->data)) {\n'
+    '            node = @ListTypeName_DeleteNode(list, node, 1);\n'
+    '            removed += 1;\n'
+    '        }\n'
+    '        else {\n'
+    '            node = node->next;\n'
+    '        }\n'
+    '    }\n'
+    '\n'
+    '    return removed;\n'
+    '}\n'
+    '\n'
+)
+
+POOL_LIST_FILTER_SNIPPET = (
+    'static int @PoolListTypeName_Is@FilterName(const @ElementType* elem) {\n'
+    '    return (@FilterCondition);\n'
+    '}\n'
+    '\n'
+    '/* @PoolListTypeName_RemoveIf with the predicate compiled in. */\n'
+    'uint32_t @PoolListTypeName_Remove@FilterName(@PoolListTypeName* list) {\n'
+    '    uint32_t node = @PoolListTypeName_Head(list), next, removed = 0;\n'
+    '\n'
+    '    while (node != @PoolListTypeName_END) {\n'
+    '        next = list->nodes[node].next;\n'
+    '\n'
+    '        if (@PoolListTypeName_Is@FilterName(&list->nodes[node].data)) {\n'
+    '            @PoolListTypeName_Remove(list, node);\n'
+    '            removed += 1;\n'
+    '        }\n'
+    '\n'
+    '        node = next;\n'
+    '    }\n'
+    '\n'
+    '    return removed;\n'
+    '}\n'
+    '\n'
+)
+
+
+def expand_for_each_filter(snippet, filters):
+    return ''.join(snippet.replace('@FilterName', name).replace('@FilterCondition', condition) for name, condition in filters)
+
+
+def create_array(targetFilePath, elementType, arrayTypeName, filters=()):
+    # the filters still refer to the type names, so they go first.
     replaceMap = {
+        '@Filters': expand_for_each_filter(ARRAY_FILTER_SNIPPET, filters),
         '@ElementType': elementType,
         '@ArrayTypeName': arrayTypeName
     }
@@ -22,8 +112,9 @@ def create_array(targetFilePath, elementType, arrayTypeName):
     do_file_replace(targetFilePath, replaceMap)
 
 
-def create_doubly_linked_list(targetFilePath, elementType, listNodeTypeName, listTypeName):
+def create_doubly_linked_list(targetFilePath, elementType, listNodeTypeName, listTypeName, filters=()):
     replaceMap = {
+        '@Filters': expand_for_each_filter(LIST_FILTER_SNIPPET, filters),
         '@ElementType': elementType,
         '@ListNodeTypeName': listNodeTypeName,
         '@ListTypeName': listTypeName
@@ -34,5 +125,126 @@ def create_doubly_linked_list(targetFilePath, elementType, listNodeTypeName, lis
     do_file_replace(targetFilePath, replaceMap)
 
 
+def create_work_stealing_deque(targetFilePath, elementType, dequeTypeName):
+    replaceMap = {
+        '@ElementType': elementType,
+        '@DequeTypeName': dequeTypeName
+    }
+
+    templateFile = './template_work_stealing_deque.txt'
+    shutil.copyfile(templateFile, targetFilePath)
+    do_file_replace(targetFilePath, replaceMap)
+
+
+def create_bitset(targetFilePath, bitCount, bitsetTypeName):
+    replaceMap = {
+        '@BitCount': str(bitCount),
+        '@BitsetTypeName': bitsetTypeName
+    }
+
+    templateFile = './template_bitset.txt'
+    shutil.copyfile(templateFile, targetFilePath)
+    do_file_replace(targetFilePath, replaceMap)
+
+
+def create_priority_queue(targetFilePath, elementType, priorityQueueTypeName):
+    replaceMap = {
+        '@ElementType': elementType,
+        '@PriorityQueueTypeName': priorityQueueTypeName
+    }
+
+    templateFile = './template_priority_queue.txt'
+    shutil.copyfile(templateFile, targetFilePath)
+    do_file_replace(targetFilePath, replaceMap)
+
+
+def create_slot_map(targetFilePath, elementType, slotMapTypeName):
+    replaceMap = {
+        '@ElementType': elementType,
+        '@SlotMapTypeName': slotMapTypeName
+    }
+
+    templateFile = './template_slot_map.txt'
+    shutil.copyfile(templateFile, targetFilePath)
+    do_file_replace(targetFilePath, replaceMap)
+
+
+def create_fixed_array(targetFilePath, elementType, capacity, fixedArrayTypeName, filters=()):
+    replaceMap = {
+        '@Filters': expand_for_each_filter(FIXED_ARRAY_FILTER_SNIPPET, filters),
+        '@ElementType': elementType,
+        '@Capacity': str(capacity),
+        '@FixedArrayTypeName': fixedArrayTypeName
+    }
+
+    templateFile = './template_fixed_array.txt'
+    shutil.copyfile(templateFile, targetFilePath)
+    do_file_replace(targetFilePath, replaceMap)
+
+
+def create_fixed_ring_queue(targetFilePath, elementType, capacity, ringQueueTypeName):
+    replaceMap = {
+        '@ElementType': elementType,
+        '@Capacity': str(capacity),
+        '@RingQueueTypeName': ringQueueTypeName
+    }
+
+    templateFile = './template_fixed_ring_queue.txt'
+    shutil.copyfile(templateFile, targetFilePath)
+    do_file_replace(targetFilePath, replaceMap)
+
+
+def create_fixed_pool_list(targetFilePath, elementType, capacity, poolListTypeName, filters=()):
+    replaceMap = {
+        '@Filters': expand_for_each_filter(POOL_LIST_FILTER_SNIPPET, filters),
+        '@ElementType': elementType,
+        '@Capacity': str(capacity),
+        '@PoolListTypeName': poolListTypeName
+    }
+
+    templateFile = './template_fixed_pool_list.txt'
+    shutil.copyfile(templateFile, targetFilePath)
+    do_file_replace(targetFilePath, replaceMap)
+
+
+def expand_for_each_field(snippet, fields):
+    return ''.join(snippet.replace('@FieldType', fieldType).replace('@FieldName', fieldName) for fieldType, fieldName in fields)
+
+
+def create_struct_of_arrays(targetFilePath, soaTypeName, recordTypeName, fields):
+    """fields is a list of (type, name) pairs, one column is emitted per field."""
+    snippets = {
+        '@RecordFields': '    @FieldType @FieldName;\n',
+        '@ColumnFields': '    @FieldType* @FieldName;\n',
+        '@ColumnRowSize': ' + sizeof(@FieldType)',
+        '@ColumnAccessors': '#define @SoATypeName_@FieldName(soaPtr, i)    ((soaPtr)->@FieldName[(i)])\n'
+                            '#define @SoATypeName_Column_@FieldName(soaPtr)    ((soaPtr)->@FieldName)\n',
+        '@ColumnNextNulls': '    next.@FieldName = NULL;\n',
+        '@ColumnAllocs': '    if (ok && (next.@FieldName = (@FieldType*)@SoATypeName_AllocColumn(newCapacity * sizeof(@FieldType))) == NULL) {\n'
+                         '        ok = 0;\n'
+                         '    }\n\n',
+        '@ColumnFreeNext': '        free(next.@FieldName);\n',
+        '@ColumnCopies': '        memcpy(next.@FieldName, soa->@FieldName, soa->length * sizeof(@FieldType));\n',
+        '@ColumnMoves': '    free(soa->@FieldName);\n'
+                        '    soa->@FieldName = next.@FieldName;\n',
+        '@ColumnNulls': '    soa->@FieldName = NULL;\n',
+        '@ColumnFrees': '    free(soa->@FieldName);\n',
+        '@ColumnStores': '    soa->@FieldName[i] = record->@FieldName;\n',
+        '@ColumnLoads': '    record->@FieldName = soa->@FieldName[i];\n',
+        '@ColumnShifts': '    memmove(soa->@FieldName + index, soa->@FieldName + index + 1, n * sizeof(@FieldType));\n',
+        '@ColumnSwaps': '    soa->@FieldName[index] = soa->@FieldName[last];\n',
+        '@ColumnKeeps': '                soa->@FieldName[write] = soa->@FieldName[read];\n'
+    }
+
+    # the per field blocks still refer to the type names, so those go last.
+    replaceMap = {pattern: expand_for_each_field(snippet, fields) for pattern, snippet in snippets.items()}
+    replaceMap['@RecordTypeName'] = recordTypeName
+    replaceMap['@SoATypeName'] = soaTypeName
+
+    templateFile = './template_struct_of_arrays.txt'
+    shutil.copyfile(templateFile, targetFilePath)
+    do_file_replace(targetFilePath, replaceMap)
+
+
 if __name__ == '__main__':
     create_array('array_int64.c', 'int64_t', 'ArrayInt64')
@@ -0,0 +1,140 @@
+/**
+ * slabs for the Compact operation of the node based containers: Compact copies every node, in
+ * traversal order, into one contiguous slab and frees the scattered originals, so a traversal walks
+ * memory sequentially again.
+ *
+ * a node inside a slab must not be passed to free(), NodeSlabSet_FreeNode tells the two apart. a slab
+ * counts its live nodes and the sets referring to it, and is released once both reach 0. a container
+ * keeps a set because nodes can move between containers (DList_Splice): the receiving container merges
+ * the sender's set into its own and so can still recognize those nodes.
+ */
+#ifndef NODE_SLAB_H
+#define NODE_SLAB_H
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct NodeSlab {
+    char* begin;
+    char* end;
+    size_t live;   /* nodes not freed yet. */
+    size_t refs;   /* sets holding this slab. */
+} NodeSlab;
+
+typedef struct NodeSlabSet {
+    NodeSlab** slabs;
+    size_t length;
+    size_t capacity;
+} NodeSlabSet;
+
+/* room for count nodes of nodeSize bytes, all counted as live. */
+static inline NodeSlab* NodeSlab_CreateNew(size_t nodeSize, size_t count) {
+    NodeSlab* slab = (NodeSlab*)malloc(sizeof(NodeSlab));
+    if (slab == NULL) {
+        return NULL;
+    }
+
+    if ((slab->begin = (char*)malloc(nodeSize * count)) == NULL) {
+        free(slab);
+        return NULL;
+    }
+
+    slab->end = slab->begin + nodeSize * count;
+    slab->live = count;
+    slab->refs = 0;
+    return slab;
+}
+
+/* nodeSize rounded up so that every node in a slab is as aligned as one from malloc(). */
+static inline size_t NodeSlab_Stride(size_t nodeSize) {
+    return (nodeSize + _Alignof(max_align_t) - 1) / _Alignof(max_align_t) * _Alignof(max_align_t);
+}
+
+static inline void NodeSlab_Destroy(NodeSlab* slab) {
+    free(slab->begin);
+    free(slab);
+}
+
+static inline void NodeSlabSet_Init(NodeSlabSet* set) {
+    set->slabs = NULL;
+    set->length = 0;
+    set->capacity = 0;
+}
+
+/* return 0 when out of memory. */
+static inline int NodeSlabSet_Add(NodeSlabSet* set, NodeSlab* slab) {
+    NodeSlab** temp;
+    size_t i;
+
+    for (i = 0; i < set->length; ++i) {
+        if (set->slabs[i] == slab) {
+            return 1;
+        }
+    }
+
+    if (set->length == set->capacity) {
+        if ((temp = (NodeSlab**)realloc(set->slabs, (set->capacity == 0 ? 2 : 2 * set->capacity) * sizeof(NodeSlab*))) == NULL) {
+            return 0;
+        }
+
+        set->slabs = temp;
+        set->capacity = (set->capacity == 0 ? 2 : 2 * set->capacity);
+    }
+
+    set->slabs[set->length++] = slab;
+    slab->refs += 1;
+    return 1;
+}
+
+/* make dst recognize every node src does, return 0 when out of memory (dst may hold some of them). */
+static inline int NodeSlabSet_Merge(NodeSlabSet* dst, const NodeSlabSet* src) {
+    size_t i;
+
+    for (i = 0; i < src->length; ++i) {
+        if (!NodeSlabSet_Add(dst, src->slabs[i])) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static inline void NodeSlabSet_RemoveAt(NodeSlabSet* set, size_t i) {
+    NodeSlab* slab = set->slabs[i];
+
+    set->slabs[i] = set->slabs[--set->length];
+
+    if (--slab->refs == 0 && slab->live == 0) {
+        NodeSlab_Destroy(slab);
+    }
+}
+
+/* drop every slab, the set is empty afterwards. */
+static inline void NodeSlabSet_Release(NodeSlabSet* set) {
+    while (set->length > 0) {
+        NodeSlabSet_RemoveAt(set, set->length - 1);
+    }
+
+    free(set->slabs);
+    NodeSlabSet_Init(set);
+}
+
+/* return 1 when node lives in one of the slabs (it is accounted for there), 0 when it must be free()d. */
+static inline int NodeSlabSet_FreeNode(NodeSlabSet* set, void* node) {
+    size_t i;
+
+    for (i = 0; i < set->length; ++i) {
+        if ((uintptr_t)node >= (uintptr_t)set->slabs[i]->begin && (uintptr_t)node < (uintptr_t)set->slabs[i]->end) {
+            if (--set->slabs[i]->live == 0) {
+                NodeSlabSet_RemoveAt(set, i);
+            }
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+#endif
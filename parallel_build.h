@@ -0,0 +1,174 @@
+/**
+ * parallel bulk build of a chained hash table from n items, radix-partition style, no locks:
+ *   1. every thread hashes a slice of the items and counts them per bucket,
+ *   2. the counts are summed up into one slot range per (bucket, thread), so the slots of a bucket
+ *      are contiguous and in item order,
+ *   3. every thread places its items into its own slots,
+ *   4. every thread chains the slots of its own range of buckets.
+ * the table provides the callbacks, it allocates all n nodes in one block up front and a slot is an
+ * index into that block. the callbacks run concurrently on distinct items, slots and buckets.
+ *
+ * link with -lpthread.
+ */
+#ifndef PARALLEL_BUILD_H
+#define PARALLEL_BUILD_H
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define PARALLEL_BUILD_MAX_THREADS      64
+#define PARALLEL_BUILD_MIN_PER_THREAD   16384   /* fewer items than that per thread are not worth a thread. */
+
+typedef size_t (*ParallelBuild_HashFunc) (void* ctx, size_t item);                   /* bucket of item. */
+typedef void (*ParallelBuild_PlaceFunc) (void* ctx, size_t item, size_t slot);        /* put item into slot. */
+typedef void (*ParallelBuild_LinkFunc) (void* ctx, size_t bucket, size_t begin, size_t end);   /* chain the slots [begin, end). */
+
+typedef struct ParallelBuild {
+    void* ctx;
+    size_t count;
+    size_t bucketCount;
+    size_t threadCount;
+    size_t* bucketOf;      /* count entries. */
+    size_t* offsets;       /* threadCount x bucketCount: item counts, then the next free slot. */
+    size_t* bucketBegin;   /* bucketCount + 1 entries. */
+
+    ParallelBuild_HashFunc hash;
+    ParallelBuild_PlaceFunc place;
+    ParallelBuild_LinkFunc link;
+} ParallelBuild;
+
+typedef struct ParallelBuildJob {
+    ParallelBuild* build;
+    size_t thread;
+} ParallelBuildJob;
+
+static inline void* ParallelBuild_HashSlice(void* arg) {
+    ParallelBuildJob* job = (ParallelBuildJob*)arg;
+    ParallelBuild* pb = job->build;
+    size_t* counts = pb->offsets + job->thread * pb->bucketCount;
+    size_t end = pb->count * (job->thread + 1) / pb->threadCount;
+    size_t i;
+
+    for (i = pb->count * job->thread / pb->threadCount; i < end; ++i) {
+        pb->bucketOf[i] = pb->hash(pb->ctx, i);
+        counts[pb->bucketOf[i]] += 1;
+    }
+
+    return NULL;
+}
+
+static inline void* ParallelBuild_PlaceSlice(void* arg) {
+    ParallelBuildJob* job = (ParallelBuildJob*)arg;
+    ParallelBuild* pb = job->build;
+    size_t* next = pb->offsets + job->thread * pb->bucketCount;
+    size_t end = pb->count * (job->thread + 1) / pb->threadCount;
+    size_t i;
+
+    for (i = pb->count * job->thread / pb->threadCount; i < end; ++i) {
+        pb->place(pb->ctx, i, next[pb->bucketOf[i]]++);
+    }
+
+    return NULL;
+}
+
+static inline void* ParallelBuild_LinkSlice(void* arg) {
+    ParallelBuildJob* job = (ParallelBuildJob*)arg;
+    ParallelBuild* pb = job->build;
+    size_t end = pb->bucketCount * (job->thread + 1) / pb->threadCount;
+    size_t b;
+
+    for (b = pb->bucketCount * job->thread / pb->threadCount; b < end; ++b) {
+        pb->link(pb->ctx, b, pb->bucketBegin[b], pb->bucketBegin[b + 1]);
+    }
+
+    return NULL;
+}
+
+/* run func on every thread slice, the calling thread takes slice 0 and any slice no thread was started for. */
+static inline void ParallelBuild_Phase(ParallelBuild* pb, void* (*func)(void*)) {
+    pthread_t threads[PARALLEL_BUILD_MAX_THREADS];
+    ParallelBuildJob jobs[PARALLEL_BUILD_MAX_THREADS];
+    int started[PARALLEL_BUILD_MAX_THREADS];
+    size_t t;
+
+    for (t = 0; t < pb->threadCount; ++t) {
+        jobs[t].build = pb;
+        jobs[t].thread = t;
+        started[t] = (t > 0 && pthread_create(&threads[t], NULL, func, &jobs[t]) == 0);
+    }
+
+    for (t = 0; t < pb->threadCount; ++t) {
+        if (!started[t]) {
+            func(&jobs[t]);
+        }
+    }
+
+    for (t = 1; t < pb->threadCount; ++t) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+}
+
+/* threadCount 0 means one per online cpu. return 0 when out of memory, no callback has run then. */
+static inline int ParallelBuild_Run(void* ctx, size_t count, size_t bucketCount, size_t threadCount,
+                                    ParallelBuild_HashFunc hash, ParallelBuild_PlaceFunc place, ParallelBuild_LinkFunc link) {
+    ParallelBuild pb;
+    long cpus;
+    size_t b, t, slot;
+    int ok = 0;
+
+    if (threadCount == 0) {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = (cpus > 0 ? (size_t)cpus : 1);
+    }
+
+    if (threadCount > count / PARALLEL_BUILD_MIN_PER_THREAD) {
+        threadCount = count / PARALLEL_BUILD_MIN_PER_THREAD;
+    }
+
+    if (threadCount > PARALLEL_BUILD_MAX_THREADS) {
+        threadCount = PARALLEL_BUILD_MAX_THREADS;
+    }
+
+    pb.ctx = ctx;
+    pb.count = count;
+    pb.bucketCount = bucketCount;
+    pb.threadCount = (threadCount == 0 ? 1 : threadCount);
+    pb.hash = hash;
+    pb.place = place;
+    pb.link = link;
+    pb.bucketOf = (size_t*)malloc((count == 0 ? 1 : count) * sizeof(size_t));
+    pb.offsets = (size_t*)calloc(pb.threadCount * bucketCount, sizeof(size_t));
+    pb.bucketBegin = (size_t*)malloc((bucketCount + 1) * sizeof(size_t));
+
+    if (pb.bucketOf != NULL && pb.offsets != NULL && pb.bucketBegin != NULL) {
+        ParallelBuild_Phase(&pb, ParallelBuild_HashSlice);
+
+        /* bucket-major, thread-minor: each thread's items of a bucket follow those of the thread before. */
+        for (slot = 0, b = 0; b < bucketCount; ++b) {
+            pb.bucketBegin[b] = slot;
+
+            for (t = 0; t < pb.threadCount; ++t) {
+                size_t n = pb.offsets[t * bucketCount + b];
+                pb.offsets[t * bucketCount + b] = slot;
+                slot += n;
+            }
+        }
+
+        pb.bucketBegin[bucketCount] = slot;
+
+        ParallelBuild_Phase(&pb, ParallelBuild_PlaceSlice);
+        ParallelBuild_Phase(&pb, ParallelBuild_LinkSlice);
+        ok = 1;
+    }
+
+    free(pb.bucketOf);
+    free(pb.offsets);
+    free(pb.bucketBegin);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,351 @@
+/**
+ * hardware performance counters for the benchmarks, read through Linux perf_event_open.
+ *
+ * PerfCounters_Start / PerfCounters_Stop bracket a measured section, the sample holds every counter
+ * divided by the operation count: cycles, instructions, L1D read misses, last level cache misses,
+ * branch misses, dTLB read misses and page faults, plus the wall time. counters are opened one by one,
+ * each is scaled by time_enabled / time_running when the kernel multiplexes them, and a counter the
+ * machine does not have (a VM, perf_event_paranoid, no PMU) is reported as n/a while the others go on.
+ * without Linux only the wall time is measured.
+ *
+ * a baseline is a text file of "name value value ..." lines, written by PerfBaseline_Save and read back
+ * by PerfBaseline_Load, PerfBaseline_Compare prints every counter that got worse by more than a
+ * threshold so a slower run comes with the cause next to it.
+ *
+ * the including file must define _GNU_SOURCE before its first system header (sched_setaffinity, syscall).
+ */
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+typedef enum PerfCounterId {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_L1D_MISSES,
+    PERF_COUNTER_LLC_MISSES,
+    PERF_COUNTER_BRANCH_MISSES,
+    PERF_COUNTER_DTLB_MISSES,
+    PERF_COUNTER_PAGE_FAULTS,
+    PERF_COUNTER_COUNT
+} PerfCounterId;
+
+static const char* const PerfCounter_Names[PERF_COUNTER_COUNT] = {
+    "cycles", "instr", "L1D-miss", "LLC-miss", "br-miss", "dTLB-miss", "faults"
+};
+
+typedef struct PerfCounters {
+    int fd[PERF_COUNTER_COUNT];   /* -1 when the counter is not available. */
+    struct timespec begin;
+} PerfCounters;
+
+typedef struct PerfSample {
+    size_t ops;
+    double nsPerOp;
+    double perOp[PERF_COUNTER_COUNT];
+    int valid[PERF_COUNTER_COUNT];
+} PerfSample;
+
+#if defined(__linux__)
+static inline int PerfCounters_OpenOne(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+#define PERF_COUNTERS_CACHE_READ_MISS(cache) \
+    ((uint64_t)(cache) | ((uint64_t)PERF_COUNT_HW_CACHE_OP_READ << 8) | ((uint64_t)PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+#endif
+
+/* return how many counters could be opened, 0 means wall time only. */
+static inline int PerfCounters_Open(PerfCounters* pc) {
+    int i, opened = 0;
+
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        pc->fd[i] = -1;
+    }
+
+#if defined(__linux__)
+    pc->fd[PERF_COUNTER_CYCLES] = PerfCounters_OpenOne(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    pc->fd[PERF_COUNTER_INSTRUCTIONS] = PerfCounters_OpenOne(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    pc->fd[PERF_COUNTER_L1D_MISSES] = PerfCounters_OpenOne(PERF_TYPE_HW_CACHE, PERF_COUNTERS_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D));
+    pc->fd[PERF_COUNTER_LLC_MISSES] = PerfCounters_OpenOne(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    pc->fd[PERF_COUNTER_BRANCH_MISSES] = PerfCounters_OpenOne(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    pc->fd[PERF_COUNTER_DTLB_MISSES] = PerfCounters_OpenOne(PERF_TYPE_HW_CACHE, PERF_COUNTERS_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB));
+    pc->fd[PERF_COUNTER_PAGE_FAULTS] = PerfCounters_OpenOne(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (pc->fd[i] < 0) {
+            pc->fd[i] = -1;
+        }
+        else {
+            opened += 1;
+        }
+    }
+#endif
+
+    return opened;
+}
+
+static inline void PerfCounters_Close(PerfCounters* pc) {
+#if defined(__linux__)
+    int i;
+
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (pc->fd[i] >= 0) {
+            close(pc->fd[i]);
+            pc->fd[i] = -1;
+        }
+    }
+#endif
+}
+
+/* keep the calling thread on one cpu, return 0 when that is not possible. */
+static inline int PerfCounters_PinToCpu(int cpu) {
+#if defined(__linux__)
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return 0;
+#endif
+}
+
+static inline void PerfCounters_Start(PerfCounters* pc) {
+#if defined(__linux__)
+    int i;
+
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (pc->fd[i] >= 0) {
+            ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+
+    clock_gettime(CLOCK_MONOTONIC, &pc->begin);
+}
+
+static inline void PerfCounters_Stop(PerfCounters* pc, size_t ops, PerfSample* out) {
+    struct timespec end;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+#if defined(__linux__)
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (pc->fd[i] >= 0) {
+            ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+#endif
+
+    if (ops == 0) {
+        ops = 1;
+    }
+
+    out->ops = ops;
+    out->nsPerOp = ((double)(end.tv_sec - pc->begin.tv_sec) * 1e9 + (double)(end.tv_nsec - pc->begin.tv_nsec)) / (double)ops;
+
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        out->valid[i] = 0;
+        out->perOp[i] = 0;
+
+#if defined(__linux__)
+        uint64_t values[3];   /* value, time enabled, time running. */
+
+        if (pc->fd[i] >= 0 && read(pc->fd[i], values, sizeof(values)) == (ssize_t)sizeof(values) && values[2] != 0) {
+            out->perOp[i] = (double)values[0] * ((double)values[1] / (double)values[2]) / (double)ops;
+            out->valid[i] = 1;
+        }
+#endif
+    }
+}
+
+static inline void PerfSample_PrintHeader(FILE* f) {
+    int i;
+
+    fprintf(f, "%-28s %10s", "benchmark (per op)", "ns");
+
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        fprintf(f, " %10s", PerfCounter_Names[i]);
+    }
+
+    fprintf(f, "\n");
+}
+
+static inline void PerfSample_Print(FILE* f, const char* name, const PerfSample* sample) {
+    int i;
+
+    fprintf(f, "%-28s %10.2f", name, sample->nsPerOp);
+
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (sample->valid[i]) {
+            fprintf(f, " %10.3f", sample->perOp[i]);
+        }
+        else {
+            fprintf(f, " %10s", "n/a");
+        }
+    }
+
+    fprintf(f, "\n");
+}
+
+/* one line per benchmark: name, ns, then every counter or "-" when it was not available. */
+static inline int PerfBaseline_Save(const char* filePath, const char* const* names, const PerfSample* samples, size_t count) {
+    FILE* f = fopen(filePath, "w");
+    size_t i;
+    int j;
+
+    if (f == NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < count; ++i) {
+        fprintf(f, "%s %.6g", names[i], samples[i].nsPerOp);
+
+        for (j = 0; j < PERF_COUNTER_COUNT; ++j) {
+            if (samples[i].valid[j]) {
+                fprintf(f, " %.6g", samples[i].perOp[j]);
+            }
+            else {
+                fprintf(f, " -");
+            }
+        }
+
+        fprintf(f, "\n");
+    }
+
+    return fclose(f) == 0;
+}
+
+#define PERF_BASELINE_NAME_MAX   64
+
+typedef struct PerfBaselineEntry {
+    char name[PERF_BASELINE_NAME_MAX];
+    PerfSample sample;
+} PerfBaselineEntry;
+
+typedef struct PerfBaseline {
+    PerfBaselineEntry* entries;
+    size_t length;
+} PerfBaseline;
+
+/* NULL when the file cannot be read, malformed lines are skipped. */
+static inline PerfBaseline* PerfBaseline_Load(const char* filePath) {
+    PerfBaseline* baseline;
+    PerfBaselineEntry entry;
+    PerfBaselineEntry* temp;
+    size_t capacity = 0;
+    char field[32];
+    int j, ok;
+    FILE* f;
+
+    if ((f = fopen(filePath, "r")) == NULL) {
+        return NULL;
+    }
+
+    if ((baseline = (PerfBaseline*)malloc(sizeof(PerfBaseline))) == NULL) {
+        fclose(f);
+        return NULL;
+    }
+
+    baseline->entries = NULL;
+    baseline->length = 0;
+
+    while (fscanf(f, "%63s %lf", entry.name, &entry.sample.nsPerOp) == 2) {
+        ok = 1;
+
+        for (j = 0; ok && j < PERF_COUNTER_COUNT; ++j) {
+            ok = (fscanf(f, "%31s", field) == 1);
+            entry.sample.valid[j] = ok && strcmp(field, "-") != 0;
+            entry.sample.perOp[j] = entry.sample.valid[j] ? strtod(field, NULL) : 0;
+        }
+
+        if (!ok) {
+            break;
+        }
+
+        if (baseline->length == capacity) {
+            capacity = (capacity == 0 ? 16 : 2 * capacity);
+
+            if ((temp = (PerfBaselineEntry*)realloc(baseline->entries, capacity * sizeof(PerfBaselineEntry))) == NULL) {
+                break;
+            }
+
+            baseline->entries = temp;
+        }
+
+        baseline->entries[baseline->length++] = entry;
+    }
+
+    fclose(f);
+    return baseline;
+}
+
+static inline void PerfBaseline_Destroy(PerfBaseline* baseline) {
+    free(baseline->entries);
+    free(baseline);
+}
+
+/**
+ * print the counters of sample that are more than thresholdPercent above the baseline entry of the
+ * same name, return how many regressed (0 also when the name is not in the baseline).
+ */
+static inline int PerfBaseline_Compare(FILE* f, const PerfBaseline* baseline, const char* name, const PerfSample* sample, double thresholdPercent) {
+    const PerfSample* base = NULL;
+    double limit = 1.0 + thresholdPercent / 100.0;
+    int j, regressions = 0;
+    size_t i;
+
+    for (i = 0; i < baseline->length; ++i) {
+        if (strcmp(baseline->entries[i].name, name) == 0) {
+            base = &baseline->entries[i].sample;
+            break;
+        }
+    }
+
+    if (base == NULL) {
+        return 0;
+    }
+
+    if (sample->nsPerOp > base->nsPerOp * limit) {
+        fprintf(f, "  regression %s: ns %.2f -> %.2f (%+.1f%%)\n", name, base->nsPerOp, sample->nsPerOp, 100.0 * (sample->nsPerOp / base->nsPerOp - 1.0));
+        regressions += 1;
+    }
+
+    for (j = 0; j < PERF_COUNTER_COUNT; ++j) {
+        /* counts below 0.01 per op are noise. */
+        if (sample->valid[j] && base->valid[j] && sample->perOp[j] > 0.01 && sample->perOp[j] > base->perOp[j] * limit) {
+            fprintf(f, "  regression %s: %s %.3f -> %.3f per op\n", name, PerfCounter_Names[j], base->perOp[j], sample->perOp[j]);
+            regressions += 1;
+        }
+    }
+
+    return regressions;
+}
+
+#endif
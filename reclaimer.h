@@ -0,0 +1,189 @@
+/**
+ * background reclaimer: tears down detached containers on its own thread, so the thread that drops
+ * a huge container does not pay for freeing it. X_DestroyAsync hands a container over in O(1), the
+ * reclaimer frees it RECLAIMER_BATCH nodes at a time and releases its lock between the batches.
+ *
+ * the destroy callbacks of a container handed over run on the reclaimer thread: they must not touch
+ * anything the caller keeps using without synchronization (free() and friends are fine).
+ *
+ * outstanding work is counted in nodes. Reclaimer_Wait blocks until everything handed over is freed,
+ * and a reclaimer created with maxOutstanding > 0 makes Reclaimer_Submit block while more than that
+ * many nodes are waiting, which bounds the memory held by garbage.
+ *
+ * link with -lpthread.
+ */
+#ifndef RECLAIMER_H
+#define RECLAIMER_H
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define RECLAIMER_BATCH   4096
+
+/**
+ * free up to budget nodes of the detached container garbage and return how many were freed. less
+ * than budget means it is all gone, the container itself included, and it is not called again.
+ */
+typedef size_t (*Reclaimer_StepFunc) (void* garbage, size_t budget);
+
+typedef struct ReclaimerJob {
+    struct ReclaimerJob* next;
+    Reclaimer_StepFunc step;
+    void* garbage;
+    size_t weight;   /* nodes not yet freed, as announced by the submitter. */
+} ReclaimerJob;
+
+typedef struct Reclaimer {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t pending;   /* a job came in, or stop. */
+    pthread_cond_t done;      /* outstanding went down. */
+
+    ReclaimerJob* head;
+    ReclaimerJob* tail;
+    size_t outstanding;
+    size_t maxOutstanding;   /* 0 means no bound. */
+    int stop;
+} Reclaimer;
+
+static inline void* Reclaimer_Run(void* arg) {
+    Reclaimer* rc = (Reclaimer*)arg;
+    ReclaimerJob* job;
+    size_t freed;
+
+    pthread_mutex_lock(&rc->lock);
+
+    for (;;) {
+        while (rc->head == NULL && !rc->stop) {
+            pthread_cond_wait(&rc->pending, &rc->lock);
+        }
+
+        if (rc->head == NULL) {
+            break;
+        }
+
+        /* only this thread removes jobs, so head stays valid while the lock is released. */
+        job = rc->head;
+        pthread_mutex_unlock(&rc->lock);
+        freed = job->step(job->garbage, RECLAIMER_BATCH);
+        pthread_mutex_lock(&rc->lock);
+
+        if (freed < RECLAIMER_BATCH) {
+            if ((rc->head = job->next) == NULL) {
+                rc->tail = NULL;
+            }
+
+            rc->outstanding -= job->weight;
+            free(job);
+        }
+        else {
+            freed = (freed < job->weight ? freed : job->weight);
+            job->weight -= freed;
+            rc->outstanding -= freed;
+        }
+
+        pthread_cond_broadcast(&rc->done);
+    }
+
+    pthread_mutex_unlock(&rc->lock);
+    return NULL;
+}
+
+/* maxOutstanding 0 means Reclaimer_Submit never blocks. */
+static inline Reclaimer* Reclaimer_CreateNew(size_t maxOutstanding) {
+    Reclaimer* rc = (Reclaimer*)malloc(sizeof(Reclaimer));
+    if (rc == NULL) {
+        return NULL;
+    }
+
+    rc->head = rc->tail = NULL;
+    rc->outstanding = 0;
+    rc->maxOutstanding = maxOutstanding;
+    rc->stop = 0;
+    pthread_mutex_init(&rc->lock, NULL);
+    pthread_cond_init(&rc->pending, NULL);
+    pthread_cond_init(&rc->done, NULL);
+
+    if (pthread_create(&rc->thread, NULL, Reclaimer_Run, rc) != 0) {
+        pthread_cond_destroy(&rc->done);
+        pthread_cond_destroy(&rc->pending);
+        pthread_mutex_destroy(&rc->lock);
+        free(rc);
+        return NULL;
+    }
+
+    return rc;
+}
+
+/**
+ * hand garbage over, weight is the number of nodes it holds. blocks while the bound would be
+ * exceeded, unless nothing is outstanding. return 0 when out of memory, the caller still owns garbage.
+ */
+static inline int Reclaimer_Submit(Reclaimer* rc, Reclaimer_StepFunc step, void* garbage, size_t weight) {
+    ReclaimerJob* job = (ReclaimerJob*)malloc(sizeof(ReclaimerJob));
+    if (job == NULL) {
+        return 0;
+    }
+
+    job->next = NULL;
+    job->step = step;
+    job->garbage = garbage;
+    job->weight = weight;
+
+    pthread_mutex_lock(&rc->lock);
+
+    while (rc->maxOutstanding > 0 && rc->outstanding > 0 && rc->outstanding + weight > rc->maxOutstanding) {
+        pthread_cond_wait(&rc->done, &rc->lock);
+    }
+
+    if (rc->tail == NULL) {
+        rc->head = rc->tail = job;
+    }
+    else {
+        rc->tail->next = job;
+        rc->tail = job;
+    }
+
+    rc->outstanding += weight;
+    pthread_cond_signal(&rc->pending);
+    pthread_mutex_unlock(&rc->lock);
+    return 1;
+}
+
+/* nodes handed over and not freed yet. */
+static inline size_t Reclaimer_Outstanding(Reclaimer* rc) {
+    size_t outstanding;
+
+    pthread_mutex_lock(&rc->lock);
+    outstanding = rc->outstanding;
+    pthread_mutex_unlock(&rc->lock);
+    return outstanding;
+}
+
+/* block until everything handed over so far is freed. */
+static inline void Reclaimer_Wait(Reclaimer* rc) {
+    pthread_mutex_lock(&rc->lock);
+
+    while (rc->head != NULL) {
+        pthread_cond_wait(&rc->done, &rc->lock);
+    }
+
+    pthread_mutex_unlock(&rc->lock);
+}
+
+/* finish the outstanding work, then stop the thread. */
+static inline void Reclaimer_Destroy(Reclaimer* rc) {
+    pthread_mutex_lock(&rc->lock);
+    rc->stop = 1;
+    pthread_cond_signal(&rc->pending);
+    pthread_mutex_unlock(&rc->lock);
+
+    pthread_join(rc->thread, NULL);
+    pthread_cond_destroy(&rc->done);
+    pthread_cond_destroy(&rc->pending);
+    pthread_mutex_destroy(&rc->lock);
+    free(rc);
+}
+
+#endif
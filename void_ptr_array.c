@@ -1,11 +1,22 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "container_stats.h"
 
 typedef void(*GenericArray_RemoveElemFunc)(void*);
 void GenericArray_RemoveElemFunc_Default(void*) {}
 
+typedef int (*GenericArray_PredicateFunc) (void* elem, void* arg);   /* return non 0 to select elem. */
+
 typedef struct GenericArray {
     void* data;
     size_t capacity;
@@ -13,6 +24,11 @@ typedef struct GenericArray {
     size_t elemSize;
 
     GenericArray_RemoveElemFunc removeElemFunc;
+
+    void* mapBase;       /* not NULL when data lives in a file mapping, see GenericArray_Map. */
+    size_t mapLength;
+
+    CONTAINER_STATS_FIELD(stats)
 } GenericArray;
 
 #define GenericArray_At(arrPtr, index) \
@@ -49,12 +65,16 @@ GenericArray* GenericArray_CreateNew(size_t capacity, size_t elemSize, GenericAr
     arr->elemSize = elemSize;
     arr->length = 0;
     arr->capacity = (capacity == 0 ? 15 : capacity);
+    arr->mapBase = NULL;
+    arr->mapLength = 0;
 
     if ((arr->data = malloc(arr->capacity * elemSize)) == NULL) {
         free(arr);
         return NULL;
     }
 
+    ContainerStats_Init(&arr->stats, "GenericArray");
+    ContainerStats_OnAlloc(&arr->stats, arr->capacity * elemSize);
     return arr;
 }
 
@@ -64,24 +84,47 @@ void GenericArray_Destroy(GenericArray* arr) {
         arr->removeElemFunc(GenericArray_At(arr, i));
     }
 
-    free(arr->data);
+    if (arr->mapBase != NULL) {
+        munmap(arr->mapBase, arr->mapLength);
+    }
+    else {
+        free(arr->data);
+    }
+
     free(arr);
 }
 
 int GenericArray_ExpandCapacity(GenericArray* arr, size_t newCapacity) {
-    void* temp = realloc(arr->data, newCapacity * arr->elemSize);
-    if (temp == NULL) {
+    void* temp;
+
+    if (arr->mapBase != NULL) {   /* leave the mapping, the file is never resized. */
+        if ((temp = malloc(newCapacity * arr->elemSize)) == NULL) {
+            return 0;
+        }
+
+        memcpy(temp, arr->data, arr->length * arr->elemSize);
+        munmap(arr->mapBase, arr->mapLength);
+        arr->mapBase = NULL;
+        arr->mapLength = 0;
+        ContainerStats_OnAlloc(&arr->stats, newCapacity * arr->elemSize);
+        arr->data = temp;
+        arr->capacity = newCapacity;
+        return 1;
+    }
+
+    if ((temp = realloc(arr->data, newCapacity * arr->elemSize)) == NULL) {
         return 0;
     }
 
+    ContainerStats_OnGrow(&arr->stats, arr->capacity * arr->elemSize, newCapacity * arr->elemSize);
     arr->data = temp;
     arr->capacity = newCapacity;
     return 1;
 }
 
 void* GenericArray_PushBack(GenericArray* arr) {
-    if (arr->length == arr->capacity) {
-        if (!GenericArray_ExpandCapacity(arr, 2 * arr->capacity)) {
+    if (arr->length == arr->capacity) {   /* a mapped empty snapshot has capacity 0. */
+        if (!GenericArray_ExpandCapacity(arr, arr->capacity == 0 ? 15 : 2 * arr->capacity)) {
             return NULL;
         }
     }
@@ -98,12 +141,51 @@ void GenericArray_Remove(GenericArray* arr, size_t index) {
     arr->removeElemFunc(GenericArray_At(arr, index));
 
     size_t i;
-    for (i = index; i < GenericArray_Length(arr); ++i) {
+    for (i = index; i + 1 < GenericArray_Length(arr); ++i) {
         memcpy(GenericArray_At(arr, i), GenericArray_At(arr, i + 1), arr->elemSize);
     }
 
-    arr->length -= 1;
-    arr->removeElemFunc(GenericArray_At(arr, arr->length));
+    arr->length -= 1;   /* the old last slot now duplicates the new last element, it is not destroyed. */
+}
+
+/**
+ * one stable pass: the kept elements between two removed ones are a run, moved down with one memmove,
+ * so every kept element moves at most once.
+ */
+static size_t GenericArray_Filter(GenericArray* arr, GenericArray_PredicateFunc pred, void* arg, int removeSelected) {
+    size_t read, write = 0, run = 0;   /* [run, read) are kept elements not moved yet. */
+
+    for (read = 0; read < arr->length; ++read) {
+        if ((pred(GenericArray_At(arr, read), arg) != 0) == removeSelected) {
+            arr->removeElemFunc(GenericArray_At(arr, read));
+
+            if (write != run) {
+                memmove(GenericArray_At(arr, write), GenericArray_At(arr, run), (read - run) * arr->elemSize);
+            }
+
+            write += read - run;
+            run = read + 1;
+        }
+    }
+
+    if (write != run) {
+        memmove(GenericArray_At(arr, write), GenericArray_At(arr, run), (read - run) * arr->elemSize);
+    }
+
+    write += read - run;
+    read = arr->length - write;
+    arr->length = write;
+    return read;
+}
+
+/* remove every element pred selects in O(n), the order of the rest is kept. return how many were removed. */
+size_t GenericArray_RemoveIf(GenericArray* arr, GenericArray_PredicateFunc pred, void* arg) {
+    return GenericArray_Filter(arr, pred, arg, 1);
+}
+
+/* keep only the elements pred selects. */
+size_t GenericArray_Retain(GenericArray* arr, GenericArray_PredicateFunc pred, void* arg) {
+    return GenericArray_Filter(arr, pred, arg, 0);
 }
 
 void GenericArray_PopFront(GenericArray* arr) {
@@ -114,6 +196,344 @@ void GenericArray_PopBack(GenericArray* arr) {
     GenericArray_Remove(arr, GenericArray_Length(arr) - 1);
 }
 
+/**
+ * binary snapshot: a GenericArrayFileHeader followed by the raw element bytes at dataOffset.
+ * the same format is written by the generated arrays (template_array.txt), so a file saved by one
+ * can be loaded by the other when the element size and type tag agree.
+ */
+#define GENERIC_ARRAY_FILE_MAGIC        "CARRAY\0\0"
+#define GENERIC_ARRAY_FILE_VERSION      1
+#define GENERIC_ARRAY_FILE_BYTE_ORDER   0x01020304u
+#define GENERIC_ARRAY_FILE_DATA_OFFSET  64
+#define GENERIC_ARRAY_IO_CHUNK_SIZE     (8u << 20)
+
+#define GENERIC_ARRAY_MAP_READ_ONLY       0   /* shared, read-only view of the page cache, do not modify the array. */
+#define GENERIC_ARRAY_MAP_COPY_ON_WRITE   1   /* private mapping, writes stay in this process. */
+
+typedef struct GenericArrayFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t elemSize;
+    uint64_t length;
+    uint64_t typeTag;
+    uint64_t checksum;
+    uint64_t dataOffset;
+    uint64_t reserved;
+} GenericArrayFileHeader;
+
+/* 4 independent multiply-xor lanes over 8-byte words, fast enough to keep up with the disk. */
+typedef struct GenericArrayChecksum {
+    uint64_t lane[4];
+    unsigned char tail[32];
+    size_t tailLength;
+    uint64_t totalLength;
+} GenericArrayChecksum;
+
+#define GENERIC_ARRAY_CHECKSUM_PRIME   0x100000001b3ull
+
+void GenericArrayChecksum_Init(GenericArrayChecksum* cs) {
+    cs->lane[0] = 0xcbf29ce484222325ull;
+    cs->lane[1] = 0x84222325cbf29ce4ull;
+    cs->lane[2] = 0x9e3779b97f4a7c15ull;
+    cs->lane[3] = 0xc2b2ae3d27d4eb4full;
+    cs->tailLength = 0;
+    cs->totalLength = 0;
+}
+
+static void GenericArrayChecksum_Block(GenericArrayChecksum* cs, const unsigned char* block) {
+    uint64_t w[4];
+    memcpy(w, block, sizeof(w));
+
+    cs->lane[0] = (cs->lane[0] ^ w[0]) * GENERIC_ARRAY_CHECKSUM_PRIME;
+    cs->lane[1] = (cs->lane[1] ^ w[1]) * GENERIC_ARRAY_CHECKSUM_PRIME;
+    cs->lane[2] = (cs->lane[2] ^ w[2]) * GENERIC_ARRAY_CHECKSUM_PRIME;
+    cs->lane[3] = (cs->lane[3] ^ w[3]) * GENERIC_ARRAY_CHECKSUM_PRIME;
+}
+
+void GenericArrayChecksum_Update(GenericArrayChecksum* cs, const void* data, size_t length) {
+    const unsigned char* p = (const unsigned char*)data;
+    size_t n;
+
+    cs->totalLength += length;
+
+    if (cs->tailLength != 0) {
+        n = sizeof(cs->tail) - cs->tailLength;
+        n = (n < length) ? n : length;
+        memcpy(cs->tail + cs->tailLength, p, n);
+        cs->tailLength += n;
+        p += n;
+        length -= n;
+
+        if (cs->tailLength < sizeof(cs->tail)) {
+            return;
+        }
+
+        GenericArrayChecksum_Block(cs, cs->tail);
+        cs->tailLength = 0;
+    }
+
+    for (; length >= sizeof(cs->tail); p += sizeof(cs->tail), length -= sizeof(cs->tail)) {
+        GenericArrayChecksum_Block(cs, p);
+    }
+
+    memcpy(cs->tail, p, length);
+    cs->tailLength = length;
+}
+
+uint64_t GenericArrayChecksum_Final(GenericArrayChecksum* cs) {
+    uint64_t h = cs->totalLength;
+    size_t i;
+
+    for (i = 0; i < cs->tailLength; ++i) {
+        h = (h ^ cs->tail[i]) * GENERIC_ARRAY_CHECKSUM_PRIME;
+    }
+
+    for (i = 0; i < 4; ++i) {
+        h = (h ^ cs->lane[i]) * GENERIC_ARRAY_CHECKSUM_PRIME;
+        h ^= h >> 29;
+    }
+
+    return h;
+}
+
+/* FNV-1a of a type name, e.g. GenericArray_TypeTag("long long"), the generated arrays use the same tag. */
+uint64_t GenericArray_TypeTag(const char* typeName) {
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    for (; *typeName != '\0'; ++typeName) {
+        h = (h ^ (unsigned char)*typeName) * GENERIC_ARRAY_CHECKSUM_PRIME;
+    }
+
+    return h;
+}
+
+/* streaming writer, elements can be appended in any number of batches. */
+typedef struct GenericArrayWriter {
+    FILE* file;
+    GenericArrayFileHeader header;
+    GenericArrayChecksum checksum;
+    int failed;
+} GenericArrayWriter;
+
+GenericArrayWriter* GenericArrayWriter_Open(const char* filePath, size_t elemSize, uint64_t typeTag) {
+    static const char zeros[GENERIC_ARRAY_FILE_DATA_OFFSET] = { 0 };
+    GenericArrayWriter* w;
+
+    if (elemSize == 0 || (w = (GenericArrayWriter*)malloc(sizeof(GenericArrayWriter))) == NULL) {
+        return NULL;
+    }
+
+    if ((w->file = fopen(filePath, "wb")) == NULL) {
+        free(w);
+        return NULL;
+    }
+
+    setvbuf(w->file, NULL, _IOFBF, 1 << 20);
+
+    memset(&w->header, 0, sizeof(w->header));
+    memcpy(w->header.magic, GENERIC_ARRAY_FILE_MAGIC, sizeof(w->header.magic));
+    w->header.version = GENERIC_ARRAY_FILE_VERSION;
+    w->header.byteOrder = GENERIC_ARRAY_FILE_BYTE_ORDER;
+    w->header.elemSize = elemSize;
+    w->header.typeTag = typeTag;
+    w->header.dataOffset = GENERIC_ARRAY_FILE_DATA_OFFSET;
+    GenericArrayChecksum_Init(&w->checksum);
+
+    /* the header is patched in GenericArrayWriter_Close, once length and checksum are known. */
+    w->failed = fwrite(zeros, 1, GENERIC_ARRAY_FILE_DATA_OFFSET, w->file) != GENERIC_ARRAY_FILE_DATA_OFFSET;
+    return w;
+}
+
+int GenericArrayWriter_Append(GenericArrayWriter* w, const void* elems, size_t count) {
+    size_t bytes = count * (size_t)w->header.elemSize;
+
+    if (w->failed || fwrite(elems, 1, bytes, w->file) != bytes) {
+        w->failed = 1;
+        return 0;
+    }
+
+    GenericArrayChecksum_Update(&w->checksum, elems, bytes);
+    w->header.length += count;
+    return 1;
+}
+
+/* return 1 when the whole file was written. */
+int GenericArrayWriter_Close(GenericArrayWriter* w) {
+    int ok = !w->failed;
+
+    w->header.checksum = GenericArrayChecksum_Final(&w->checksum);
+    ok = ok && fseek(w->file, 0, SEEK_SET) == 0;
+    ok = ok && fwrite(&w->header, sizeof(w->header), 1, w->file) == 1;
+
+    if (fclose(w->file) != 0) {
+        ok = 0;
+    }
+
+    free(w);
+    return ok;
+}
+
+int GenericArray_Save(GenericArray* arr, const char* filePath, uint64_t typeTag) {
+    GenericArrayWriter* w = GenericArrayWriter_Open(filePath, arr->elemSize, typeTag);
+    if (w == NULL) {
+        return 0;
+    }
+
+    GenericArrayWriter_Append(w, arr->data, arr->length);
+
+    if (!GenericArrayWriter_Close(w)) {   /* do not leave a truncated snapshot behind. */
+        remove(filePath);
+        return 0;
+    }
+
+    return 1;
+}
+
+static int GenericArray_CheckFileHeader(const GenericArrayFileHeader* header, size_t elemSize, uint64_t typeTag, uint64_t fileSize) {
+    return memcmp(header->magic, GENERIC_ARRAY_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == GENERIC_ARRAY_FILE_VERSION &&
+           header->byteOrder == GENERIC_ARRAY_FILE_BYTE_ORDER &&
+           elemSize != 0 &&
+           header->elemSize == elemSize &&
+           header->typeTag == typeTag &&
+           header->dataOffset >= sizeof(GenericArrayFileHeader) &&
+           header->dataOffset % _Alignof(max_align_t) == 0 &&   /* a mapped array hands out aligned elements. */
+           header->dataOffset <= fileSize &&
+           header->length <= (fileSize - header->dataOffset) / elemSize &&   /* the product below cannot overflow. */
+           header->dataOffset + header->length * header->elemSize == fileSize;
+}
+
+/* read the file into a heap array, in GENERIC_ARRAY_IO_CHUNK_SIZE chunks straight into the final buffer. */
+GenericArray* GenericArray_Load(const char* filePath, size_t elemSize, uint64_t typeTag, GenericArray_RemoveElemFunc func) {
+    GenericArrayFileHeader header;
+    GenericArrayChecksum checksum;
+    GenericArray* arr;
+    struct stat st;
+    size_t bytes, done, n;
+
+    FILE* f = fopen(filePath, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+
+    if (fstat(fileno(f), &st) != 0 ||
+        fread(&header, sizeof(header), 1, f) != 1 ||
+        !GenericArray_CheckFileHeader(&header, elemSize, typeTag, (uint64_t)st.st_size) ||
+        fseek(f, (long)header.dataOffset, SEEK_SET) != 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    setvbuf(f, NULL, _IONBF, 0);   /* chunks are large, skip the stdio copy. */
+
+    if ((arr = GenericArray_CreateNew((size_t)header.length, elemSize, func)) == NULL) {
+        fclose(f);
+        return NULL;
+    }
+
+    GenericArrayChecksum_Init(&checksum);
+    bytes = (size_t)header.length * elemSize;
+
+    for (done = 0; done < bytes; done += n) {
+        n = (bytes - done < GENERIC_ARRAY_IO_CHUNK_SIZE) ? bytes - done : GENERIC_ARRAY_IO_CHUNK_SIZE;
+
+        if (fread((char*)arr->data + done, 1, n, f) != n) {
+            break;
+        }
+
+        GenericArrayChecksum_Update(&checksum, (char*)arr->data + done, n);
+    }
+
+    fclose(f);
+
+    if (done != bytes || GenericArrayChecksum_Final(&checksum) != header.checksum) {
+        arr->removeElemFunc = GenericArray_RemoveElemFunc_Default;
+        GenericArray_Destroy(arr);
+        return NULL;
+    }
+
+    arr->length = (size_t)header.length;
+    return arr;
+}
+
+/**
+ * use the file itself as the backing store, pages are faulted in on demand.
+ * verify != 0 checksums the whole file first, which reads every page once.
+ * the first push on a mapped array moves the elements to the heap.
+ */
+GenericArray* GenericArray_Map(const char* filePath, size_t elemSize, uint64_t typeTag, int mode, int verify, GenericArray_RemoveElemFunc func) {
+    const GenericArrayFileHeader* header;
+    GenericArrayChecksum checksum;
+    GenericArray* arr;
+    struct stat st;
+    void* base;
+    int fd;
+
+    if (elemSize == 0 || (fd = open(filePath, O_RDONLY)) < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GenericArrayFileHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    if (mode == GENERIC_ARRAY_MAP_COPY_ON_WRITE) {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    else {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    header = (const GenericArrayFileHeader*)base;
+    if (!GenericArray_CheckFileHeader(header, elemSize, typeTag, (uint64_t)st.st_size)) {
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+
+    if (verify) {
+        posix_madvise(base, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+        GenericArrayChecksum_Init(&checksum);
+        GenericArrayChecksum_Update(&checksum, (const char*)base + header->dataOffset, (size_t)(header->length * elemSize));
+
+        if (GenericArrayChecksum_Final(&checksum) != header->checksum) {
+            munmap(base, (size_t)st.st_size);
+            return NULL;
+        }
+    }
+
+    if ((arr = (GenericArray*)malloc(sizeof(GenericArray))) == NULL) {
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+
+    arr->removeElemFunc = (func == NULL ? GenericArray_RemoveElemFunc_Default : func);
+    arr->elemSize = elemSize;
+    arr->length = arr->capacity = (size_t)header->length;
+    arr->data = (char*)base + header->dataOffset;
+    arr->mapBase = base;
+    arr->mapLength = (size_t)st.st_size;
+    ContainerStats_Init(&arr->stats, "GenericArray");
+    return arr;
+}
+
+#ifdef CONTAINER_STATS
+void GenericArray_GetStats(GenericArray* arr, ContainerStats* out) {
+    *out = arr->stats;
+}
+#endif
+
+int generic_array_is_expired(void* elem, void* arg) {
+    return *(long long*)elem < *(long long*)arg;
+}
+
 int main() {
     GenericArray* arr = GenericArray_CreateNew(5, sizeof(long long), NULL);
 
@@ -132,6 +552,58 @@ int main() {
     // }
 
     printf("%lld\n", *(long long*)GenericArray_Back(arr));
+
+    /* expiry pass: drop the timestamps older than now in one sweep. */
+    GenericArray* times = GenericArray_CreateNew(0, sizeof(long long), NULL);
+    long long now = 5;
+    size_t j;
+
+    for (i = 0; i < 10; ++i) {
+        *(long long*)GenericArray_PushBack(times) = (i * 7) % 10;
+    }
+
+    printf("expired: %zu, left:", GenericArray_RemoveIf(times, generic_array_is_expired, &now));
+    GenericArray_ForEach(times, j) {
+        printf(" %lld", *(long long*)GenericArray_At(times, j));
+    }
+    printf("\n");
+    GenericArray_Destroy(times);
+
+    /* binary snapshot, of an array of its own: the big one above would be gigabytes on disk. */
+    uint64_t tag = GenericArray_TypeTag("long long");
+    GenericArray* snapshot = GenericArray_CreateNew(0, sizeof(long long), NULL);
+    GenericArray* loaded;
+
+    for (i = 0; i < 4096; ++i) {
+        *(long long*)GenericArray_PushBack(snapshot) = i * i;
+    }
+
+    if (GenericArray_Save(snapshot, "array.bin", tag)) {
+        if ((loaded = GenericArray_Load("array.bin", sizeof(long long), tag, NULL)) != NULL) {
+            printf("load: %zu elements, back %lld\n", GenericArray_Length(loaded), *(long long*)GenericArray_Back(loaded));
+            GenericArray_Destroy(loaded);
+        }
+
+        if ((loaded = GenericArray_Map("array.bin", sizeof(long long), tag, GENERIC_ARRAY_MAP_COPY_ON_WRITE, 1, NULL)) != NULL) {
+            *(long long*)GenericArray_Front(loaded) = -1;   /* private to this process. */
+            data = GenericArray_PushBack(loaded);           /* moves the elements to the heap. */
+            *data = 42;
+            printf("map: %zu elements, front %lld, back %lld\n", GenericArray_Length(loaded),
+                   *(long long*)GenericArray_Front(loaded), *(long long*)GenericArray_Back(loaded));
+            GenericArray_Destroy(loaded);
+        }
+
+        remove("array.bin");
+    }
+
+    GenericArray_Destroy(snapshot);
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    GenericArray_GetStats(arr, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
     GenericArray_Destroy(arr);
     return 0;
 }
@@ -0,0 +1,546 @@
+/**
+ * memory-compact hash table: bucketized cuckoo hashing with keys and values packed inline.
+ *
+ * the table is an array of buckets of 4 slots, a slot is keyElemSize + valueElemSize bytes (padded so
+ * keys and values are aligned for any type of their size) with no pointer and no allocation of its own. every key has two candidate buckets, so a lookup reads at
+ * most 8 slots. each slot also has a one byte tag (a piece of the hash, 0 marks an empty slot),
+ * kept in a separate array so a lookup first scans 8 tag bytes and compares keys only on a tag match.
+ *
+ * an insert whose two buckets are full moves a resident to its other bucket (cuckoo kick), up to
+ * GENERIC_CUCKOO_TABLE_MAX_KICKS times, and only then doubles the table. with 4 slots per bucket
+ * that happens past about 95% occupancy, so the table runs full instead of at half load.
+ *
+ * keys are compared bytewise, zero the padding of struct keys. the hash function returns 64 bits,
+ * the table picks the buckets and the tag from it.
+ *
+ * build: cc -std=c11 -O2 void_ptr_cuckoo_hash_table.c
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "container_stats.h"
+
+#define GENERIC_CUCKOO_TABLE_SLOTS_PER_BUCKET   4
+#define GENERIC_CUCKOO_TABLE_MAX_KICKS          500
+#define GENERIC_CUCKOO_TABLE_MAX_REHASH_GROWS   3     /* doublings one rehash may try before giving up. */
+#define GENERIC_CUCKOO_TABLE_EMPTY_TAG          0
+
+typedef uint64_t (*GenericCuckooTable_HashFunc) (const void* key, size_t keyElemSize);
+typedef void(*GenericCuckooTable_RemoveKeyElemFunc)(void*);
+typedef void(*GenericCuckooTable_RemoveValueElemFunc)(void*);
+
+void GenericCuckooTable_RemoveKeyElemFunc_Default(void* key) {}
+void GenericCuckooTable_RemoveValueElemFunc_Default(void* value) {}
+
+typedef struct GenericCuckooTable {
+    uint8_t* tags;          /* one per slot. */
+    char* slots;            /* key bytes then value bytes, slot after slot. */
+    size_t bucketMask;      /* bucket count - 1, the bucket count is a power of 2. */
+    size_t length;
+    size_t keyElemSize;
+    size_t valueElemSize;
+    size_t valueOffset;     /* keyElemSize rounded up to the alignment of the value. */
+    size_t slotSize;
+    char* carry;            /* 2 slots of scratch for the kicks. */
+    uint64_t random;
+
+    GenericCuckooTable_HashFunc hashFunc;
+    GenericCuckooTable_RemoveKeyElemFunc removeKeyElemFunc;
+    GenericCuckooTable_RemoveValueElemFunc removeValueElemFunc;
+
+    CONTAINER_STATS_FIELD(stats)
+} GenericCuckooTable;
+
+#define GenericCuckooTable_Length(tablePtr)     ((tablePtr)->length)
+#define GenericCuckooTable_SlotCount(tablePtr)  (((tablePtr)->bucketMask + 1) * GENERIC_CUCKOO_TABLE_SLOTS_PER_BUCKET)
+#define GenericCuckooTable_LoadFactor(tablePtr) ((double)(tablePtr)->length / (double)GenericCuckooTable_SlotCount(tablePtr))
+
+#define GenericCuckooTable_SlotKey(tablePtr, slot) \
+    ((void*)((tablePtr)->slots + (slot) * (tablePtr)->slotSize))
+
+#define GenericCuckooTable_SlotValue(tablePtr, slot) \
+    ((void*)((tablePtr)->slots + (slot) * (tablePtr)->slotSize + (tablePtr)->valueOffset))
+
+/* visit every occupied slot, in no particular order. */
+#define GenericCuckooTable_ForEach(tablePtr, slot) \
+    for (slot = 0; slot < GenericCuckooTable_SlotCount(tablePtr); ++slot) \
+        if ((tablePtr)->tags[slot] != GENERIC_CUCKOO_TABLE_EMPTY_TAG)
+
+/* FNV-1a over the key bytes, then mixed. */
+uint64_t GenericCuckooTable_DefaultHash(const void* key, size_t keyElemSize) {
+    const unsigned char* p = (const unsigned char*)key;
+    uint64_t h = 0xcbf29ce484222325ull;
+    size_t i;
+
+    for (i = 0; i < keyElemSize; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint8_t GenericCuckooTable_Tag(uint64_t hash) {
+    uint8_t tag = (uint8_t)(hash >> 56);
+    return tag == GENERIC_CUCKOO_TABLE_EMPTY_TAG ? 1 : tag;
+}
+
+/* the low half picks the first bucket, the high half the second one. */
+static size_t GenericCuckooTable_Bucket1(GenericCuckooTable* table, uint64_t hash) {
+    return (size_t)hash & table->bucketMask;
+}
+
+static size_t GenericCuckooTable_Bucket2(GenericCuckooTable* table, uint64_t hash) {
+    size_t bucket = (size_t)(hash >> 32) & table->bucketMask;
+    return bucket == GenericCuckooTable_Bucket1(table, hash) ? bucket ^ (1 & table->bucketMask) : bucket;
+}
+
+/* bytes held by the table itself: tags, slots and the struct. */
+size_t GenericCuckooTable_SizeBytes(GenericCuckooTable* table) {
+    return sizeof(GenericCuckooTable) + 2 * table->slotSize + GenericCuckooTable_SlotCount(table) * (1 + table->slotSize);
+}
+
+/* exact memory cost of one stored entry at the current occupancy. */
+double GenericCuckooTable_BytesPerEntry(GenericCuckooTable* table) {
+    return table->length == 0 ? 0.0 : (double)GenericCuckooTable_SizeBytes(table) / (double)table->length;
+}
+
+/* the strictest alignment a type of this size can have: its lowest set bit, at most max_align_t. */
+static size_t GenericCuckooTable_AlignOf(size_t size) {
+    size_t align = size & (~size + 1);   /* 0 for size 0. */
+
+    if (align == 0) {
+        return 1;
+    }
+
+    return align < _Alignof(max_align_t) ? align : _Alignof(max_align_t);
+}
+
+static size_t GenericCuckooTable_RoundUp(size_t size, size_t align) {
+    return (size + align - 1) / align * align;
+}
+
+static int GenericCuckooTable_AllocSlots(GenericCuckooTable* table, size_t bucketCount) {
+    size_t slotCount = bucketCount * GENERIC_CUCKOO_TABLE_SLOTS_PER_BUCKET;
+
+    table->tags = (uint8_t*)calloc(slotCount, 1);
+    table->slots = (char*)malloc(slotCount * table->slotSize);
+
+    if (table->tags == NULL || table->slots == NULL) {
+        free(table->tags);
+        free(table->slots);
+        return 0;
+    }
+
+    table->bucketMask = bucketCount - 1;
+    return 1;
+}
+
+GenericCuckooTable* GenericCuckooTable_CreateNew(size_t capacity,
+                                                size_t keyElemSize,
+                                                size_t valueElemSize,
+                                                GenericCuckooTable_HashFunc hashFunc,
+                                                GenericCuckooTable_RemoveKeyElemFunc removeKeyElemFunc,
+                                                GenericCuckooTable_RemoveValueElemFunc removeValueElemFunc)
+{
+    GenericCuckooTable* table;
+    size_t bucketCount = 1;
+    size_t keyAlign = GenericCuckooTable_AlignOf(keyElemSize);
+    size_t valueAlign = GenericCuckooTable_AlignOf(valueElemSize);
+
+    if (keyElemSize == 0) {
+        return NULL;
+    }
+
+    if ((table = (GenericCuckooTable*)malloc(sizeof(GenericCuckooTable))) == NULL) {
+        return NULL;
+    }
+
+    /* capacity entries fit at about 95% load. */
+    while (bucketCount * GENERIC_CUCKOO_TABLE_SLOTS_PER_BUCKET * 95 < capacity * 100) {
+        bucketCount *= 2;
+    }
+
+    table->length = 0;
+    table->keyElemSize = keyElemSize;
+    table->valueElemSize = valueElemSize;
+    table->valueOffset = GenericCuckooTable_RoundUp(keyElemSize, valueAlign);
+    table->slotSize = GenericCuckooTable_RoundUp(table->valueOffset + valueElemSize, keyAlign > valueAlign ? keyAlign : valueAlign);
+    table->random = 88172645463325252ull;
+    table->hashFunc = (hashFunc == NULL ? GenericCuckooTable_DefaultHash : hashFunc);
+    table->removeKeyElemFunc = (removeKeyElemFunc == NULL ? GenericCuckooTable_RemoveKeyElemFunc_Default : removeKeyElemFunc);
+    table->removeValueElemFunc = (removeValueElemFunc == NULL ? GenericCuckooTable_RemoveValueElemFunc_Default : removeValueElemFunc);
+
+    if ((table->carry = (char*)malloc(2 * table->slotSize)) == NULL) {
+        free(table);
+        return NULL;
+    }
+
+    if (!GenericCuckooTable_AllocSlots(table, bucketCount)) {
+        free(table->carry);
+        free(table);
+        return NULL;
+    }
+
+    ContainerStats_Init(&table->stats, "GenericCuckooTable");
+    ContainerStats_OnAlloc(&table->stats, GenericCuckooTable_SizeBytes(table));
+    return table;
+}
+
+void GenericCuckooTable_Destroy(GenericCuckooTable* table) {
+    size_t slot;
+
+    GenericCuckooTable_ForEach(table, slot) {
+        table->removeKeyElemFunc(GenericCuckooTable_SlotKey(table, slot));
+        table->removeValueElemFunc(GenericCuckooTable_SlotValue(table, slot));
+    }
+
+    free(table->tags);
+    free(table->slots);
+    free(table->carry);
+    free(table);
+}
+
+/* return the slot holding key, or -1. */
+static long GenericCuckooTable_FindSlot(GenericCuckooTable* table, uint64_t hash, const void* key) {
+    size_t buckets[2];
+    size_t b, i, slot;
+    size_t probe = 0;
+    uint8_t tag = GenericCuckooTable_Tag(hash);
+
+    buckets[0] = GenericCuckooTable_Bucket1(table, hash);
+    buckets[1] = GenericCuckooTable_Bucket2(table, hash);
+
+    for (b = 0; b < 2; ++b) {
+        slot = buckets[b] * GENERIC_CUCKOO_TABLE_SLOTS_PER_BUCKET;
+
+        for (i = 0; i < GENERIC_CUCKOO_TABLE_SLOTS_PER_BUCKET; ++i, ++slot) {
+            if (table->tags[slot] == tag) {
+                probe += 1;
+
+                if (memcmp(GenericCuckooTable_SlotKey(table, slot), key, table->keyElemSize) == 0) {
+                    ContainerStats_OnProbe(&table->stats, probe);
+                    return (long)slot;
+                }
+            }
+        }
+    }
+
+    ContainerStats_OnProbe(&table->stats, probe);
+    return -1;
+}
+
+/* return the value of key, or NULL. */
+void* GenericCuckooTable_Find(GenericCuckooTable* table, const void* key) {
+    ContainerStats_OpBegin(&table->stats, opBegin);
+    long slot = GenericCuckooTable_FindSlot(table, table->hashFunc(key, table->keyElemSize), key);
+    ContainerStats_OpEnd(&table->stats, opBegin);
+    return slot < 0 ? NULL : GenericCuckooTable_SlotValue(table, slot);
+}
+
+static int GenericCuckooTable_PlaceInBucket(GenericCuckooTable* table, size_t bucket, const char* entry, uint8_t tag) {
+    size_t slot = bucket * GENERIC_CUCKOO_TABLE_SLOTS_PER_BUCKET;
+    size_t i;
+
+    for (i = 0; i < GENERIC_CUCKOO_TABLE_SLOTS_PER_BUCKET; ++i, ++slot) {
+        if (table->tags[slot] == GENERIC_CUCKOO_TABLE_EMPTY_TAG) {
+            table->tags[slot] = tag;
+            memcpy(GenericCuckooTable_SlotKey(table, slot), entry, table->slotSize);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void GenericCuckooTable_SwapSlot(GenericCuckooTable* table, size_t slot, char* entry, uint8_t* tag, char* swap) {
+    uint8_t swapTag = table->tags[slot];
+
+    memcpy(swap, GenericCuckooTable_SlotKey(table, slot), table->slotSize);
+    memcpy(GenericCuckooTable_SlotKey(table, slot), entry, table->slotSize);
+    memcpy(entry, swap, table->slotSize);
+    table->tags[slot] = *tag;
+    *tag = swapTag;
+}
+
+/**
+ * store a key that is not in the table yet. when no room is found after the kicks, they are undone
+ * in reverse order and 0 is returned, the table and entry are as before.
+ */
+static int GenericCuckooTable_Place(GenericCuckooTable* table, char* entry, char* swap) {
+    uint64_t hash = table->hashFunc(entry, table->keyElemSize);
+    uint8_t tag = GenericCuckooTable_Tag(hash);
+    size_t bucket = GenericCuckooTable_Bucket1(table, hash);
+    size_t path[GENERIC_CUCKOO_TABLE_MAX_KICKS];
+    size_t kick, slot;
+
+    if (GenericCuckooTable_PlaceInBucket(table, bucket, entry, tag)) {
+        return 1;
+    }
+
+    bucket = GenericCuckooTable_Bucket2(table, hash);
+
+    for (kick = 0; kick < GENERIC_CUCKOO_TABLE_MAX_KICKS; ++kick) {
+        if (GenericCuckooTable_PlaceInBucket(table, bucket, entry, tag)) {
+            return 1;
+        }
+
+        /* evict a random resident of this bucket and move it to its other bucket. */
+        table->random ^= table->random << 13;
+        table->random ^= table->random >> 7;
+        table->random ^= table->random << 17;
+        slot = bucket * GENERIC_CUCKOO_TABLE_SLOTS_PER_BUCKET + (size_t)(table->random % GENERIC_CUCKOO_TABLE_SLOTS_PER_BUCKET);
+        path[kick] = slot;
+        GenericCuckooTable_SwapSlot(table, slot, entry, &tag, swap);
+
+        hash = table->hashFunc(entry, table->keyElemSize);
+        bucket = (GenericCuckooTable_Bucket1(table, hash) == bucket) ? GenericCuckooTable_Bucket2(table, hash) : GenericCuckooTable_Bucket1(table, hash);
+    }
+
+    while (kick-- > 0) {
+        GenericCuckooTable_SwapSlot(table, path[kick], entry, &tag, swap);
+    }
+
+    return 0;
+}
+
+/**
+ * move everything into a table of bucketCount buckets, plus entry when not NULL. doubled again at most
+ * GENERIC_CUCKOO_TABLE_MAX_REHASH_GROWS times: keys that still do not fit share too few buckets (a
+ * degenerate hash), more memory would not help, 0 is returned and the table is as before.
+ */
+static int GenericCuckooTable_Rehash(GenericCuckooTable* table, size_t bucketCount, const char* entry) {
+    GenericCuckooTable next = *table;
+    char* scratch;
+    size_t slot, grows;
+    int ok;
+
+    if ((scratch = (char*)malloc(2 * table->slotSize)) == NULL) {
+        return 0;
+    }
+
+    for (grows = 0; ; ++grows) {
+        if (!GenericCuckooTable_AllocSlots(&next, bucketCount)) {
+            free(scratch);
+            return 0;
+        }
+
+        ok = 1;
+
+        for (slot = 0; ok && slot < GenericCuckooTable_SlotCount(table); ++slot) {
+            if (table->tags[slot] != GENERIC_CUCKOO_TABLE_EMPTY_TAG) {
+                memcpy(scratch, GenericCuckooTable_SlotKey(table, slot), table->slotSize);
+                ok = GenericCuckooTable_Place(&next, scratch, scratch + table->slotSize);
+            }
+        }
+
+        if (ok && entry != NULL) {
+            memcpy(scratch, entry, table->slotSize);
+            ok = GenericCuckooTable_Place(&next, scratch, scratch + table->slotSize);
+        }
+
+        if (ok) {
+            break;
+        }
+
+        free(next.tags);
+        free(next.slots);
+
+        if (grows == GENERIC_CUCKOO_TABLE_MAX_REHASH_GROWS) {
+            free(scratch);
+            return 0;
+        }
+
+        bucketCount *= 2;
+    }
+
+    free(scratch);
+    ContainerStats_OnGrow(&table->stats, GenericCuckooTable_SlotCount(table) * (1 + table->slotSize), bucketCount * GENERIC_CUCKOO_TABLE_SLOTS_PER_BUCKET * (1 + table->slotSize));
+
+    free(table->tags);
+    free(table->slots);
+    table->tags = next.tags;
+    table->slots = next.slots;
+    table->bucketMask = next.bucketMask;
+    table->random = next.random;
+    return 1;
+}
+
+/* insert or overwrite, the key and value are copied in. return 0 when out of memory. */
+int GenericCuckooTable_Insert(GenericCuckooTable* table, const void* key, const void* value) {
+    ContainerStats_OpBegin(&table->stats, opBegin);
+    long slot = GenericCuckooTable_FindSlot(table, table->hashFunc(key, table->keyElemSize), key);
+
+    if (slot >= 0) {
+        table->removeKeyElemFunc(GenericCuckooTable_SlotKey(table, slot));
+        table->removeValueElemFunc(GenericCuckooTable_SlotValue(table, slot));
+        memcpy(GenericCuckooTable_SlotKey(table, slot), key, table->keyElemSize);
+        memcpy(GenericCuckooTable_SlotValue(table, slot), value, table->valueElemSize);
+    }
+    else {
+        memcpy(table->carry, key, table->keyElemSize);
+        memcpy(table->carry + table->valueOffset, value, table->valueElemSize);
+
+        if (!GenericCuckooTable_Place(table, table->carry, table->carry + table->slotSize)) {
+            /* the table is as full as cuckoo gets, the new entry goes into a larger one. */
+            if (!GenericCuckooTable_Rehash(table, 2 * (table->bucketMask + 1), table->carry)) {
+                return 0;
+            }
+        }
+
+        table->length += 1;
+    }
+
+    ContainerStats_OpEnd(&table->stats, opBegin);
+    return 1;
+}
+
+/* return 0 when the key is not in the table. */
+int GenericCuckooTable_Remove(GenericCuckooTable* table, const void* key) {
+    ContainerStats_OpBegin(&table->stats, opBegin);
+    long slot = GenericCuckooTable_FindSlot(table, table->hashFunc(key, table->keyElemSize), key);
+
+    if (slot >= 0) {
+        table->removeKeyElemFunc(GenericCuckooTable_SlotKey(table, slot));
+        table->removeValueElemFunc(GenericCuckooTable_SlotValue(table, slot));
+        table->tags[slot] = GENERIC_CUCKOO_TABLE_EMPTY_TAG;
+        table->length -= 1;
+    }
+
+    ContainerStats_OpEnd(&table->stats, opBegin);
+    return slot >= 0;
+}
+
+#ifdef CONTAINER_STATS
+void GenericCuckooTable_GetStats(GenericCuckooTable* table, ContainerStats* out) {
+    *out = table->stats;
+}
+#endif
+
+static double seconds_since(const struct timespec* begin) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - begin->tv_sec) + (double)(end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+uint64_t hash_uint64(const void* key, size_t keyElemSize) {
+    uint64_t h;
+
+    memcpy(&h, key, sizeof(h));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+#define BENCH_PAIRS   ((1u << 22) / 100 * 94)   /* ends at about 94% of 2^22 slots. */
+
+/* fill with uint64 -> uint64 pairs, watching the occupancy the table reaches before it grows. */
+void bench(void) {
+    GenericCuckooTable* table = GenericCuckooTable_CreateNew(0, sizeof(uint64_t), sizeof(uint64_t), hash_uint64, NULL, NULL);
+    struct timespec begin;
+    uint64_t key, value, found = 0;
+    double peakLoad = 0, insertSeconds, hitSeconds, missSeconds;
+    size_t slotCount;
+    uint32_t i;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < BENCH_PAIRS; ++i) {
+        key = (uint64_t)i * 0x9e3779b97f4a7c15ull;
+        value = i;
+        slotCount = GenericCuckooTable_SlotCount(table);
+
+        if (slotCount >= 1024 && GenericCuckooTable_LoadFactor(table) > peakLoad) {
+            peakLoad = GenericCuckooTable_LoadFactor(table);
+        }
+
+        GenericCuckooTable_Insert(table, &key, &value);
+
+        if (GenericCuckooTable_SlotCount(table) != slotCount && slotCount >= 1024) {
+            printf("grew at %.1f%% of %zu slots\n", 100.0 * (double)(GenericCuckooTable_Length(table) - 1) / (double)slotCount, slotCount);
+        }
+    }
+
+    insertSeconds = seconds_since(&begin);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < BENCH_PAIRS; ++i) {
+        key = (uint64_t)i * 0x9e3779b97f4a7c15ull;
+        found += (GenericCuckooTable_Find(table, &key) != NULL);
+    }
+
+    hitSeconds = seconds_since(&begin);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < BENCH_PAIRS; ++i) {
+        key = (uint64_t)i * 0x9e3779b97f4a7c15ull + 1;
+        found += (GenericCuckooTable_Find(table, &key) != NULL);
+    }
+
+    missSeconds = seconds_since(&begin);
+
+    printf("%u pairs of uint64: %zu found, peak load %.1f%%, now %.1f%%\n", BENCH_PAIRS, (size_t)found, 100.0 * peakLoad, 100.0 * GenericCuckooTable_LoadFactor(table));
+    printf("  %.2f bytes per entry (16 of payload)\n", GenericCuckooTable_BytesPerEntry(table));
+    printf("  insert %.1f ns, hit %.1f ns, miss %.1f ns\n",
+           1e9 * insertSeconds / BENCH_PAIRS, 1e9 * hitSeconds / BENCH_PAIRS, 1e9 * missSeconds / BENCH_PAIRS);
+
+    GenericCuckooTable_Destroy(table);
+}
+
+int main() {
+    GenericCuckooTable* table = GenericCuckooTable_CreateNew(950, sizeof(uint64_t), sizeof(uint32_t), hash_uint64, NULL, NULL);
+    uint64_t key;
+    uint32_t value;
+    uint32_t* found;
+    size_t slot;
+
+    for (key = 0; key < 950; ++key) {
+        value = (uint32_t)(key * key);
+        GenericCuckooTable_Insert(table, &key, &value);
+    }
+
+    key = 30;
+    GenericCuckooTable_Remove(table, &key);
+
+    key = 31;
+    if ((found = (uint32_t*)GenericCuckooTable_Find(table, &key)) != NULL) {
+        printf("find %llu -> %u\n", (unsigned long long)key, *found);
+    }
+
+    key = 30;
+    printf("find %llu -> %s\n", (unsigned long long)key, GenericCuckooTable_Find(table, &key) == NULL ? "not found" : "found");
+
+    value = 0;
+    GenericCuckooTable_ForEach(table, slot) {
+        value += 1;
+    }
+
+    printf("%u entries in %zu slots (%.1f%%), %.2f bytes per entry\n\n", value, GenericCuckooTable_SlotCount(table),
+           100.0 * GenericCuckooTable_LoadFactor(table), GenericCuckooTable_BytesPerEntry(table));
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    GenericCuckooTable_GetStats(table, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
+    GenericCuckooTable_Destroy(table);
+
+    bench();
+    return 0;
+}
@@ -1,10 +1,21 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "container_stats.h"
+#include "node_slab.h"
 
 typedef void(*GenericDoublyList_RemoveElemFunc)(void*);
 void GenericDoublyList_RemoveElemFunc_Default(void*) {}
 
+typedef int (*GenericDoublyList_CompareFunc) (const void* left, const void* right);   /* element data, like qsort. */
+typedef int (*GenericDoublyList_PredicateFunc) (void* elem, void* arg);                /* return non 0 to select elem. */
+
 typedef struct GenericDoublyListNode {
     struct GenericDoublyListNode* prev;
     struct GenericDoublyListNode* next;
@@ -17,6 +28,9 @@ typedef struct GenericDoublyList {
     size_t elemSize;
 
     GenericDoublyList_RemoveElemFunc removeElemFunc;
+    NodeSlabSet slabs;   /* slabs of GenericDoublyList_Compact holding some of the nodes. */
+
+    CONTAINER_STATS_FIELD(stats)
 } GenericDoublyList;
 
 #define GenericDoublyList_NodePrev(nodePtr)   ((nodePtr)->prev)
@@ -48,16 +62,27 @@ GenericDoublyList* GenericDoublyList_CreateNew(size_t elemSize, GenericDoublyLis
     list->head = list->tail = NULL;
     list->length = 0;
     list->elemSize = elemSize;
+    NodeSlabSet_Init(&list->slabs);
+    ContainerStats_Init(&list->stats, "GenericDoublyList");
     return list;
 }
 
+/* a node copied by GenericDoublyList_Compact lives in a slab, the slab is released with its last node. */
+static void GenericDoublyList_FreeNode(GenericDoublyList* list, GenericDoublyListNode* node) {
+    if (!NodeSlabSet_FreeNode(&list->slabs, node)) {
+        free(node);
+    }
+
+    ContainerStats_OnFree(&list->stats, sizeof(GenericDoublyListNode) + list->elemSize);
+}
+
 void GenericDoublyList_Clear(GenericDoublyList* list) {
     GenericDoublyListNode* node = list->head;
 
     while (list->head != NULL) {
         node = node->next;
         list->removeElemFunc(GenericDoublyList_NodeData(list->head));
-        free(list->head);
+        GenericDoublyList_FreeNode(list, list->head);
         list->head = node;
     }
 
@@ -66,6 +91,7 @@ void GenericDoublyList_Clear(GenericDoublyList* list) {
 
 void GenericDoublyList_Destroy(GenericDoublyList* list) {
     GenericDoublyList_Clear(list);
+    NodeSlabSet_Release(&list->slabs);
     free(list);
 }
 
@@ -75,6 +101,8 @@ void* GenericDoublyList_PushBack(GenericDoublyList* list) {
         return NULL;
     }
 
+    ContainerStats_OnAlloc(&list->stats, sizeof(GenericDoublyListNode) + list->elemSize);
+
     if (list->head == NULL) {
         node->prev = node->next = NULL;
         list->head = list->tail = node;
@@ -96,6 +124,8 @@ void* GenericDoublyList_PushFront(GenericDoublyList* list) {
         return NULL;
     }
 
+    ContainerStats_OnAlloc(&list->stats, sizeof(GenericDoublyListNode) + list->elemSize);
+
     if (list->head == NULL) {
         node->prev = node->next = NULL;
         list->head = list->tail = node;
@@ -103,6 +133,7 @@ void* GenericDoublyList_PushFront(GenericDoublyList* list) {
     else {
         node->prev = NULL;
         node->next = list->head;
+        list->head->prev = node;
         list->head = node;
     }
 
@@ -136,11 +167,39 @@ GenericDoublyListNode* GenericDoublyList_RemoveNode(GenericDoublyList* list, Gen
     }
 
     list->removeElemFunc(GenericDoublyList_NodeData(node));
-    free(node);
+    GenericDoublyList_FreeNode(list, node);
     list->length -= 1;
     return retNode;
 }
 
+/* one traversal, every removal is an O(1) unlink. */
+static size_t GenericDoublyList_Filter(GenericDoublyList* list, GenericDoublyList_PredicateFunc pred, void* arg, int removeSelected) {
+    GenericDoublyListNode* node = list->head;
+    size_t removed = 0;
+
+    while (node != NULL) {
+        if ((pred(GenericDoublyList_NodeData(node), arg) != 0) == removeSelected) {
+            node = GenericDoublyList_RemoveNode(list, node, 1);
+            removed += 1;
+        }
+        else {
+            node = node->next;
+        }
+    }
+
+    return removed;
+}
+
+/* remove every element pred selects, return how many were removed. */
+size_t GenericDoublyList_RemoveIf(GenericDoublyList* list, GenericDoublyList_PredicateFunc pred, void* arg) {
+    return GenericDoublyList_Filter(list, pred, arg, 1);
+}
+
+/* keep only the elements pred selects. */
+size_t GenericDoublyList_Retain(GenericDoublyList* list, GenericDoublyList_PredicateFunc pred, void* arg) {
+    return GenericDoublyList_Filter(list, pred, arg, 0);
+}
+
 void GenericDoublyList_PopFront(GenericDoublyList* list) {
     if (GenericDoublyList_IsEmpty(list)) {
         return;
@@ -157,6 +216,262 @@ void GenericDoublyList_PopBack(GenericDoublyList* list) {
     GenericDoublyList_RemoveNode(list, list->tail, 1);
 }
 
+/* merge two NULL terminated runs linked by next only, ties keep left first. */
+static GenericDoublyListNode* GenericDoublyList_MergeRuns(GenericDoublyListNode* left, GenericDoublyListNode* right, GenericDoublyList_CompareFunc compare) {
+    GenericDoublyListNode head;
+    GenericDoublyListNode* tail = &head;
+
+    while (left != NULL && right != NULL) {
+        if (compare(GenericDoublyList_NodeData(right), GenericDoublyList_NodeData(left)) < 0) {
+            tail->next = right;
+            right = right->next;
+        }
+        else {
+            tail->next = left;
+            left = left->next;
+        }
+
+        tail = tail->next;
+    }
+
+    tail->next = (left != NULL) ? left : right;
+    return head.next;
+}
+
+/* restore prev links and tail after the next links were rewritten. */
+static void GenericDoublyList_Relink(GenericDoublyList* list, GenericDoublyListNode* head) {
+    GenericDoublyListNode* prev = NULL;
+    GenericDoublyListNode* node;
+
+    list->head = head;
+    for (node = head; node != NULL; node = node->next) {
+        node->prev = prev;
+        prev = node;
+    }
+
+    list->tail = prev;
+}
+
+/**
+ * stable bottom-up merge sort, O(n log n) and no allocation: nodes are relinked, never copied.
+ * run[i] holds a sorted run of 2^i nodes, each node is carried in like a binary counter.
+ */
+void GenericDoublyList_Sort(GenericDoublyList* list, GenericDoublyList_CompareFunc compare) {
+    GenericDoublyListNode* run[64] = { NULL };
+    GenericDoublyListNode* node = list->head;
+    GenericDoublyListNode* next;
+    GenericDoublyListNode* carry;
+    size_t i;
+
+    while (node != NULL) {
+        next = node->next;
+        node->next = NULL;
+        carry = node;
+
+        for (i = 0; run[i] != NULL; ++i) {
+            carry = GenericDoublyList_MergeRuns(run[i], carry, compare);
+            run[i] = NULL;
+        }
+
+        run[i] = carry;
+        node = next;
+    }
+
+    for (carry = NULL, i = 0; i < 64; ++i) {
+        if (run[i] != NULL) {
+            carry = (carry == NULL) ? run[i] : GenericDoublyList_MergeRuns(run[i], carry, compare);
+        }
+    }
+
+    GenericDoublyList_Relink(list, carry);
+}
+
+/**
+ * both lists sorted, move every node of other into list in order. other ends up empty, O(n).
+ * return 0 when out of memory, nothing is moved then.
+ */
+int GenericDoublyList_Merge(GenericDoublyList* list, GenericDoublyList* other, GenericDoublyList_CompareFunc compare) {
+    if (list == other || other->head == NULL) {
+        return 1;
+    }
+
+    if (!NodeSlabSet_Merge(&list->slabs, &other->slabs)) {
+        return 0;
+    }
+
+    GenericDoublyList_Relink(list, GenericDoublyList_MergeRuns(list->head, other->head, compare));
+    list->length += other->length;
+    other->head = other->tail = NULL;
+    other->length = 0;
+    return 1;
+}
+
+/**
+ * move the nodes [first, last] of other in front of pos in list (pos NULL means at the end), O(1).
+ * count is the number of nodes in the range, the caller knows it, a constant time splice can't
+ * count them. other may be list itself, then pos must not be inside the range.
+ * return 0 when out of memory (list could not take over the slabs of other), nothing is moved then.
+ */
+int GenericDoublyList_Splice(GenericDoublyList* list, GenericDoublyListNode* pos, GenericDoublyList* other, GenericDoublyListNode* first, GenericDoublyListNode* last, size_t count) {
+    if (list != other && !NodeSlabSet_Merge(&list->slabs, &other->slabs)) {
+        return 0;
+    }
+
+    if (first->prev != NULL) {
+        first->prev->next = last->next;
+    }
+    else {
+        other->head = last->next;
+    }
+
+    if (last->next != NULL) {
+        last->next->prev = first->prev;
+    }
+    else {
+        other->tail = first->prev;
+    }
+
+    other->length -= count;
+
+    if (pos == NULL) {
+        first->prev = list->tail;
+        last->next = NULL;
+
+        if (list->tail != NULL) {
+            list->tail->next = first;
+        }
+        else {
+            list->head = first;
+        }
+
+        list->tail = last;
+    }
+    else {
+        first->prev = pos->prev;
+        last->next = pos;
+
+        if (pos->prev != NULL) {
+            pos->prev->next = first;
+        }
+        else {
+            list->head = first;
+        }
+
+        pos->prev = last;
+    }
+
+    list->length += count;
+    return 1;
+}
+
+/* move all of other in front of pos in list, O(1). */
+int GenericDoublyList_SpliceAll(GenericDoublyList* list, GenericDoublyListNode* pos, GenericDoublyList* other) {
+    if (list != other && other->head != NULL) {
+        return GenericDoublyList_Splice(list, pos, other, other->head, other->tail, other->length);
+    }
+
+    return 1;
+}
+
+/**
+ * copy every node with its element, in list order, into one contiguous slab and free the old ones,
+ * so a traversal walks memory sequentially again after a lot of insert/delete churn. the elements
+ * move too: every node and element pointer the caller holds is invalidated. return 0 when out of
+ * memory, the list is unchanged then.
+ */
+int GenericDoublyList_Compact(GenericDoublyList* list) {
+    NodeSlabSet old = list->slabs;
+    size_t stride = NodeSlab_Stride(sizeof(GenericDoublyListNode) + list->elemSize);
+    NodeSlab* slab;
+    GenericDoublyListNode* copy;
+    GenericDoublyListNode* prev = NULL;
+    GenericDoublyListNode* node;
+    GenericDoublyListNode* next;
+    char* dst;
+
+    if (list->length == 0) {
+        return 1;
+    }
+
+    if ((slab = NodeSlab_CreateNew(stride, list->length)) == NULL) {
+        return 0;
+    }
+
+    NodeSlabSet_Init(&list->slabs);
+    if (!NodeSlabSet_Add(&list->slabs, slab)) {
+        NodeSlab_Destroy(slab);
+        list->slabs = old;
+        return 0;
+    }
+
+    ContainerStats_OnAlloc(&list->stats, list->length * (sizeof(GenericDoublyListNode) + list->elemSize));
+
+    for (dst = slab->begin, node = list->head; node != NULL; dst += stride, node = next) {
+        next = node->next;
+        copy = (GenericDoublyListNode*)dst;
+        copy->prev = prev;
+        copy->next = (next == NULL) ? NULL : (GenericDoublyListNode*)(dst + stride);
+        memcpy(GenericDoublyList_NodeData(copy), GenericDoublyList_NodeData(node), list->elemSize);
+        prev = copy;
+
+        if (!NodeSlabSet_FreeNode(&old, node)) {
+            free(node);
+        }
+
+        ContainerStats_OnFree(&list->stats, sizeof(GenericDoublyListNode) + list->elemSize);
+    }
+
+    NodeSlabSet_Release(&old);
+    list->head = (GenericDoublyListNode*)slab->begin;
+    list->tail = prev;
+    return 1;
+}
+
+#ifdef CONTAINER_STATS
+void GenericDoublyList_GetStats(GenericDoublyList* list, ContainerStats* out) {
+    *out = list->stats;
+}
+#endif
+
+int compare_int_descending(const void* left, const void* right) {
+    return *(const int*)right - *(const int*)left;
+}
+
+int generic_dlist_is_odd(void* elem, void* arg) {
+    return *(int*)elem % 2 != 0;
+}
+
+int compare_uint64(const void* left, const void* right) {
+    return (*(const uint64_t*)left > *(const uint64_t*)right) - (*(const uint64_t*)left < *(const uint64_t*)right);
+}
+
+static double seconds_since(const struct timespec* begin) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - begin->tv_sec) + (double)(end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+#define GENERIC_DLIST_BENCH_NODES   (1 << 20)
+#define GENERIC_DLIST_BENCH_WALKS   20
+
+double bench_generic_dlist_walk(GenericDoublyList* list, uint64_t* sum) {
+    struct timespec begin;
+    GenericDoublyListNode* node;
+    int i;
+
+    *sum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < GENERIC_DLIST_BENCH_WALKS; ++i) {
+        GenericDoublyList_ForEach(list, node) {
+            *sum += *(uint64_t*)GenericDoublyList_NodeData(node);
+        }
+    }
+
+    return seconds_since(&begin);
+}
+
 int main() {
     GenericDoublyList* list = GenericDoublyList_CreateNew(sizeof(int), NULL);
 
@@ -168,19 +483,71 @@ int main() {
     }
 
     GenericDoublyListNode* node;
-    for (node = list->head; node != NULL;) {
-        if (*(int*)GenericDoublyList_NodeData(node) % 2 != 0) {
-            node = GenericDoublyList_RemoveNode(list, node, 1);
-        }
-        else {
-            node = node->next;
-        }
-    }
+    GenericDoublyList_RemoveIf(list, generic_dlist_is_odd, NULL);
 
     GenericDoublyList_ForEach(list, node) {
         printf("%d\n", *(int*)GenericDoublyList_NodeData(node));
     }
 
+    /* descending order, then move the two largest behind the rest in O(1). */
+    GenericDoublyList_Sort(list, compare_int_descending);
+    GenericDoublyList_Splice(list, NULL, list, list->head, list->head->next, 2);
+
+    printf("sorted and spliced:");
+    GenericDoublyList_ForEach(list, node) {
+        printf(" %d", *(int*)GenericDoublyList_NodeData(node));
+    }
+    printf("\n");
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    GenericDoublyList_GetStats(list, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
+    GenericDoublyList_Destroy(list);
+
+    /* PushFront links the old head back to the new one, walking from the tail gives the push order. */
+    list = GenericDoublyList_CreateNew(sizeof(int), NULL);
+    for (i = 0; i < 5; ++i) {
+        *(int*)GenericDoublyList_PushFront(list) = i;
+    }
+
+    i = 0;
+    GenericDoublyList_ForEachReverse(list, node) {
+        if (*(int*)GenericDoublyList_NodeData(node) != i) {
+            break;
+        }
+
+        i += 1;
+    }
+    printf("reverse walk after push front: %s\n", i == 5 && node == NULL && list->head->prev == NULL ? "ok" : "FAILED");
+
+    GenericDoublyList_Destroy(list);
+
+    /* sorted by random keys the list order no longer follows the address order, Compact restores it. */
+    uint64_t x = 88172645463325252ull;
+    uint64_t sum;
+
+    list = GenericDoublyList_CreateNew(sizeof(uint64_t), NULL);
+    for (i = 0; i < GENERIC_DLIST_BENCH_NODES; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        *(uint64_t*)GenericDoublyList_PushBack(list) = x >> 16;
+    }
+
+    double freshSeconds = bench_generic_dlist_walk(list, &sum);
+    GenericDoublyList_Sort(list, compare_uint64);
+    double scatteredSeconds = bench_generic_dlist_walk(list, &sum);
+    GenericDoublyList_Compact(list);
+    double compactSeconds = bench_generic_dlist_walk(list, &sum);
+
+    printf("\n%d nodes, %d walks\n", GENERIC_DLIST_BENCH_NODES, GENERIC_DLIST_BENCH_WALKS);
+    printf("  allocation order: %.4f s\n", freshSeconds);
+    printf("  after sort:       %.4f s\n", scatteredSeconds);
+    printf("  after compact:    %.4f s (checksum %llu)\n", compactSeconds, (unsigned long long)sum);
+
     GenericDoublyList_Destroy(list);
     return 0;
 }
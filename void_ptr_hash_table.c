@@ -1,7 +1,20 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "container_stats.h"
+#include "bloom_filter.h"
+#include "node_slab.h"
+#include "reclaimer.h"
+#include "parallel_build.h"
 
 #define DEFAULT_HASH_TABLE_BUCKET_MAX_LEN   256
 
@@ -9,6 +22,7 @@ typedef unsigned int (*GenericHashTable_HashFunc) (void*);
 typedef int (*GenericHashTable_CompareFunc) (void*, void*);
 typedef void(*GenericHashTable_RemoveKeyElemFunc)(void*);
 typedef void(*GenericHashTable_RemoveValueElemFunc)(void*);
+typedef uint64_t (*GenericHashTable_BloomHashFunc) (void*);   /* full 64-bit hash for the Bloom filter, not a bucket index. */
 
 void GenericHashTable_RemoveKeyElemFunc_Default(void*) {}
 void GenericHashTable_RemoveValueElemFunc_Default(void*) {}
@@ -28,6 +42,13 @@ typedef struct GenericHashTable {
     GenericHashTable_CompareFunc compareFunc;
     GenericHashTable_RemoveKeyElemFunc removeKeyElemFunc;
     GenericHashTable_RemoveValueElemFunc removeValueElemFunc;
+
+    BloomFilter* bloom;   /* optional, see GenericHashTable_AttachBloomFilter. */
+    GenericHashTable_BloomHashFunc bloomHash;
+
+    NodeSlabSet slabs;   /* slabs of GenericHashTable_Compact holding some of the nodes. */
+
+    CONTAINER_STATS_FIELD(stats)
 } GenericHashTable;
 
 #define GenericHashNode_Key(hashTablePtr, nodePtr) \
@@ -42,14 +63,33 @@ typedef struct GenericHashTable {
 #define GenericHashTable_BucketSize(hashTablePtr) \
     ((hashTablePtr)->bucketSize)   
 
+#define GenericHashTable_NodeSize(hashTablePtr) \
+    (sizeof(GenericHashNode) + (hashTablePtr)->keyElemSize + (hashTablePtr)->valueElemSize)
+
 #define GenericHashTable_CreateNode(hashTablePtr) \
-    (GenericHashNode*)malloc(sizeof(GenericHashNode) + ht->keyElemSize + ht->valueElemSize)
+    GenericHashTable_AllocNode(hashTablePtr)
+
+
+GenericHashNode* GenericHashTable_AllocNode(GenericHashTable* ht) {
+    GenericHashNode* node = (GenericHashNode*)malloc(GenericHashTable_NodeSize(ht));
 
+    if (node != NULL) {
+        ContainerStats_OnAlloc(&ht->stats, GenericHashTable_NodeSize(ht));
+    }
+
+    return node;
+}
 
 void GenericHashTable_RemoveNode(GenericHashTable* ht, GenericHashNode* node) {
     ht->removeKeyElemFunc(GenericHashNode_Key(ht, node));
     ht->removeValueElemFunc(GenericHashNode_Value(ht, node));
-    free(node);
+
+    /* a node copied by GenericHashTable_Compact lives in a slab, the slab is released with its last node. */
+    if (!NodeSlabSet_FreeNode(&ht->slabs, node)) {
+        free(node);
+    }
+
+    ContainerStats_OnFree(&ht->stats, GenericHashTable_NodeSize(ht));
 }
 
 GenericHashTable* GenericHashTable_CreateNew(size_t bucketSize,
@@ -88,6 +128,11 @@ GenericHashTable* GenericHashTable_CreateNew(size_t bucketSize,
     ht->compareFunc = compareFunc;
     ht->removeKeyElemFunc = (removeKeyElemFunc == NULL ? GenericHashTable_RemoveKeyElemFunc_Default : removeKeyElemFunc);
     ht->removeValueElemFunc = (removeValueElemFunc == NULL ? GenericHashTable_RemoveValueElemFunc_Default : removeValueElemFunc);
+    ht->bloom = NULL;
+    ht->bloomHash = NULL;
+    NodeSlabSet_Init(&ht->slabs);
+    ContainerStats_Init(&ht->stats, "GenericHashTable");
+    ContainerStats_OnAlloc(&ht->stats, ht->bucketSize * sizeof(GenericHashNode*));
     return ht;
 }
 
@@ -106,30 +151,242 @@ void GenericHashTable_Destroy(GenericHashTable* ht) {
             }
         }
     }
+
+    if (ht->bloom != NULL) {
+        BloomFilter_Destroy(ht->bloom);
+        ht->bloom = NULL;
+    }
+
+    NodeSlabSet_Release(&ht->slabs);
 }
 
-GenericHashNode* GenericHashTable_Search(GenericHashTable* ht, void* key) {
+/* Reclaimer_StepFunc of a detached table, bucketSize is the cursor. the table itself goes last. */
+static size_t GenericHashTable_ReclaimStep(void* garbage, size_t budget) {
+    GenericHashTable* ht = (GenericHashTable*)garbage;
     GenericHashNode* node;
+    size_t n = 0;
+
+    while (ht->bucketSize > 0 && n < budget) {
+        if ((node = ht->bucket[ht->bucketSize - 1]) == NULL) {
+            ht->bucketSize -= 1;
+            continue;
+        }
+
+        ht->bucket[ht->bucketSize - 1] = node->next;
+        GenericHashTable_RemoveNode(ht, node);
+        n += 1;
+    }
+
+    if (n < budget) {
+        if (ht->bloom != NULL) {
+            BloomFilter_Destroy(ht->bloom);
+        }
+
+        NodeSlabSet_Release(&ht->slabs);
+        free(ht->bucket);
+        free(ht);
+    }
+
+    return n;
+}
+
+/**
+ * like GenericHashTable_Destroy, but the nodes are freed and the remove callbacks are called on the
+ * reclaimer thread, the caller only pays O(1). the bucket array and the table itself are released
+ * too, ht must not be used afterwards. falls back to the synchronous path when out of memory.
+ */
+void GenericHashTable_DestroyAsync(GenericHashTable* ht, Reclaimer* reclaimer) {
+    if (!Reclaimer_Submit(reclaimer, GenericHashTable_ReclaimStep, ht, ht->length + 1)) {
+        GenericHashTable_Destroy(ht);
+        free(ht->bucket);
+        free(ht);
+    }
+}
+
+typedef struct GenericHashTableBuild {
+    GenericHashTable* ht;
+    char* nodes;
+    size_t stride;
+    const char* keys;
+    const char* values;
+} GenericHashTableBuild;
+
+static size_t GenericHashTable_BuildHash(void* ctx, size_t item) {
+    GenericHashTableBuild* build = (GenericHashTableBuild*)ctx;
+    return build->ht->hashFunc((void*)(build->keys + item * build->ht->keyElemSize));
+}
+
+static void GenericHashTable_BuildPlace(void* ctx, size_t item, size_t slot) {
+    GenericHashTableBuild* build = (GenericHashTableBuild*)ctx;
+    GenericHashNode* node = (GenericHashNode*)(build->nodes + slot * build->stride);
+
+    memcpy(GenericHashNode_Key(build->ht, node), build->keys + item * build->ht->keyElemSize, build->ht->keyElemSize);
+    memcpy(GenericHashNode_Value(build->ht, node), build->values + item * build->ht->valueElemSize, build->ht->valueElemSize);
+}
+
+static void GenericHashTable_BuildLink(void* ctx, size_t bucket, size_t begin, size_t end) {
+    GenericHashTableBuild* build = (GenericHashTableBuild*)ctx;
+    size_t slot;
+
+    for (slot = begin; slot + 1 < end; ++slot) {
+        ((GenericHashNode*)(build->nodes + slot * build->stride))->next = (GenericHashNode*)(build->nodes + (slot + 1) * build->stride);
+    }
+
+    if (begin < end) {
+        ((GenericHashNode*)(build->nodes + (end - 1) * build->stride))->next = NULL;
+    }
+
+    build->ht->bucket[bucket] = (begin < end ? (GenericHashNode*)(build->nodes + begin * build->stride) : NULL);
+}
+
+/**
+ * build a table out of count keys and values, packed arrays of keyElemSize and valueElemSize bytes
+ * per entry, in one go: the keys are hashed on threadCount threads (0 means one per cpu), partitioned
+ * by bucket and the nodes are allocated as one block. no lookup is done, so the keys must be
+ * distinct, GenericHashTable_Set them one by one when they may repeat. hashFunc is called from
+ * several threads at once. return NULL when out of memory.
+ */
+GenericHashTable* GenericHashTable_CreateFromArrays(size_t bucketSize,
+                                                   size_t keyElemSize,
+                                                   size_t valueElemSize,
+                                                   GenericHashTable_HashFunc hashFunc,
+                                                   GenericHashTable_CompareFunc compareFunc,
+                                                   GenericHashTable_RemoveKeyElemFunc removeKeyElemFunc,
+                                                   GenericHashTable_RemoveValueElemFunc removeValueElemFunc,
+                                                   const void* keys,
+                                                   const void* values,
+                                                   size_t count,
+                                                   size_t threadCount)
+{
+    GenericHashTable* ht = GenericHashTable_CreateNew(bucketSize, keyElemSize, valueElemSize, hashFunc, compareFunc, removeKeyElemFunc, removeValueElemFunc);
+    GenericHashTableBuild build;
+    NodeSlab* slab;
+
+    if (ht == NULL || count == 0) {
+        return ht;
+    }
+
+    build.ht = ht;
+    build.stride = NodeSlab_Stride(GenericHashTable_NodeSize(ht));
+    build.keys = (const char*)keys;
+    build.values = (const char*)values;
+
+    if ((slab = NodeSlab_CreateNew(build.stride, count)) == NULL) {
+        free(ht->bucket);
+        free(ht);
+        return NULL;
+    }
+
+    build.nodes = slab->begin;
+
+    if (!NodeSlabSet_Add(&ht->slabs, slab) ||
+        !ParallelBuild_Run(&build, count, ht->bucketSize, threadCount, GenericHashTable_BuildHash, GenericHashTable_BuildPlace, GenericHashTable_BuildLink)) {
+        NodeSlabSet_Release(&ht->slabs);
+        NodeSlab_Destroy(slab);
+        free(ht->bucket);
+        free(ht);
+        return NULL;
+    }
+
+    ht->length = count;
+    ContainerStats_OnAlloc(&ht->stats, count * GenericHashTable_NodeSize(ht));
+    return ht;
+}
+
+/* replace the filter by one holding the current keys, the old one stays when out of memory. */
+static int GenericHashTable_RebuildBloomFilter(GenericHashTable* ht, size_t expectedKeys) {
+    BloomFilter* bloom;
+    GenericHashNode* node;
+    size_t i;
+
+    if ((bloom = BloomFilter_CreateNew(expectedKeys, 0)) == NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < ht->bucketSize; ++i) {
+        for (node = ht->bucket[i]; node != NULL; node = node->next) {
+            BloomFilter_Add(bloom, ht->bloomHash(GenericHashNode_Key(ht, node)));
+        }
+    }
+
+    if (ht->bloom != NULL) {
+        BloomFilter_Destroy(ht->bloom);
+    }
+
+    ht->bloom = bloom;
+    return 1;
+}
+
+/**
+ * put a Bloom filter in front of the buckets, a key it has never seen is rejected without walking a
+ * chain or calling compareFunc. GenericHashTable_Set keeps it in sync, it is rebuilt twice as large
+ * when the table outgrows it. expectedKeys 0 means the current length.
+ */
+int GenericHashTable_AttachBloomFilter(GenericHashTable* ht, GenericHashTable_BloomHashFunc bloomHash, size_t expectedKeys) {
+    if (bloomHash == NULL) {
+        return 0;
+    }
+
+    ht->bloomHash = bloomHash;
+    return GenericHashTable_RebuildBloomFilter(ht, expectedKeys > ht->length ? expectedKeys : ht->length);
+}
+
+void GenericHashTable_DetachBloomFilter(GenericHashTable* ht) {
+    if (ht->bloom != NULL) {
+        BloomFilter_Destroy(ht->bloom);
+    }
+
+    ht->bloom = NULL;
+    ht->bloomHash = NULL;
+}
+
+GenericHashNode* GenericHashTable_SearchInBucket(GenericHashTable* ht, unsigned int hashValue, void* key) {
+    GenericHashNode* node;
+    size_t probe = 0;
+
+    for (node = ht->bucket[hashValue]; node != NULL; node = node->next) {
+        probe += 1;
 
-    for (node = ht->bucket[ht->hashFunc(key)]; node != NULL; node = node->next) {
         if (ht->compareFunc(key, GenericHashNode_Key(ht, node)) != 0) {
-            return node;
+            break;
         }
     }
 
-    return NULL;
+    ContainerStats_OnProbe(&ht->stats, probe);
+    return node;
+}
+
+GenericHashNode* GenericHashTable_Search(GenericHashTable* ht, void* key) {
+    ContainerStats_OpBegin(&ht->stats, opBegin);
+    GenericHashNode* node = NULL;
+
+    if (ht->bloom == NULL || BloomFilter_MayContain(ht->bloom, ht->bloomHash(key))) {
+        node = GenericHashTable_SearchInBucket(ht, ht->hashFunc(key), key);
+    }
+    else {
+        ContainerStats_OnProbe(&ht->stats, 0);
+    }
+
+    ContainerStats_OpEnd(&ht->stats, opBegin);
+    return node;
 }
 
 void GenericHashTable_Set(GenericHashTable* ht, GenericHashNode* node) {
+    ContainerStats_OpBegin(&ht->stats, opBegin);
+    unsigned int hashValue = ht->hashFunc(GenericHashNode_Key(ht, node));
     GenericHashNode* findNode;
-    unsigned int hashValue;
 
-    if ((findNode = GenericHashTable_Search(ht, GenericHashNode_Key(ht, node))) == NULL) {
-        hashValue = ht->hashFunc(GenericHashNode_Key(ht, node));
+    if ((findNode = GenericHashTable_SearchInBucket(ht, hashValue, GenericHashNode_Key(ht, node))) == NULL) {
         node->next = ht->bucket[hashValue];
         ht->bucket[hashValue] = node;
         
         ht->length += 1;
+
+        /* the rebuild includes the new key. out of memory, the old filter gets fuller, it must not miss it. */
+        if (ht->bloom != NULL
+            && (ht->length <= BloomFilter_Capacity(ht->bloom) || !GenericHashTable_RebuildBloomFilter(ht, 2 * ht->length))) {
+            BloomFilter_Add(ht->bloom, ht->bloomHash(GenericHashNode_Key(ht, node)));
+        }
     }
     else {
         ht->removeKeyElemFunc(GenericHashNode_Key(ht, findNode));
@@ -138,6 +395,373 @@ void GenericHashTable_Set(GenericHashTable* ht, GenericHashNode* node) {
         memcpy(GenericHashNode_Key(ht, findNode), GenericHashNode_Key(ht, node), ht->keyElemSize);
         memcpy(GenericHashNode_Value(ht, findNode), GenericHashNode_Value(ht, node), ht->valueElemSize);
     }
+
+    ContainerStats_OpEnd(&ht->stats, opBegin);
+}
+
+/**
+ * copy every node with its key and value into one contiguous slab, bucket by bucket in chain order,
+ * and free the old ones, so walking a chain or the whole table reads memory sequentially again after
+ * a lot of churn. keys and values move too: every node pointer the caller holds is invalidated.
+ * return 0 when out of memory, the table is unchanged then.
+ */
+int GenericHashTable_Compact(GenericHashTable* ht) {
+    NodeSlabSet old = ht->slabs;
+    size_t stride = NodeSlab_Stride(GenericHashTable_NodeSize(ht));
+    NodeSlab* slab;
+    GenericHashNode* copy;
+    GenericHashNode* node;
+    GenericHashNode* next;
+    char* dst;
+    size_t i;
+
+    if (ht->length == 0) {
+        return 1;
+    }
+
+    if ((slab = NodeSlab_CreateNew(stride, ht->length)) == NULL) {
+        return 0;
+    }
+
+    NodeSlabSet_Init(&ht->slabs);
+    if (!NodeSlabSet_Add(&ht->slabs, slab)) {
+        NodeSlab_Destroy(slab);
+        ht->slabs = old;
+        return 0;
+    }
+
+    ContainerStats_OnAlloc(&ht->stats, ht->length * GenericHashTable_NodeSize(ht));
+    dst = slab->begin;
+
+    for (i = 0; i < ht->bucketSize; ++i) {
+        if (ht->bucket[i] == NULL) {
+            continue;
+        }
+
+        for (node = ht->bucket[i], ht->bucket[i] = (GenericHashNode*)dst; node != NULL; node = next, dst += stride) {
+            next = node->next;
+            copy = (GenericHashNode*)dst;
+            memcpy(copy, node, GenericHashTable_NodeSize(ht));
+            copy->next = (next == NULL) ? NULL : (GenericHashNode*)(dst + stride);
+
+            if (!NodeSlabSet_FreeNode(&old, node)) {
+                free(node);
+            }
+
+            ContainerStats_OnFree(&ht->stats, GenericHashTable_NodeSize(ht));
+        }
+    }
+
+    NodeSlabSet_Release(&old);
+    return 1;
+}
+
+#ifdef CONTAINER_STATS
+/* copy the counters, and fill the chain length histogram from the current buckets. */
+void GenericHashTable_GetStats(GenericHashTable* ht, ContainerStats* out) {
+    size_t i, len;
+    GenericHashNode* node;
+
+    *out = ht->stats;
+    memset(out->chainHistogram, 0, sizeof(out->chainHistogram));
+
+    for (i = 0; i < ht->bucketSize; ++i) {
+        len = 0;
+        for (node = ht->bucket[i]; node != NULL; node = node->next) {
+            len += 1;
+        }
+
+        ContainerStats_OnChain(out, len);
+    }
+}
+#endif
+
+/**
+ * on-disk image: a flat, offset-based copy of the table that can be mmap-ed read-only and searched
+ * in place, no parsing and no copying. layout:
+ *
+ *   GenericHashTableImageHeader
+ *   uint64_t bucketStart[bucketSize + 1]   index of the first entry of every bucket, the last one == length
+ *   entries                                key bytes then value bytes, grouped by bucket
+ *
+ * the value starts at valueOffset inside an entry and entries are entrySize apart, both padded so the
+ * key and value pointers Search hands back are aligned for any type of their size.
+ * keys and values are written byte by byte, so they must not hold pointers. the image must be
+ * searched with the same hashFunc / compareFunc the table was built with.
+ */
+#define GENERIC_HASH_TABLE_IMAGE_MAGIC        "GHTIMAGE"
+#define GENERIC_HASH_TABLE_IMAGE_VERSION      2
+#define GENERIC_HASH_TABLE_IMAGE_BYTE_ORDER   0x01020304u
+#define GENERIC_HASH_TABLE_IMAGE_ALIGN        64
+
+typedef struct GenericHashTableImageHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t bucketSize;
+    uint64_t length;
+    uint64_t keyElemSize;
+    uint64_t valueElemSize;
+    uint64_t valueOffset;    /* of the value inside an entry. */
+    uint64_t entrySize;      /* stride between two entries. */
+    uint64_t bucketOffset;   /* file offset of bucketStart. */
+    uint64_t entryOffset;    /* file offset of the first entry. */
+    uint64_t fileSize;
+} GenericHashTableImageHeader;
+
+typedef struct GenericHashTableImage {
+    void* base;
+    size_t mapLength;
+    const GenericHashTableImageHeader* header;
+    const uint64_t* bucketStart;
+    const char* entries;
+    size_t valueOffset;
+    size_t entrySize;
+
+    GenericHashTable_HashFunc hashFunc;
+    GenericHashTable_CompareFunc compareFunc;
+} GenericHashTableImage;
+
+#define GenericHashTableImage_Length(imagePtr) \
+    ((size_t)(imagePtr)->header->length)
+
+#define GenericHashTableImage_EntryKey(imagePtr, entryPtr) \
+    ((const void*)(entryPtr))
+
+#define GenericHashTableImage_EntryValue(imagePtr, entryPtr) \
+    ((const void*)((const char*)(entryPtr) + (imagePtr)->valueOffset))
+
+static uint64_t GenericHashTableImage_AlignUp(uint64_t offset) {
+    return (offset + GENERIC_HASH_TABLE_IMAGE_ALIGN - 1) & ~(uint64_t)(GENERIC_HASH_TABLE_IMAGE_ALIGN - 1);
+}
+
+/* the strictest alignment a type of this size can have: its lowest set bit, at most max_align_t. */
+static uint64_t GenericHashTableImage_AlignOf(uint64_t size) {
+    uint64_t align = size & (~size + 1);   /* 0 for size 0. */
+
+    if (align == 0) {
+        return 1;
+    }
+
+    return align < _Alignof(max_align_t) ? align : _Alignof(max_align_t);
+}
+
+static void GenericHashTableImage_EntryLayout(uint64_t keyElemSize, uint64_t valueElemSize, uint64_t* valueOffset, uint64_t* entrySize) {
+    uint64_t keyAlign = GenericHashTableImage_AlignOf(keyElemSize);
+    uint64_t valueAlign = GenericHashTableImage_AlignOf(valueElemSize);
+    uint64_t align = keyAlign > valueAlign ? keyAlign : valueAlign;
+
+    *valueOffset = (keyElemSize + valueAlign - 1) / valueAlign * valueAlign;
+    *entrySize = (*valueOffset + valueElemSize + align - 1) / align * align;
+}
+
+static int GenericHashTableImage_WritePadding(FILE* f, uint64_t from, uint64_t to) {
+    static const char zeros[GENERIC_HASH_TABLE_IMAGE_ALIGN] = { 0 };
+    return fwrite(zeros, 1, (size_t)(to - from), f) == (size_t)(to - from);
+}
+
+/* return 1 on success, 0 on failure (a partially written file is removed). */
+int GenericHashTable_SaveImage(GenericHashTable* ht, const char* filePath) {
+    GenericHashTableImageHeader header;
+    GenericHashNode* node;
+    uint64_t start = 0;
+    size_t i;
+    int ok = 1;
+
+    FILE* f = fopen(filePath, "wb");
+    if (f == NULL) {
+        return 0;
+    }
+
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GENERIC_HASH_TABLE_IMAGE_MAGIC, sizeof(header.magic));
+    header.version = GENERIC_HASH_TABLE_IMAGE_VERSION;
+    header.byteOrder = GENERIC_HASH_TABLE_IMAGE_BYTE_ORDER;
+    header.bucketSize = ht->bucketSize;
+    header.length = ht->length;
+    header.keyElemSize = ht->keyElemSize;
+    header.valueElemSize = ht->valueElemSize;
+    GenericHashTableImage_EntryLayout(ht->keyElemSize, ht->valueElemSize, &header.valueOffset, &header.entrySize);
+    header.bucketOffset = GenericHashTableImage_AlignUp(sizeof(header));
+    header.entryOffset = GenericHashTableImage_AlignUp(header.bucketOffset + (ht->bucketSize + 1) * sizeof(uint64_t));
+    header.fileSize = header.entryOffset + ht->length * header.entrySize;
+
+    ok = ok && fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && GenericHashTableImage_WritePadding(f, sizeof(header), header.bucketOffset);
+
+    for (i = 0; ok && i < ht->bucketSize; ++i) {
+        ok = fwrite(&start, sizeof(uint64_t), 1, f) == 1;
+
+        for (node = ht->bucket[i]; node != NULL; node = node->next) {
+            start += 1;
+        }
+    }
+
+    ok = ok && fwrite(&start, sizeof(uint64_t), 1, f) == 1;
+    ok = ok && GenericHashTableImage_WritePadding(f, header.bucketOffset + (ht->bucketSize + 1) * sizeof(uint64_t), header.entryOffset);
+
+    for (i = 0; ok && i < ht->bucketSize; ++i) {
+        for (node = ht->bucket[i]; ok && node != NULL; node = node->next) {
+            ok = fwrite(GenericHashNode_Key(ht, node), 1, ht->keyElemSize, f) == ht->keyElemSize &&
+                 GenericHashTableImage_WritePadding(f, ht->keyElemSize, header.valueOffset) &&
+                 fwrite(GenericHashNode_Value(ht, node), 1, ht->valueElemSize, f) == ht->valueElemSize &&
+                 GenericHashTableImage_WritePadding(f, header.valueOffset + ht->valueElemSize, header.entrySize);
+        }
+    }
+
+    if (fclose(f) != 0) {
+        ok = 0;
+    }
+
+    if (!ok) {
+        remove(filePath);
+    }
+
+    return ok;
+}
+
+/**
+ * every offset and size Search relies on must lie inside the mapping, and the entries must have the
+ * caller's key and value sizes. checked without forming a product or sum that can wrap: a bound is
+ * divided out of the space left instead.
+ */
+static int GenericHashTableImage_CheckLayout(const GenericHashTableImageHeader* header, uint64_t fileSize, size_t keyElemSize, size_t valueElemSize) {
+    const uint64_t* bucketStart;
+    uint64_t valueOffset, entrySize, i;
+
+    if (memcmp(header->magic, GENERIC_HASH_TABLE_IMAGE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != GENERIC_HASH_TABLE_IMAGE_VERSION ||
+        header->byteOrder != GENERIC_HASH_TABLE_IMAGE_BYTE_ORDER ||
+        header->fileSize != fileSize ||
+        header->bucketSize == 0 ||
+        header->keyElemSize == 0 ||
+        header->keyElemSize != keyElemSize ||
+        header->valueElemSize != valueElemSize ||
+        header->keyElemSize > fileSize ||
+        header->valueElemSize > fileSize) {
+        return 0;
+    }
+
+    GenericHashTableImage_EntryLayout(header->keyElemSize, header->valueElemSize, &valueOffset, &entrySize);
+    if (header->valueOffset != valueOffset || header->entrySize != entrySize) {
+        return 0;
+    }
+
+    /* bucketStart[bucketSize + 1], aligned for uint64_t reads, between the header and the entries. */
+    if (header->bucketOffset < sizeof(GenericHashTableImageHeader) ||
+        header->bucketOffset % sizeof(uint64_t) != 0 ||
+        header->bucketOffset > fileSize ||
+        header->bucketSize >= (fileSize - header->bucketOffset) / sizeof(uint64_t) ||
+        header->entryOffset < header->bucketOffset + (header->bucketSize + 1) * sizeof(uint64_t) ||
+        header->entryOffset % GENERIC_HASH_TABLE_IMAGE_ALIGN != 0 ||
+        header->entryOffset > fileSize) {
+        return 0;
+    }
+
+    if (header->length > (fileSize - header->entryOffset) / entrySize ||
+        header->entryOffset + header->length * entrySize != fileSize) {
+        return 0;
+    }
+
+    /* non-decreasing and ending at length, so every bucket's entries are inside the entry array. */
+    bucketStart = (const uint64_t*)((const char*)header + header->bucketOffset);
+    for (i = 0; i < header->bucketSize; ++i) {
+        if (bucketStart[i] > bucketStart[i + 1]) {
+            return 0;
+        }
+    }
+
+    return bucketStart[header->bucketSize] == header->length;
+}
+
+/**
+ * map the image read-only and shared, so every process opening the same file shares the page cache.
+ * a truncated or corrupt image, or one saved from a table with other key / value sizes, gives NULL.
+ * the whole layout is checked here and not on every Search.
+ */
+GenericHashTableImage* GenericHashTableImage_Open(const char* filePath,
+                                                  size_t keyElemSize,
+                                                  size_t valueElemSize,
+                                                  GenericHashTable_HashFunc hashFunc,
+                                                  GenericHashTable_CompareFunc compareFunc) {
+    GenericHashTableImage* image;
+    const GenericHashTableImageHeader* header;
+    struct stat st;
+    void* base;
+    int fd;
+
+    if (hashFunc == NULL || compareFunc == NULL) {
+        return NULL;
+    }
+
+    if ((fd = open(filePath, O_RDONLY)) < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GenericHashTableImageHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);   /* the mapping keeps the file alive. */
+
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    header = (const GenericHashTableImageHeader*)base;
+    if (!GenericHashTableImage_CheckLayout(header, (uint64_t)st.st_size, keyElemSize, valueElemSize)) {
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+
+    if ((image = (GenericHashTableImage*)malloc(sizeof(GenericHashTableImage))) == NULL) {
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+
+    posix_madvise(base, (size_t)st.st_size, POSIX_MADV_RANDOM);
+
+    image->base = base;
+    image->mapLength = (size_t)st.st_size;
+    image->header = header;
+    image->bucketStart = (const uint64_t*)((const char*)base + header->bucketOffset);
+    image->entries = (const char*)base + header->entryOffset;
+    image->valueOffset = (size_t)header->valueOffset;
+    image->entrySize = (size_t)header->entrySize;
+    image->hashFunc = hashFunc;
+    image->compareFunc = compareFunc;
+    return image;
+}
+
+void GenericHashTableImage_Close(GenericHashTableImage* image) {
+    munmap(image->base, image->mapLength);
+    free(image);
+}
+
+/* return the entry (key then value) inside the mapping, or NULL. */
+const void* GenericHashTableImage_Search(GenericHashTableImage* image, void* key) {
+    unsigned int hashValue = image->hashFunc(key);
+    const char* entry;
+    const char* end;
+
+    if (hashValue >= image->header->bucketSize) {
+        return NULL;
+    }
+
+    entry = image->entries + image->bucketStart[hashValue] * image->entrySize;
+    end = image->entries + image->bucketStart[hashValue + 1] * image->entrySize;
+
+    for (; entry != end; entry += image->entrySize) {
+        if (image->compareFunc(key, (void*)entry) != 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
 }
 
 /* usage. */
@@ -148,6 +772,10 @@ int compare(void* left, void* right) {
     return !strcmp((const char*)left, (const char*)right);
 }
 
+uint64_t bloom_hash(void* data) {
+    return BloomFilter_HashBytes(data, strlen((const char*)data));
+}
+
 unsigned int hash(void* data) {   /* from K & R. */
     const char* s = (const char*)data;
     unsigned hashval;
@@ -176,6 +804,8 @@ int main() {
                                                             NULL,
                                                             NULL);
 
+    GenericHashTable_AttachBloomFilter(hashTable, bloom_hash, 4);   /* grows on the fifth key. */
+
     create_my_hash_node(hashTable, "Bjarne", "Stroustrup");
     create_my_hash_node(hashTable, "a", "b");
     create_my_hash_node(hashTable, "c", "d");
@@ -190,5 +820,50 @@ int main() {
         printf("%s\n", (const char*)GenericHashNode_Value(hashTable, temp));
     }
 
-    GenericHashTable_Destroy(hashTable);
+    printf("Ken %s\n", GenericHashTable_Search(hashTable, "Ken") == NULL ? "not found" : "found");
+
+    /* the nodes move into one slab, the node pointer found above is stale now. */
+    GenericHashTable_Compact(hashTable);
+    temp = GenericHashTable_Search(hashTable, "Bjarne");
+    printf("compacted: %s\n", temp == NULL ? "not found" : (const char*)GenericHashNode_Value(hashTable, temp));
+
+    /* on-disk image. */
+    if (GenericHashTable_SaveImage(hashTable, "hash_table.img")) {
+        GenericHashTableImage* image = GenericHashTableImage_Open("hash_table.img", CHAR_BUF_MAX_LEN, CHAR_BUF_MAX_LEN, hash, compare);
+        const void* entry;
+
+        if (image != NULL) {
+            if ((entry = GenericHashTableImage_Search(image, "Bjarne")) != NULL) {
+                printf("image: %s\n", (const char*)GenericHashTableImage_EntryValue(image, entry));
+            }
+
+            printf("image: %zu entries, %s\n", GenericHashTableImage_Length(image),
+                   GenericHashTableImage_Search(image, "Ken") == NULL ? "Ken not found" : "Ken found");
+            GenericHashTableImage_Close(image);
+        }
+
+        remove("hash_table.img");
+    }
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    GenericHashTable_GetStats(hashTable, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
+    /* the same entries again, built from packed arrays in one go. */
+    const char names[][CHAR_BUF_MAX_LEN] = { "Bjarne", "a", "c", "e", "Dennis" };
+    const char surnames[][CHAR_BUF_MAX_LEN] = { "Stroustrup", "b", "d", "f", "Ritchie" };
+    GenericHashTable* bulk = GenericHashTable_CreateFromArrays(BUCKET_SIZE, CHAR_BUF_MAX_LEN * sizeof(char), CHAR_BUF_MAX_LEN * sizeof(char),
+                                                               hash, compare, NULL, NULL, names, surnames, 5, 0);
+    temp = GenericHashTable_Search(bulk, "Dennis");
+    printf("bulk: %zu entries, %s\n", GenericHashTable_Length(bulk), temp == NULL ? "not found" : (const char*)GenericHashNode_Value(bulk, temp));
+
+    /* the nodes are freed on the reclaimer thread, main goes on at once. */
+    Reclaimer* reclaimer = Reclaimer_CreateNew(0);
+    GenericHashTable_DestroyAsync(hashTable, reclaimer);
+    GenericHashTable_DestroyAsync(bulk, reclaimer);
+    Reclaimer_Wait(reclaimer);
+    Reclaimer_Destroy(reclaimer);
+    return 0;
 }
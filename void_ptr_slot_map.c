@@ -0,0 +1,398 @@
+/**
+ * generational slot map: values stay contiguous like GenericArray, and a handle keeps naming the
+ * same value until it is removed, no matter how the values move.
+ *
+ * a handle is (generation << 32 | slot). the slot holds the value's current dense index and a
+ * generation that is bumped on insert and on remove, odd while the slot is in use. a handle whose
+ * generation differs from its slot's is stale, lookups return NULL for it instead of touching
+ * whatever was stored there later. removal swap-removes in the dense part, so both insert and remove
+ * are O(1) and iteration is a linear scan. handle 0 is never valid.
+ *
+ * build: cc -std=c11 -O2 void_ptr_slot_map.c
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "container_stats.h"
+
+#define GENERIC_SLOT_MAP_NULL_HANDLE   ((GenericSlotMapHandle)0)
+#define GENERIC_SLOT_MAP_NO_SLOT       UINT32_MAX
+
+typedef uint64_t GenericSlotMapHandle;
+
+typedef void(*GenericSlotMap_RemoveElemFunc)(void*);
+void GenericSlotMap_RemoveElemFunc_Default(void* elem) {}
+
+typedef struct GenericSlotMapSlot {
+    uint32_t index;        /* dense index while in use, next free slot otherwise. */
+    uint32_t generation;   /* odd while in use. */
+} GenericSlotMapSlot;
+
+typedef struct GenericSlotMap {
+    void* data;            /* dense values. */
+    uint32_t* denseToSlot; /* the slot of each dense value, to fix it up after a swap-remove. */
+    size_t capacity;
+    size_t length;
+    size_t elemSize;
+
+    GenericSlotMapSlot* slots;
+    size_t slotCount;
+    size_t slotCapacity;
+    uint32_t freeSlot;
+
+    GenericSlotMap_RemoveElemFunc removeElemFunc;
+
+    CONTAINER_STATS_FIELD(stats)
+} GenericSlotMap;
+
+#define GenericSlotMap_MakeHandle(slot, generation)   (((GenericSlotMapHandle)(generation) << 32) | (GenericSlotMapHandle)(slot))
+#define GenericSlotMap_HandleSlot(handle)             ((uint32_t)((handle) & 0xffffffffu))
+#define GenericSlotMap_HandleGeneration(handle)       ((uint32_t)((handle) >> 32))
+
+/* dense access, the order changes on removal. */
+#define GenericSlotMap_At(mapPtr, index) \
+    ((char*)((mapPtr)->data) + (index) * (mapPtr)->elemSize)
+
+#define GenericSlotMap_Length(mapPtr)     ((mapPtr)->length)
+#define GenericSlotMap_Data(mapPtr)       ((mapPtr)->data)
+#define GenericSlotMap_IsEmpty(mapPtr)    (GenericSlotMap_Length(mapPtr) == 0)
+
+/* the handle of the value at a dense index. */
+#define GenericSlotMap_HandleAt(mapPtr, index) \
+    GenericSlotMap_MakeHandle((mapPtr)->denseToSlot[(index)], (mapPtr)->slots[(mapPtr)->denseToSlot[(index)]].generation)
+
+#define GenericSlotMap_ForEach(mapPtr, cursor) \
+    for (cursor = 0; cursor < GenericSlotMap_Length(mapPtr); ++cursor)
+
+GenericSlotMap* GenericSlotMap_CreateNew(size_t capacity, size_t elemSize, GenericSlotMap_RemoveElemFunc func) {
+    GenericSlotMap* map;
+
+    if (elemSize == 0) {
+        return NULL;
+    }
+
+    if ((map = (GenericSlotMap*)malloc(sizeof(GenericSlotMap))) == NULL) {
+        return NULL;
+    }
+
+    map->removeElemFunc = (func == NULL ? GenericSlotMap_RemoveElemFunc_Default : func);
+    map->elemSize = elemSize;
+    map->length = 0;
+    map->capacity = (capacity == 0 ? 16 : capacity);
+    map->slotCount = 0;
+    map->slotCapacity = map->capacity;
+    map->freeSlot = GENERIC_SLOT_MAP_NO_SLOT;
+
+    map->data = malloc(map->capacity * elemSize);
+    map->denseToSlot = (uint32_t*)malloc(map->capacity * sizeof(uint32_t));
+    map->slots = (GenericSlotMapSlot*)malloc(map->slotCapacity * sizeof(GenericSlotMapSlot));
+
+    if (map->data == NULL || map->denseToSlot == NULL || map->slots == NULL) {
+        free(map->data);
+        free(map->denseToSlot);
+        free(map->slots);
+        free(map);
+        return NULL;
+    }
+
+    ContainerStats_Init(&map->stats, "GenericSlotMap");
+    ContainerStats_OnAlloc(&map->stats, map->capacity * (elemSize + sizeof(uint32_t)) + map->slotCapacity * sizeof(GenericSlotMapSlot));
+    return map;
+}
+
+void GenericSlotMap_Destroy(GenericSlotMap* map) {
+    size_t i;
+    GenericSlotMap_ForEach(map, i) {
+        map->removeElemFunc(GenericSlotMap_At(map, i));
+    }
+
+    free(map->data);
+    free(map->denseToSlot);
+    free(map->slots);
+    free(map);
+}
+
+int GenericSlotMap_ExpandCapacity(GenericSlotMap* map, size_t newCapacity) {
+    void* data;
+    uint32_t* denseToSlot;
+
+    if (newCapacity > GENERIC_SLOT_MAP_NO_SLOT) {
+        return 0;
+    }
+
+    if ((denseToSlot = (uint32_t*)realloc(map->denseToSlot, newCapacity * sizeof(uint32_t))) == NULL) {
+        return 0;
+    }
+
+    map->denseToSlot = denseToSlot;
+
+    if ((data = realloc(map->data, newCapacity * map->elemSize)) == NULL) {
+        return 0;
+    }
+
+    ContainerStats_OnGrow(&map->stats, map->capacity * (map->elemSize + sizeof(uint32_t)), newCapacity * (map->elemSize + sizeof(uint32_t)));
+    map->data = data;
+    map->capacity = newCapacity;
+    return 1;
+}
+
+/* a free slot, either recycled or new. GENERIC_SLOT_MAP_NO_SLOT when out of memory. */
+static uint32_t GenericSlotMap_TakeSlot(GenericSlotMap* map) {
+    GenericSlotMapSlot* slots;
+    uint32_t slot;
+
+    if (map->freeSlot != GENERIC_SLOT_MAP_NO_SLOT) {
+        slot = map->freeSlot;
+        map->freeSlot = map->slots[slot].index;
+        return slot;
+    }
+
+    if (map->slotCount == map->slotCapacity) {
+        if ((slots = (GenericSlotMapSlot*)realloc(map->slots, 2 * map->slotCapacity * sizeof(GenericSlotMapSlot))) == NULL) {
+            return GENERIC_SLOT_MAP_NO_SLOT;
+        }
+
+        ContainerStats_OnGrow(&map->stats, map->slotCapacity * sizeof(GenericSlotMapSlot), 2 * map->slotCapacity * sizeof(GenericSlotMapSlot));
+        map->slots = slots;
+        map->slotCapacity *= 2;
+    }
+
+    map->slots[map->slotCount].generation = 0;
+    return (uint32_t)map->slotCount++;
+}
+
+/* room for a new value at the end of the dense part, its handle goes to *handle. NULL when out of memory. */
+void* GenericSlotMap_Insert(GenericSlotMap* map, GenericSlotMapHandle* handle) {
+    uint32_t slot;
+
+    if (map->length == map->capacity) {
+        if (!GenericSlotMap_ExpandCapacity(map, 2 * map->capacity)) {
+            return NULL;
+        }
+    }
+
+    if ((slot = GenericSlotMap_TakeSlot(map)) == GENERIC_SLOT_MAP_NO_SLOT) {
+        return NULL;
+    }
+
+    map->slots[slot].index = (uint32_t)map->length;
+    map->slots[slot].generation += 1;
+    map->denseToSlot[map->length] = slot;
+    map->length += 1;
+
+    *handle = GenericSlotMap_MakeHandle(slot, map->slots[slot].generation);
+    return (void*)GenericSlotMap_At(map, map->length - 1);
+}
+
+/* the value of a live handle, NULL for a stale or invalid one. the pointer is valid until the next insert or remove. */
+void* GenericSlotMap_Get(GenericSlotMap* map, GenericSlotMapHandle handle) {
+    uint32_t slot = GenericSlotMap_HandleSlot(handle);
+    uint32_t generation = GenericSlotMap_HandleGeneration(handle);
+
+    if (slot >= map->slotCount || map->slots[slot].generation != generation || (generation & 1u) == 0) {
+        return NULL;
+    }
+
+    return (void*)GenericSlotMap_At(map, map->slots[slot].index);
+}
+
+/* return 0 when the handle is stale. */
+int GenericSlotMap_Remove(GenericSlotMap* map, GenericSlotMapHandle handle) {
+    uint32_t slot = GenericSlotMap_HandleSlot(handle);
+    size_t index, last;
+    void* elem;
+
+    if ((elem = GenericSlotMap_Get(map, handle)) == NULL) {
+        return 0;
+    }
+
+    map->removeElemFunc(elem);
+
+    index = map->slots[slot].index;
+    last = map->length - 1;
+
+    if (index != last) {
+        memcpy(elem, GenericSlotMap_At(map, last), map->elemSize);
+        map->denseToSlot[index] = map->denseToSlot[last];
+        map->slots[map->denseToSlot[index]].index = (uint32_t)index;
+    }
+
+    map->length -= 1;
+    map->slots[slot].generation += 1;
+    map->slots[slot].index = map->freeSlot;
+    map->freeSlot = slot;
+    return 1;
+}
+
+#ifdef CONTAINER_STATS
+void GenericSlotMap_GetStats(GenericSlotMap* map, ContainerStats* out) {
+    *out = map->stats;
+}
+#endif
+
+typedef struct Entity {
+    float x;
+    float y;
+    int hp;
+} Entity;
+
+/* the layout the slot map replaces: one malloc per entity, linked so pointers stay valid. */
+typedef struct EntityNode {
+    struct EntityNode* prev;
+    struct EntityNode* next;
+    Entity entity;
+} EntityNode;
+
+static double seconds_since(const struct timespec* begin) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - begin->tv_sec) + (double)(end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+#define BENCH_ENTITIES   1000000
+#define BENCH_ROUNDS     20
+
+/* insert n entities, remove a random third of them, then sum hp over the rest a few times. */
+void bench(void) {
+    GenericSlotMap* map = GenericSlotMap_CreateNew(0, sizeof(Entity), NULL);
+    GenericSlotMapHandle* handles = (GenericSlotMapHandle*)malloc(BENCH_ENTITIES * sizeof(GenericSlotMapHandle));
+    EntityNode** nodes = (EntityNode**)malloc(BENCH_ENTITIES * sizeof(EntityNode*));
+    EntityNode head;
+    EntityNode* node;
+    Entity* entity;
+    struct timespec begin;
+    uint64_t x = 88172645463325252ull;
+    long long mapSum = 0, listSum = 0;
+    double mapSeconds, listSeconds, mapIterate, listIterate;
+    size_t i, round;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < BENCH_ENTITIES; ++i) {
+        entity = (Entity*)GenericSlotMap_Insert(map, &handles[i]);
+        entity->x = entity->y = 0;
+        entity->hp = (int)(i & 0xff);
+    }
+
+    for (i = 0; i < BENCH_ENTITIES; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+
+        if (x % 3 == 0) {
+            GenericSlotMap_Remove(map, handles[i]);
+        }
+    }
+
+    mapSeconds = seconds_since(&begin);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (round = 0; round < BENCH_ROUNDS; ++round) {
+        GenericSlotMap_ForEach(map, i) {
+            mapSum += ((Entity*)GenericSlotMap_At(map, i))->hp;
+        }
+    }
+
+    mapIterate = seconds_since(&begin);
+
+    x = 88172645463325252ull;
+    head.prev = head.next = &head;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (i = 0; i < BENCH_ENTITIES; ++i) {
+        node = nodes[i] = (EntityNode*)malloc(sizeof(EntityNode));
+        node->entity.x = node->entity.y = 0;
+        node->entity.hp = (int)(i & 0xff);
+        node->next = &head;
+        node->prev = head.prev;
+        head.prev->next = node;
+        head.prev = node;
+    }
+
+    for (i = 0; i < BENCH_ENTITIES; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+
+        if (x % 3 == 0) {
+            nodes[i]->prev->next = nodes[i]->next;
+            nodes[i]->next->prev = nodes[i]->prev;
+            free(nodes[i]);
+        }
+    }
+
+    listSeconds = seconds_since(&begin);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (round = 0; round < BENCH_ROUNDS; ++round) {
+        for (node = head.next; node != &head; node = node->next) {
+            listSum += node->entity.hp;
+        }
+    }
+
+    listIterate = seconds_since(&begin);
+
+    printf("%zu entities, a third removed, %d passes\n", (size_t)BENCH_ENTITIES, BENCH_ROUNDS);
+    printf("%12s %14s %14s\n", "", "insert+remove", "iterate");
+    printf("%12s %12.4f s %12.4f s\n", "slot map", mapSeconds, mapIterate);
+    printf("%12s %12.4f s %12.4f s\n", "malloc list", listSeconds, listIterate);
+
+    if (mapSum != listSum) {
+        printf("sums differ: %lld %lld\n", mapSum, listSum);
+    }
+
+    while (head.next != &head) {
+        node = head.next;
+        head.next = node->next;
+        free(node);
+    }
+
+    free(nodes);
+    free(handles);
+    GenericSlotMap_Destroy(map);
+}
+
+int main() {
+    GenericSlotMap* map = GenericSlotMap_CreateNew(0, sizeof(Entity), NULL);
+    GenericSlotMapHandle handles[5];
+    Entity* entity;
+    size_t i;
+
+    for (i = 0; i < 5; ++i) {
+        entity = (Entity*)GenericSlotMap_Insert(map, &handles[i]);
+        entity->x = (float)i;
+        entity->y = (float)(i * 2);
+        entity->hp = (int)(100 + i);
+    }
+
+    GenericSlotMap_Remove(map, handles[1]);   /* the last entity moves into the hole. */
+
+    printf("handle 1 after remove: %p\n", GenericSlotMap_Get(map, handles[1]));
+    printf("handle 4 still finds hp %d\n", ((Entity*)GenericSlotMap_Get(map, handles[4]))->hp);
+
+    entity = (Entity*)GenericSlotMap_Insert(map, &handles[1]);   /* reuses slot 1 with a new generation. */
+    entity->hp = 999;
+    printf("new handle %#llx, old one stays stale\n", (unsigned long long)handles[1]);
+
+    GenericSlotMap_ForEach(map, i) {
+        entity = (Entity*)GenericSlotMap_At(map, i);
+        printf("  [%zu] handle %#llx hp %d\n", i, (unsigned long long)GenericSlotMap_HandleAt(map, i), entity->hp);
+    }
+
+#ifdef CONTAINER_STATS
+    ContainerStats stats;
+    GenericSlotMap_GetStats(map, &stats);
+    ContainerStats_Dump(&stats, stdout);
+#endif
+
+    GenericSlotMap_Destroy(map);
+    bench();
+    return 0;
+}